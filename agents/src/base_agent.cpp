@@ -71,8 +71,19 @@ bool BaseAgent::processData(const std::vector<float>& input) {
         return false;
     }
 
+    if (!aiModel) {
+        LOG_ERROR("No AI model loaded for agent: " + agentId);
+        return false;
+    }
+
     try {
-        lastOutput = aiModel->inference(input);
+        // lastOutput is reused across calls; resize only reallocates when a
+        // wider output than any seen before is requested
+        lastOutput.resize(aiModel->getOutputSize(input.size()));
+        if (!aiModel->inference(input.data(), input.size(), lastOutput.data(), lastOutput.size())) {
+            lastOutput.clear();
+            return false;
+        }
         return true;
     } catch (const std::exception& e) {
         LOG_ERROR("Error processing data in agent " + agentId + ": " + e.what());
@@ -81,10 +92,76 @@ bool BaseAgent::processData(const std::vector<float>& input) {
     }
 }
 
+bool BaseAgent::processData(const SparseVector& input) {
+    if (state != AgentState::RUNNING) {
+        LOG_ERROR("Cannot process data - agent not running: " + agentId);
+        return false;
+    }
+
+    if (!aiModel) {
+        LOG_ERROR("No AI model loaded for agent: " + agentId);
+        return false;
+    }
+
+    try {
+        lastOutput.resize(aiModel->getOutputSize(input.dimension));
+        if (!aiModel->inference(input, lastOutput.data(), lastOutput.size())) {
+            lastOutput.clear();
+            return false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error processing data in agent " + agentId + ": " + e.what());
+        state = AgentState::ERROR;
+        return false;
+    }
+}
+
+bool BaseAgent::processSample(const std::vector<float>& sample) {
+    if (state != AgentState::RUNNING) {
+        LOG_ERROR("Cannot process data - agent not running: " + agentId);
+        return false;
+    }
+
+    if (!aiModel) {
+        LOG_ERROR("No AI model loaded for agent: " + agentId);
+        return false;
+    }
+
+    try {
+        if (!stream) {
+            stream = aiModel->createStream(sample.size());
+            if (!stream) {
+                return false;
+            }
+        }
+        lastOutput.resize(aiModel->getOutputSize(stream->rowSize()));
+        if (!aiModel->inferenceStream(*stream, sample.data(), sample.size(), lastOutput.data(), lastOutput.size())) {
+            lastOutput.clear();
+            return false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error processing data in agent " + agentId + ": " + e.what());
+        state = AgentState::ERROR;
+        return false;
+    }
+}
+
+void BaseAgent::resetStream() {
+    if (stream) {
+        stream->reset();
+    }
+}
+
 std::vector<float> BaseAgent::getOutput() const {
     return lastOutput;
 }
 
+const std::vector<float>& BaseAgent::getLastOutput() const {
+    return lastOutput;
+}
+
 bool BaseAgent::loadModel(std::shared_ptr<AIModel> model) {
     if (!model) {
         LOG_ERROR("Attempted to load null model in agent: " + agentId);
@@ -92,6 +169,11 @@ bool BaseAgent::loadModel(std::shared_ptr<AIModel> model) {
     }
 
     aiModel = model;
+    // Stream state belongs to the model's stream configuration
+    stream.reset();
+    // Reserve the output buffer up front for models with a fixed output width
+    lastOutput.clear();
+    lastOutput.reserve(model->getOutputSize(0));
     LOG_INFO("Loaded AI model in agent: " + agentId);
     return true;
 }
@@ -36,7 +36,17 @@ public:
 
     // Data processing
     virtual bool processData(const std::vector<float>& input);
+    // Same for a sparse input (see AIModel::inference)
+    virtual bool processData(const SparseVector& input);
+    // Stateful processing of one sample of a stream: the model runs on the
+    // agent's stream state (see AIModel::createStream), created on the first
+    // sample. Samples must keep that first sample's width.
+    virtual bool processSample(const std::vector<float>& sample);
+    // Starts the stream over, e.g. after a gap in the samples
+    void resetStream();
     virtual std::vector<float> getOutput() const;
+    // Non-copying view of the output buffer reused by processData
+    const std::vector<float>& getLastOutput() const;
 
     // Model management
     bool loadModel(std::shared_ptr<AIModel> model);
@@ -49,6 +59,8 @@ protected:
     std::shared_ptr<AIModel> aiModel;
     std::unordered_map<std::string, std::string> configuration;
     std::vector<float> lastOutput;
+    // Null until the first processSample() with the current model
+    std::unique_ptr<StreamState> stream;
 };
 
 } // namespace xyz
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include "memory_account.h"
+
+namespace xyz {
+
+// Cache-line aligned, zero-initialized storage for weights and activations.
+// Alignment is 64 bytes so that every row of a padded matrix starts on an
+// AVX-512 vector boundary.
+//
+// A buffer can also borrow memory it does not own (e.g. a tensor inside a
+// memory-mapped model file); `owner` keeps that memory alive. Borrowed
+// memory may be read-only, so call detach() before writing to it. Copies of
+// a borrowed buffer are always owned.
+//
+// Owned storage is charged to the MemoryScope active when it is allocated
+// and credited back to the same account when freed, whichever thread frees
+// it.
+template<typename T>
+class AlignedBuffer {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t count) { resize(count); }
+
+    AlignedBuffer(const AlignedBuffer& other) { copyFrom(other); }
+    AlignedBuffer(AlignedBuffer&& other) noexcept { swap(other); }
+
+    AlignedBuffer& operator=(const AlignedBuffer& other) {
+        if (this != &other) {
+            AlignedBuffer tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        AlignedBuffer tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    ~AlignedBuffer() { release(); }
+
+    // Wraps `count` elements at `data`, which must be 64-byte aligned
+    static AlignedBuffer borrow(const T* data, size_t count, std::shared_ptr<const void> owner) {
+        AlignedBuffer buffer;
+        buffer.storage = const_cast<T*>(data);
+        buffer.length = count;
+        buffer.owner = std::move(owner);
+        return buffer;
+    }
+
+    // Borrowed view of this buffer's elements that keeps `keepAlive` alive;
+    // whoever owns the elements must outlive `keepAlive`
+    AlignedBuffer view(std::shared_ptr<const void> keepAlive) const {
+        return empty() ? AlignedBuffer() : borrow(storage, length, std::move(keepAlive));
+    }
+
+    bool isBorrowed() const { return owner != nullptr; }
+
+    // Copies borrowed elements into storage of its own
+    void detach() {
+        if (isBorrowed()) {
+            AlignedBuffer copy(*this);
+            swap(copy);
+        }
+    }
+
+    // Reallocates to hold `count` elements; contents are reset to zero
+    void resize(size_t count) {
+        release();
+        if (count == 0) {
+            return;
+        }
+        storage = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT)));
+        std::memset(static_cast<void*>(storage), 0, count * sizeof(T));
+        length = count;
+        tag = MemoryScope::active();
+        tag.charge(bytes());
+    }
+
+    void fill(const T& value) {
+        for (size_t i = 0; i < length; ++i) {
+            storage[i] = value;
+        }
+    }
+
+    T* data() { return storage; }
+    const T* data() const { return storage; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    size_t bytes() const { return length * sizeof(T); }
+
+    T& operator[](size_t i) { return storage[i]; }
+    const T& operator[](size_t i) const { return storage[i]; }
+
+    void swap(AlignedBuffer& other) noexcept {
+        std::swap(storage, other.storage);
+        std::swap(length, other.length);
+        std::swap(owner, other.owner);
+        std::swap(tag, other.tag);
+    }
+
+private:
+    void copyFrom(const AlignedBuffer& other) {
+        resize(other.length);
+        if (length > 0) {
+            std::memcpy(static_cast<void*>(storage), other.storage, length * sizeof(T));
+        }
+    }
+
+    void release() {
+        if (storage && !owner) {
+            tag.credit(bytes());
+            ::operator delete(storage, std::align_val_t(ALIGNMENT));
+        }
+        storage = nullptr;
+        length = 0;
+        owner.reset();
+        tag = MemoryTag();
+    }
+
+    T* storage = nullptr;
+    size_t length = 0;
+    std::shared_ptr<const void> owner;
+    MemoryTag tag;
+};
+
+} // namespace xyz
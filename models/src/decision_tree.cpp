@@ -0,0 +1,299 @@
+#include "decision_tree.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "kernels.h"
+#include "model_format.h"
+#include "simd_target.h"
+
+namespace xyz {
+
+namespace {
+
+// Rows walked in lockstep by the scalar kernel; enough independent chains to
+// overlap the cache misses of each level
+constexpr size_t LOCKSTEP_ROWS = 16;
+
+// Rows per leaf-index chunk in predictBatch, kept on the stack
+constexpr size_t PREDICT_CHUNK = 64;
+
+void traverseScalar(const TreeArrays& tree, int32_t root, uint32_t depth,
+                    const float* x, size_t rows, size_t stride, int32_t* leaves) {
+    for (size_t base = 0; base < rows; base += LOCKSTEP_ROWS) {
+        const size_t count = std::min(LOCKSTEP_ROWS, rows - base);
+        const float* block = x + base * stride;
+        int32_t node[LOCKSTEP_ROWS];
+        for (size_t j = 0; j < count; ++j) {
+            node[j] = root;
+        }
+        for (uint32_t d = 0; d < depth; ++d) {
+            for (size_t j = 0; j < count; ++j) {
+                const int32_t n = node[j];
+                node[j] = tree.child[n] + (block[j * stride + tree.feature[n]] > tree.threshold[n]);
+            }
+        }
+        std::memcpy(leaves + base, node, count * sizeof(int32_t));
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+// Eight rows per vector: every level is four gathers (node fields and the
+// selected feature) plus a compare, with no branches
+XYZ_TARGET_AVX2 void traverseAvx2(const TreeArrays& tree, int32_t root, uint32_t depth,
+                                  const float* x, size_t rows, size_t stride, int32_t* leaves) {
+    const int32_t s = static_cast<int32_t>(stride);
+    const __m256i rowOffsets = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+    size_t base = 0;
+    for (; base + 8 <= rows; base += 8) {
+        const float* block = x + base * stride;
+        __m256i node = _mm256_set1_epi32(root);
+        for (uint32_t d = 0; d < depth; ++d) {
+            __m256i f = _mm256_i32gather_epi32(tree.feature, node, 4);
+            __m256 t = _mm256_i32gather_ps(tree.threshold, node, 4);
+            __m256i c = _mm256_i32gather_epi32(tree.child, node, 4);
+            __m256 v = _mm256_i32gather_ps(block, _mm256_add_epi32(rowOffsets, f), 4);
+            // All-ones lanes (-1) where x > threshold, so subtracting moves right
+            __m256i goRight = _mm256_castps_si256(_mm256_cmp_ps(v, t, _CMP_GT_OQ));
+            node = _mm256_sub_epi32(c, goRight);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves + base), node);
+    }
+    if (base < rows) {
+        traverseScalar(tree, root, depth, x + base * stride, rows - base, stride, leaves + base);
+    }
+}
+#endif
+
+} // namespace
+
+void tree_kernels::traverseBatch(const TreeArrays& tree, int32_t root, uint32_t depth,
+                                 const float* x, size_t rows, size_t stride, int32_t* leaves) {
+#ifdef XYZ_X86_KERNELS
+    static const bool useAvx2 = kernels::detectSimdLevel() != kernels::SimdLevel::SCALAR;
+    // 32-bit gather offsets cover the eight rows of one block
+    if (useAvx2 && stride * 8 < static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        traverseAvx2(tree, root, depth, x, rows, stride, leaves);
+        return;
+    }
+#endif
+    traverseScalar(tree, root, depth, x, rows, stride, leaves);
+}
+
+bool tree_kernels::measureDepth(const TreeArrays& tree, int32_t root, std::vector<bool>& visited, uint32_t& depth) {
+    depth = 0;
+    std::vector<std::pair<int32_t, uint32_t>> pending = {{root, 0}};
+    while (!pending.empty()) {
+        const auto [node, level] = pending.back();
+        pending.pop_back();
+        if (visited[node]) {
+            return false;
+        }
+        visited[node] = true;
+        const int32_t next = tree.child[node];
+        if (next == node) {
+            depth = std::max(depth, level);
+            continue;
+        }
+        pending.push_back({next, level + 1});
+        pending.push_back({next + 1, level + 1});
+    }
+    return true;
+}
+
+DecisionTree::DecisionTree()
+    : nodeCount(0)
+    , outputs(0)
+    , features(0)
+    , depth(0)
+{
+}
+
+void DecisionTree::build(const std::vector<TreeNode>& nodes, size_t outputCount) {
+    if (nodes.empty()) {
+        throw std::invalid_argument("Decision tree needs at least one node");
+    }
+    if (outputCount == 0) {
+        throw std::invalid_argument("Decision tree needs at least one output");
+    }
+
+    // Breadth-first renumbering that allocates both children of a node as
+    // one adjacent pair
+    const int32_t count = static_cast<int32_t>(nodes.size());
+    std::vector<int32_t> order = {0};
+    std::vector<int32_t> newIndex(nodes.size(), -1);
+    std::vector<uint32_t> level(nodes.size(), 0);
+    newIndex[0] = 0;
+    uint32_t maxDepth = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const TreeNode& node = nodes[order[i]];
+        if (node.feature < 0) {
+            if (node.value.size() != outputCount) {
+                throw std::invalid_argument("Leaf value size does not match tree outputs");
+            }
+            continue;
+        }
+        for (int32_t c : {node.left, node.right}) {
+            if (c <= 0 || c >= count || newIndex[c] != -1) {
+                throw std::invalid_argument("Invalid or shared child index in decision tree");
+            }
+            newIndex[c] = static_cast<int32_t>(order.size());
+            level[c] = level[order[i]] + 1;
+            maxDepth = std::max(maxDepth, level[c]);
+            order.push_back(c);
+        }
+    }
+
+    nodeCount = order.size();
+    outputs = outputCount;
+    depth = maxDepth;
+    feature.resize(nodeCount);
+    threshold.resize(nodeCount);
+    child.resize(nodeCount);
+    value.resize(nodeCount * outputs);
+
+    for (size_t i = 0; i < nodeCount; ++i) {
+        const TreeNode& node = nodes[order[i]];
+        if (node.feature < 0) {
+            feature[i] = 0;
+            threshold[i] = std::numeric_limits<float>::infinity();
+            child[i] = static_cast<int32_t>(i);
+            std::copy(node.value.begin(), node.value.end(), value.data() + i * outputs);
+        } else {
+            feature[i] = node.feature;
+            threshold[i] = node.threshold;
+            child[i] = newIndex[node.left];
+            if (newIndex[node.right] != child[i] + 1) {
+                throw std::logic_error("Decision tree siblings are not adjacent");
+            }
+        }
+    }
+    updateShape();
+}
+
+DecisionTree DecisionTree::stump(int32_t feature, float threshold, float low, float high) {
+    std::vector<TreeNode> nodes(3);
+    nodes[0].feature = feature;
+    nodes[0].threshold = threshold;
+    nodes[0].left = 1;
+    nodes[0].right = 2;
+    nodes[1].value = {low};
+    nodes[2].value = {high};
+
+    DecisionTree tree;
+    tree.build(nodes, 1);
+    return tree;
+}
+
+void DecisionTree::updateShape() {
+    features = 0;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        if (child[i] != static_cast<int32_t>(i)) {
+            features = std::max(features, static_cast<size_t>(feature[i]) + 1);
+        }
+    }
+}
+
+DecisionTree DecisionTree::view(const std::shared_ptr<const void>& keepAlive) const {
+    DecisionTree result;
+    result.nodeCount = nodeCount;
+    result.outputs = outputs;
+    result.features = features;
+    result.depth = depth;
+    result.feature = feature.view(keepAlive);
+    result.threshold = threshold.view(keepAlive);
+    result.child = child.view(keepAlive);
+    result.value = value.view(keepAlive);
+    return result;
+}
+
+void DecisionTree::detachWeights() {
+    feature.detach();
+    threshold.detach();
+    child.detach();
+    value.detach();
+}
+
+void DecisionTree::predict(const float* x, float* output) const {
+    int32_t node = 0;
+    for (uint32_t d = 0; d < depth; ++d) {
+        node = child[node] + (x[feature[node]] > threshold[node]);
+    }
+    std::memcpy(output, leafValue(node), outputs * sizeof(float));
+}
+
+void DecisionTree::predictBatch(const float* x, size_t rows, size_t stride, float* output) const {
+    int32_t leaves[PREDICT_CHUNK];
+    for (size_t base = 0; base < rows; base += PREDICT_CHUNK) {
+        const size_t count = std::min(PREDICT_CHUNK, rows - base);
+        tree_kernels::traverseBatch(arrays(), 0, depth, x + base * stride, count, stride, leaves);
+        for (size_t j = 0; j < count; ++j) {
+            std::memcpy(output + (base + j) * outputs, leafValue(leaves[j]), outputs * sizeof(float));
+        }
+    }
+}
+
+void DecisionTree::save(ModelFileWriter& writer, const std::string& prefix) const {
+    writer.setAttribute(prefix + ".depth", std::to_string(depth));
+    writer.setAttribute(prefix + ".outputs", std::to_string(outputs));
+    writer.addTensor(prefix + ".feature", model_format::TensorType::INT32, {nodeCount}, feature.data());
+    writer.addTensor(prefix + ".threshold", model_format::TensorType::FLOAT32, {nodeCount}, threshold.data());
+    writer.addTensor(prefix + ".child", model_format::TensorType::INT32, {nodeCount}, child.data());
+    writer.addTensor(prefix + ".value", model_format::TensorType::FLOAT32, {nodeCount, outputs}, value.data());
+}
+
+void DecisionTree::load(const ModelFile& file, const std::string& prefix) {
+    const TensorInfo* f = file.findTensor(prefix + ".feature");
+    const TensorInfo* t = file.findTensor(prefix + ".threshold");
+    const TensorInfo* c = file.findTensor(prefix + ".child");
+    const TensorInfo* v = file.findTensor(prefix + ".value");
+    if (!f || !t || !c || !v) {
+        throw std::runtime_error("Missing tensors for decision tree " + prefix);
+    }
+
+    const size_t count = f->elementCount();
+    const size_t outputCount = std::stoul(file.getAttribute(prefix + ".outputs", "0"));
+    if (count == 0 || outputCount == 0 || t->elementCount() != count ||
+        c->elementCount() != count || v->elementCount() != count * outputCount) {
+        throw std::runtime_error("Malformed decision tree " + prefix);
+    }
+
+    // Children must stay inside the arrays or traversal would run off them.
+    // Leaves are evaluated on every remaining step, so they must be stored
+    // as build() writes them: feature 0 and an +inf threshold. Predictions
+    // take exactly `depth` steps, so it must match the tree: more would
+    // spin, fewer would stop on internal nodes.
+    const int32_t* childData = file.tensorDataInt(*c);
+    const int32_t* featureData = file.tensorDataInt(*f);
+    const float* thresholdData = file.tensorData(*t);
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t next = childData[i];
+        const bool leaf = next == static_cast<int32_t>(i);
+        if (featureData[i] < 0 || next < 0 || (!leaf && static_cast<size_t>(next) + 1 >= count) ||
+            (leaf && (featureData[i] != 0 || thresholdData[i] != std::numeric_limits<float>::infinity()))) {
+            throw std::runtime_error("Corrupt node " + std::to_string(i) + " in decision tree " + prefix);
+        }
+    }
+    const TreeArrays nodes = {featureData, thresholdData, childData};
+    std::vector<bool> visited(count, false);
+    uint32_t measured = 0;
+    if (!tree_kernels::measureDepth(nodes, 0, visited, measured)) {
+        throw std::runtime_error("Corrupt node links in decision tree " + prefix);
+    }
+    if (std::stoul(file.getAttribute(prefix + ".depth", "0")) != measured) {
+        throw std::runtime_error("Depth does not match decision tree " + prefix);
+    }
+
+    auto owner = file.keepAlive();
+    feature = AlignedBuffer<int32_t>::borrow(featureData, count, owner);
+    child = AlignedBuffer<int32_t>::borrow(childData, count, owner);
+    threshold = AlignedBuffer<float>::borrow(thresholdData, count, owner);
+    value = AlignedBuffer<float>::borrow(file.tensorData(*v), count * outputCount, owner);
+    nodeCount = count;
+    outputs = outputCount;
+    depth = measured;
+    updateShape();
+}
+
+} // namespace xyz
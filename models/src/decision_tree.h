@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+
+namespace xyz {
+
+class ModelFile;
+class ModelFileWriter;
+
+// Node of a tree under construction. Children are indices into the node
+// list passed to DecisionTree::build; leaves have feature < 0.
+struct TreeNode {
+    int32_t feature = -1;
+    float threshold = 0.0f;
+    int32_t left = -1;
+    int32_t right = -1;
+    std::vector<float> value;
+};
+
+// Read-only view of flattened node arrays, shared by single trees and the
+// packed forest arena.
+//
+// Node n is evaluated as
+//     n = child[n] + (x[feature[n]] > threshold[n])
+// i.e. siblings are stored next to each other with the right child at
+// child[n] + 1. Leaves point at themselves with an +inf threshold, so every
+// row can take exactly `depth` steps with no data-dependent branches and rows
+// walk the tree in lockstep. NaN features compare false and go left.
+struct TreeArrays {
+    const int32_t* feature;
+    const float* threshold;
+    const int32_t* child;
+};
+
+namespace tree_kernels {
+
+// Leaf node index reached by each of `rows` rows (row-major, `stride` floats
+// apart) starting from `root`
+void traverseBatch(const TreeArrays& tree, int32_t root, uint32_t depth,
+                   const float* x, size_t rows, size_t stride, int32_t* leaves);
+
+// Longest path from `root` to a leaf, for validating a loaded depth. Child
+// indices must already be in range. Marks the nodes walked in `visited` and
+// returns false if one was marked before: shared nodes or a cycle, which
+// build() never writes.
+bool measureDepth(const TreeArrays& tree, int32_t root, std::vector<bool>& visited, uint32_t& depth);
+
+} // namespace tree_kernels
+
+// Single decision tree stored as struct-of-arrays
+class DecisionTree {
+public:
+    DecisionTree();
+
+    // Flattens `nodes` (root at index 0) into breadth-first sibling order.
+    // Every leaf must carry `outputs` values.
+    void build(const std::vector<TreeNode>& nodes, size_t outputs);
+
+    // One split on `feature`: rows with x[feature] > threshold get `high`,
+    // others `low`
+    static DecisionTree stump(int32_t feature, float threshold, float low, float high);
+
+    // Tree whose arrays borrow this tree's memory and keep `keepAlive` alive
+    DecisionTree view(const std::shared_ptr<const void>& keepAlive) const;
+    // Copies borrowed arrays into memory of its own
+    void detachWeights();
+
+    void predict(const float* x, float* output) const;
+    void predictBatch(const float* x, size_t rows, size_t stride, float* output) const;
+
+    bool empty() const { return nodeCount == 0; }
+    size_t getNodeCount() const { return nodeCount; }
+    uint32_t getDepth() const { return depth; }
+    size_t outputSize() const { return outputs; }
+    // Minimum input width: one past the highest feature index used
+    size_t featureCount() const { return features; }
+    size_t weightBytes() const { return feature.bytes() + threshold.bytes() + child.bytes() + value.bytes(); }
+
+    TreeArrays arrays() const { return {feature.data(), threshold.data(), child.data()}; }
+    const float* leafValue(int32_t node) const { return value.data() + static_cast<size_t>(node) * outputs; }
+
+    // Model file tensors "<prefix>.feature|threshold|child|value"
+    void save(ModelFileWriter& writer, const std::string& prefix) const;
+    void load(const ModelFile& file, const std::string& prefix);
+
+private:
+    void updateShape();
+
+    size_t nodeCount;
+    size_t outputs;
+    size_t features;
+    uint32_t depth;
+    AlignedBuffer<int32_t> feature;
+    AlignedBuffer<float> threshold;
+    AlignedBuffer<int32_t> child;
+    // `outputs` values per node; only leaf rows are meaningful
+    AlignedBuffer<float> value;
+};
+
+} // namespace xyz
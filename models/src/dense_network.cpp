@@ -0,0 +1,668 @@
+#include "dense_network.h"
+#include "model_format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace xyz {
+
+namespace {
+
+// Random input rows pushed through the float and int8 or half-precision
+// networks to measure the quantization error
+constexpr size_t QUANT_CALIBRATION_ROWS = 64;
+
+} // namespace
+
+DenseLayer::DenseLayer(size_t inputs, size_t outputs, kernels::Activation act)
+    : inputSize(inputs)
+    , outputSize(outputs)
+    , stride(kernels::paddedStride(inputs))
+    , activation(act)
+    , weights(outputs * kernels::paddedStride(inputs))
+    , bias(outputs)
+{
+}
+
+void DenseLayer::quantize() {
+    quantStride = kernels::paddedStrideInt8(inputSize);
+    quantWeights.resize(outputSize * quantStride);
+    scales.resize(outputSize);
+    for (size_t r = 0; r < outputSize; ++r) {
+        scales[r] = kernels::quantizeSymmetric(weights.data() + r * stride, inputSize,
+                                               quantWeights.data() + r * quantStride);
+    }
+    weights = AlignedBuffer<float>();
+    bound = kernels::LayerKernels();
+}
+
+void DenseLayer::toHalf(kernels::HalfType type) {
+    halfType = type;
+    // Padding converts to +0 in both formats
+    halfWeights.resize(weights.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        halfWeights[i] = kernels::floatToHalf(weights[i], type);
+    }
+    weights = AlignedBuffer<float>();
+    bound = kernels::LayerKernels();
+}
+
+DenseNetwork::DenseNetwork()
+    : outputActivation(kernels::Activation::TANH)
+    , kernelTable(&kernels::activeKernels())
+    , batchStride(0)
+    , quantizationError(0.0f)
+    , specializeShapes(false)
+    , fuseActivations(false)
+    , inputNormalized(false)
+{
+}
+
+void DenseNetwork::configure(const std::vector<size_t>& widths, kernels::Activation hidden,
+                             kernels::Activation output, uint32_t seed) {
+    clear();
+    outputActivation = output;
+    if (widths.size() < 2) {
+        return;
+    }
+
+    std::mt19937 rng(seed);
+    for (size_t i = 0; i + 1 < widths.size(); ++i) {
+        if (widths[i] == 0 || widths[i + 1] == 0) {
+            throw std::invalid_argument("Layer width must be positive");
+        }
+        const bool last = i + 2 == widths.size();
+        DenseLayer layer(widths[i], widths[i + 1], last ? output : hidden);
+
+        // Xavier/Glorot uniform initialization
+        const float limit = std::sqrt(6.0f / static_cast<float>(widths[i] + widths[i + 1]));
+        std::uniform_real_distribution<float> dist(-limit, limit);
+        for (size_t r = 0; r < layer.outputSize; ++r) {
+            for (size_t c = 0; c < layer.inputSize; ++c) {
+                layer.weight(r, c) = dist(rng);
+            }
+        }
+        layers.push_back(std::move(layer));
+    }
+    measureLayers();
+}
+
+void DenseNetwork::addLayer(DenseLayer layer) {
+    if (!layers.empty() && layers.back().outputSize != layer.inputSize) {
+        throw std::invalid_argument("Layer input size does not match previous layer output");
+    }
+    outputActivation = layer.activation;
+    layers.push_back(std::move(layer));
+    measureLayers();
+    bindKernels();
+}
+
+void DenseNetwork::clear() {
+    layers.clear();
+    batchStride = 0;
+    quantizationError = 0.0f;
+    specializeShapes = false;
+    fuseActivations = false;
+    normMean = AlignedBuffer<float>();
+    normScale = AlignedBuffer<float>();
+    inputNormalized = false;
+    sparseColumns = AlignedBuffer<float>();
+    sparseBias = AlignedBuffer<float>();
+}
+
+DenseNetwork DenseNetwork::view(const std::shared_ptr<const void>& keepAlive) const {
+    DenseNetwork result;
+    result.outputActivation = outputActivation;
+    result.kernelTable = kernelTable;
+    result.quantizationError = quantizationError;
+    result.specializeShapes = specializeShapes;
+    result.fuseActivations = fuseActivations;
+    result.normMean = normMean.view(keepAlive);
+    result.normScale = normScale.view(keepAlive);
+    result.inputNormalized = inputNormalized;
+    result.sparseColumns = sparseColumns.view(keepAlive);
+    result.sparseBias = sparseBias.view(keepAlive);
+    result.layers.reserve(layers.size());
+    for (const auto& layer : layers) {
+        DenseLayer shared;
+        shared.inputSize = layer.inputSize;
+        shared.outputSize = layer.outputSize;
+        shared.stride = layer.stride;
+        shared.activation = layer.activation;
+        shared.weights = layer.weights.view(keepAlive);
+        shared.bias = layer.bias.view(keepAlive);
+        shared.quantStride = layer.quantStride;
+        shared.quantWeights = layer.quantWeights.view(keepAlive);
+        shared.scales = layer.scales.view(keepAlive);
+        shared.halfType = layer.halfType;
+        shared.halfWeights = layer.halfWeights.view(keepAlive);
+        shared.bound = layer.bound;
+        result.layers.push_back(std::move(shared));
+    }
+    result.batchStride = batchStride;
+    return result;
+}
+
+void DenseNetwork::detachWeights() {
+    for (auto& layer : layers) {
+        layer.weights.detach();
+        layer.bias.detach();
+        layer.quantWeights.detach();
+        layer.scales.detach();
+        layer.halfWeights.detach();
+    }
+    normMean.detach();
+    normScale.detach();
+    sparseColumns.detach();
+    sparseBias.detach();
+}
+
+void DenseNetwork::save(ModelFileWriter& writer) const {
+    writer.setAttribute("network.layers", std::to_string(layers.size()));
+    writer.setAttribute("network.output_activation", kernels::activationName(outputActivation));
+    if (inputNormalized) {
+        writer.setAttribute("network.normalized", "true");
+    }
+    if (isQuantized() || isHalfPrecision()) {
+        writer.setAttribute("network.quantization_error", std::to_string(quantizationError));
+    }
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const DenseLayer& layer = layers[i];
+        const std::string prefix = "dense." + std::to_string(i);
+        writer.setAttribute(prefix + ".activation", kernels::activationName(layer.activation));
+        if (layer.quantized()) {
+            writer.addTensor(prefix + ".qweight", model_format::TensorType::INT8,
+                             {layer.outputSize, layer.inputSize}, layer.quantWeights.data(), layer.quantStride);
+            writer.addTensor(prefix + ".scale", model_format::TensorType::FLOAT32,
+                             {layer.outputSize}, layer.scales.data());
+        } else if (layer.halfPrecision()) {
+            const auto dtype = layer.halfType == kernels::HalfType::FP16 ? model_format::TensorType::FLOAT16
+                                                                         : model_format::TensorType::BFLOAT16;
+            writer.addTensor(prefix + ".weight", dtype, {layer.outputSize, layer.inputSize},
+                             layer.halfWeights.data(), layer.stride);
+        } else {
+            writer.addTensor(prefix + ".weight", model_format::TensorType::FLOAT32,
+                             {layer.outputSize, layer.inputSize}, layer.weights.data(), layer.stride);
+        }
+        writer.addTensor(prefix + ".bias", model_format::TensorType::FLOAT32,
+                         {layer.outputSize}, layer.bias.data());
+    }
+    if (hasInputNormalization()) {
+        writer.addTensor("network.norm.mean", model_format::TensorType::FLOAT32,
+                         {normMean.size()}, normMean.data());
+        writer.addTensor("network.norm.scale", model_format::TensorType::FLOAT32,
+                         {normScale.size()}, normScale.data());
+    }
+}
+
+void DenseNetwork::load(const ModelFile& file) {
+    const size_t count = std::stoul(file.getAttribute("network.layers", "0"));
+    std::vector<DenseLayer> loaded;
+    loaded.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const std::string prefix = "dense." + std::to_string(i);
+        const TensorInfo* quantWeight = file.findTensor(prefix + ".qweight");
+        const TensorInfo* scale = file.findTensor(prefix + ".scale");
+        const TensorInfo* weight = quantWeight ? quantWeight : file.findTensor(prefix + ".weight");
+        const TensorInfo* bias = file.findTensor(prefix + ".bias");
+        if (!weight || !bias || weight->shape.size() != 2 || bias->shape.size() != 1 ||
+            bias->shape[0] != weight->shape[0] ||
+            (quantWeight && (!scale || scale->elementCount() != weight->shape[0]))) {
+            throw std::runtime_error("Missing or malformed tensors for layer " + prefix);
+        }
+        if (!loaded.empty() && loaded.back().outputSize != weight->shape[1]) {
+            throw std::runtime_error("Layer shape mismatch at " + prefix);
+        }
+
+        DenseLayer layer;
+        layer.outputSize = weight->shape[0];
+        layer.inputSize = weight->shape[1];
+        layer.stride = kernels::paddedStride(layer.inputSize);
+        layer.activation = kernels::parseActivation(file.getAttribute(prefix + ".activation"));
+
+        // Blobs are page aligned, so weights stored with the padded stride can
+        // be used in place; anything else is repacked
+        if (quantWeight) {
+            layer.quantStride = kernels::paddedStrideInt8(layer.inputSize);
+            const int8_t* quantData = file.tensorDataInt8(*quantWeight);
+            if (quantWeight->rowStride == layer.quantStride) {
+                layer.quantWeights = AlignedBuffer<int8_t>::borrow(
+                    quantData, layer.outputSize * layer.quantStride, file.keepAlive());
+            } else {
+                const size_t srcStride = quantWeight->rowStride ? quantWeight->rowStride : layer.inputSize;
+                layer.quantWeights.resize(layer.outputSize * layer.quantStride);
+                for (size_t r = 0; r < layer.outputSize; ++r) {
+                    std::memcpy(layer.quantWeights.data() + r * layer.quantStride,
+                                quantData + r * srcStride, layer.inputSize);
+                }
+            }
+            layer.scales = AlignedBuffer<float>::borrow(file.tensorData(*scale), layer.outputSize,
+                                                        file.keepAlive());
+            layer.bias = AlignedBuffer<float>::borrow(file.tensorData(*bias), layer.outputSize,
+                                                      file.keepAlive());
+            loaded.push_back(std::move(layer));
+            continue;
+        }
+
+        if (weight->dtype == model_format::TensorType::FLOAT16 ||
+            weight->dtype == model_format::TensorType::BFLOAT16) {
+            layer.halfType = weight->dtype == model_format::TensorType::FLOAT16 ? kernels::HalfType::FP16
+                                                                                : kernels::HalfType::BF16;
+            const uint16_t* halfData = file.tensorDataHalf(*weight);
+            if (weight->rowStride == layer.stride) {
+                layer.halfWeights = AlignedBuffer<uint16_t>::borrow(halfData, layer.outputSize * layer.stride,
+                                                                    file.keepAlive());
+            } else {
+                const size_t srcStride = weight->rowStride ? weight->rowStride : layer.inputSize;
+                layer.halfWeights.resize(layer.outputSize * layer.stride);
+                for (size_t r = 0; r < layer.outputSize; ++r) {
+                    std::memcpy(layer.halfWeights.data() + r * layer.stride, halfData + r * srcStride,
+                                layer.inputSize * sizeof(uint16_t));
+                }
+            }
+            layer.bias = AlignedBuffer<float>::borrow(file.tensorData(*bias), layer.outputSize,
+                                                      file.keepAlive());
+            loaded.push_back(std::move(layer));
+            continue;
+        }
+
+        const float* weightData = file.tensorData(*weight);
+        if (weight->rowStride == layer.stride) {
+            layer.weights = AlignedBuffer<float>::borrow(weightData, layer.outputSize * layer.stride,
+                                                         file.keepAlive());
+        } else {
+            const size_t srcStride = weight->rowStride ? weight->rowStride : layer.inputSize;
+            layer.weights.resize(layer.outputSize * layer.stride);
+            for (size_t r = 0; r < layer.outputSize; ++r) {
+                std::memcpy(&layer.weight(r, 0), weightData + r * srcStride, layer.inputSize * sizeof(float));
+            }
+        }
+        layer.bias = AlignedBuffer<float>::borrow(file.tensorData(*bias), layer.outputSize, file.keepAlive());
+        loaded.push_back(std::move(layer));
+    }
+
+    const TensorInfo* mean = file.findTensor("network.norm.mean");
+    const TensorInfo* scale = file.findTensor("network.norm.scale");
+    const size_t inputs = loaded.empty() ? 0 : loaded.front().inputSize;
+    if ((mean || scale) && (!mean || !scale || mean->elementCount() != inputs ||
+                            scale->elementCount() != inputs)) {
+        throw std::runtime_error("Malformed input normalization tensors");
+    }
+
+    clear();
+    layers = std::move(loaded);
+    outputActivation = kernels::parseActivation(file.getAttribute("network.output_activation", "tanh"));
+    measureLayers();
+    quantizationError = std::stof(file.getAttribute("network.quantization_error", "0"));
+    inputNormalized = mean || file.getAttribute("network.normalized") == "true";
+    if (mean) {
+        // Small enough to copy, and fuse() may rewrite it
+        normMean.resize(inputs);
+        normScale.resize(inputs);
+        std::memcpy(normMean.data(), file.tensorData(*mean), inputs * sizeof(float));
+        std::memcpy(normScale.data(), file.tensorData(*scale), inputs * sizeof(float));
+    }
+}
+
+void DenseNetwork::setSimdLevel(kernels::SimdLevel level) {
+    kernelTable = &kernels::getKernels(level);
+    bindKernels();
+}
+
+size_t DenseNetwork::specialize() {
+    specializeShapes = true;
+    bindKernels();
+    return specializedLayerCount();
+}
+
+size_t DenseNetwork::specializedLayerCount() const {
+    return static_cast<size_t>(std::count_if(layers.begin(), layers.end(),
+                                             [](const DenseLayer& layer) { return layer.bound.fixedShape; }));
+}
+
+size_t DenseNetwork::fuse() {
+    fuseActivations = true;
+    const size_t folded = foldNormalization() ? 1 : 0;
+    bindKernels();
+    return folded + fusedLayerCount();
+}
+
+size_t DenseNetwork::fusedLayerCount() const {
+    return static_cast<size_t>(std::count_if(layers.begin(), layers.end(), [](const DenseLayer& layer) {
+        return layer.bound && layer.bound.activation != kernels::Activation::NONE &&
+               layer.bound.activation == layer.activation;
+    }));
+}
+
+void DenseNetwork::bindKernels() {
+    for (auto& layer : layers) {
+        layer.bound = kernels::LayerKernels();
+        if (layer.quantized() || layer.halfPrecision()) {
+            continue;
+        }
+        const kernels::Activation fused = fuseActivations ? layer.activation : kernels::Activation::NONE;
+        if (specializeShapes) {
+            layer.bound = kernels::findFixedKernels(kernelTable->level, layer.outputSize, layer.inputSize, fused);
+        }
+        if (!layer.bound && fuseActivations) {
+            layer.bound = kernels::fusedLayerKernels(*kernelTable, fused);
+        }
+    }
+}
+
+void DenseNetwork::setInputNormalization(const std::vector<float>& mean, const std::vector<float>& scale) {
+    if (layers.empty() || mean.size() != inputSize() || scale.size() != inputSize()) {
+        throw std::invalid_argument("Input normalization must match the network input size");
+    }
+    normMean.resize(mean.size());
+    normScale.resize(scale.size());
+    std::copy(mean.begin(), mean.end(), normMean.data());
+    std::copy(scale.begin(), scale.end(), normScale.data());
+    inputNormalized = true;
+    if (hasSparseInput()) {
+        prepareSparseInput();
+    }
+}
+
+bool DenseNetwork::foldNormalization() {
+    if (!hasInputNormalization() || layers.front().quantized() || layers.front().halfPrecision()) {
+        return false;
+    }
+
+    // W' = W * diag(scale), b' = b - W' * mean. Borrowed tensors are copied
+    // first so the file mapping stays untouched.
+    DenseLayer& layer = layers.front();
+    if (layer.weights.isBorrowed()) {
+        layer.weights = AlignedBuffer<float>(layer.weights);
+    }
+    if (layer.bias.isBorrowed()) {
+        layer.bias = AlignedBuffer<float>(layer.bias);
+    }
+    for (size_t r = 0; r < layer.outputSize; ++r) {
+        double shift = 0.0;
+        for (size_t c = 0; c < layer.inputSize; ++c) {
+            const float scaled = layer.weight(r, c) * normScale[c];
+            layer.weight(r, c) = scaled;
+            shift += static_cast<double>(scaled) * normMean[c];
+        }
+        layer.bias[r] -= static_cast<float>(shift);
+    }
+    normMean = AlignedBuffer<float>();
+    normScale = AlignedBuffer<float>();
+    return true;
+}
+
+const float* DenseNetwork::normalizeInput(const float* input, size_t rows, size_t stride,
+                                          InferenceScratch& scratch) const {
+    const size_t width = inputSize();
+    float* normalized = scratch.floats(InferenceScratch::NORMALIZED, rows * width);
+    for (size_t r = 0; r < rows; ++r) {
+        const float* src = input + r * stride;
+        float* dst = normalized + r * width;
+        for (size_t c = 0; c < width; ++c) {
+            dst[c] = (src[c] - normMean[c]) * normScale[c];
+        }
+    }
+    return normalized;
+}
+
+size_t DenseNetwork::parameterCount() const {
+    size_t count = 0;
+    for (const auto& layer : layers) {
+        count += layer.inputSize * layer.outputSize + layer.outputSize;
+    }
+    return count;
+}
+
+size_t DenseNetwork::weightBytes() const {
+    size_t bytes = 0;
+    for (const auto& layer : layers) {
+        bytes += layer.weights.bytes() + layer.quantWeights.bytes() + layer.scales.bytes() +
+                 layer.halfWeights.bytes() + layer.bias.bytes();
+    }
+    return bytes + sparseColumns.bytes() + sparseBias.bytes();
+}
+
+bool DenseNetwork::isQuantized() const {
+    return std::any_of(layers.begin(), layers.end(), [](const DenseLayer& layer) { return layer.quantized(); });
+}
+
+bool DenseNetwork::isHalfPrecision() const {
+    return std::any_of(layers.begin(), layers.end(), [](const DenseLayer& layer) { return layer.halfPrecision(); });
+}
+
+float DenseNetwork::quantize(uint32_t seed) {
+    return convertLayers(seed, [](DenseLayer& layer) {
+        if (!layer.quantized() && !layer.halfPrecision()) {
+            layer.quantize();
+        }
+    });
+}
+
+float DenseNetwork::toHalf(kernels::HalfType type, uint32_t seed) {
+    return convertLayers(seed, [type](DenseLayer& layer) {
+        if (!layer.quantized() && !layer.halfPrecision()) {
+            layer.toHalf(type);
+        }
+    });
+}
+
+float DenseNetwork::convertLayers(uint32_t seed, const std::function<void(DenseLayer&)>& convert) {
+    if (layers.empty()) {
+        return 0.0f;
+    }
+
+    const size_t inputs = inputSize();
+    const size_t outputs = layers.back().outputSize;
+    std::vector<float> calibration(QUANT_CALIBRATION_ROWS * inputs);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (auto& value : calibration) {
+        value = dist(rng);
+    }
+
+    std::vector<float> reference(QUANT_CALIBRATION_ROWS * outputs);
+    std::vector<float> converted(QUANT_CALIBRATION_ROWS * outputs);
+    forwardBatch(calibration.data(), QUANT_CALIBRATION_ROWS, inputs, reference.data());
+    for (auto& layer : layers) {
+        convert(layer);
+    }
+    forwardBatch(calibration.data(), QUANT_CALIBRATION_ROWS, inputs, converted.data());
+    if (hasSparseInput()) {
+        prepareSparseInput();
+    }
+
+    quantizationError = 0.0f;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        quantizationError = std::max(quantizationError, std::fabs(reference[i] - converted[i]));
+    }
+    return quantizationError;
+}
+
+void DenseNetwork::measureLayers() {
+    size_t widest = 0;
+    for (const auto& layer : layers) {
+        widest = std::max(widest, layer.outputSize);
+    }
+    batchStride = kernels::paddedStride(widest);
+}
+
+void DenseNetwork::forward(const float* input, size_t inputWidth, float* output, InferenceScratch& scratch) const {
+    if (layers.empty()) {
+        std::memcpy(output, input, inputWidth * sizeof(float));
+        kernels::applyActivation(*kernelTable, outputActivation, output, inputWidth);
+        return;
+    }
+
+    const float* current = hasInputNormalization() ? normalizeInput(input, 1, inputWidth, scratch) : input;
+    forwardLayers(0, current, output, scratch);
+}
+
+void DenseNetwork::forward(const float* input, size_t inputWidth, float* output) const {
+    InferenceScratch scratch;
+    forward(input, inputWidth, output, scratch);
+}
+
+void DenseNetwork::forwardLayers(size_t first, const float* current, float* output,
+                                 InferenceScratch& scratch) const {
+    for (size_t i = first; i < layers.size(); ++i) {
+        const DenseLayer& layer = layers[i];
+        // The last layer writes straight into the caller's buffer
+        float* next = (i + 1 == layers.size()) ? output
+                    : scratch.floats(i % 2 == 0 ? InferenceScratch::ACTIVATION_A : InferenceScratch::ACTIVATION_B,
+                                     batchStride);
+        if (layer.quantized()) {
+            forwardInt8(layer, current, next, scratch);
+        } else if (layer.halfPrecision()) {
+            kernelTable->gemvHalf[static_cast<size_t>(layer.halfType)](
+                layer.halfWeights.data(), layer.stride, layer.bias.data(),
+                current, next, layer.outputSize, layer.inputSize);
+        } else {
+            const kernels::GemvFn gemv = layer.bound ? layer.bound.gemv : kernelTable->gemv;
+            gemv(layer.weights.data(), layer.stride, layer.bias.data(),
+                 current, next, layer.outputSize, layer.inputSize);
+        }
+        if (!layer.bound || layer.bound.activation != layer.activation) {
+            kernels::applyActivation(*kernelTable, layer.activation, next, layer.outputSize);
+        }
+        current = next;
+    }
+}
+
+void DenseNetwork::forwardBatch(const float* input, size_t rows, size_t inputWidth, float* output,
+                                InferenceScratch& scratch) const {
+    if (layers.empty()) {
+        std::memcpy(output, input, rows * inputWidth * sizeof(float));
+        kernels::applyActivation(*kernelTable, outputActivation, output, rows, inputWidth, inputWidth);
+        return;
+    }
+
+    if (hasInputNormalization()) {
+        forwardBatchLayers(0, normalizeInput(input, rows, inputWidth, scratch), inputSize(), rows, output, scratch);
+    } else {
+        forwardBatchLayers(0, input, inputWidth, rows, output, scratch);
+    }
+}
+
+void DenseNetwork::forwardBatch(const float* input, size_t rows, size_t inputWidth, float* output) const {
+    InferenceScratch scratch;
+    forwardBatch(input, rows, inputWidth, output, scratch);
+}
+
+void DenseNetwork::forwardBatchLayers(size_t first, const float* current, size_t currentStride, size_t rows,
+                                      float* output, InferenceScratch& scratch) const {
+    for (size_t i = first; i < layers.size(); ++i) {
+        const DenseLayer& layer = layers[i];
+        const bool last = i + 1 == layers.size();
+        // Scratch only grows, so steady-state batches of the same size never
+        // allocate
+        float* next = last ? output
+                    : scratch.floats(i % 2 == 0 ? InferenceScratch::ACTIVATION_A : InferenceScratch::ACTIVATION_B,
+                                     rows * batchStride);
+        const size_t nextStride = last ? layer.outputSize : batchStride;
+        if (layer.quantized()) {
+            // Each row gets its own activation scale
+            for (size_t r = 0; r < rows; ++r) {
+                forwardInt8(layer, current + r * currentStride, next + r * nextStride, scratch);
+            }
+        } else if (layer.halfPrecision()) {
+            kernelTable->gemmHalf[static_cast<size_t>(layer.halfType)](
+                layer.halfWeights.data(), layer.stride, layer.bias.data(),
+                current, currentStride, next, nextStride,
+                rows, layer.outputSize, layer.inputSize);
+        } else {
+            const kernels::GemmFn gemm = layer.bound ? layer.bound.gemm : kernelTable->gemm;
+            gemm(layer.weights.data(), layer.stride, layer.bias.data(),
+                 current, currentStride, next, nextStride,
+                 rows, layer.outputSize, layer.inputSize);
+        }
+        if (!layer.bound || layer.bound.activation != layer.activation) {
+            kernels::applyActivation(*kernelTable, layer.activation, next, rows, layer.outputSize, nextStride);
+        }
+        current = next;
+        currentStride = nextStride;
+    }
+}
+
+bool DenseNetwork::prepareSparseInput() {
+    if (layers.empty()) {
+        return false;
+    }
+
+    // Column c holds W[:, c] * scale[c]; the bias absorbs -W' * mean, as in
+    // foldNormalization()
+    const DenseLayer& layer = layers.front();
+    const size_t ld = kernels::paddedStride(layer.outputSize);
+    AlignedBuffer<float> columns(layer.inputSize * ld);
+    AlignedBuffer<float> bias(layer.outputSize);
+    for (size_t r = 0; r < layer.outputSize; ++r) {
+        double shift = 0.0;
+        for (size_t c = 0; c < layer.inputSize; ++c) {
+            float w;
+            if (layer.quantized()) {
+                w = static_cast<float>(layer.quantWeights[r * layer.quantStride + c]) * layer.scales[r];
+            } else if (layer.halfPrecision()) {
+                w = kernels::halfToFloat(layer.halfWeights[r * layer.stride + c], layer.halfType);
+            } else {
+                w = layer.weight(r, c);
+            }
+            if (hasInputNormalization()) {
+                w *= normScale[c];
+                shift += static_cast<double>(w) * normMean[c];
+            }
+            columns[c * ld + r] = w;
+        }
+        bias[r] = layer.bias[r] - static_cast<float>(shift);
+    }
+    sparseColumns = std::move(columns);
+    sparseBias = std::move(bias);
+    return true;
+}
+
+void DenseNetwork::forwardSparse(const SparseVector& input, float* output, InferenceScratch& scratch) const {
+    // The first layer reads one column per non-zero feature
+    const DenseLayer& layer = layers.front();
+    float* next = layers.size() == 1 ? output : scratch.floats(InferenceScratch::ACTIVATION_A, batchStride);
+    kernelTable->sparseAxpy(sparseColumns.data(), kernels::paddedStride(layer.outputSize), sparseBias.data(),
+                            input.indices, input.values, input.nnz, next, layer.outputSize);
+    kernels::applyActivation(*kernelTable, layer.activation, next, layer.outputSize);
+    forwardLayers(1, next, output, scratch);
+}
+
+void DenseNetwork::forwardSparse(const SparseVector& input, float* output) const {
+    InferenceScratch scratch;
+    forwardSparse(input, output, scratch);
+}
+
+void DenseNetwork::forwardSparseBatch(const SparseBatch& input, float* output, InferenceScratch& scratch) const {
+    const DenseLayer& layer = layers.front();
+    const bool last = layers.size() == 1;
+    float* next = last ? output : scratch.floats(InferenceScratch::ACTIVATION_A, input.rows * batchStride);
+    const size_t nextStride = last ? layer.outputSize : batchStride;
+    const size_t ld = kernels::paddedStride(layer.outputSize);
+    for (size_t r = 0; r < input.rows; ++r) {
+        const SparseVector row = input.row(r);
+        kernelTable->sparseAxpy(sparseColumns.data(), ld, sparseBias.data(), row.indices, row.values, row.nnz,
+                                next + r * nextStride, layer.outputSize);
+    }
+    kernels::applyActivation(*kernelTable, layer.activation, next, input.rows, layer.outputSize, nextStride);
+    forwardBatchLayers(1, next, nextStride, input.rows, output, scratch);
+}
+
+void DenseNetwork::forwardSparseBatch(const SparseBatch& input, float* output) const {
+    InferenceScratch scratch;
+    forwardSparseBatch(input, output, scratch);
+}
+
+void DenseNetwork::forwardInt8(const DenseLayer& layer, const float* input, float* output,
+                               InferenceScratch& scratch) const {
+    int8_t* quantInput = scratch.quantized(kernels::paddedStrideInt8(layer.inputSize));
+    const float inputScale = kernels::quantizeSymmetric(input, layer.inputSize, quantInput);
+    kernelTable->gemvInt8(layer.quantWeights.data(), layer.quantStride, layer.scales.data(), layer.bias.data(),
+                          quantInput, inputScale, output, layer.outputSize, layer.inputSize);
+}
+
+} // namespace xyz
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "aligned_buffer.h"
+#include "fixed_kernels.h"
+#include "inference_scratch.h"
+#include "kernels.h"
+#include "sparse_input.h"
+
+namespace xyz {
+
+class ModelFile;
+class ModelFileWriter;
+
+// Fully connected layer: y = activation(W * x + b).
+// W has `outputSize` rows of `inputSize` weights stored row-major with a
+// padded stride of kernels::paddedStride(inputSize) floats.
+struct DenseLayer {
+    size_t inputSize = 0;
+    size_t outputSize = 0;
+    size_t stride = 0;
+    kernels::Activation activation = kernels::Activation::NONE;
+    AlignedBuffer<float> weights;
+    AlignedBuffer<float> bias;
+
+    // Int8 weights with one scale per output row, padded to
+    // kernels::paddedStrideInt8(inputSize) bytes. A quantized layer drops
+    // its float weights.
+    size_t quantStride = 0;
+    AlignedBuffer<int8_t> quantWeights;
+    AlignedBuffer<float> scales;
+
+    // 16-bit weights in the float layout (same stride, zero padding),
+    // widened to float inside the kernels. A half-precision layer drops its
+    // float weights.
+    kernels::HalfType halfType = kernels::HalfType::FP16;
+    AlignedBuffer<uint16_t> halfWeights;
+
+    // Float kernels bound by DenseNetwork::specialize()/fuse(); empty for
+    // layers on the plain kernel table. When `bound.activation` equals
+    // `activation` the kernels already apply it.
+    kernels::LayerKernels bound;
+
+    DenseLayer() = default;
+    DenseLayer(size_t inputs, size_t outputs, kernels::Activation act);
+
+    bool quantized() const { return !quantWeights.empty(); }
+    // Replaces the float weights by int8 weights with per-output-channel scales
+    void quantize();
+    bool halfPrecision() const { return !halfWeights.empty(); }
+    // Replaces the float weights by the nearest `type` values
+    void toHalf(kernels::HalfType type);
+
+    float& weight(size_t row, size_t col) { return weights[row * stride + col]; }
+    float weight(size_t row, size_t col) const { return weights[row * stride + col]; }
+};
+
+// Multi-layer dense network evaluated with the SIMD kernel table selected for
+// the host CPU. A network without layers passes its input through the output
+// activation unchanged in shape. Forward passes keep intermediate rows in
+// the caller's InferenceScratch, so one network may be evaluated by several
+// threads at once; the overloads without a scratch allocate one per call.
+class DenseNetwork {
+public:
+    DenseNetwork();
+
+    // Builds layers for `widths` = {input, hidden..., output} with Xavier
+    // uniform weights drawn from `seed`
+    void configure(const std::vector<size_t>& widths, kernels::Activation hidden,
+                   kernels::Activation output, uint32_t seed);
+
+    void addLayer(DenseLayer layer);
+    void clear();
+
+    // Network with the same layers and kernel bindings whose tensors borrow
+    // this network's memory and keep `keepAlive` alive
+    DenseNetwork view(const std::shared_ptr<const void>& keepAlive) const;
+    // Copies borrowed tensors into memory of its own
+    void detachWeights();
+
+    // Pins the kernel level, mainly for testing against the scalar reference.
+    // Specialized layers switch to the kernels of the new level.
+    void setSimdLevel(kernels::SimdLevel level);
+    kernels::SimdLevel getSimdLevel() const { return kernelTable->level; }
+
+    // Moves float layers whose input and output widths are both in
+    // kernels::FIXED_WIDTHS onto compile-time specialized kernels. Returns the
+    // number of specialized layers.
+    size_t specialize();
+    size_t specializedLayerCount() const;
+
+    // Fusion pass run once after loading: binds kernels that apply ReLU/tanh
+    // in registers before single-row outputs are stored and to each batch
+    // tile while it is still in cache, and folds a pending input
+    // normalization into the first layer's weights and bias. Int8 and
+    // half-precision layers run on their own kernels: they fuse nothing and
+    // a first such layer keeps normalizing as a separate pass. Returns the
+    // number of fused operations.
+    size_t fuse();
+    size_t fusedLayerCount() const;
+
+    // Per-feature normalization x' = (x - mean) * scale applied before the
+    // first layer. Requires layers; both vectors must be inputSize() long.
+    void setInputNormalization(const std::vector<float>& mean, const std::vector<float>& scale);
+    // True while the normalization still runs as its own pass
+    bool hasInputNormalization() const { return !normMean.empty(); }
+    // True once a normalization was set, pending or folded into the first
+    // layer by fuse(). Saved with the network and kept by views, so loaded or
+    // shared weights are not normalized twice.
+    bool isInputNormalized() const { return inputNormalized; }
+    const float* inputMean() const { return normMean.data(); }
+    const float* inputScale() const { return normScale.data(); }
+
+    // Forward pass of one row. `output` must hold outputSize(inputWidth) values.
+    void forward(const float* input, size_t inputWidth, float* output, InferenceScratch& scratch) const;
+    void forward(const float* input, size_t inputWidth, float* output) const;
+
+    // Forward pass of `rows` contiguous input rows as one GEMM per layer.
+    // `output` receives rows x outputSize(inputWidth) values, row-major.
+    void forwardBatch(const float* input, size_t rows, size_t inputWidth, float* output,
+                      InferenceScratch& scratch) const;
+    void forwardBatch(const float* input, size_t rows, size_t inputWidth, float* output) const;
+
+    // Builds an input-major copy of the first layer (inputSize() rows of
+    // paddedStride(outputs) floats, dequantized or widened, with a pending
+    // input normalization folded in) so that sparse rows read only the
+    // weights of their non-zero features. Quantization, half precision and
+    // new input normalization rebuild it; call it again after changing the
+    // first layer's weights directly. False without layers.
+    bool prepareSparseInput();
+    bool hasSparseInput() const { return !sparseColumns.empty(); }
+
+    // Forward pass of one sparse row of inputSize() features; requires
+    // prepareSparseInput(). `output` as in forward().
+    void forwardSparse(const SparseVector& input, float* output, InferenceScratch& scratch) const;
+    void forwardSparse(const SparseVector& input, float* output) const;
+    // Forward pass of a CSR batch; `output` as in forwardBatch()
+    void forwardSparseBatch(const SparseBatch& input, float* output, InferenceScratch& scratch) const;
+    void forwardSparseBatch(const SparseBatch& input, float* output) const;
+
+    bool empty() const { return layers.empty(); }
+    size_t inputSize() const { return layers.empty() ? 0 : layers.front().inputSize; }
+    size_t outputSize(size_t inputWidth) const {
+        return layers.empty() ? inputWidth : layers.back().outputSize;
+    }
+    size_t parameterCount() const;
+    // Bytes held by weights, scales and biases, including the sparse input
+    // copy of the first layer
+    size_t weightBytes() const;
+
+    // Quantizes every layer to int8 (see DenseLayer::quantize) and returns the
+    // largest output difference to the float network over a calibration
+    // batch of uniform [-1, 1] inputs drawn from `seed`
+    float quantize(uint32_t seed);
+    bool isQuantized() const;
+    // Stores every float layer's weights as fp16 or bf16 (see
+    // DenseLayer::toHalf) and returns the error as quantize() does
+    float toHalf(kernels::HalfType type, uint32_t seed);
+    bool isHalfPrecision() const;
+    // Error measured by the last quantize() or toHalf()
+    float getQuantizationError() const { return quantizationError; }
+
+    kernels::Activation getOutputActivation() const { return outputActivation; }
+    void setOutputActivation(kernels::Activation act) { outputActivation = act; }
+
+    // Model file tensors "dense.<i>.weight" / "dense.<i>.bias", or
+    // "dense.<i>.qweight" / "dense.<i>.scale" for int8 layers (weights of
+    // half-precision layers keep their 16-bit type), plus
+    // "network.norm.mean|scale" for an unfused input normalization and the
+    // "network.normalized" attribute for any normalization. Loaded
+    // weights borrow the file mapping instead of being copied.
+    void save(ModelFileWriter& writer) const;
+    void load(const ModelFile& file);
+
+    const std::vector<DenseLayer>& getLayers() const { return layers; }
+    std::vector<DenseLayer>& getLayers() { return layers; }
+
+private:
+    void bindKernels();
+    // Folds normMean/normScale into the first layer; false unless it is float
+    bool foldNormalization();
+    // Writes `rows` normalized input rows to scratch and returns them
+    const float* normalizeInput(const float* input, size_t rows, size_t stride, InferenceScratch& scratch) const;
+    // Sets batchStride from the widest layer
+    void measureLayers();
+    // Runs layers [first, end) on one row / `rows` rows `currentStride`
+    // apart, ping-ponging through the scratch activations as forward() and
+    // forwardBatch() do
+    void forwardLayers(size_t first, const float* current, float* output, InferenceScratch& scratch) const;
+    void forwardBatchLayers(size_t first, const float* current, size_t currentStride, size_t rows,
+                            float* output, InferenceScratch& scratch) const;
+    // Quantizes one input row and runs an int8 layer on it
+    void forwardInt8(const DenseLayer& layer, const float* input, float* output, InferenceScratch& scratch) const;
+    // Applies `convert` to every layer and returns the largest output
+    // change over a calibration batch drawn from `seed`
+    float convertLayers(uint32_t seed, const std::function<void(DenseLayer&)>& convert);
+
+    std::vector<DenseLayer> layers;
+    // Applied element-wise when the network has no layers
+    kernels::Activation outputActivation;
+    const kernels::KernelTable* kernelTable;
+    // Row stride of scratch activations, paddedStride(widest layer)
+    size_t batchStride;
+    float quantizationError;
+    // Kernel binding requested through specialize() and fuse()
+    bool specializeShapes;
+    bool fuseActivations;
+    AlignedBuffer<float> normMean;
+    AlignedBuffer<float> normScale;
+    bool inputNormalized;
+    // First layer for sparse rows, see prepareSparseInput(): column c of W
+    // at c * paddedStride(outputs), and the matching bias
+    AlignedBuffer<float> sparseColumns;
+    AlignedBuffer<float> sparseBias;
+};
+
+} // namespace xyz
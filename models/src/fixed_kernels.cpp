@@ -0,0 +1,285 @@
+#include "fixed_kernels.h"
+#include "simd_math.h"
+#include "simd_target.h"
+
+namespace xyz {
+namespace kernels {
+
+namespace {
+
+// Independent partial sums per scalar row, so the compiler can keep them in
+// vector registers without reassociating the float additions
+constexpr size_t SCALAR_LANES = 8;
+
+// ---------------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------------
+
+template<size_t Rows, size_t Cols, Activation Act>
+void gemvFixedScalar(const float* weights, size_t /*ld*/, const float* bias,
+                     const float* x, float* y, size_t /*rows*/, size_t /*cols*/) {
+    for (size_t r = 0; r < Rows; ++r) {
+        const float* w = weights + r * Cols;
+        float acc[SCALAR_LANES] = {};
+#pragma GCC unroll 16
+        for (size_t c = 0; c < Cols; c += SCALAR_LANES) {
+            for (size_t j = 0; j < SCALAR_LANES; ++j) {
+                acc[j] += w[c + j] * x[c + j];
+            }
+        }
+        float sum = 0.0f;
+        for (size_t j = 0; j < SCALAR_LANES; ++j) {
+            sum += acc[j];
+        }
+        y[r] = activateScalar<Act>(sum + (bias ? bias[r] : 0.0f));
+    }
+}
+
+template<size_t Rows, size_t Cols, Activation Act>
+void gemmFixedScalar(const float* weights, size_t ld, const float* bias,
+                     const float* x, size_t ldx, float* y, size_t ldy,
+                     size_t batch, size_t rows, size_t cols) {
+    for (size_t i = 0; i < batch; ++i) {
+        gemvFixedScalar<Rows, Cols, Act>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA
+// ---------------------------------------------------------------------------
+
+// Horizontal sums of eight accumulators in one vector: lane k = sum(acc[k])
+XYZ_TARGET_AVX2 inline __m256 reduce8(const __m256* acc) {
+    const __m256 t0 = _mm256_hadd_ps(acc[0], acc[1]);
+    const __m256 t1 = _mm256_hadd_ps(acc[2], acc[3]);
+    const __m256 t2 = _mm256_hadd_ps(acc[4], acc[5]);
+    const __m256 t3 = _mm256_hadd_ps(acc[6], acc[7]);
+    const __m256 lo = _mm256_hadd_ps(t0, t1);
+    const __m256 hi = _mm256_hadd_ps(t2, t3);
+    return _mm256_add_ps(_mm256_permute2f128_ps(lo, hi, 0x20), _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+// Eight output rows per pass; each x vector is loaded once for eight FMAs and
+// the eight sums leave through one reduction and one store
+template<size_t Rows, size_t Cols, Activation Act>
+XYZ_TARGET_AVX2 void gemvFixedAvx2(const float* weights, size_t /*ld*/, const float* bias,
+                                   const float* x, float* y, size_t /*rows*/, size_t /*cols*/) {
+    static_assert(Rows % 8 == 0 && Cols % 8 == 0, "Fixed AVX2 shapes are whole vectors");
+    for (size_t r = 0; r < Rows; r += 8) {
+        const float* w = weights + r * Cols;
+        __m256 acc[8];
+        for (size_t k = 0; k < 8; ++k) {
+            acc[k] = _mm256_setzero_ps();
+        }
+#pragma GCC unroll 16
+        for (size_t c = 0; c < Cols; c += 8) {
+            const __m256 xv = _mm256_loadu_ps(x + c);
+#pragma GCC unroll 8
+            for (size_t k = 0; k < 8; ++k) {
+                acc[k] = _mm256_fmadd_ps(_mm256_load_ps(w + k * Cols + c), xv, acc[k]);
+            }
+        }
+        __m256 sums = reduce8(acc);
+        if (bias) {
+            sums = _mm256_add_ps(sums, _mm256_loadu_ps(bias + r));
+        }
+        _mm256_storeu_ps(y + r, activate256<Act>(sums));
+    }
+}
+
+// 2 (inputs) x 4 (outputs) tiles: one reduction yields four outputs for each
+// of the two input rows
+template<size_t Rows, size_t Cols, Activation Act>
+XYZ_TARGET_AVX2 void gemmFixedAvx2(const float* weights, size_t ld, const float* bias,
+                                   const float* x, size_t ldx, float* y, size_t ldy,
+                                   size_t batch, size_t rows, size_t cols) {
+    size_t i = 0;
+    for (; i + 2 <= batch; i += 2) {
+        const float* x0 = x + i * ldx;
+        const float* x1 = x0 + ldx;
+        float* y0 = y + i * ldy;
+        float* y1 = y0 + ldy;
+        for (size_t r = 0; r < Rows; r += 4) {
+            const float* w = weights + r * Cols;
+            __m256 acc[8];
+            for (size_t k = 0; k < 8; ++k) {
+                acc[k] = _mm256_setzero_ps();
+            }
+#pragma GCC unroll 16
+            for (size_t c = 0; c < Cols; c += 8) {
+                const __m256 xa = _mm256_loadu_ps(x0 + c);
+                const __m256 xb = _mm256_loadu_ps(x1 + c);
+#pragma GCC unroll 4
+                for (size_t k = 0; k < 4; ++k) {
+                    const __m256 wv = _mm256_load_ps(w + k * Cols + c);
+                    acc[k] = _mm256_fmadd_ps(wv, xa, acc[k]);
+                    acc[k + 4] = _mm256_fmadd_ps(wv, xb, acc[k + 4]);
+                }
+            }
+            __m256 sums = reduce8(acc);
+            if (bias) {
+                const __m128 b = _mm_loadu_ps(bias + r);
+                sums = _mm256_add_ps(sums, _mm256_set_m128(b, b));
+            }
+            sums = activate256<Act>(sums);
+            _mm_storeu_ps(y0 + r, _mm256_castps256_ps128(sums));
+            _mm_storeu_ps(y1 + r, _mm256_extractf128_ps(sums, 1));
+        }
+    }
+    if (i < batch) {
+        gemvFixedAvx2<Rows, Cols, Act>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512
+// ---------------------------------------------------------------------------
+
+// Adds the upper half of a 512-bit accumulator onto its lower half
+XYZ_TARGET_AVX512 inline __m256 fold512(__m512 v) {
+    const __m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+    return _mm256_add_ps(_mm512_castps512_ps256(v), hi);
+}
+
+template<size_t Rows, size_t Cols, Activation Act>
+XYZ_TARGET_AVX512 void gemvFixedAvx512(const float* weights, size_t /*ld*/, const float* bias,
+                                       const float* x, float* y, size_t /*rows*/, size_t /*cols*/) {
+    static_assert(Rows % 8 == 0 && Cols % 16 == 0, "Fixed AVX-512 shapes are whole vectors");
+    for (size_t r = 0; r < Rows; r += 8) {
+        const float* w = weights + r * Cols;
+        __m512 acc[8];
+        for (size_t k = 0; k < 8; ++k) {
+            acc[k] = _mm512_setzero_ps();
+        }
+#pragma GCC unroll 8
+        for (size_t c = 0; c < Cols; c += 16) {
+            const __m512 xv = _mm512_loadu_ps(x + c);
+#pragma GCC unroll 8
+            for (size_t k = 0; k < 8; ++k) {
+                acc[k] = _mm512_fmadd_ps(_mm512_load_ps(w + k * Cols + c), xv, acc[k]);
+            }
+        }
+        __m256 halves[8];
+        for (size_t k = 0; k < 8; ++k) {
+            halves[k] = fold512(acc[k]);
+        }
+        __m256 sums = reduce8(halves);
+        if (bias) {
+            sums = _mm256_add_ps(sums, _mm256_loadu_ps(bias + r));
+        }
+        _mm256_storeu_ps(y + r, activate256<Act>(sums));
+    }
+}
+
+// 4 (inputs) x 4 (outputs) tiles, sixteen accumulators out of the 32
+// vector registers
+template<size_t Rows, size_t Cols, Activation Act>
+XYZ_TARGET_AVX512 void gemmFixedAvx512(const float* weights, size_t ld, const float* bias,
+                                       const float* x, size_t ldx, float* y, size_t ldy,
+                                       size_t batch, size_t rows, size_t cols) {
+    size_t i = 0;
+    for (; i + 4 <= batch; i += 4) {
+        const float* xs[4] = {x + i * ldx, x + (i + 1) * ldx, x + (i + 2) * ldx, x + (i + 3) * ldx};
+        float* ys[4] = {y + i * ldy, y + (i + 1) * ldy, y + (i + 2) * ldy, y + (i + 3) * ldy};
+        for (size_t r = 0; r < Rows; r += 4) {
+            const float* w = weights + r * Cols;
+            __m512 acc[16];
+            for (size_t k = 0; k < 16; ++k) {
+                acc[k] = _mm512_setzero_ps();
+            }
+#pragma GCC unroll 8
+            for (size_t c = 0; c < Cols; c += 16) {
+                __m512 wv[4];
+#pragma GCC unroll 4
+                for (size_t k = 0; k < 4; ++k) {
+                    wv[k] = _mm512_load_ps(w + k * Cols + c);
+                }
+#pragma GCC unroll 4
+                for (size_t j = 0; j < 4; ++j) {
+                    const __m512 xv = _mm512_loadu_ps(xs[j] + c);
+#pragma GCC unroll 4
+                    for (size_t k = 0; k < 4; ++k) {
+                        acc[j * 4 + k] = _mm512_fmadd_ps(wv[k], xv, acc[j * 4 + k]);
+                    }
+                }
+            }
+            __m256 halves[16];
+            for (size_t k = 0; k < 16; ++k) {
+                halves[k] = fold512(acc[k]);
+            }
+            const __m128 b = bias ? _mm_loadu_ps(bias + r) : _mm_setzero_ps();
+            const __m256 b2 = _mm256_set_m128(b, b);
+            // Lanes hold four outputs of input row j, then four of row j + 1
+            for (size_t j = 0; j < 4; j += 2) {
+                const __m256 sums = activate256<Act>(_mm256_add_ps(reduce8(halves + j * 4), b2));
+                _mm_storeu_ps(ys[j] + r, _mm256_castps256_ps128(sums));
+                _mm_storeu_ps(ys[j + 1] + r, _mm256_extractf128_ps(sums, 1));
+            }
+        }
+    }
+    for (; i < batch; ++i) {
+        gemvFixedAvx512<Rows, Cols, Act>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+#endif // XYZ_X86_KERNELS
+
+// ---------------------------------------------------------------------------
+// Shape dispatch
+// ---------------------------------------------------------------------------
+
+template<size_t Rows, size_t Cols, Activation Act>
+LayerKernels instantiate(SimdLevel level) {
+#ifdef XYZ_X86_KERNELS
+    switch (level) {
+        case SimdLevel::AVX512:
+            return {gemvFixedAvx512<Rows, Cols, Act>, gemmFixedAvx512<Rows, Cols, Act>, Act, true};
+        case SimdLevel::AVX2:
+            return {gemvFixedAvx2<Rows, Cols, Act>, gemmFixedAvx2<Rows, Cols, Act>, Act, true};
+        default:
+            break;
+    }
+#else
+    (void)level;
+#endif
+    return {gemvFixedScalar<Rows, Cols, Act>, gemmFixedScalar<Rows, Cols, Act>, Act, true};
+}
+
+template<size_t Rows, size_t Cols>
+LayerKernels instantiate(SimdLevel level, Activation activation) {
+    switch (activation) {
+        case Activation::RELU: return instantiate<Rows, Cols, Activation::RELU>(level);
+        case Activation::TANH: return instantiate<Rows, Cols, Activation::TANH>(level);
+        default:               return instantiate<Rows, Cols, Activation::NONE>(level);
+    }
+}
+
+// The cases here and in findFixedKernels mirror FIXED_WIDTHS
+template<size_t Rows>
+LayerKernels findForRows(SimdLevel level, size_t cols, Activation activation) {
+    switch (cols) {
+        case 16:  return instantiate<Rows, 16>(level, activation);
+        case 32:  return instantiate<Rows, 32>(level, activation);
+        case 64:  return instantiate<Rows, 64>(level, activation);
+        case 128: return instantiate<Rows, 128>(level, activation);
+        default:  return {};
+    }
+}
+
+} // namespace
+
+LayerKernels findFixedKernels(SimdLevel level, size_t rows, size_t cols, Activation activation) {
+    static_assert(paddedStride(16) == 16 && paddedStride(128) == 128, "Fixed widths need no row padding");
+    switch (rows) {
+        case 16:  return findForRows<16>(level, cols, activation);
+        case 32:  return findForRows<32>(level, cols, activation);
+        case 64:  return findForRows<64>(level, cols, activation);
+        case 128: return findForRows<128>(level, cols, activation);
+        default:  return {};
+    }
+}
+
+} // namespace kernels
+} // namespace xyz
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include "kernels.h"
+
+namespace xyz {
+namespace kernels {
+
+// Layer widths with compile-time specialized kernels. Both the input and the
+// output width of a layer must be in this list for it to be specialized.
+constexpr size_t FIXED_WIDTHS[] = {16, 32, 64, 128};
+
+constexpr bool isFixedWidth(size_t width) {
+    for (size_t fixed : FIXED_WIDTHS) {
+        if (fixed == width) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Kernels instantiated for one rows x cols shape with constexpr tile counts
+// and fully unrolled column loops. They have the generic signatures so a
+// layer can swap them in, but ignore the `rows`/`cols` arguments and require
+// ld == paddedStride(cols). RELU and TANH can be fused into the epilogue,
+// where they act on the output vectors in registers; for other activations
+// the result has activation NONE and the caller applies it.
+//
+// Returns empty kernels when the shape has no specialization. `level` must
+// be runnable on the host.
+LayerKernels findFixedKernels(SimdLevel level, size_t rows, size_t cols,
+                              Activation activation = Activation::NONE);
+
+} // namespace kernels
+} // namespace xyz
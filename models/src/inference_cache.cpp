@@ -0,0 +1,183 @@
+#include "inference_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace xyz {
+
+namespace {
+
+// Murmur3 finalizer
+uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace
+
+InferenceCache::InferenceCache(size_t capacityBytes, size_t shardCount)
+    : capacity(capacityBytes)
+    , tag(MemoryScope::active())
+{
+    size_t count = 1;
+    while (count < std::max<size_t>(1, shardCount)) {
+        count <<= 1;
+    }
+    shardMask = count - 1;
+    shardCapacity = capacity / count;
+    shards = std::make_unique<Shard[]>(count);
+    tag.charge(count * sizeof(Shard));
+}
+
+InferenceCache::~InferenceCache() {
+    size_t bytes = (shardMask + 1) * sizeof(Shard);
+    for (size_t s = 0; s <= shardMask; ++s) {
+        bytes += shards[s].bytes;
+    }
+    tag.credit(bytes);
+}
+
+uint64_t InferenceCache::hashInput(const float* input, size_t inputSize) {
+    // Multiply-xorshift over 8-byte words; the length seeds the state so
+    // prefixes of one another do not collide
+    const auto* bytes = reinterpret_cast<const unsigned char*>(input);
+    const size_t length = inputSize * sizeof(float);
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (length * 0xc2b2ae3d27d4eb4fULL);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        h = (h ^ mix64(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, length - i);
+        h = (h ^ mix64(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    return mix64(h);
+}
+
+size_t InferenceCache::entryBytes(size_t inputSize, size_t outputSize) {
+    // Values plus the slot and its index node
+    return (inputSize + outputSize) * sizeof(float) + sizeof(Entry) + 4 * sizeof(void*);
+}
+
+bool InferenceCache::lookup(uint64_t hash, const float* input, size_t inputSize, float* output, size_t outputSize) {
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(hash);
+    if (it != shard.index.end()) {
+        Entry& entry = shard.entries[it->second];
+        // The hash only narrows the search; the input must match exactly
+        if (entry.inputSize == inputSize && entry.values.size() == inputSize + outputSize &&
+            std::memcmp(entry.values.data(), input, inputSize * sizeof(float)) == 0) {
+            std::memcpy(output, entry.values.data() + inputSize, outputSize * sizeof(float));
+            entry.referenced = true;
+            ++shard.hits;
+            return true;
+        }
+    }
+    ++shard.misses;
+    return false;
+}
+
+void InferenceCache::insert(uint64_t hash, const float* input, size_t inputSize,
+                            const float* output, size_t outputSize) {
+    const size_t needed = entryBytes(inputSize, outputSize);
+    if (needed > shardCapacity) {
+        return;
+    }
+
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // A colliding input replaces the entry under its hash
+    auto it = shard.index.find(hash);
+    if (it != shard.index.end()) {
+        remove(shard, it->second);
+    }
+    makeRoom(shard, needed);
+
+    size_t slot;
+    if (!shard.freeSlots.empty()) {
+        slot = shard.freeSlots.back();
+        shard.freeSlots.pop_back();
+    } else {
+        slot = shard.entries.size();
+        shard.entries.emplace_back();
+    }
+    Entry& entry = shard.entries[slot];
+    entry.hash = hash;
+    entry.inputSize = inputSize;
+    entry.values.assign(input, input + inputSize);
+    entry.values.insert(entry.values.end(), output, output + outputSize);
+    entry.referenced = false;
+    entry.live = true;
+    shard.index.emplace(hash, slot);
+    shard.bytes += needed;
+    tag.charge(needed);
+}
+
+void InferenceCache::makeRoom(Shard& shard, size_t needed) {
+    // Every live entry is passed at most twice: once to clear its
+    // reference bit and once to evict it
+    while (shard.bytes + needed > shardCapacity && !shard.index.empty()) {
+        if (shard.hand >= shard.entries.size()) {
+            shard.hand = 0;
+        }
+        Entry& entry = shard.entries[shard.hand];
+        if (entry.live) {
+            if (entry.referenced) {
+                entry.referenced = false;
+            } else {
+                remove(shard, shard.hand);
+                ++shard.evictions;
+            }
+        }
+        ++shard.hand;
+    }
+}
+
+void InferenceCache::remove(Shard& shard, size_t slot) {
+    Entry& entry = shard.entries[slot];
+    shard.index.erase(entry.hash);
+    const size_t bytes = entryBytes(entry.inputSize, entry.values.size() - entry.inputSize);
+    shard.bytes -= bytes;
+    tag.credit(bytes);
+    entry.values = std::vector<float>();
+    entry.live = false;
+    shard.freeSlots.push_back(slot);
+}
+
+void InferenceCache::clear() {
+    for (size_t s = 0; s <= shardMask; ++s) {
+        Shard& shard = shards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.freeSlots.clear();
+        shard.hand = 0;
+        tag.credit(shard.bytes);
+        shard.bytes = 0;
+    }
+}
+
+InferenceCache::Stats InferenceCache::getStats() const {
+    Stats stats;
+    for (size_t s = 0; s <= shardMask; ++s) {
+        Shard& shard = shards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.index.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
+
+} // namespace xyz
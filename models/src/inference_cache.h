@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "memory_account.h"
+
+namespace xyz {
+
+// Bounded cache of single-row inference results keyed by the exact input
+// bytes.
+//
+// Entries are spread over independently locked shards by input hash. Each
+// shard evicts with the CLOCK algorithm: a hit sets the entry's reference
+// bit, and the eviction hand clears set bits and evicts the first entry it
+// finds without one, which approximates LRU without reordering on hits.
+// Memory is bounded by counting the input, output and bookkeeping bytes of
+// every entry against a per-shard share of the budget. The same bytes are
+// charged to the MemoryScope active when the cache is constructed.
+class InferenceCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    // `shards` is rounded up to a power of two
+    InferenceCache(size_t capacityBytes, size_t shards);
+    ~InferenceCache();
+
+    InferenceCache(const InferenceCache&) = delete;
+    InferenceCache& operator=(const InferenceCache&) = delete;
+
+    // Key of `input`, computed once per call and passed to lookup/insert
+    static uint64_t hashInput(const float* input, size_t inputSize);
+
+    // Copies the cached result for `input` to `output` (which must hold
+    // `outputSize` values) and returns true on a hit
+    bool lookup(uint64_t hash, const float* input, size_t inputSize, float* output, size_t outputSize);
+    void insert(uint64_t hash, const float* input, size_t inputSize, const float* output, size_t outputSize);
+    // Drops all entries; counters are kept
+    void clear();
+
+    Stats getStats() const;
+    size_t getCapacity() const { return capacity; }
+
+private:
+    struct Entry {
+        uint64_t hash = 0;
+        size_t inputSize = 0;
+        // Input values followed by the output values
+        std::vector<float> values;
+        bool referenced = false;
+        bool live = false;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, size_t> index;
+        // CLOCK ring; dead slots are reused before the ring grows
+        std::vector<Entry> entries;
+        std::vector<size_t> freeSlots;
+        size_t hand = 0;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    static size_t entryBytes(size_t inputSize, size_t outputSize);
+    Shard& shardFor(uint64_t hash) { return shards[(hash >> 32) & shardMask]; }
+    // Evicts entries of `shard` until `needed` more bytes fit
+    void makeRoom(Shard& shard, size_t needed);
+    void remove(Shard& shard, size_t slot);
+
+    size_t capacity;
+    size_t shardCapacity;
+    size_t shardMask;
+    std::unique_ptr<Shard[]> shards;
+    MemoryTag tag;
+};
+
+} // namespace xyz
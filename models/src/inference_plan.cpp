@@ -0,0 +1,214 @@
+#include "inference_plan.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "decision_tree.h"
+#include "dense_network.h"
+#include "random_forest.h"
+#include "svm.h"
+
+namespace xyz {
+
+namespace {
+
+void runDense(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+              InferenceScratch& /*scratch*/) {
+    step.gemv(step.weights, step.ld, step.bias, input, output, step.rows, step.cols);
+    if (step.activation) {
+        step.activation(output, step.rows);
+    }
+}
+
+// Input normalization that could not be folded into the first layer; `bias`
+// holds the mean and `scales` the scale per feature
+void runNormalize(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+                  InferenceScratch& /*scratch*/) {
+    for (size_t c = 0; c < step.cols; ++c) {
+        output[c] = (input[c] - step.bias[c]) * step.scales[c];
+    }
+}
+
+void runDenseInt8(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+                  InferenceScratch& scratch) {
+    int8_t* quantInput = scratch.quantized(kernels::paddedStrideInt8(step.cols));
+    const float inputScale = kernels::quantizeSymmetric(input, step.cols, quantInput);
+    step.gemvInt8(step.quantWeights, step.ld, step.scales, step.bias, quantInput, inputScale,
+                  output, step.rows, step.cols);
+    if (step.activation) {
+        step.activation(output, step.rows);
+    }
+}
+
+void runDenseHalf(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+                  InferenceScratch& /*scratch*/) {
+    step.gemvHalf(step.halfWeights, step.ld, step.bias, input, output, step.rows, step.cols);
+    if (step.activation) {
+        step.activation(output, step.rows);
+    }
+}
+
+void runPassthrough(const PlanStep& step, const float* input, size_t width, float* output,
+                    InferenceScratch& /*scratch*/) {
+    std::memcpy(output, input, width * sizeof(float));
+    if (step.activation) {
+        step.activation(output, width);
+    }
+}
+
+void runTree(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+             InferenceScratch& /*scratch*/) {
+    static_cast<const DecisionTree*>(step.engine)->predict(input, output);
+}
+
+void runForest(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+               InferenceScratch& /*scratch*/) {
+    static_cast<const RandomForest*>(step.engine)->predict(input, output);
+}
+
+void runSvm(const PlanStep& step, const float* input, size_t /*width*/, float* output,
+            InferenceScratch& scratch) {
+    static_cast<const SupportVectorMachine*>(step.engine)->predict(input, output, scratch);
+}
+
+constexpr size_t ANY_WIDTH = std::numeric_limits<size_t>::max();
+
+} // namespace
+
+InferencePlan::InferencePlan()
+    : compiled(false)
+    , minInput(1)
+    , maxInput(ANY_WIDTH)
+    , fixedOutput(0)
+{
+}
+
+void InferencePlan::reset(size_t minInputSize, size_t maxInputSize, size_t outputs) {
+    compiled.store(false, std::memory_order_relaxed);
+    steps.clear();
+    minInput = std::max<size_t>(1, minInputSize);
+    maxInput = maxInputSize;
+    fixedOutput = outputs;
+}
+
+void InferencePlan::publish() {
+    compiled.store(true, std::memory_order_release);
+}
+
+void InferencePlan::clear() {
+    compiled.store(false, std::memory_order_release);
+    steps.clear();
+}
+
+void InferencePlan::reserve(InferenceScratch& scratch) const {
+    for (const PlanStep& step : steps) {
+        if (step.toScratch) {
+            scratch.floats(step.slot, step.outputSize);
+        }
+        if (step.quantWeights) {
+            scratch.quantized(kernels::paddedStrideInt8(step.cols));
+        }
+    }
+}
+
+void InferencePlan::compile(const DenseNetwork& network) {
+    const auto& table = kernels::getKernels(network.getSimdLevel());
+    if (network.empty()) {
+        compilePassthrough(kernels::activationKernel(table, network.getOutputActivation()));
+        return;
+    }
+
+    const auto& layers = network.getLayers();
+    reset(network.inputSize(), network.inputSize(), layers.back().outputSize);
+
+    if (network.hasInputNormalization()) {
+        PlanStep step;
+        step.run = runNormalize;
+        step.bias = network.inputMean();
+        step.scales = network.inputScale();
+        step.cols = network.inputSize();
+        step.toScratch = true;
+        step.slot = InferenceScratch::NORMALIZED;
+        step.outputSize = step.cols;
+        steps.push_back(step);
+    }
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const DenseLayer& layer = layers[i];
+        PlanStep step;
+        step.bias = layer.bias.data();
+        step.rows = layer.outputSize;
+        step.cols = layer.inputSize;
+        // Left null when the bound kernels already apply it
+        const bool fused = layer.bound && layer.bound.activation == layer.activation;
+        step.activation = fused ? nullptr : kernels::activationKernel(table, layer.activation);
+        if (layer.quantized()) {
+            step.run = runDenseInt8;
+            step.gemvInt8 = table.gemvInt8;
+            step.quantWeights = layer.quantWeights.data();
+            step.scales = layer.scales.data();
+            step.ld = layer.quantStride;
+        } else if (layer.halfPrecision()) {
+            step.run = runDenseHalf;
+            step.gemvHalf = table.gemvHalf[static_cast<size_t>(layer.halfType)];
+            step.halfWeights = layer.halfWeights.data();
+            step.ld = layer.stride;
+        } else {
+            step.run = runDense;
+            step.gemv = layer.bound ? layer.bound.gemv : table.gemv;
+            step.weights = layer.weights.data();
+            step.ld = layer.stride;
+        }
+        if (i + 1 < layers.size()) {
+            step.toScratch = true;
+            step.slot = i % 2 == 0 ? InferenceScratch::ACTIVATION_A : InferenceScratch::ACTIVATION_B;
+            step.outputSize = layer.outputSize;
+        }
+        steps.push_back(step);
+    }
+    publish();
+}
+
+void InferencePlan::compile(const DecisionTree& tree) {
+    reset(tree.featureCount(), ANY_WIDTH, tree.outputSize());
+    PlanStep step;
+    step.run = runTree;
+    step.engine = &tree;
+    steps.push_back(step);
+    publish();
+}
+
+void InferencePlan::compile(const RandomForest& forest) {
+    if (forest.empty()) {
+        compilePassthrough(nullptr);
+        return;
+    }
+    reset(forest.featureCount(), ANY_WIDTH, forest.outputSize());
+    PlanStep step;
+    step.run = runForest;
+    step.engine = &forest;
+    steps.push_back(step);
+    publish();
+}
+
+void InferencePlan::compile(const SupportVectorMachine& svm) {
+    if (svm.empty()) {
+        compilePassthrough(nullptr);
+        return;
+    }
+    reset(svm.inputSize(), svm.inputSize(), svm.outputSize());
+    PlanStep step;
+    step.run = runSvm;
+    step.engine = &svm;
+    steps.push_back(step);
+    publish();
+}
+
+void InferencePlan::compilePassthrough(kernels::ElementwiseFn activation) {
+    reset(1, ANY_WIDTH, 0);
+    PlanStep step;
+    step.run = runPassthrough;
+    step.activation = activation;
+    steps.push_back(step);
+    publish();
+}
+
+} // namespace xyz
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "inference_scratch.h"
+#include "kernels.h"
+
+namespace xyz {
+
+class DecisionTree;
+class DenseNetwork;
+class RandomForest;
+class SupportVectorMachine;
+
+struct PlanStep;
+
+// Runs one step from `input` into `output`; `width` is the caller's input
+// width, which only pass-through steps read
+using PlanStepFn = void (*)(const PlanStep& step, const float* input, size_t width, float* output,
+                            InferenceScratch& scratch);
+
+// One pre-bound operation of an inference plan. Only the fields its `run`
+// function reads are set.
+struct PlanStep {
+    PlanStepFn run = nullptr;
+    // Engine evaluated as a whole (tree, forest, SVM)
+    const void* engine = nullptr;
+
+    // Dense layer operands
+    kernels::GemvFn gemv = nullptr;
+    kernels::GemvInt8Fn gemvInt8 = nullptr;
+    kernels::GemvHalfFn gemvHalf = nullptr;
+    const float* weights = nullptr;
+    const int8_t* quantWeights = nullptr;
+    const uint16_t* halfWeights = nullptr;
+    const float* scales = nullptr;
+    const float* bias = nullptr;
+    size_t ld = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+    // Applied in place to the step output; null for none
+    kernels::ElementwiseFn activation = nullptr;
+
+    // Scratch slot of `outputSize` floats the step writes to, unless it is
+    // the last step, which writes to the caller's buffer
+    bool toScratch = false;
+    InferenceScratch::Slot slot = InferenceScratch::ACTIVATION_A;
+    size_t outputSize = 0;
+};
+
+// A model compiled into a flat list of steps with kernels, shapes and
+// intermediate buffers resolved up front, so running it needs no type
+// dispatch, string handling or allocation. Plans point into the engine they
+// were compiled from and must be recompiled whenever it changes. A compiled
+// plan is immutable: intermediate rows live in the InferenceScratch of each
+// call, so any number of threads may run it at once.
+class InferencePlan {
+public:
+    InferencePlan();
+
+    InferencePlan(const InferencePlan&) = delete;
+    InferencePlan& operator=(const InferencePlan&) = delete;
+
+    // Each compile call replaces the whole plan
+    void compile(const DenseNetwork& network);
+    void compile(const DecisionTree& tree);
+    void compile(const RandomForest& forest);
+    void compile(const SupportVectorMachine& svm);
+    // Copies the input through, then applies `activation` (null for none)
+    void compilePassthrough(kernels::ElementwiseFn activation);
+
+    void clear();
+    // Marks the plan stale. Compiling publishes the new steps to threads
+    // that see valid() afterwards.
+    void invalidate() { compiled.store(false, std::memory_order_release); }
+    bool valid() const { return compiled.load(std::memory_order_acquire); }
+
+    bool acceptsInput(size_t inputSize) const { return inputSize >= minInput && inputSize <= maxInput; }
+    size_t outputSize(size_t inputSize) const { return fixedOutput ? fixedOutput : inputSize; }
+    size_t stepCount() const { return steps.size(); }
+
+    // `input` must satisfy acceptsInput(inputSize) and `output` hold
+    // outputSize(inputSize) values
+    void run(const float* input, size_t inputSize, float* output, InferenceScratch& scratch) const {
+        const float* current = input;
+        for (const PlanStep& step : steps) {
+            float* next = step.toScratch ? scratch.floats(step.slot, step.outputSize) : output;
+            step.run(step, current, inputSize, next, scratch);
+            current = next;
+        }
+    }
+
+    // Grows `scratch` to the activation rows run() needs, so the first call
+    // does not allocate them
+    void reserve(InferenceScratch& scratch) const;
+
+private:
+    void reset(size_t minInputSize, size_t maxInputSize, size_t outputs);
+    // Marks the steps complete
+    void publish();
+
+    std::vector<PlanStep> steps;
+    std::atomic<bool> compiled;
+    size_t minInput;
+    size_t maxInput;
+    // Output width, or 0 when it equals the input width
+    size_t fixedOutput;
+};
+
+} // namespace xyz
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "aligned_buffer.h"
+#include "memory_account.h"
+
+namespace xyz {
+
+// Intermediate buffers of one inference call. Engines and compiled plans
+// are shared by every thread running a model and keep no per-call state;
+// they evaluate into a scratch owned by the caller instead. Buffers only
+// grow, so a scratch reused for calls of the same shape never allocates.
+// Growth is charged to the enclosing MemoryScope as SCRATCH.
+class InferenceScratch {
+public:
+    enum Slot {
+        // Ping-pong activations between dense layers
+        ACTIVATION_A,
+        ACTIVATION_B,
+        // Normalized input rows
+        NORMALIZED,
+        // Dense feature row that sparse inputs are scattered into; zero
+        // except during a call, which clears what it scattered
+        FEATURES,
+        // SVM kernel values of a block of rows
+        KERNEL,
+        SLOT_COUNT
+    };
+
+    // At least `count` floats of `slot`; growing discards the contents
+    float* floats(Slot slot, size_t count) {
+        AlignedBuffer<float>& buffer = slots[slot];
+        if (buffer.size() < count) {
+            grow(buffer, count);
+        }
+        return buffer.data();
+    }
+
+    // At least `count` bytes for a quantized input row
+    int8_t* quantized(size_t count) {
+        if (quantRow.size() < count) {
+            grow(quantRow, count);
+        }
+        return quantRow.data();
+    }
+
+private:
+    template<typename T>
+    static void grow(AlignedBuffer<T>& buffer, size_t count) {
+        MemoryScope scope(MemoryCategory::SCRATCH);
+        buffer.resize(count);
+    }
+
+    AlignedBuffer<float> slots[SLOT_COUNT];
+    AlignedBuffer<int8_t> quantRow;
+};
+
+// Scratch of one model, lent to one call at a time. The pool keeps as many
+// as calls have run on the model concurrently.
+class ScratchPool {
+public:
+    // Returns its scratch to the pool when it goes out of scope
+    class Lease {
+    public:
+        Lease(ScratchPool& owner, std::unique_ptr<InferenceScratch> lent)
+            : pool(owner)
+            , scratch(std::move(lent))
+        {
+        }
+        ~Lease() { pool.release(std::move(scratch)); }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        InferenceScratch& operator*() const { return *scratch; }
+        InferenceScratch* operator->() const { return scratch.get(); }
+
+    private:
+        ScratchPool& pool;
+        std::unique_ptr<InferenceScratch> scratch;
+    };
+
+    Lease acquire() {
+        std::unique_ptr<InferenceScratch> scratch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty()) {
+                scratch = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if (!scratch) {
+            scratch = std::make_unique<InferenceScratch>();
+        }
+        return Lease(*this, std::move(scratch));
+    }
+
+private:
+    void release(std::unique_ptr<InferenceScratch> scratch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(scratch));
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<InferenceScratch>> idle;
+};
+
+} // namespace xyz
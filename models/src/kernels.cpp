@@ -0,0 +1,1376 @@
+#include "kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "simd_math.h"
+#include "simd_target.h"
+
+namespace xyz {
+namespace kernels {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Scalar fallback
+// ---------------------------------------------------------------------------
+
+// GEMV kernels apply the activation to each output before storing it; the
+// plain GemvFn entries are their Activation::NONE instances
+template<Activation Act>
+void gemvActScalar(const float* weights, size_t ld, const float* bias,
+                   const float* x, float* y, size_t rows, size_t cols) {
+    for (size_t r = 0; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        float acc = 0.0f;
+        for (size_t c = 0; c < cols; ++c) {
+            acc += w[c] * x[c];
+        }
+        y[r] = activateScalar<Act>(acc + (bias ? bias[r] : 0.0f));
+    }
+}
+
+void gemvScalar(const float* weights, size_t ld, const float* bias,
+                const float* x, float* y, size_t rows, size_t cols) {
+    gemvActScalar<Activation::NONE>(weights, ld, bias, x, y, rows, cols);
+}
+
+void gemmScalar(const float* weights, size_t ld, const float* bias,
+                const float* x, size_t ldx, float* y, size_t ldy,
+                size_t batch, size_t rows, size_t cols) {
+    for (size_t i = 0; i < batch; ++i) {
+        gemvScalar(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+void reluScalar(float* data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = data[i] > 0.0f ? data[i] : 0.0f;
+    }
+}
+
+void tanhScalar(float* data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = std::tanh(data[i]);
+    }
+}
+
+void sigmoidScalar(float* data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = 1.0f / (1.0f + std::exp(-data[i]));
+    }
+}
+
+void expScalar(float* data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = std::exp(std::min(std::max(data[i], EXP_LO), EXP_HI));
+    }
+}
+
+void gemvInt8Scalar(const int8_t* weights, size_t ld, const float* scales, const float* bias,
+                    const int8_t* x, float xScale, float* y, size_t rows, size_t cols) {
+    for (size_t r = 0; r < rows; ++r) {
+        const int8_t* w = weights + r * ld;
+        int32_t acc = 0;
+        for (size_t c = 0; c < cols; ++c) {
+            acc += static_cast<int32_t>(w[c]) * static_cast<int32_t>(x[c]);
+        }
+        y[r] = static_cast<float>(acc) * scales[r] * xScale + (bias ? bias[r] : 0.0f);
+    }
+}
+
+float fp16ToFloat(uint16_t value) {
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        // Infinity or NaN
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else {
+        // Zero or subnormal: mantissa * 2^-24, exact in float
+        const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+float bf16ToFloat(uint16_t value) {
+    const uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+template<HalfType Type>
+inline float widen(uint16_t value) {
+    return Type == HalfType::FP16 ? fp16ToFloat(value) : bf16ToFloat(value);
+}
+
+template<HalfType Type>
+void gemvHalfScalar(const uint16_t* weights, size_t ld, const float* bias,
+                    const float* x, float* y, size_t rows, size_t cols) {
+    for (size_t r = 0; r < rows; ++r) {
+        const uint16_t* w = weights + r * ld;
+        float acc = 0.0f;
+        for (size_t c = 0; c < cols; ++c) {
+            acc += widen<Type>(w[c]) * x[c];
+        }
+        y[r] = acc + (bias ? bias[r] : 0.0f);
+    }
+}
+
+template<HalfType Type>
+void gemmHalfScalar(const uint16_t* weights, size_t ld, const float* bias,
+                    const float* x, size_t ldx, float* y, size_t ldy,
+                    size_t batch, size_t rows, size_t cols) {
+    for (size_t i = 0; i < batch; ++i) {
+        gemvHalfScalar<Type>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+void sparseGatherScalar(const float* weights, size_t ld, const float* bias,
+                        const uint32_t* indices, const float* values, size_t nnz,
+                        float* y, size_t rows) {
+    for (size_t r = 0; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        float acc = 0.0f;
+        for (size_t k = 0; k < nnz; ++k) {
+            acc += w[indices[k]] * values[k];
+        }
+        y[r] = acc + (bias ? bias[r] : 0.0f);
+    }
+}
+
+void sparseAxpyScalar(const float* weights, size_t ld, const float* bias,
+                      const uint32_t* indices, const float* values, size_t nnz,
+                      float* y, size_t rows) {
+    for (size_t r = 0; r < rows; ++r) {
+        y[r] = bias ? bias[r] : 0.0f;
+    }
+    for (size_t k = 0; k < nnz; ++k) {
+        const float* w = weights + static_cast<size_t>(indices[k]) * ld;
+        const float value = values[k];
+        for (size_t r = 0; r < rows; ++r) {
+            y[r] += value * w[r];
+        }
+    }
+}
+
+// Softmax over one row on top of a level's exp kernel
+template<ElementwiseFn Exp>
+void softmaxWith(float* data, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    const float maxValue = *std::max_element(data, data + n);
+    for (size_t i = 0; i < n; ++i) {
+        data[i] -= maxValue;
+    }
+    Exp(data, n);
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += data[i];
+    }
+    const float inv = 1.0f / sum;
+    for (size_t i = 0; i < n; ++i) {
+        data[i] *= inv;
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA
+// ---------------------------------------------------------------------------
+
+XYZ_TARGET_AVX2 inline float hsum256(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    __m128 shuf = _mm_movehdup_ps(lo);
+    __m128 sums = _mm_add_ps(lo, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+// Lane mask selecting the first `n` (< 8) lanes, for masked tail loads
+XYZ_TARGET_AVX2 inline __m256i tailMask256(size_t n) {
+    alignas(32) static const int table[16] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table + 8 - n));
+}
+
+template<Activation Act>
+XYZ_TARGET_AVX2 void gemvActAvx2(const float* weights, size_t ld, const float* bias,
+                                 const float* x, float* y, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(7);
+    const size_t tail = cols - bodyCols;
+    const __m256i mask = tailMask256(tail);
+
+    size_t r = 0;
+    // Four output rows per pass so each load of x feeds four FMAs
+    for (; r + 4 <= rows; r += 4) {
+        const float* w0 = weights + r * ld;
+        const float* w1 = w0 + ld;
+        const float* w2 = w1 + ld;
+        const float* w3 = w2 + ld;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 8) {
+            __m256 xv = _mm256_loadu_ps(x + c);
+            acc0 = _mm256_fmadd_ps(_mm256_load_ps(w0 + c), xv, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_load_ps(w1 + c), xv, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_load_ps(w2 + c), xv, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_load_ps(w3 + c), xv, acc3);
+        }
+        if (tail) {
+            // Padding columns of the weight rows are zero, so a full load is safe
+            __m256 xv = _mm256_maskload_ps(x + bodyCols, mask);
+            acc0 = _mm256_fmadd_ps(_mm256_load_ps(w0 + bodyCols), xv, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_load_ps(w1 + bodyCols), xv, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_load_ps(w2 + bodyCols), xv, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_load_ps(w3 + bodyCols), xv, acc3);
+        }
+        if constexpr (Act == Activation::NONE) {
+            y[r] = hsum256(acc0) + (bias ? bias[r] : 0.0f);
+            y[r + 1] = hsum256(acc1) + (bias ? bias[r + 1] : 0.0f);
+            y[r + 2] = hsum256(acc2) + (bias ? bias[r + 2] : 0.0f);
+            y[r + 3] = hsum256(acc3) + (bias ? bias[r + 3] : 0.0f);
+        } else {
+            // The four outputs are activated in registers and leave in one store
+            __m128 sums = _mm_setr_ps(hsum256(acc0), hsum256(acc1), hsum256(acc2), hsum256(acc3));
+            if (bias) {
+                sums = _mm_add_ps(sums, _mm_loadu_ps(bias + r));
+            }
+            _mm_storeu_ps(y + r, _mm256_castps256_ps128(activate256<Act>(_mm256_set_m128(sums, sums))));
+        }
+    }
+    for (; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        __m256 acc = _mm256_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 8) {
+            acc = _mm256_fmadd_ps(_mm256_load_ps(w + c), _mm256_loadu_ps(x + c), acc);
+        }
+        if (tail) {
+            acc = _mm256_fmadd_ps(_mm256_load_ps(w + bodyCols),
+                                  _mm256_maskload_ps(x + bodyCols, mask), acc);
+        }
+        y[r] = activateScalar<Act>(hsum256(acc) + (bias ? bias[r] : 0.0f));
+    }
+}
+
+XYZ_TARGET_AVX2 void gemvAvx2(const float* weights, size_t ld, const float* bias,
+                              const float* x, float* y, size_t rows, size_t cols) {
+    gemvActAvx2<Activation::NONE>(weights, ld, bias, x, y, rows, cols);
+}
+
+// Register-blocked GEMM: each pass computes a 4 (inputs) x 2 (outputs) tile
+// so every weight vector load is reused across four input rows
+XYZ_TARGET_AVX2 void gemmAvx2(const float* weights, size_t ld, const float* bias,
+                              const float* x, size_t ldx, float* y, size_t ldy,
+                              size_t batch, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(7);
+    const size_t tail = cols - bodyCols;
+    const __m256i mask = tailMask256(tail);
+
+    size_t i = 0;
+    for (; i + 4 <= batch; i += 4) {
+        const float* x0 = x + i * ldx;
+        const float* x1 = x0 + ldx;
+        const float* x2 = x1 + ldx;
+        const float* x3 = x2 + ldx;
+        float* y0 = y + i * ldy;
+        float* y1 = y0 + ldy;
+        float* y2 = y1 + ldy;
+        float* y3 = y2 + ldy;
+
+        size_t r = 0;
+        for (; r + 2 <= rows; r += 2) {
+            const float* wa = weights + r * ld;
+            const float* wb = wa + ld;
+            __m256 a0 = _mm256_setzero_ps(), b0 = _mm256_setzero_ps();
+            __m256 a1 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+            __m256 a2 = _mm256_setzero_ps(), b2 = _mm256_setzero_ps();
+            __m256 a3 = _mm256_setzero_ps(), b3 = _mm256_setzero_ps();
+            for (size_t c = 0; c < bodyCols; c += 8) {
+                __m256 wav = _mm256_load_ps(wa + c);
+                __m256 wbv = _mm256_load_ps(wb + c);
+                __m256 xv = _mm256_loadu_ps(x0 + c);
+                a0 = _mm256_fmadd_ps(wav, xv, a0);
+                b0 = _mm256_fmadd_ps(wbv, xv, b0);
+                xv = _mm256_loadu_ps(x1 + c);
+                a1 = _mm256_fmadd_ps(wav, xv, a1);
+                b1 = _mm256_fmadd_ps(wbv, xv, b1);
+                xv = _mm256_loadu_ps(x2 + c);
+                a2 = _mm256_fmadd_ps(wav, xv, a2);
+                b2 = _mm256_fmadd_ps(wbv, xv, b2);
+                xv = _mm256_loadu_ps(x3 + c);
+                a3 = _mm256_fmadd_ps(wav, xv, a3);
+                b3 = _mm256_fmadd_ps(wbv, xv, b3);
+            }
+            if (tail) {
+                __m256 wav = _mm256_load_ps(wa + bodyCols);
+                __m256 wbv = _mm256_load_ps(wb + bodyCols);
+                __m256 xv = _mm256_maskload_ps(x0 + bodyCols, mask);
+                a0 = _mm256_fmadd_ps(wav, xv, a0);
+                b0 = _mm256_fmadd_ps(wbv, xv, b0);
+                xv = _mm256_maskload_ps(x1 + bodyCols, mask);
+                a1 = _mm256_fmadd_ps(wav, xv, a1);
+                b1 = _mm256_fmadd_ps(wbv, xv, b1);
+                xv = _mm256_maskload_ps(x2 + bodyCols, mask);
+                a2 = _mm256_fmadd_ps(wav, xv, a2);
+                b2 = _mm256_fmadd_ps(wbv, xv, b2);
+                xv = _mm256_maskload_ps(x3 + bodyCols, mask);
+                a3 = _mm256_fmadd_ps(wav, xv, a3);
+                b3 = _mm256_fmadd_ps(wbv, xv, b3);
+            }
+            const float ba = bias ? bias[r] : 0.0f;
+            const float bb = bias ? bias[r + 1] : 0.0f;
+            y0[r] = hsum256(a0) + ba; y0[r + 1] = hsum256(b0) + bb;
+            y1[r] = hsum256(a1) + ba; y1[r + 1] = hsum256(b1) + bb;
+            y2[r] = hsum256(a2) + ba; y2[r + 1] = hsum256(b2) + bb;
+            y3[r] = hsum256(a3) + ba; y3[r + 1] = hsum256(b3) + bb;
+        }
+        if (r < rows) {
+            const size_t remaining = rows - r;
+            gemvAvx2(weights + r * ld, ld, bias ? bias + r : nullptr, x0, y0 + r, remaining, cols);
+            gemvAvx2(weights + r * ld, ld, bias ? bias + r : nullptr, x1, y1 + r, remaining, cols);
+            gemvAvx2(weights + r * ld, ld, bias ? bias + r : nullptr, x2, y2 + r, remaining, cols);
+            gemvAvx2(weights + r * ld, ld, bias ? bias + r : nullptr, x3, y3 + r, remaining, cols);
+        }
+    }
+    for (; i < batch; ++i) {
+        gemvAvx2(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+XYZ_TARGET_AVX2 void reluAvx2(float* data, size_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_max_ps(_mm256_loadu_ps(data + i), zero));
+    }
+    reluScalar(data + i, n - i);
+}
+
+XYZ_TARGET_AVX2 void expAvx2(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, exp256(_mm256_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __m256i mask = tailMask256(n - i);
+        _mm256_maskstore_ps(data + i, mask, exp256(_mm256_maskload_ps(data + i, mask)));
+    }
+}
+
+XYZ_TARGET_AVX2 void tanhAvx2(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, tanh256(_mm256_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __m256i mask = tailMask256(n - i);
+        _mm256_maskstore_ps(data + i, mask, tanh256(_mm256_maskload_ps(data + i, mask)));
+    }
+}
+
+XYZ_TARGET_AVX2 void sigmoidAvx2(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, sigmoid256(_mm256_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __m256i mask = tailMask256(n - i);
+        _mm256_maskstore_ps(data + i, mask, sigmoid256(_mm256_maskload_ps(data + i, mask)));
+    }
+}
+
+XYZ_TARGET_AVX2 inline int32_t hsum256i(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// maddubs multiplies unsigned by signed bytes, so |x| meets the weights with
+// the sign of x moved onto them. Values stay within [-127, 127], so the
+// pairwise int16 sums (at most 2 * 127 * 127) cannot saturate.
+XYZ_TARGET_AVX2 inline __m256i dotInt8Avx2(__m256i acc, __m256i absX, __m256i x, const int8_t* w) {
+    const __m256i weights = _mm256_load_si256(reinterpret_cast<const __m256i*>(w));
+    const __m256i pairs = _mm256_maddubs_epi16(absX, _mm256_sign_epi8(weights, x));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+}
+
+XYZ_TARGET_AVX2 void gemvInt8Avx2(const int8_t* weights, size_t ld, const float* scales, const float* bias,
+                                  const int8_t* x, float xScale, float* y, size_t rows, size_t cols) {
+    // Zero weight padding makes whole vectors past `cols` harmless
+    const size_t span = (cols + 31) & ~static_cast<size_t>(31);
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const int8_t* w = weights + r * ld;
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        __m256i acc3 = _mm256_setzero_si256();
+        for (size_t c = 0; c < span; c += 32) {
+            const __m256i xv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + c));
+            const __m256i ax = _mm256_abs_epi8(xv);
+            acc0 = dotInt8Avx2(acc0, ax, xv, w + c);
+            acc1 = dotInt8Avx2(acc1, ax, xv, w + ld + c);
+            acc2 = dotInt8Avx2(acc2, ax, xv, w + 2 * ld + c);
+            acc3 = dotInt8Avx2(acc3, ax, xv, w + 3 * ld + c);
+        }
+        const __m256i sums[4] = {acc0, acc1, acc2, acc3};
+        for (size_t k = 0; k < 4; ++k) {
+            y[r + k] = static_cast<float>(hsum256i(sums[k])) * scales[r + k] * xScale +
+                       (bias ? bias[r + k] : 0.0f);
+        }
+    }
+    for (; r < rows; ++r) {
+        const int8_t* w = weights + r * ld;
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t c = 0; c < span; c += 32) {
+            const __m256i xv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + c));
+            acc = dotInt8Avx2(acc, _mm256_abs_epi8(xv), xv, w + c);
+        }
+        y[r] = static_cast<float>(hsum256i(acc)) * scales[r] * xScale + (bias ? bias[r] : 0.0f);
+    }
+}
+
+// Eight 16-bit weights widened to float. fp16 converts with F16C; bf16 is
+// the upper half of a float, so a shift does.
+template<HalfType Type>
+XYZ_TARGET_AVX2_F16C inline __m256 widen256(const uint16_t* w) {
+    const __m128i half = _mm_load_si128(reinterpret_cast<const __m128i*>(w));
+    if (Type == HalfType::FP16) {
+        return _mm256_cvtph_ps(half);
+    }
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(half), 16));
+}
+
+// Same blocking as gemvAvx2; weights are widened once per load and never
+// stored as floats
+template<HalfType Type>
+XYZ_TARGET_AVX2_F16C void gemvHalfAvx2(const uint16_t* weights, size_t ld, const float* bias,
+                                       const float* x, float* y, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(7);
+    const size_t tail = cols - bodyCols;
+    const __m256i mask = tailMask256(tail);
+
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const uint16_t* w0 = weights + r * ld;
+        const uint16_t* w1 = w0 + ld;
+        const uint16_t* w2 = w1 + ld;
+        const uint16_t* w3 = w2 + ld;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 8) {
+            __m256 xv = _mm256_loadu_ps(x + c);
+            acc0 = _mm256_fmadd_ps(widen256<Type>(w0 + c), xv, acc0);
+            acc1 = _mm256_fmadd_ps(widen256<Type>(w1 + c), xv, acc1);
+            acc2 = _mm256_fmadd_ps(widen256<Type>(w2 + c), xv, acc2);
+            acc3 = _mm256_fmadd_ps(widen256<Type>(w3 + c), xv, acc3);
+        }
+        if (tail) {
+            __m256 xv = _mm256_maskload_ps(x + bodyCols, mask);
+            acc0 = _mm256_fmadd_ps(widen256<Type>(w0 + bodyCols), xv, acc0);
+            acc1 = _mm256_fmadd_ps(widen256<Type>(w1 + bodyCols), xv, acc1);
+            acc2 = _mm256_fmadd_ps(widen256<Type>(w2 + bodyCols), xv, acc2);
+            acc3 = _mm256_fmadd_ps(widen256<Type>(w3 + bodyCols), xv, acc3);
+        }
+        y[r] = hsum256(acc0) + (bias ? bias[r] : 0.0f);
+        y[r + 1] = hsum256(acc1) + (bias ? bias[r + 1] : 0.0f);
+        y[r + 2] = hsum256(acc2) + (bias ? bias[r + 2] : 0.0f);
+        y[r + 3] = hsum256(acc3) + (bias ? bias[r + 3] : 0.0f);
+    }
+    for (; r < rows; ++r) {
+        const uint16_t* w = weights + r * ld;
+        __m256 acc = _mm256_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 8) {
+            acc = _mm256_fmadd_ps(widen256<Type>(w + c), _mm256_loadu_ps(x + c), acc);
+        }
+        if (tail) {
+            acc = _mm256_fmadd_ps(widen256<Type>(w + bodyCols), _mm256_maskload_ps(x + bodyCols, mask), acc);
+        }
+        y[r] = hsum256(acc) + (bias ? bias[r] : 0.0f);
+    }
+}
+
+// 4 (inputs) x 2 (outputs) tiles as in gemmAvx2, so each widened weight
+// vector feeds four input rows
+template<HalfType Type>
+XYZ_TARGET_AVX2_F16C void gemmHalfAvx2(const uint16_t* weights, size_t ld, const float* bias,
+                                       const float* x, size_t ldx, float* y, size_t ldy,
+                                       size_t batch, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(7);
+    const size_t tail = cols - bodyCols;
+    const __m256i mask = tailMask256(tail);
+
+    size_t i = 0;
+    for (; i + 4 <= batch; i += 4) {
+        const float* x0 = x + i * ldx;
+        const float* x1 = x0 + ldx;
+        const float* x2 = x1 + ldx;
+        const float* x3 = x2 + ldx;
+        float* y0 = y + i * ldy;
+        float* y1 = y0 + ldy;
+        float* y2 = y1 + ldy;
+        float* y3 = y2 + ldy;
+
+        size_t r = 0;
+        for (; r + 2 <= rows; r += 2) {
+            const uint16_t* wa = weights + r * ld;
+            const uint16_t* wb = wa + ld;
+            __m256 a0 = _mm256_setzero_ps(), b0 = _mm256_setzero_ps();
+            __m256 a1 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+            __m256 a2 = _mm256_setzero_ps(), b2 = _mm256_setzero_ps();
+            __m256 a3 = _mm256_setzero_ps(), b3 = _mm256_setzero_ps();
+            for (size_t c = 0; c < cols; c += 8) {
+                __m256 wav = widen256<Type>(wa + c);
+                __m256 wbv = widen256<Type>(wb + c);
+                const bool full = c < bodyCols;
+                __m256 xv = full ? _mm256_loadu_ps(x0 + c) : _mm256_maskload_ps(x0 + c, mask);
+                a0 = _mm256_fmadd_ps(wav, xv, a0);
+                b0 = _mm256_fmadd_ps(wbv, xv, b0);
+                xv = full ? _mm256_loadu_ps(x1 + c) : _mm256_maskload_ps(x1 + c, mask);
+                a1 = _mm256_fmadd_ps(wav, xv, a1);
+                b1 = _mm256_fmadd_ps(wbv, xv, b1);
+                xv = full ? _mm256_loadu_ps(x2 + c) : _mm256_maskload_ps(x2 + c, mask);
+                a2 = _mm256_fmadd_ps(wav, xv, a2);
+                b2 = _mm256_fmadd_ps(wbv, xv, b2);
+                xv = full ? _mm256_loadu_ps(x3 + c) : _mm256_maskload_ps(x3 + c, mask);
+                a3 = _mm256_fmadd_ps(wav, xv, a3);
+                b3 = _mm256_fmadd_ps(wbv, xv, b3);
+            }
+            const float ba = bias ? bias[r] : 0.0f;
+            const float bb = bias ? bias[r + 1] : 0.0f;
+            y0[r] = hsum256(a0) + ba; y0[r + 1] = hsum256(b0) + bb;
+            y1[r] = hsum256(a1) + ba; y1[r + 1] = hsum256(b1) + bb;
+            y2[r] = hsum256(a2) + ba; y2[r + 1] = hsum256(b2) + bb;
+            y3[r] = hsum256(a3) + ba; y3[r + 1] = hsum256(b3) + bb;
+        }
+        if (r < rows) {
+            const size_t remaining = rows - r;
+            gemvHalfAvx2<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x0, y0 + r, remaining, cols);
+            gemvHalfAvx2<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x1, y1 + r, remaining, cols);
+            gemvHalfAvx2<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x2, y2 + r, remaining, cols);
+            gemvHalfAvx2<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x3, y3 + r, remaining, cols);
+        }
+    }
+    for (; i < batch; ++i) {
+        gemvHalfAvx2<Type>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+// Eight active inputs per gather; four rows share each load of the indices
+// and values
+XYZ_TARGET_AVX2 void sparseGatherAvx2(const float* weights, size_t ld, const float* bias,
+                                      const uint32_t* indices, const float* values, size_t nnz,
+                                      float* y, size_t rows) {
+    const size_t body = nnz & ~static_cast<size_t>(7);
+    const __m256i mask = tailMask256(nnz - body);
+    const __m256 maskPs = _mm256_castsi256_ps(mask);
+    const __m256 zero = _mm256_setzero_ps();
+    const int* idx = reinterpret_cast<const int*>(indices);
+
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* w0 = weights + r * ld;
+        const float* w1 = w0 + ld;
+        const float* w2 = w1 + ld;
+        const float* w3 = w2 + ld;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for (size_t k = 0; k < body; k += 8) {
+            const __m256i iv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + k));
+            const __m256 xv = _mm256_loadu_ps(values + k);
+            acc0 = _mm256_fmadd_ps(_mm256_i32gather_ps(w0, iv, 4), xv, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_i32gather_ps(w1, iv, 4), xv, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_i32gather_ps(w2, iv, 4), xv, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_i32gather_ps(w3, iv, 4), xv, acc3);
+        }
+        if (body < nnz) {
+            const __m256i iv = _mm256_maskload_epi32(idx + body, mask);
+            const __m256 xv = _mm256_maskload_ps(values + body, mask);
+            acc0 = _mm256_fmadd_ps(_mm256_mask_i32gather_ps(zero, w0, iv, maskPs, 4), xv, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_mask_i32gather_ps(zero, w1, iv, maskPs, 4), xv, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_mask_i32gather_ps(zero, w2, iv, maskPs, 4), xv, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_mask_i32gather_ps(zero, w3, iv, maskPs, 4), xv, acc3);
+        }
+        y[r] = hsum256(acc0) + (bias ? bias[r] : 0.0f);
+        y[r + 1] = hsum256(acc1) + (bias ? bias[r + 1] : 0.0f);
+        y[r + 2] = hsum256(acc2) + (bias ? bias[r + 2] : 0.0f);
+        y[r + 3] = hsum256(acc3) + (bias ? bias[r + 3] : 0.0f);
+    }
+    for (; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        __m256 acc = _mm256_setzero_ps();
+        for (size_t k = 0; k < body; k += 8) {
+            const __m256i iv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + k));
+            acc = _mm256_fmadd_ps(_mm256_i32gather_ps(w, iv, 4), _mm256_loadu_ps(values + k), acc);
+        }
+        if (body < nnz) {
+            const __m256i iv = _mm256_maskload_epi32(idx + body, mask);
+            acc = _mm256_fmadd_ps(_mm256_mask_i32gather_ps(zero, w, iv, maskPs, 4),
+                                  _mm256_maskload_ps(values + body, mask), acc);
+        }
+        y[r] = hsum256(acc) + (bias ? bias[r] : 0.0f);
+    }
+}
+
+// Blocks of 32 outputs stay in four registers across all active inputs
+XYZ_TARGET_AVX2 void sparseAxpyAvx2(const float* weights, size_t ld, const float* bias,
+                                    const uint32_t* indices, const float* values, size_t nnz,
+                                    float* y, size_t rows) {
+    for (size_t base = 0; base < rows; base += 32) {
+        const size_t width = std::min<size_t>(32, rows - base);
+        __m256i masks[4];
+        __m256 acc[4];
+        for (size_t v = 0; v < 4; ++v) {
+            const size_t start = v * 8;
+            masks[v] = tailMask256(width > start ? std::min<size_t>(8, width - start) : 0);
+            acc[v] = bias ? _mm256_maskload_ps(bias + base + start, masks[v]) : _mm256_setzero_ps();
+        }
+        for (size_t k = 0; k < nnz; ++k) {
+            // Padding past `rows` is zero, so whole vectors can be loaded
+            const float* w = weights + static_cast<size_t>(indices[k]) * ld + base;
+            const __m256 value = _mm256_set1_ps(values[k]);
+            acc[0] = _mm256_fmadd_ps(_mm256_load_ps(w), value, acc[0]);
+            if (width > 8) {
+                acc[1] = _mm256_fmadd_ps(_mm256_load_ps(w + 8), value, acc[1]);
+            }
+            if (width > 16) {
+                acc[2] = _mm256_fmadd_ps(_mm256_load_ps(w + 16), value, acc[2]);
+            }
+            if (width > 24) {
+                acc[3] = _mm256_fmadd_ps(_mm256_load_ps(w + 24), value, acc[3]);
+            }
+        }
+        for (size_t v = 0; v < 4; ++v) {
+            _mm256_maskstore_ps(y + base + v * 8, masks[v], acc[v]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512F
+// ---------------------------------------------------------------------------
+
+XYZ_TARGET_AVX512 inline __mmask16 tailMask512(size_t n) {
+    return static_cast<__mmask16>((1u << n) - 1u);
+}
+
+template<Activation Act>
+XYZ_TARGET_AVX512 void gemvActAvx512(const float* weights, size_t ld, const float* bias,
+                                     const float* x, float* y, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(15);
+    const size_t tail = cols - bodyCols;
+    const __mmask16 mask = tailMask512(tail);
+
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* w0 = weights + r * ld;
+        const float* w1 = w0 + ld;
+        const float* w2 = w1 + ld;
+        const float* w3 = w2 + ld;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 16) {
+            __m512 xv = _mm512_loadu_ps(x + c);
+            acc0 = _mm512_fmadd_ps(_mm512_load_ps(w0 + c), xv, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_load_ps(w1 + c), xv, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_load_ps(w2 + c), xv, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_load_ps(w3 + c), xv, acc3);
+        }
+        if (tail) {
+            __m512 xv = _mm512_maskz_loadu_ps(mask, x + bodyCols);
+            acc0 = _mm512_fmadd_ps(_mm512_load_ps(w0 + bodyCols), xv, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_load_ps(w1 + bodyCols), xv, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_load_ps(w2 + bodyCols), xv, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_load_ps(w3 + bodyCols), xv, acc3);
+        }
+        if constexpr (Act == Activation::NONE) {
+            y[r] = _mm512_reduce_add_ps(acc0) + (bias ? bias[r] : 0.0f);
+            y[r + 1] = _mm512_reduce_add_ps(acc1) + (bias ? bias[r + 1] : 0.0f);
+            y[r + 2] = _mm512_reduce_add_ps(acc2) + (bias ? bias[r + 2] : 0.0f);
+            y[r + 3] = _mm512_reduce_add_ps(acc3) + (bias ? bias[r + 3] : 0.0f);
+        } else {
+            // The four outputs are activated in registers and leave in one store
+            __m128 sums = _mm_setr_ps(_mm512_reduce_add_ps(acc0), _mm512_reduce_add_ps(acc1),
+                                      _mm512_reduce_add_ps(acc2), _mm512_reduce_add_ps(acc3));
+            if (bias) {
+                sums = _mm_add_ps(sums, _mm_loadu_ps(bias + r));
+            }
+            _mm_storeu_ps(y + r, _mm512_castps512_ps128(activate512<Act>(_mm512_broadcast_f32x4(sums))));
+        }
+    }
+    for (; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        __m512 acc = _mm512_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 16) {
+            acc = _mm512_fmadd_ps(_mm512_load_ps(w + c), _mm512_loadu_ps(x + c), acc);
+        }
+        if (tail) {
+            acc = _mm512_fmadd_ps(_mm512_load_ps(w + bodyCols),
+                                  _mm512_maskz_loadu_ps(mask, x + bodyCols), acc);
+        }
+        y[r] = activateScalar<Act>(_mm512_reduce_add_ps(acc) + (bias ? bias[r] : 0.0f));
+    }
+}
+
+XYZ_TARGET_AVX512 void gemvAvx512(const float* weights, size_t ld, const float* bias,
+                                  const float* x, float* y, size_t rows, size_t cols) {
+    gemvActAvx512<Activation::NONE>(weights, ld, bias, x, y, rows, cols);
+}
+
+XYZ_TARGET_AVX512 void gemmAvx512(const float* weights, size_t ld, const float* bias,
+                                  const float* x, size_t ldx, float* y, size_t ldy,
+                                  size_t batch, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(15);
+    const size_t tail = cols - bodyCols;
+    const __mmask16 mask = tailMask512(tail);
+
+    size_t i = 0;
+    for (; i + 4 <= batch; i += 4) {
+        const float* x0 = x + i * ldx;
+        const float* x1 = x0 + ldx;
+        const float* x2 = x1 + ldx;
+        const float* x3 = x2 + ldx;
+        float* y0 = y + i * ldy;
+        float* y1 = y0 + ldy;
+        float* y2 = y1 + ldy;
+        float* y3 = y2 + ldy;
+
+        size_t r = 0;
+        for (; r + 2 <= rows; r += 2) {
+            const float* wa = weights + r * ld;
+            const float* wb = wa + ld;
+            __m512 a0 = _mm512_setzero_ps(), b0 = _mm512_setzero_ps();
+            __m512 a1 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+            __m512 a2 = _mm512_setzero_ps(), b2 = _mm512_setzero_ps();
+            __m512 a3 = _mm512_setzero_ps(), b3 = _mm512_setzero_ps();
+            for (size_t c = 0; c < bodyCols; c += 16) {
+                __m512 wav = _mm512_load_ps(wa + c);
+                __m512 wbv = _mm512_load_ps(wb + c);
+                __m512 xv = _mm512_loadu_ps(x0 + c);
+                a0 = _mm512_fmadd_ps(wav, xv, a0);
+                b0 = _mm512_fmadd_ps(wbv, xv, b0);
+                xv = _mm512_loadu_ps(x1 + c);
+                a1 = _mm512_fmadd_ps(wav, xv, a1);
+                b1 = _mm512_fmadd_ps(wbv, xv, b1);
+                xv = _mm512_loadu_ps(x2 + c);
+                a2 = _mm512_fmadd_ps(wav, xv, a2);
+                b2 = _mm512_fmadd_ps(wbv, xv, b2);
+                xv = _mm512_loadu_ps(x3 + c);
+                a3 = _mm512_fmadd_ps(wav, xv, a3);
+                b3 = _mm512_fmadd_ps(wbv, xv, b3);
+            }
+            if (tail) {
+                __m512 wav = _mm512_load_ps(wa + bodyCols);
+                __m512 wbv = _mm512_load_ps(wb + bodyCols);
+                __m512 xv = _mm512_maskz_loadu_ps(mask, x0 + bodyCols);
+                a0 = _mm512_fmadd_ps(wav, xv, a0);
+                b0 = _mm512_fmadd_ps(wbv, xv, b0);
+                xv = _mm512_maskz_loadu_ps(mask, x1 + bodyCols);
+                a1 = _mm512_fmadd_ps(wav, xv, a1);
+                b1 = _mm512_fmadd_ps(wbv, xv, b1);
+                xv = _mm512_maskz_loadu_ps(mask, x2 + bodyCols);
+                a2 = _mm512_fmadd_ps(wav, xv, a2);
+                b2 = _mm512_fmadd_ps(wbv, xv, b2);
+                xv = _mm512_maskz_loadu_ps(mask, x3 + bodyCols);
+                a3 = _mm512_fmadd_ps(wav, xv, a3);
+                b3 = _mm512_fmadd_ps(wbv, xv, b3);
+            }
+            const float ba = bias ? bias[r] : 0.0f;
+            const float bb = bias ? bias[r + 1] : 0.0f;
+            y0[r] = _mm512_reduce_add_ps(a0) + ba; y0[r + 1] = _mm512_reduce_add_ps(b0) + bb;
+            y1[r] = _mm512_reduce_add_ps(a1) + ba; y1[r + 1] = _mm512_reduce_add_ps(b1) + bb;
+            y2[r] = _mm512_reduce_add_ps(a2) + ba; y2[r + 1] = _mm512_reduce_add_ps(b2) + bb;
+            y3[r] = _mm512_reduce_add_ps(a3) + ba; y3[r + 1] = _mm512_reduce_add_ps(b3) + bb;
+        }
+        if (r < rows) {
+            const size_t remaining = rows - r;
+            gemvAvx512(weights + r * ld, ld, bias ? bias + r : nullptr, x0, y0 + r, remaining, cols);
+            gemvAvx512(weights + r * ld, ld, bias ? bias + r : nullptr, x1, y1 + r, remaining, cols);
+            gemvAvx512(weights + r * ld, ld, bias ? bias + r : nullptr, x2, y2 + r, remaining, cols);
+            gemvAvx512(weights + r * ld, ld, bias ? bias + r : nullptr, x3, y3 + r, remaining, cols);
+        }
+    }
+    for (; i < batch; ++i) {
+        gemvAvx512(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+XYZ_TARGET_AVX512 void reluAvx512(float* data, size_t n) {
+    const __m512 zero = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(data + i, _mm512_max_ps(_mm512_loadu_ps(data + i), zero));
+    }
+    if (i < n) {
+        const __mmask16 mask = tailMask512(n - i);
+        _mm512_mask_storeu_ps(data + i, mask, _mm512_max_ps(_mm512_maskz_loadu_ps(mask, data + i), zero));
+    }
+}
+
+XYZ_TARGET_AVX512 void expAvx512(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(data + i, exp512(_mm512_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __mmask16 mask = tailMask512(n - i);
+        _mm512_mask_storeu_ps(data + i, mask, exp512(_mm512_maskz_loadu_ps(mask, data + i)));
+    }
+}
+
+XYZ_TARGET_AVX512 void tanhAvx512(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(data + i, tanh512(_mm512_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __mmask16 mask = tailMask512(n - i);
+        _mm512_mask_storeu_ps(data + i, mask, tanh512(_mm512_maskz_loadu_ps(mask, data + i)));
+    }
+}
+
+XYZ_TARGET_AVX512 void sigmoidAvx512(float* data, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(data + i, sigmoid512(_mm512_loadu_ps(data + i)));
+    }
+    if (i < n) {
+        const __mmask16 mask = tailMask512(n - i);
+        _mm512_mask_storeu_ps(data + i, mask, sigmoid512(_mm512_maskz_loadu_ps(mask, data + i)));
+    }
+}
+
+// Sixteen 16-bit weights widened to float; both conversions are AVX-512F
+template<HalfType Type>
+XYZ_TARGET_AVX512 inline __m512 widen512(const uint16_t* w) {
+    const __m256i half = _mm256_load_si256(reinterpret_cast<const __m256i*>(w));
+    if (Type == HalfType::FP16) {
+        return _mm512_cvtph_ps(half);
+    }
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(half), 16));
+}
+
+template<HalfType Type>
+XYZ_TARGET_AVX512 void gemvHalfAvx512(const uint16_t* weights, size_t ld, const float* bias,
+                                      const float* x, float* y, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(15);
+    const size_t tail = cols - bodyCols;
+    const __mmask16 mask = tailMask512(tail);
+
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const uint16_t* w0 = weights + r * ld;
+        const uint16_t* w1 = w0 + ld;
+        const uint16_t* w2 = w1 + ld;
+        const uint16_t* w3 = w2 + ld;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 16) {
+            __m512 xv = _mm512_loadu_ps(x + c);
+            acc0 = _mm512_fmadd_ps(widen512<Type>(w0 + c), xv, acc0);
+            acc1 = _mm512_fmadd_ps(widen512<Type>(w1 + c), xv, acc1);
+            acc2 = _mm512_fmadd_ps(widen512<Type>(w2 + c), xv, acc2);
+            acc3 = _mm512_fmadd_ps(widen512<Type>(w3 + c), xv, acc3);
+        }
+        if (tail) {
+            __m512 xv = _mm512_maskz_loadu_ps(mask, x + bodyCols);
+            acc0 = _mm512_fmadd_ps(widen512<Type>(w0 + bodyCols), xv, acc0);
+            acc1 = _mm512_fmadd_ps(widen512<Type>(w1 + bodyCols), xv, acc1);
+            acc2 = _mm512_fmadd_ps(widen512<Type>(w2 + bodyCols), xv, acc2);
+            acc3 = _mm512_fmadd_ps(widen512<Type>(w3 + bodyCols), xv, acc3);
+        }
+        y[r] = _mm512_reduce_add_ps(acc0) + (bias ? bias[r] : 0.0f);
+        y[r + 1] = _mm512_reduce_add_ps(acc1) + (bias ? bias[r + 1] : 0.0f);
+        y[r + 2] = _mm512_reduce_add_ps(acc2) + (bias ? bias[r + 2] : 0.0f);
+        y[r + 3] = _mm512_reduce_add_ps(acc3) + (bias ? bias[r + 3] : 0.0f);
+    }
+    for (; r < rows; ++r) {
+        const uint16_t* w = weights + r * ld;
+        __m512 acc = _mm512_setzero_ps();
+        for (size_t c = 0; c < bodyCols; c += 16) {
+            acc = _mm512_fmadd_ps(widen512<Type>(w + c), _mm512_loadu_ps(x + c), acc);
+        }
+        if (tail) {
+            acc = _mm512_fmadd_ps(widen512<Type>(w + bodyCols), _mm512_maskz_loadu_ps(mask, x + bodyCols), acc);
+        }
+        y[r] = _mm512_reduce_add_ps(acc) + (bias ? bias[r] : 0.0f);
+    }
+}
+
+template<HalfType Type>
+XYZ_TARGET_AVX512 void gemmHalfAvx512(const uint16_t* weights, size_t ld, const float* bias,
+                                      const float* x, size_t ldx, float* y, size_t ldy,
+                                      size_t batch, size_t rows, size_t cols) {
+    const size_t bodyCols = cols & ~static_cast<size_t>(15);
+    const __mmask16 mask = tailMask512(cols - bodyCols);
+
+    size_t i = 0;
+    for (; i + 4 <= batch; i += 4) {
+        const float* x0 = x + i * ldx;
+        const float* x1 = x0 + ldx;
+        const float* x2 = x1 + ldx;
+        const float* x3 = x2 + ldx;
+        float* y0 = y + i * ldy;
+        float* y1 = y0 + ldy;
+        float* y2 = y1 + ldy;
+        float* y3 = y2 + ldy;
+
+        size_t r = 0;
+        for (; r + 2 <= rows; r += 2) {
+            const uint16_t* wa = weights + r * ld;
+            const uint16_t* wb = wa + ld;
+            __m512 a0 = _mm512_setzero_ps(), b0 = _mm512_setzero_ps();
+            __m512 a1 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+            __m512 a2 = _mm512_setzero_ps(), b2 = _mm512_setzero_ps();
+            __m512 a3 = _mm512_setzero_ps(), b3 = _mm512_setzero_ps();
+            for (size_t c = 0; c < cols; c += 16) {
+                __m512 wav = widen512<Type>(wa + c);
+                __m512 wbv = widen512<Type>(wb + c);
+                // Only the last block of x is partial
+                const __mmask16 m = c < bodyCols ? static_cast<__mmask16>(0xFFFF) : mask;
+                __m512 xv = _mm512_maskz_loadu_ps(m, x0 + c);
+                a0 = _mm512_fmadd_ps(wav, xv, a0);
+                b0 = _mm512_fmadd_ps(wbv, xv, b0);
+                xv = _mm512_maskz_loadu_ps(m, x1 + c);
+                a1 = _mm512_fmadd_ps(wav, xv, a1);
+                b1 = _mm512_fmadd_ps(wbv, xv, b1);
+                xv = _mm512_maskz_loadu_ps(m, x2 + c);
+                a2 = _mm512_fmadd_ps(wav, xv, a2);
+                b2 = _mm512_fmadd_ps(wbv, xv, b2);
+                xv = _mm512_maskz_loadu_ps(m, x3 + c);
+                a3 = _mm512_fmadd_ps(wav, xv, a3);
+                b3 = _mm512_fmadd_ps(wbv, xv, b3);
+            }
+            const float ba = bias ? bias[r] : 0.0f;
+            const float bb = bias ? bias[r + 1] : 0.0f;
+            y0[r] = _mm512_reduce_add_ps(a0) + ba; y0[r + 1] = _mm512_reduce_add_ps(b0) + bb;
+            y1[r] = _mm512_reduce_add_ps(a1) + ba; y1[r + 1] = _mm512_reduce_add_ps(b1) + bb;
+            y2[r] = _mm512_reduce_add_ps(a2) + ba; y2[r + 1] = _mm512_reduce_add_ps(b2) + bb;
+            y3[r] = _mm512_reduce_add_ps(a3) + ba; y3[r + 1] = _mm512_reduce_add_ps(b3) + bb;
+        }
+        if (r < rows) {
+            const size_t remaining = rows - r;
+            gemvHalfAvx512<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x0, y0 + r, remaining, cols);
+            gemvHalfAvx512<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x1, y1 + r, remaining, cols);
+            gemvHalfAvx512<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x2, y2 + r, remaining, cols);
+            gemvHalfAvx512<Type>(weights + r * ld, ld, bias ? bias + r : nullptr, x3, y3 + r, remaining, cols);
+        }
+    }
+    for (; i < batch; ++i) {
+        gemvHalfAvx512<Type>(weights, ld, bias, x + i * ldx, y + i * ldy, rows, cols);
+    }
+}
+
+XYZ_TARGET_AVX512 void sparseGatherAvx512(const float* weights, size_t ld, const float* bias,
+                                          const uint32_t* indices, const float* values, size_t nnz,
+                                          float* y, size_t rows) {
+    const size_t body = nnz & ~static_cast<size_t>(15);
+    const __mmask16 mask = tailMask512(nnz - body);
+    const __m512 zero = _mm512_setzero_ps();
+
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* w0 = weights + r * ld;
+        const float* w1 = w0 + ld;
+        const float* w2 = w1 + ld;
+        const float* w3 = w2 + ld;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        for (size_t k = 0; k < body; k += 16) {
+            const __m512i iv = _mm512_loadu_si512(indices + k);
+            const __m512 xv = _mm512_loadu_ps(values + k);
+            acc0 = _mm512_fmadd_ps(_mm512_i32gather_ps(iv, w0, 4), xv, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_i32gather_ps(iv, w1, 4), xv, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_i32gather_ps(iv, w2, 4), xv, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_i32gather_ps(iv, w3, 4), xv, acc3);
+        }
+        if (body < nnz) {
+            const __m512i iv = _mm512_maskz_loadu_epi32(mask, indices + body);
+            const __m512 xv = _mm512_maskz_loadu_ps(mask, values + body);
+            acc0 = _mm512_fmadd_ps(_mm512_mask_i32gather_ps(zero, mask, iv, w0, 4), xv, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_mask_i32gather_ps(zero, mask, iv, w1, 4), xv, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_mask_i32gather_ps(zero, mask, iv, w2, 4), xv, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_mask_i32gather_ps(zero, mask, iv, w3, 4), xv, acc3);
+        }
+        y[r] = _mm512_reduce_add_ps(acc0) + (bias ? bias[r] : 0.0f);
+        y[r + 1] = _mm512_reduce_add_ps(acc1) + (bias ? bias[r + 1] : 0.0f);
+        y[r + 2] = _mm512_reduce_add_ps(acc2) + (bias ? bias[r + 2] : 0.0f);
+        y[r + 3] = _mm512_reduce_add_ps(acc3) + (bias ? bias[r + 3] : 0.0f);
+    }
+    for (; r < rows; ++r) {
+        const float* w = weights + r * ld;
+        __m512 acc = _mm512_setzero_ps();
+        for (size_t k = 0; k < body; k += 16) {
+            acc = _mm512_fmadd_ps(_mm512_i32gather_ps(_mm512_loadu_si512(indices + k), w, 4),
+                                  _mm512_loadu_ps(values + k), acc);
+        }
+        if (body < nnz) {
+            const __m512i iv = _mm512_maskz_loadu_epi32(mask, indices + body);
+            acc = _mm512_fmadd_ps(_mm512_mask_i32gather_ps(zero, mask, iv, w, 4),
+                                  _mm512_maskz_loadu_ps(mask, values + body), acc);
+        }
+        y[r] = _mm512_reduce_add_ps(acc) + (bias ? bias[r] : 0.0f);
+    }
+}
+
+XYZ_TARGET_AVX512 void sparseAxpyAvx512(const float* weights, size_t ld, const float* bias,
+                                        const uint32_t* indices, const float* values, size_t nnz,
+                                        float* y, size_t rows) {
+    for (size_t base = 0; base < rows; base += 64) {
+        const size_t width = std::min<size_t>(64, rows - base);
+        __mmask16 masks[4];
+        __m512 acc[4];
+        for (size_t v = 0; v < 4; ++v) {
+            const size_t start = v * 16;
+            masks[v] = tailMask512(width > start ? std::min<size_t>(16, width - start) : 0);
+            acc[v] = bias ? _mm512_maskz_loadu_ps(masks[v], bias + base + start) : _mm512_setzero_ps();
+        }
+        for (size_t k = 0; k < nnz; ++k) {
+            const float* w = weights + static_cast<size_t>(indices[k]) * ld + base;
+            const __m512 value = _mm512_set1_ps(values[k]);
+            acc[0] = _mm512_fmadd_ps(_mm512_load_ps(w), value, acc[0]);
+            if (width > 16) {
+                acc[1] = _mm512_fmadd_ps(_mm512_load_ps(w + 16), value, acc[1]);
+            }
+            if (width > 32) {
+                acc[2] = _mm512_fmadd_ps(_mm512_load_ps(w + 32), value, acc[2]);
+            }
+            if (width > 48) {
+                acc[3] = _mm512_fmadd_ps(_mm512_load_ps(w + 48), value, acc[3]);
+            }
+        }
+        for (size_t v = 0; v < 4; ++v) {
+            _mm512_mask_storeu_ps(y + base + v * 16, masks[v], acc[v]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512 VNNI
+// ---------------------------------------------------------------------------
+
+// vpdpbusd is unsigned x signed like maddubs; the sign of x moves onto the
+// weights with a masked subtract since AVX-512 has no byte sign instruction
+XYZ_TARGET_AVX512_VNNI inline __m512i dotInt8Vnni(__m512i acc, __m512i absX, __mmask64 negative,
+                                                  const int8_t* w) {
+    const __m512i weights = _mm512_load_si512(w);
+    const __m512i signedWeights = _mm512_mask_sub_epi8(weights, negative, _mm512_setzero_si512(), weights);
+    return _mm512_dpbusd_epi32(acc, absX, signedWeights);
+}
+
+XYZ_TARGET_AVX512_VNNI void gemvInt8Vnni(const int8_t* weights, size_t ld, const float* scales,
+                                         const float* bias, const int8_t* x, float xScale, float* y,
+                                         size_t rows, size_t cols) {
+    const size_t span = (cols + 63) & ~static_cast<size_t>(63);
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const int8_t* w = weights + r * ld;
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        __m512i acc2 = _mm512_setzero_si512();
+        __m512i acc3 = _mm512_setzero_si512();
+        for (size_t c = 0; c < span; c += 64) {
+            const __m512i xv = _mm512_loadu_si512(x + c);
+            const __m512i ax = _mm512_abs_epi8(xv);
+            const __mmask64 negative = _mm512_movepi8_mask(xv);
+            acc0 = dotInt8Vnni(acc0, ax, negative, w + c);
+            acc1 = dotInt8Vnni(acc1, ax, negative, w + ld + c);
+            acc2 = dotInt8Vnni(acc2, ax, negative, w + 2 * ld + c);
+            acc3 = dotInt8Vnni(acc3, ax, negative, w + 3 * ld + c);
+        }
+        const __m512i sums[4] = {acc0, acc1, acc2, acc3};
+        for (size_t k = 0; k < 4; ++k) {
+            y[r + k] = static_cast<float>(_mm512_reduce_add_epi32(sums[k])) * scales[r + k] * xScale +
+                       (bias ? bias[r + k] : 0.0f);
+        }
+    }
+    for (; r < rows; ++r) {
+        const int8_t* w = weights + r * ld;
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t c = 0; c < span; c += 64) {
+            const __m512i xv = _mm512_loadu_si512(x + c);
+            acc = dotInt8Vnni(acc, _mm512_abs_epi8(xv), _mm512_movepi8_mask(xv), w + c);
+        }
+        y[r] = static_cast<float>(_mm512_reduce_add_epi32(acc)) * scales[r] * xScale +
+               (bias ? bias[r] : 0.0f);
+    }
+}
+
+#endif // XYZ_X86_KERNELS
+
+const KernelTable SCALAR_KERNELS = {
+    SimdLevel::SCALAR, gemvScalar, gemmScalar, reluScalar, tanhScalar, sigmoidScalar, expScalar,
+    gemvInt8Scalar, softmaxWith<expScalar>,
+    {gemvHalfScalar<HalfType::FP16>, gemvHalfScalar<HalfType::BF16>},
+    {gemmHalfScalar<HalfType::FP16>, gemmHalfScalar<HalfType::BF16>},
+    sparseGatherScalar, sparseAxpyScalar
+};
+
+#ifdef XYZ_X86_KERNELS
+// The half-precision kernels are built with F16C, which AVX2 does not
+// imply; without it they stay scalar
+KernelTable makeAvx2Kernels() {
+    KernelTable table = {
+        SimdLevel::AVX2, gemvAvx2, gemmAvx2, reluAvx2, tanhAvx2, sigmoidAvx2, expAvx2,
+        gemvInt8Avx2, softmaxWith<expAvx2>,
+        {gemvHalfScalar<HalfType::FP16>, gemvHalfScalar<HalfType::BF16>},
+        {gemmHalfScalar<HalfType::FP16>, gemmHalfScalar<HalfType::BF16>},
+        sparseGatherAvx2, sparseAxpyAvx2
+    };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("f16c")) {
+        table.gemvHalf[0] = gemvHalfAvx2<HalfType::FP16>;
+        table.gemvHalf[1] = gemvHalfAvx2<HalfType::BF16>;
+        table.gemmHalf[0] = gemmHalfAvx2<HalfType::FP16>;
+        table.gemmHalf[1] = gemmHalfAvx2<HalfType::BF16>;
+    }
+    return table;
+}
+
+// The int8 kernel needs AVX-512 VNNI on top of AVX-512F; without it the
+// AVX2 integer kernel is used
+KernelTable makeAvx512Kernels() {
+    KernelTable table = {
+        SimdLevel::AVX512, gemvAvx512, gemmAvx512, reluAvx512, tanhAvx512, sigmoidAvx512, expAvx512,
+        gemvInt8Avx2, softmaxWith<expAvx512>,
+        {gemvHalfAvx512<HalfType::FP16>, gemvHalfAvx512<HalfType::BF16>},
+        {gemmHalfAvx512<HalfType::FP16>, gemmHalfAvx512<HalfType::BF16>},
+        sparseGatherAvx512, sparseAxpyAvx512
+    };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+        table.gemvInt8 = gemvInt8Vnni;
+    }
+    return table;
+}
+#endif
+
+// Batch rows computed before the fused activation runs over them; matches
+// the row tile of the GEMM kernels so their blocking is unchanged
+constexpr size_t FUSED_TILE_ROWS = 4;
+
+template<GemmFn Gemm, ElementwiseFn Act>
+void gemmFused(const float* weights, size_t ld, const float* bias,
+               const float* x, size_t ldx, float* y, size_t ldy,
+               size_t batch, size_t rows, size_t cols) {
+    for (size_t i = 0; i < batch; i += FUSED_TILE_ROWS) {
+        const size_t count = std::min(FUSED_TILE_ROWS, batch - i);
+        Gemm(weights, ld, bias, x + i * ldx, ldx, y + i * ldy, ldy, count, rows, cols);
+        for (size_t j = 0; j < count; ++j) {
+            Act(y + (i + j) * ldy, rows);
+        }
+    }
+}
+
+// Single rows use the GEMV kernels' own activation epilogue
+template<GemvFn GemvRelu, GemvFn GemvTanh, GemmFn Gemm, ElementwiseFn Relu, ElementwiseFn Tanh>
+LayerKernels fusedFor(Activation activation) {
+    switch (activation) {
+        case Activation::RELU:
+            return {GemvRelu, gemmFused<Gemm, Relu>, Activation::RELU, false};
+        case Activation::TANH:
+            return {GemvTanh, gemmFused<Gemm, Tanh>, Activation::TANH, false};
+        default:
+            return {};
+    }
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+#ifdef XYZ_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::AVX2;
+    }
+#endif
+    return SimdLevel::SCALAR;
+}
+
+std::string simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2:   return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default:                return "scalar";
+    }
+}
+
+const KernelTable& getKernels(SimdLevel level) {
+    static const SimdLevel hostLevel = detectSimdLevel();
+    if (static_cast<int>(level) > static_cast<int>(hostLevel)) {
+        level = hostLevel;
+    }
+#ifdef XYZ_X86_KERNELS
+    switch (level) {
+        case SimdLevel::AVX512: {
+            static const KernelTable avx512Kernels = makeAvx512Kernels();
+            return avx512Kernels;
+        }
+        case SimdLevel::AVX2: {
+            static const KernelTable avx2Kernels = makeAvx2Kernels();
+            return avx2Kernels;
+        }
+        default:
+            break;
+    }
+#endif
+    return SCALAR_KERNELS;
+}
+
+const KernelTable& activeKernels() {
+    static const KernelTable& table = getKernels(detectSimdLevel());
+    return table;
+}
+
+float quantizeSymmetric(const float* x, size_t n, int8_t* out) {
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        maxAbs = std::max(maxAbs, std::fabs(x[i]));
+    }
+    if (maxAbs == 0.0f) {
+        std::fill(out, out + n, static_cast<int8_t>(0));
+        return 0.0f;
+    }
+    const float inv = 127.0f / maxAbs;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<int8_t>(std::lrint(x[i] * inv));
+    }
+    return maxAbs / 127.0f;
+}
+
+uint16_t floatToHalf(float value, HalfType type) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (type == HalfType::BF16) {
+        if (magnitude > 0x7F800000) {
+            // Keep NaNs NaN when their payload sits in the dropped bits
+            return static_cast<uint16_t>((bits >> 16) | 0x40);
+        }
+        return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+    }
+
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    if (magnitude > 0x7F800000) {
+        return static_cast<uint16_t>(sign | 0x7E00);
+    }
+    // From halfway past 65504, the largest fp16 value, up
+    if (magnitude >= 0x477FF000) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    // Below 2^-14 values are subnormal: a multiple of 2^-24
+    if (magnitude < 0x38800000) {
+        float scaled;
+        std::memcpy(&scaled, &magnitude, sizeof(scaled));
+        return static_cast<uint16_t>(sign | std::lrint(scaled * 16777216.0f));
+    }
+    // Rebias the exponent and round the dropped 13 mantissa bits to even;
+    // a carry out of the mantissa correctly bumps the exponent
+    const uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+    return static_cast<uint16_t>(sign | ((rounded - ((127 - 15) << 23)) >> 13));
+}
+
+float halfToFloat(uint16_t value, HalfType type) {
+    return type == HalfType::FP16 ? fp16ToFloat(value) : bf16ToFloat(value);
+}
+
+Activation parseActivation(const std::string& name) {
+    if (name.empty() || name == "none" || name == "linear") return Activation::NONE;
+    if (name == "relu") return Activation::RELU;
+    if (name == "tanh") return Activation::TANH;
+    if (name == "sigmoid") return Activation::SIGMOID;
+    if (name == "softmax") return Activation::SOFTMAX;
+    throw std::invalid_argument("Unknown activation: " + name);
+}
+
+std::string activationName(Activation activation) {
+    switch (activation) {
+        case Activation::RELU:    return "relu";
+        case Activation::TANH:    return "tanh";
+        case Activation::SIGMOID: return "sigmoid";
+        case Activation::SOFTMAX: return "softmax";
+        default:                  return "none";
+    }
+}
+
+LayerKernels fusedLayerKernels(const KernelTable& table, Activation activation) {
+#ifdef XYZ_X86_KERNELS
+    switch (table.level) {
+        case SimdLevel::AVX512:
+            return fusedFor<gemvActAvx512<Activation::RELU>, gemvActAvx512<Activation::TANH>, gemmAvx512,
+                            reluAvx512, tanhAvx512>(activation);
+        case SimdLevel::AVX2:
+            return fusedFor<gemvActAvx2<Activation::RELU>, gemvActAvx2<Activation::TANH>, gemmAvx2,
+                            reluAvx2, tanhAvx2>(activation);
+        default:
+            break;
+    }
+#endif
+    return fusedFor<gemvActScalar<Activation::RELU>, gemvActScalar<Activation::TANH>, gemmScalar,
+                    reluScalar, tanhScalar>(activation);
+}
+
+ElementwiseFn activationKernel(const KernelTable& table, Activation activation) {
+    switch (activation) {
+        case Activation::RELU:    return table.relu;
+        case Activation::TANH:    return table.tanh;
+        case Activation::SIGMOID: return table.sigmoid;
+        case Activation::SOFTMAX: return table.softmax;
+        default:                  return nullptr;
+    }
+}
+
+void applyActivation(const KernelTable& table, Activation activation, float* data, size_t n) {
+    if (ElementwiseFn kernel = activationKernel(table, activation)) {
+        kernel(data, n);
+    }
+}
+
+void applyActivation(const KernelTable& table, Activation activation, float* data,
+                     size_t rows, size_t n, size_t ld) {
+    if (activation == Activation::NONE) {
+        return;
+    }
+    // Contiguous rows run as a single sweep; softmax normalizes each row
+    if (activation != Activation::SOFTMAX && ld == n) {
+        applyActivation(table, activation, data, rows * n);
+        return;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        applyActivation(table, activation, data + i * ld, n);
+    }
+}
+
+} // namespace kernels
+} // namespace xyz
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xyz {
+namespace kernels {
+
+// Instruction set used by the numeric kernels. The best level supported by
+// the host CPU is detected once at startup; SCALAR is always available.
+enum class SimdLevel {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+// 16-bit weight formats. fp16 keeps 10 mantissa bits within +-65504; bf16
+// keeps 7 bits over the whole float range.
+enum class HalfType {
+    FP16,
+    BF16
+};
+
+enum class Activation {
+    NONE,
+    RELU,
+    TANH,
+    SIGMOID,
+    SOFTMAX
+};
+
+// y[r] = dot(weights[r, 0:cols], x) + bias[r] for r in [0, rows).
+// `weights` is row-major with leading dimension `ld` (see paddedStride) and
+// must be 64-byte aligned; `bias` may be null.
+using GemvFn = void (*)(const float* weights, size_t ld, const float* bias,
+                        const float* x, float* y, size_t rows, size_t cols);
+
+// Y[i, r] = dot(weights[r, 0:cols], X[i, 0:cols]) + bias[r] for a batch of
+// `batch` input rows. X and Y are row-major with leading dimensions `ldx`
+// and `ldy`; rows of X need no particular alignment.
+using GemmFn = void (*)(const float* weights, size_t ld, const float* bias,
+                        const float* x, size_t ldx, float* y, size_t ldy,
+                        size_t batch, size_t rows, size_t cols);
+
+// In-place element-wise transform of `n` contiguous values
+using ElementwiseFn = void (*)(float* data, size_t n);
+
+// y[r] = scales[r] * xScale * dot(weights[r, 0:cols], x) + bias[r] on int8
+// operands with int32 accumulation. Weight rows are zero padded to
+// ld = paddedStrideInt8(cols) bytes and 64-byte aligned; `x` must be readable
+// up to ld bytes, but its padding may hold anything. `bias` may be null.
+using GemvInt8Fn = void (*)(const int8_t* weights, size_t ld, const float* scales, const float* bias,
+                            const int8_t* x, float xScale, float* y, size_t rows, size_t cols);
+
+// GEMV/GEMM on 16-bit weights widened to float as they are loaded, with
+// float inputs and accumulation. Weight rows are laid out as for GemvFn /
+// GemmFn (padded stride, zero padding, 64-byte aligned base).
+using GemvHalfFn = void (*)(const uint16_t* weights, size_t ld, const float* bias,
+                            const float* x, float* y, size_t rows, size_t cols);
+using GemmHalfFn = void (*)(const uint16_t* weights, size_t ld, const float* bias,
+                            const float* x, size_t ldx, float* y, size_t ldy,
+                            size_t batch, size_t rows, size_t cols);
+
+// Sparse-input kernels over `nnz` active inputs (indices[k], values[k]),
+// reading only the weights of those inputs. `bias` may be null.
+//
+// Gather form, on row-major weights as for GemvFn:
+//     y[r] = sum_k weights[r * ld + indices[k]] * values[k] + bias[r]
+// for r in [0, rows). Suits few output rows (linear SVMs).
+//
+// Axpy form, on input-major (transposed) weights whose row c holds the
+// weights of input c, `ld` = paddedStride(rows) apart:
+//     y[0:rows] = sum_k values[k] * weights[indices[k] * ld + 0:rows] + bias
+// Each active input adds one contiguous row, so wide layers read whole
+// cache lines.
+using SparseGemvFn = void (*)(const float* weights, size_t ld, const float* bias,
+                              const uint32_t* indices, const float* values, size_t nnz,
+                              float* y, size_t rows);
+
+struct KernelTable {
+    SimdLevel level;
+    GemvFn gemv;
+    GemmFn gemm;
+    ElementwiseFn relu;
+    ElementwiseFn tanh;
+    ElementwiseFn sigmoid;
+    ElementwiseFn exp;
+    GemvInt8Fn gemvInt8;
+    // Normalizes one row in place (max-subtracted exp over the row sum)
+    ElementwiseFn softmax;
+    // Indexed by HalfType
+    GemvHalfFn gemvHalf[2];
+    GemmHalfFn gemmHalf[2];
+    SparseGemvFn sparseGather;
+    SparseGemvFn sparseAxpy;
+};
+
+// GEMV/GEMM pair bound to one dense layer in place of the table kernels
+struct LayerKernels {
+    GemvFn gemv = nullptr;
+    GemmFn gemm = nullptr;
+    // Activation the kernels apply to each output tile before it leaves
+    // cache; NONE leaves the layer activation to the caller
+    Activation activation = Activation::NONE;
+    // Instantiated for one exact layer shape (see fixed_kernels.h)
+    bool fixedShape = false;
+
+    explicit operator bool() const { return gemv != nullptr; }
+};
+
+// Row stride (in floats) for a matrix with `cols` columns, rounded up so that
+// every row starts on a 64-byte boundary.
+constexpr size_t paddedStride(size_t cols) {
+    return (cols + 15) & ~static_cast<size_t>(15);
+}
+
+// Row stride (in bytes) for an int8 matrix, padded to whole cache lines
+constexpr size_t paddedStrideInt8(size_t cols) {
+    return (cols + 63) & ~static_cast<size_t>(63);
+}
+
+// Symmetric int8 quantization of `n` values: out[i] = round(x[i] / scale)
+// with scale = max|x| / 127. Returns the scale (0 for an all-zero input).
+float quantizeSymmetric(const float* x, size_t n, int8_t* out);
+
+// Round-to-nearest-even conversion to a 16-bit format; values beyond the
+// fp16 range become infinities
+uint16_t floatToHalf(float value, HalfType type);
+float halfToFloat(uint16_t value, HalfType type);
+
+SimdLevel detectSimdLevel();
+std::string simdLevelName(SimdLevel level);
+
+// Kernels for a specific level; unsupported levels fall back to the best
+// level the host can run.
+const KernelTable& getKernels(SimdLevel level);
+
+// Kernels for the detected level, resolved once
+const KernelTable& activeKernels();
+
+Activation parseActivation(const std::string& name);
+std::string activationName(Activation activation);
+
+// Generic-shape GEMV/GEMM for `table`'s level with `activation` fused into
+// the epilogue: the GEMV activates each group of outputs in registers before
+// storing it, the GEMM activates each tile of batch rows right after it is
+// written, while still in L1. Empty unless `activation` is RELU or TANH.
+LayerKernels fusedLayerKernels(const KernelTable& table, Activation activation);
+
+// Kernel computing `activation` in place over one row, or null for NONE
+ElementwiseFn activationKernel(const KernelTable& table, Activation activation);
+
+// Applies `activation` in place to one row of `n` values
+void applyActivation(const KernelTable& table, Activation activation, float* data, size_t n);
+
+// Applies `activation` in place to `rows` rows of `n` values spaced `ld` apart
+void applyActivation(const KernelTable& table, Activation activation, float* data,
+                     size_t rows, size_t n, size_t ld);
+
+} // namespace kernels
+} // namespace xyz
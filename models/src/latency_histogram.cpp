@@ -0,0 +1,106 @@
+#include "latency_histogram.h"
+#include <algorithm>
+
+namespace xyz {
+
+namespace cycle_clock {
+
+namespace {
+
+using Steady = std::chrono::steady_clock;
+
+// Shortest interval the tick rate is measured over
+constexpr auto MIN_CALIBRATION = std::chrono::milliseconds(1);
+
+struct Reference {
+    uint64_t ticks;
+    Steady::time_point time;
+};
+
+// Taken at static initialization, so later calibrations span the whole run
+const Reference origin = {now(), Steady::now()};
+
+} // namespace
+
+double nanosPerTick() {
+#ifdef XYZ_X86_KERNELS
+    Steady::time_point time = Steady::now();
+    while (time - origin.time < MIN_CALIBRATION) {
+        time = Steady::now();
+    }
+    const uint64_t ticks = now() - origin.ticks;
+    const double nanos = std::chrono::duration<double, std::nano>(time - origin.time).count();
+    return ticks ? nanos / static_cast<double>(ticks) : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+} // namespace cycle_clock
+
+LatencyHistogram::LatencyHistogram()
+    : total(0)
+    , largest(0)
+{
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::bucketLow(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    const size_t shift = index / SUB_BUCKETS - 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::bucketWidth(size_t index) {
+    return index < SUB_BUCKETS ? 1 : uint64_t(1) << (index / SUB_BUCKETS - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    uint64_t counts[BUCKETS];
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += counts[i];
+    }
+    if (result.count == 0) {
+        return result;
+    }
+
+    const double msPerTick = cycle_clock::nanosPerTick() * 1e-6;
+    result.mean = static_cast<double>(total.load(std::memory_order_relaxed)) * msPerTick /
+                  static_cast<double>(result.count);
+    result.max = static_cast<double>(largest.load(std::memory_order_relaxed)) * msPerTick;
+
+    // Value below which `quantile` of the recordings fall, nearest rank
+    auto percentile = [&](double quantile) {
+        const auto rank = static_cast<uint64_t>(quantile * static_cast<double>(result.count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const double mid = static_cast<double>(bucketLow(i)) + static_cast<double>(bucketWidth(i) - 1) / 2.0;
+                return std::min(mid * msPerTick, result.max);
+            }
+        }
+        return result.max;
+    };
+    result.p50 = percentile(0.50);
+    result.p90 = percentile(0.90);
+    result.p99 = percentile(0.99);
+    result.p999 = percentile(0.999);
+    return result;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    largest.store(0, std::memory_order_relaxed);
+}
+
+} // namespace xyz
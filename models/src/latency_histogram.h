@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "simd_target.h"
+
+namespace xyz {
+
+namespace cycle_clock {
+
+// Raw timestamp: the time stamp counter on x86, steady_clock nanoseconds
+// elsewhere. Only differences are meaningful.
+inline uint64_t now() {
+#ifdef XYZ_X86_KERNELS
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Length of one tick, calibrated against steady_clock over the time since
+// the first call
+double nanosPerTick();
+
+} // namespace cycle_clock
+
+// Lock-free log-linear histogram of latencies in cycle_clock ticks.
+//
+// Values below 2^SUB_BUCKET_BITS get a bucket each; above that every power
+// of two is split into 2^SUB_BUCKET_BITS equal buckets, so a recorded value
+// is known to within 1/32 (about 3%) at any magnitude, as in HDR histograms.
+// Recording is a handful of relaxed atomic adds and may run concurrently
+// with other recorders and with readers.
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        uint64_t count = 0;
+        // Milliseconds
+        double mean = 0.0;
+        double max = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        double p999 = 0.0;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t ticks) {
+        buckets[bucketIndex(ticks)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(ticks, std::memory_order_relaxed);
+        uint64_t seen = largest.load(std::memory_order_relaxed);
+        while (ticks > seen && !largest.compare_exchange_weak(seen, ticks, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Percentiles are bucket midpoints. Concurrent recordings may or may not
+    // be included.
+    Snapshot snapshot() const;
+    void reset();
+
+    static constexpr unsigned SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    // Values from 2^MAX_MAGNITUDE ticks up share the last bucket
+    static constexpr unsigned MAX_MAGNITUDE = 48;
+    static constexpr size_t BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucketIndex(uint64_t ticks) {
+        if (ticks < SUB_BUCKETS) {
+            return static_cast<size_t>(ticks);
+        }
+        const unsigned magnitude = 63 - static_cast<unsigned>(__builtin_clzll(ticks));
+        if (magnitude >= MAX_MAGNITUDE) {
+            return BUCKETS - 1;
+        }
+        const unsigned shift = magnitude - SUB_BUCKET_BITS;
+        // The top SUB_BUCKET_BITS + 1 bits, leading one dropped
+        const size_t mantissa = static_cast<size_t>(ticks >> shift) - SUB_BUCKETS;
+        return (shift + 1) * SUB_BUCKETS + mantissa;
+    }
+    // Smallest value in bucket `index`, and the bucket's width
+    static uint64_t bucketLow(size_t index);
+    static uint64_t bucketWidth(size_t index);
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS];
+    // Sum and maximum of all recorded ticks
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> largest;
+};
+
+} // namespace xyz
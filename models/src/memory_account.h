@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace xyz {
+
+enum class MemoryCategory {
+    // Engine parameters
+    WEIGHTS,
+    // Activation, batch and training buffers
+    SCRATCH,
+    // Inference result caches
+    CACHES,
+    COUNT
+};
+
+// Live bytes allocated on behalf of one model, by category. Counters may be
+// updated and read from any thread.
+class MemoryAccount {
+public:
+    MemoryAccount() {
+        for (auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    void charge(MemoryCategory category, size_t bytes) {
+        counters[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void credit(MemoryCategory category, size_t bytes) {
+        counters[static_cast<size_t>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    size_t bytes(MemoryCategory category) const {
+        return counters[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+    }
+    size_t total() const {
+        size_t sum = 0;
+        for (const auto& counter : counters) {
+            sum += counter.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    std::atomic<size_t> counters[static_cast<size_t>(MemoryCategory::COUNT)];
+};
+
+// Account and category that allocations made by the current thread are
+// charged to, or none
+struct MemoryTag {
+    std::shared_ptr<MemoryAccount> account;
+    MemoryCategory category = MemoryCategory::WEIGHTS;
+
+    void charge(size_t bytes) const {
+        if (account) {
+            account->charge(category, bytes);
+        }
+    }
+    void credit(size_t bytes) const {
+        if (account) {
+            account->credit(category, bytes);
+        }
+    }
+};
+
+// Charges allocations made on this thread while in scope to `account`
+// under `category`. Scopes nest; the category-only form keeps the
+// enclosing account, so engines can mark their scratch buffers without
+// knowing which model they belong to. Entering a scope touches no shared
+// state; the account is only referenced once something is allocated.
+class MemoryScope {
+public:
+    MemoryScope(const std::shared_ptr<MemoryAccount>& account, MemoryCategory category)
+        : previous(current)
+        , frame{&account, category}
+    {
+        current = &frame;
+    }
+
+    explicit MemoryScope(MemoryCategory category)
+        : previous(current)
+        , frame{previous ? previous->account : nullptr, category}
+    {
+        current = &frame;
+    }
+
+    ~MemoryScope() { current = previous; }
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+    // Tag for an allocation made now; an empty tag outside of any scope
+    static MemoryTag active() {
+        if (!current || !current->account) {
+            return MemoryTag();
+        }
+        return MemoryTag{*current->account, current->category};
+    }
+
+private:
+    struct Frame {
+        const std::shared_ptr<MemoryAccount>* account;
+        MemoryCategory category;
+    };
+
+    static inline thread_local const Frame* current = nullptr;
+
+    const Frame* previous;
+    Frame frame;
+};
+
+} // namespace xyz
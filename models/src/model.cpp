@@ -1,19 +1,85 @@
 #include "model.h"
+#include "model_format.h"
+#include "model_weights.h"
+#include "tree_trainer.h"
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <sstream>
 #include "../../utils/logging.h"
 
 namespace xyz {
 
+namespace {
+
+// Parses a comma separated list of layer widths, e.g. "16,32,4"
+std::vector<size_t> parseLayerWidths(const std::string& spec) {
+    std::vector<size_t> widths;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            widths.push_back(std::stoul(item));
+        }
+    }
+    return widths;
+}
+
+// Parses a comma separated list of floats, e.g. "0.5,1,-2"
+std::vector<float> parseFloatList(const std::string& spec) {
+    std::vector<float> values;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(std::stof(item));
+        }
+    }
+    return values;
+}
+
+// Parses a comma separated list of stream features, e.g. "value,mean"
+std::vector<StreamFeature> parseStreamFeatures(const std::string& spec) {
+    std::vector<StreamFeature> features;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            features.push_back(parseStreamFeature(item));
+        }
+    }
+    return features;
+}
+
+size_t sizeParameter(const std::string& value, size_t fallback) {
+    return value.empty() ? fallback : static_cast<size_t>(std::stoul(value));
+}
+
+float floatParameter(const std::string& value, float fallback) {
+    return value.empty() ? fallback : std::stof(value);
+}
+
+// Default shard count of the inference cache
+constexpr size_t DEFAULT_CACHE_SHARDS = 16;
+
+} // namespace
+
 AIModel::AIModel(const std::string& id, ModelType t)
     : modelId(id)
     , type(t)
     , initialized(false)
+    , weightsLoaded(false)
+    , memory(std::make_shared<MemoryAccount>())
+    , weightsFromPeer(false)
+    , batchRows(0)
+    , errorCount(0)
+    , createdTicks(cycle_clock::now())
 {
     LOG_INFO("Creating AI model: " + id);
 }
 
 bool AIModel::initialize(const ModelConfig& cfg) {
+    MemoryScope scope(memory, MemoryCategory::WEIGHTS);
     try {
         config = cfg;
         
@@ -23,26 +89,49 @@ bool AIModel::initialize(const ModelConfig& cfg) {
             return false;
         }
 
+        // Parameters set explicitly through setParameter take precedence
+        parameters.insert(config.parameters.begin(), config.parameters.end());
+
         // Initialize based on model type
         switch (type) {
             case ModelType::NEURAL_NETWORK:
                 LOG_INFO("Initializing Neural Network model: " + modelId);
-                // Neural network specific initialization
+                if (!initializeNetwork()) {
+                    return false;
+                }
+                if (size_t fixed = network.specialize()) {
+                    LOG_INFO("Neural network " + modelId + ": " + std::to_string(fixed) + " of " +
+                             std::to_string(network.getLayers().size()) + " layers on shape-specialized kernels");
+                }
                 break;
                 
             case ModelType::DECISION_TREE:
                 LOG_INFO("Initializing Decision Tree model: " + modelId);
-                // Decision tree specific initialization
+                // Without a loaded or assigned tree, fall back to a single
+                // split on the first feature
+                if (tree.empty()) {
+                    tree = DecisionTree::stump(0, 0.5f, 0.0f, 1.0f);
+                }
                 break;
                 
             case ModelType::RANDOM_FOREST:
                 LOG_INFO("Initializing Random Forest model: " + modelId);
-                // Random forest specific initialization
+                // Without a loaded or assigned forest the model passes its
+                // input through
+                if (!forest.empty()) {
+                    LOG_INFO("Random forest " + modelId + ": " + std::to_string(forest.getTreeCount()) +
+                             " trees, " + std::to_string(forest.getNodeCount()) + " nodes");
+                }
                 break;
                 
             case ModelType::SVM:
                 LOG_INFO("Initializing SVM model: " + modelId);
-                // SVM specific initialization
+                // Without a loaded or assigned SVM the model passes its input
+                // through
+                if (!svm.empty()) {
+                    LOG_INFO("SVM " + modelId + ": " + svmKernelName(svm.getParams().kernel) + " kernel, " +
+                             std::to_string(svm.supportVectorCount()) + " support vectors");
+                }
                 break;
                 
             case ModelType::CUSTOM:
@@ -55,6 +144,8 @@ bool AIModel::initialize(const ModelConfig& cfg) {
                 return false;
         }
 
+        configureCache();
+        compilePlan();
         initialized = true;
         updateMetrics();
         return true;
@@ -67,49 +158,384 @@ bool AIModel::initialize(const ModelConfig& cfg) {
 
 std::vector<float> AIModel::inference(const std::vector<float>& input) {
     if (!initialized) {
-        LOG_ERROR("Model not initialized: " + modelId);
+        rejectInference("Model not initialized: " + modelId);
         return {};
     }
+    ensurePlan();
 
-    if (!validateInput(input)) {
-        LOG_ERROR("Invalid input for model: " + modelId);
+    if (!plan.acceptsInput(input.size())) {
+        // Slow path only: the type-specific checks explain the rejection
+        validateInput(input);
+        rejectInference("Invalid input for model: " + modelId);
         return {};
     }
 
+    std::vector<float> output(plan.outputSize(input.size()));
+    if (!runInference(input.data(), input.size(), output.data())) {
+        return {};
+    }
+    return output;
+}
+
+bool AIModel::inference(const float* input, size_t inputSize, float* output, size_t outputSize) {
+    if (!initialized) {
+        rejectInference("Model not initialized: " + modelId);
+        return false;
+    }
+    ensurePlan();
+
+    if (!input || !output || !plan.acceptsInput(inputSize)) {
+        validateInputSize(inputSize);
+        rejectInference("Invalid input for model: " + modelId);
+        return false;
+    }
+
+    if (outputSize < plan.outputSize(inputSize)) {
+        rejectInference("Output buffer too small for model " + modelId + ": need " +
+                        std::to_string(plan.outputSize(inputSize)) + ", got " + std::to_string(outputSize));
+        return false;
+    }
+
+    return runInference(input, inputSize, output);
+}
+
+bool AIModel::runInference(const float* input, size_t inputSize, float* output) {
+    // Cache hits are timed too: they are what the caller waited for
+    const uint64_t start = cycle_clock::now();
+    try {
+        uint64_t hash = 0;
+        if (cache) {
+            hash = InferenceCache::hashInput(input, inputSize);
+            if (cache->lookup(hash, input, inputSize, output, plan.outputSize(inputSize))) {
+                latencyHistogram.record(cycle_clock::now() - start);
+                return true;
+            }
+        }
+
+        {
+            MemoryScope scope(memory, MemoryCategory::SCRATCH);
+            plan.run(input, inputSize, output, *scratchPool.acquire());
+        }
+
+        if (cache) {
+            cache->insert(hash, input, inputSize, output, plan.outputSize(inputSize));
+        }
+        latencyHistogram.record(cycle_clock::now() - start);
+        return true;
+    }
+    catch (const std::exception& e) {
+        metrics.lastError = e.what();
+        rejectInference("Inference failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool AIModel::inference(const SparseVector& input, float* output, size_t outputSize) {
+    if (!initialized) {
+        rejectInference("Model not initialized: " + modelId);
+        return false;
+    }
+
+    if (!output || !validateSparseInput(input)) {
+        rejectInference("Invalid sparse input for model: " + modelId);
+        return false;
+    }
+
+    const size_t needed = getOutputSize(input.dimension);
+    if (outputSize < needed) {
+        rejectInference("Output buffer too small for model " + modelId + ": need " +
+                        std::to_string(needed) + ", got " + std::to_string(outputSize));
+        return false;
+    }
+
+    MemoryScope scope(memory, MemoryCategory::SCRATCH);
     try {
-        auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t start = cycle_clock::now();
+        runSparse(input, output, *scratchPool.acquire());
+        latencyHistogram.record(cycle_clock::now() - start);
+        return true;
+    }
+    catch (const std::exception& e) {
+        metrics.lastError = e.what();
+        rejectInference("Inference failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool AIModel::inferenceBatch(const SparseBatch& input, float* output) {
+    if (!initialized) {
+        rejectInference("Model not initialized: " + modelId);
+        return false;
+    }
+
+    if (!output || input.rows == 0 || !input.valid()) {
+        rejectInference("Invalid sparse batch for model: " + modelId);
+        return false;
+    }
+
+    if (input.rows > static_cast<size_t>(constants::MAX_BATCH_SIZE)) {
+        rejectInference("Batch of " + std::to_string(input.rows) +
+                        " rows exceeds maximum batch size for model: " + modelId);
+        return false;
+    }
+
+    // Rows were checked above; only the shape is left
+    if (!validateSparseInput(SparseVector{nullptr, nullptr, 0, input.dimension})) {
+        errorCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    MemoryScope scope(memory, MemoryCategory::SCRATCH);
+    try {
+        const uint64_t start = cycle_clock::now();
+
+        const auto scratch = scratchPool.acquire();
+        if (type == ModelType::NEURAL_NETWORK) {
+            network.forwardSparseBatch(input, output, *scratch);
+        } else {
+            const size_t width = getOutputSize(input.dimension);
+            for (size_t r = 0; r < input.rows; ++r) {
+                runSparse(input.row(r), output + r * width, *scratch);
+            }
+        }
+
+        batchLatencyHistogram.record(cycle_clock::now() - start);
+        batchRows.fetch_add(input.rows, std::memory_order_relaxed);
+        return true;
+    }
+    catch (const std::exception& e) {
+        metrics.lastError = e.what();
+        rejectInference("Batch inference failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+std::unique_ptr<StreamState> AIModel::createStream(size_t channels) const {
+    try {
+        StreamConfig streamConfig;
+        streamConfig.window = sizeParameter(getParameter("stream_window"), streamConfig.window);
+        streamConfig.emaAlpha = floatParameter(getParameter("stream_ema_alpha"), streamConfig.emaAlpha);
+        streamConfig.hidden = sizeParameter(getParameter("stream_hidden"), streamConfig.hidden);
+        const std::string features = getParameter("stream_features");
+        if (!features.empty()) {
+            streamConfig.features = parseStreamFeatures(features);
+        }
+        MemoryScope scope(memory, MemoryCategory::SCRATCH);
+        return std::make_unique<StreamState>(streamConfig, channels);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Cannot create stream for model " + modelId + ": " + e.what());
+        return nullptr;
+    }
+}
+
+bool AIModel::inferenceStream(StreamState& stream, const float* sample, size_t sampleSize,
+                              float* output, size_t outputSize) {
+    if (!initialized) {
+        rejectInference("Model not initialized: " + modelId);
+        return false;
+    }
+    ensurePlan();
+
+    // Rejected samples leave the stream as it was
+    if (!sample || !output || sampleSize != stream.channels() || !plan.acceptsInput(stream.rowSize())) {
+        validateInputSize(stream.rowSize());
+        rejectInference("Invalid stream sample for model " + modelId + ": " + std::to_string(sampleSize) +
+                        " values for a stream of " + std::to_string(stream.channels()) + " channels");
+        return false;
+    }
+
+    const size_t needed = plan.outputSize(stream.rowSize());
+    if (outputSize < needed || needed < stream.hidden()) {
+        rejectInference("Output of model " + modelId + " does not fit: need " + std::to_string(needed) +
+                        " values, got " + std::to_string(outputSize) + ", " + std::to_string(stream.hidden()) +
+                        " fed back");
+        return false;
+    }
+
+    if (!runInference(stream.update(sample), stream.rowSize(), output)) {
+        return false;
+    }
+    stream.feedBack(output);
+    return true;
+}
+
+bool AIModel::validateSparseInput(const SparseVector& input) const {
+    if (input.dimension == 0 || !input.valid()) {
+        LOG_ERROR("Sparse input to model " + modelId + " needs increasing indices below its dimension");
+        return false;
+    }
+    if (!validateInputSize(input.dimension)) {
+        return false;
+    }
+    if (type == ModelType::NEURAL_NETWORK && !network.hasSparseInput()) {
+        LOG_ERROR("Neural network " + modelId + " is not prepared for sparse input (sparse_input=true)");
+        return false;
+    }
+    return true;
+}
+
+void AIModel::runSparse(const SparseVector& input, float* output, InferenceScratch& scratch) {
+    // Engines without a dot product read the few features they split on
+    // from a zeroed dense row, which the input is scattered into and
+    // cleared from again
+    auto predictDense = [&](size_t width, auto&& predict) {
+        float* row = scratch.floats(InferenceScratch::FEATURES, width);
+        scatterSparse(input, width, row);
+        predict(row);
+        clearSparse(input, width, row);
+    };
+    auto passThrough = [&]() {
+        std::fill(output, output + input.dimension, 0.0f);
+        scatterSparse(input, input.dimension, output);
+    };
+
+    switch (type) {
+        case ModelType::NEURAL_NETWORK:
+            network.forwardSparse(input, output, scratch);
+            break;
+        case ModelType::DECISION_TREE:
+            predictDense(tree.featureCount(), [&](const float* row) { tree.predict(row, output); });
+            break;
+        case ModelType::RANDOM_FOREST:
+            if (forest.empty()) {
+                passThrough();
+            } else {
+                predictDense(forest.featureCount(), [&](const float* row) { forest.predict(row, output); });
+            }
+            break;
+        case ModelType::SVM:
+            if (svm.empty()) {
+                passThrough();
+            } else {
+                svm.predictSparse(input, output, scratch);
+            }
+            break;
+        default:
+            passThrough();
+    }
+}
+
+void AIModel::rejectInference(const std::string& message) {
+    errorCount.fetch_add(1, std::memory_order_relaxed);
+    LOG_ERROR(message);
+}
+
+void AIModel::compilePlan() {
+    MemoryScope scope(memory, MemoryCategory::SCRATCH);
+    // Cached results belong to the engine state the old plan was built from
+    if (cache) {
+        cache->clear();
+    }
+    switch (type) {
+        case ModelType::NEURAL_NETWORK:
+            plan.compile(network);
+            break;
+        case ModelType::DECISION_TREE:
+            plan.compile(tree);
+            break;
+        case ModelType::RANDOM_FOREST:
+            plan.compile(forest);
+            break;
+        case ModelType::SVM:
+            plan.compile(svm);
+            break;
+        default:
+            plan.compilePassthrough(nullptr);
+            break;
+    }
+    // Sized up front so the first call does not allocate
+    plan.reserve(*scratchPool.acquire());
+}
+
+void AIModel::ensurePlan() {
+    if (!plan.valid()) {
+        std::lock_guard<std::mutex> lock(planMutex);
+        if (!plan.valid()) {
+            compilePlan();
+        }
+    }
+}
+
+bool AIModel::inferenceBatch(const float* input, size_t rows, size_t inputSize, float* output) {
+    if (!initialized) {
+        rejectInference("Model not initialized: " + modelId);
+        return false;
+    }
+
+    if (!input || !output || rows == 0 || inputSize == 0) {
+        rejectInference("Invalid batch for model: " + modelId);
+        return false;
+    }
+
+    if (rows > static_cast<size_t>(constants::MAX_BATCH_SIZE)) {
+        rejectInference("Batch of " + std::to_string(rows) + " rows exceeds maximum batch size for model: " +
+                        modelId);
+        return false;
+    }
+
+    if (!validateInputSize(inputSize)) {
+        errorCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Batch buffers grow on demand
+    MemoryScope scope(memory, MemoryCategory::SCRATCH);
+    try {
+        const uint64_t start = cycle_clock::now();
 
-        // Simulate model inference based on type
-        std::vector<float> output;
         switch (type) {
             case ModelType::NEURAL_NETWORK:
-                // Simulate neural network inference
-                output.resize(input.size());
-                for (size_t i = 0; i < input.size(); ++i) {
-                    output[i] = std::tanh(input[i]); // Simple activation
-                }
+                network.forwardBatch(input, rows, inputSize, output, *scratchPool.acquire());
                 break;
-                
+
             case ModelType::DECISION_TREE:
-                // Simulate decision tree inference
-                output = {input[0] > 0.5f ? 1.0f : 0.0f};
+                tree.predictBatch(input, rows, inputSize, output);
                 break;
-                
+
+            case ModelType::RANDOM_FOREST:
+                if (forest.empty()) {
+                    std::copy(input, input + rows * inputSize, output);
+                } else {
+                    forest.predictBatch(input, rows, inputSize, output);
+                }
+                break;
+
+            case ModelType::SVM:
+                if (svm.empty()) {
+                    std::copy(input, input + rows * inputSize, output);
+                } else {
+                    svm.predictBatch(input, rows, inputSize, output, *scratchPool.acquire());
+                }
+                break;
+
             default:
-                // Default simple processing
-                output = input;
+                std::copy(input, input + rows * inputSize, output);
         }
 
-        // Update metrics
-        auto end = std::chrono::high_resolution_clock::now();
-        metrics.latency = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0; // ms
-        
-        return output;
+        batchLatencyHistogram.record(cycle_clock::now() - start);
+        batchRows.fetch_add(rows, std::memory_order_relaxed);
+        return true;
     }
     catch (const std::exception& e) {
-        LOG_ERROR("Inference failed: " + std::string(e.what()));
         metrics.lastError = e.what();
-        return {};
+        rejectInference("Batch inference failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+size_t AIModel::getOutputSize(size_t inputSize) const {
+    switch (type) {
+        case ModelType::NEURAL_NETWORK:
+            return network.outputSize(inputSize);
+        case ModelType::DECISION_TREE:
+            return tree.empty() ? 1 : tree.outputSize();
+        case ModelType::RANDOM_FOREST:
+            return forest.empty() ? inputSize : forest.outputSize();
+        case ModelType::SVM:
+            return svm.empty() ? inputSize : svm.outputSize();
+        default:
+            return inputSize;
     }
 }
 
@@ -119,10 +545,22 @@ bool AIModel::train(const std::vector<std::vector<float>>& data) {
         return false;
     }
 
+    MemoryScope scope(memory, MemoryCategory::WEIGHTS);
     try {
         LOG_INFO("Training model: " + modelId);
-        // Simulate training process
-        return true;
+        // Training writes the weights in place
+        detachWeights();
+        plan.invalidate();
+        switch (type) {
+            case ModelType::NEURAL_NETWORK:
+                return trainNetwork(data);
+            case ModelType::DECISION_TREE:
+            case ModelType::RANDOM_FOREST:
+                return trainTrees(data);
+            default:
+                // No trainer for this model type yet
+                return true;
+        }
     }
     catch (const std::exception& e) {
         LOG_ERROR("Training failed: " + std::string(e.what()));
@@ -133,7 +571,35 @@ bool AIModel::train(const std::vector<std::vector<float>>& data) {
 bool AIModel::save(const std::string& path) {
     try {
         LOG_INFO("Saving model to: " + path);
-        // Simulate model saving
+
+        ModelConfig fileConfig = config;
+        fileConfig.name = config.name.empty() ? modelId : config.name;
+        fileConfig.type = type;
+        fileConfig.parameters = parameters;
+
+        ModelFileWriter writer;
+        writer.setConfig(fileConfig);
+        switch (type) {
+            case ModelType::NEURAL_NETWORK:
+                network.save(writer);
+                break;
+            case ModelType::DECISION_TREE:
+                tree.save(writer, "tree");
+                break;
+            case ModelType::RANDOM_FOREST:
+                if (!forest.empty()) {
+                    forest.save(writer, "forest");
+                }
+                break;
+            case ModelType::SVM:
+                if (!svm.empty()) {
+                    svm.save(writer, "svm");
+                }
+                break;
+            default:
+                break;
+        }
+        writer.write(path);
         return true;
     }
     catch (const std::exception& e) {
@@ -145,7 +611,50 @@ bool AIModel::save(const std::string& path) {
 bool AIModel::load(const std::string& path) {
     try {
         LOG_INFO("Loading model from: " + path);
-        // Simulate model loading
+        auto file = ModelFile::open(path);
+        return load(*file);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Failed to load model: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool AIModel::load(const ModelFile& file) {
+    MemoryScope scope(memory, MemoryCategory::WEIGHTS);
+    try {
+        if (file.getConfig().type != type) {
+            LOG_ERROR("Model file type does not match model " + modelId + ": " + file.getPath());
+            return false;
+        }
+        plan.invalidate();
+
+        switch (type) {
+            case ModelType::NEURAL_NETWORK:
+                network.load(file);
+                trainer.reset();
+                break;
+            case ModelType::DECISION_TREE:
+                tree.load(file, "tree");
+                break;
+            case ModelType::RANDOM_FOREST:
+                if (file.findTensor("forest.roots")) {
+                    forest.load(file, "forest");
+                }
+                break;
+            case ModelType::SVM:
+                if (file.findTensor("svm.bias")) {
+                    svm.load(file, "svm");
+                }
+                break;
+            default:
+                break;
+        }
+        parameters.insert(file.getConfig().parameters.begin(), file.getConfig().parameters.end());
+        weightsLoaded = true;
+        // The loaded engine no longer views a shared store
+        sharedWeights.reset();
+        weightsFromPeer = false;
         return true;
     }
     catch (const std::exception& e) {
@@ -154,6 +663,134 @@ bool AIModel::load(const std::string& path) {
     }
 }
 
+std::shared_ptr<const ModelWeights> AIModel::shareWeights() {
+    if (sharedWeights && !weightsFromPeer) {
+        return sharedWeights;
+    }
+
+    // The engines move as they are, so views a model on a peer's weights
+    // holds stay valid and keep the peer's store alive
+    auto weights = std::make_shared<ModelWeights>();
+    weights->type = type;
+    weights->network = std::move(network);
+    weights->tree = std::move(tree);
+    weights->forest = std::move(forest);
+    weights->svm = std::move(svm);
+    viewWeights(std::move(weights));
+    weightsFromPeer = false;
+    LOG_INFO("Model " + modelId + ": sharing " + std::to_string(sharedWeights->weightBytes()) + " weight bytes");
+    return sharedWeights;
+}
+
+bool AIModel::attachWeights(std::shared_ptr<const ModelWeights> weights) {
+    if (!weights || weights->type != type) {
+        LOG_ERROR("Cannot attach weights of another model type to model " + modelId);
+        return false;
+    }
+    viewWeights(std::move(weights));
+    weightsFromPeer = true;
+    weightsLoaded = true;
+    trainer.reset();
+    LOG_INFO("Model " + modelId + ": attached " + std::to_string(sharedWeights->weightBytes()) +
+             " shared weight bytes");
+    return true;
+}
+
+void AIModel::viewWeights(std::shared_ptr<const ModelWeights> weights) {
+    const std::shared_ptr<const void> keepAlive = weights;
+    MemoryScope scope(memory, MemoryCategory::WEIGHTS);
+    network = weights->network.view(keepAlive);
+    tree = weights->tree.view(keepAlive);
+    forest = weights->forest.view(keepAlive);
+    svm = weights->svm.view(keepAlive);
+    sharedWeights = std::move(weights);
+    plan.invalidate();
+}
+
+void AIModel::detachWeights() {
+    // Engines also borrow from read-only file mappings, so this copies
+    // whatever is borrowed even without a shared store
+    MemoryScope scope(memory, MemoryCategory::WEIGHTS);
+    network.detachWeights();
+    tree.detachWeights();
+    forest.detachWeights();
+    svm.detachWeights();
+    sharedWeights.reset();
+    weightsFromPeer = false;
+    plan.invalidate();
+}
+
+bool AIModel::trainNetwork(const std::vector<std::vector<float>>& data) {
+    if (!initialized || network.empty()) {
+        LOG_ERROR("Neural network " + modelId + " needs initialized layers before training");
+        return false;
+    }
+
+    TrainingOptions options;
+    options.optimizer = parseOptimizer(getParameter("optimizer"));
+    options.learningRate = floatParameter(getParameter("learning_rate"),
+                                          options.optimizer == Optimizer::ADAM ? 0.001f : 0.01f);
+    options.batchSize = sizeParameter(getParameter("batch_size"), options.batchSize);
+    options.epochs = sizeParameter(getParameter("epochs"), options.epochs);
+    options.seed = static_cast<uint32_t>(sizeParameter(getParameter("seed"), options.seed));
+
+    // Optimizer state and per-worker gradients
+    MemoryScope scratch(MemoryCategory::SCRATCH);
+    if (!trainer) {
+        trainer = std::make_unique<NetworkTrainer>(network);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    metrics.trainingLoss = trainer->train(data, options);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (network.hasSparseInput()) {
+        MemoryScope weights(MemoryCategory::WEIGHTS);
+        network.prepareSparseInput();
+    }
+
+    LOG_INFO("Trained " + modelId + " on " + std::to_string(data.size()) + " rows in " +
+             std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()) +
+             " ms, loss " + std::to_string(metrics.trainingLoss));
+    return true;
+}
+
+bool AIModel::trainTrees(const std::vector<std::vector<float>>& data) {
+    // Rows hold the features followed by `outputs` targets
+    const size_t outputCount = sizeParameter(getParameter("outputs"), 1);
+    if (outputCount == 0 || data.front().size() <= outputCount) {
+        LOG_ERROR("Training rows for " + modelId + " need features followed by " +
+                  std::to_string(outputCount) + " targets");
+        return false;
+    }
+    const size_t featureCount = data.front().size() - outputCount;
+    const bool isForest = type == ModelType::RANDOM_FOREST;
+
+    TreeTrainingOptions options;
+    options.maxDepth = sizeParameter(getParameter("max_depth"), isForest ? 10 : 8);
+    options.minSamplesLeaf = std::max<size_t>(1, sizeParameter(getParameter("min_samples_leaf"), 1));
+    options.maxFeatures = sizeParameter(getParameter("max_features"),
+        isForest ? static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(featureCount)))) : 0);
+    options.trees = sizeParameter(getParameter("trees"), 100);
+    options.seed = static_cast<uint32_t>(sizeParameter(getParameter("seed"), options.seed));
+
+    auto start = std::chrono::high_resolution_clock::now();
+    TreeTrainer trainer(data, featureCount, outputCount, sizeParameter(getParameter("max_bins"), 255));
+    size_t nodes = 0;
+    if (isForest) {
+        forest.build(trainer.trainForest(options));
+        nodes = forest.getNodeCount();
+    } else {
+        tree = trainer.trainTree(options);
+        nodes = tree.getNodeCount();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    LOG_INFO("Trained " + modelId + " on " + std::to_string(data.size()) + " rows in " +
+             std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()) +
+             " ms, " + std::to_string(nodes) + " nodes");
+    updateMetrics();
+    return true;
+}
+
 void AIModel::setParameter(const std::string& key, const std::string& value) {
     parameters[key] = value;
     LOG_INFO("Set parameter " + key + " = " + value + " for model " + modelId);
@@ -164,10 +801,53 @@ std::string AIModel::getParameter(const std::string& key) const {
     return it != parameters.end() ? it->second : "";
 }
 
+void AIModel::configureCache() {
+    // "cache_bytes" enables the single-row result cache with that memory
+    // budget; "cache_shards" sets how many independently locked shards it has
+    const size_t bytes = sizeParameter(getParameter("cache_bytes"), 0);
+    if (bytes == 0) {
+        cache.reset();
+        return;
+    }
+    const size_t shards = sizeParameter(getParameter("cache_shards"), DEFAULT_CACHE_SHARDS);
+    MemoryScope scope(memory, MemoryCategory::CACHES);
+    cache = std::make_unique<InferenceCache>(bytes, shards);
+    LOG_INFO("Model " + modelId + ": inference cache of " + std::to_string(bytes) + " bytes in " +
+             std::to_string(shards) + " shards");
+}
+
+AIModel::ModelMetrics AIModel::getMetrics() const {
+    ModelMetrics snapshot = metrics;
+    snapshot.latency = latencyHistogram.snapshot();
+    snapshot.batchLatency = batchLatencyHistogram.snapshot();
+    snapshot.rowsProcessed = snapshot.latency.count + batchRows.load(std::memory_order_relaxed);
+    snapshot.errors = errorCount.load(std::memory_order_relaxed);
+    const double seconds =
+        static_cast<double>(cycle_clock::now() - createdTicks) * cycle_clock::nanosPerTick() * 1e-9;
+    snapshot.throughput = seconds > 0.0 ? static_cast<double>(snapshot.rowsProcessed) / seconds : 0.0;
+    snapshot.weightMemory = memory->bytes(MemoryCategory::WEIGHTS);
+    if (weightsFromPeer) {
+        snapshot.sharedWeightBytes = snapshot.weightBytes > snapshot.weightMemory
+                                     ? snapshot.weightBytes - snapshot.weightMemory : 0;
+    }
+    snapshot.scratchMemory = memory->bytes(MemoryCategory::SCRATCH);
+    snapshot.cacheMemory = memory->bytes(MemoryCategory::CACHES);
+    snapshot.memoryUsage = sizeof(*this) + memory->total();
+    if (cache) {
+        const auto stats = cache->getStats();
+        snapshot.cacheHits = stats.hits;
+        snapshot.cacheMisses = stats.misses;
+        snapshot.cacheEvictions = stats.evictions;
+        snapshot.cacheBytes = stats.bytes;
+    }
+    return snapshot;
+}
+
 void AIModel::updateMetrics() {
     // Update performance metrics
-    metrics.memoryUsage = sizeof(*this); // Basic memory tracking
     metrics.accuracy = 0.95; // Simulated accuracy
+    metrics.weightBytes = network.weightBytes() + tree.weightBytes() + forest.weightBytes() + svm.weightBytes();
+    metrics.quantizationError = network.getQuantizationError();
 }
 
 bool AIModel::validateInput(const std::vector<float>& input) {
@@ -175,6 +855,121 @@ bool AIModel::validateInput(const std::vector<float>& input) {
         LOG_ERROR("Empty input provided to model " + modelId);
         return false;
     }
+    return validateInputSize(input.size());
+}
+
+bool AIModel::validateInputSize(size_t inputSize) const {
+    if (type == ModelType::NEURAL_NETWORK && !network.empty() && inputSize != network.inputSize()) {
+        LOG_ERROR("Input size mismatch for model " + modelId + ": expected " +
+                  std::to_string(network.inputSize()) + ", got " + std::to_string(inputSize));
+        return false;
+    }
+    if (type == ModelType::DECISION_TREE && inputSize < tree.featureCount()) {
+        LOG_ERROR("Input too narrow for model " + modelId + ": tree reads " +
+                  std::to_string(tree.featureCount()) + " features, got " + std::to_string(inputSize));
+        return false;
+    }
+    if (type == ModelType::RANDOM_FOREST && inputSize < forest.featureCount()) {
+        LOG_ERROR("Input too narrow for model " + modelId + ": forest reads " +
+                  std::to_string(forest.featureCount()) + " features, got " + std::to_string(inputSize));
+        return false;
+    }
+    if (type == ModelType::SVM && !svm.empty() && inputSize != svm.inputSize()) {
+        LOG_ERROR("Input size mismatch for model " + modelId + ": expected " +
+                  std::to_string(svm.inputSize()) + ", got " + std::to_string(inputSize));
+        return false;
+    }
+    return true;
+}
+
+bool AIModel::initializeNetwork() {
+    if (weightsLoaded) {
+        LOG_INFO("Neural network " + modelId + ": using " + std::to_string(network.getLayers().size()) +
+                 " layers from model file");
+        return prepareNetwork();
+    }
+
+    // Topology comes from "layers" (e.g. "16,32,4"); a single width or no
+    // spec leaves the network empty so it only applies the output activation
+    auto widths = parseLayerWidths(getParameter("layers"));
+    auto hidden = kernels::parseActivation(getParameter("activation").empty()
+                                           ? "relu" : getParameter("activation"));
+    auto output = kernels::parseActivation(getParameter("output_activation").empty()
+                                           ? "tanh" : getParameter("output_activation"));
+    uint32_t seed = static_cast<uint32_t>(sizeParameter(getParameter("seed"), 42));
+
+    network.configure(widths, hidden, output, seed);
+    trainer.reset();
+    LOG_INFO("Neural network " + modelId + ": " + std::to_string(network.getLayers().size()) +
+             " layers, " + std::to_string(network.parameterCount()) + " parameters, kernels: " +
+             kernels::simdLevelName(network.getSimdLevel()));
+    return prepareNetwork();
+}
+
+bool AIModel::prepareNetwork() {
+    // "input_mean"/"input_scale" (comma lists, one value per input) normalize
+    // the input before the first layer; fusion folds them into its weights.
+    // Weights loaded from a file or attached from a store may already carry
+    // them, folded or pending.
+    const std::string mean = getParameter("input_mean");
+    const std::string scale = getParameter("input_scale");
+    if ((!mean.empty() || !scale.empty()) && !network.isInputNormalized()) {
+        std::vector<float> meanValues = parseFloatList(mean);
+        std::vector<float> scaleValues = parseFloatList(scale);
+        if (meanValues.empty()) {
+            meanValues.assign(network.inputSize(), 0.0f);
+        }
+        if (scaleValues.empty()) {
+            scaleValues.assign(network.inputSize(), 1.0f);
+        }
+        if (network.empty() || meanValues.size() != network.inputSize() ||
+            scaleValues.size() != network.inputSize()) {
+            LOG_ERROR("Input normalization of model " + modelId + " must have one value per input");
+            return false;
+        }
+        network.setInputNormalization(meanValues, scaleValues);
+    }
+
+    if (size_t fused = network.fuse()) {
+        LOG_INFO("Neural network " + modelId + ": " + std::to_string(fused) + " fused operations");
+    }
+    if (!applyPrecision()) {
+        return false;
+    }
+
+    // "sparse_input" = "true" keeps an input-major copy of the first layer
+    // for sparse rows; a network viewing shared weights may already have one
+    if (getParameter("sparse_input") == "true" && !network.hasSparseInput()) {
+        if (!network.prepareSparseInput()) {
+            LOG_ERROR("Sparse input needs network layers in model " + modelId);
+            return false;
+        }
+        LOG_INFO("Neural network " + modelId + ": sparse input over " + std::to_string(network.inputSize()) +
+                 " features, " + std::to_string(network.weightBytes()) + " weight bytes");
+    }
+    return true;
+}
+
+bool AIModel::applyPrecision() {
+    const std::string precision = getParameter("precision");
+    if (precision.empty() || precision == "float32") {
+        return true;
+    }
+    if (precision != "int8" && precision != "float16" && precision != "bfloat16") {
+        LOG_ERROR("Unsupported precision for model " + modelId + ": " + precision);
+        return false;
+    }
+    // Weights loaded in a reduced precision stay as they are
+    if (network.empty() || network.isQuantized() || network.isHalfPrecision()) {
+        return true;
+    }
+
+    uint32_t seed = static_cast<uint32_t>(sizeParameter(getParameter("seed"), 42));
+    const float error = precision == "int8" ? network.quantize(seed)
+                      : network.toHalf(precision == "float16" ? kernels::HalfType::FP16 : kernels::HalfType::BF16,
+                                       seed);
+    LOG_INFO("Neural network " + modelId + ": converted to " + precision + ", " +
+             std::to_string(network.weightBytes()) + " weight bytes, max error " + std::to_string(error));
     return true;
 }
 
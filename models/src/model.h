@@ -1,15 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "decision_tree.h"
+#include "dense_network.h"
+#include "inference_cache.h"
+#include "inference_plan.h"
+#include "inference_scratch.h"
+#include "latency_histogram.h"
+#include "memory_account.h"
+#include "network_trainer.h"
+#include "random_forest.h"
+#include "stream_state.h"
+#include "svm.h"
 #include "../../utils/logging.h"
 
 namespace xyz {
 
 // Forward declarations
 class ModelLoader;
+class ModelFile;
+struct ModelWeights;
 
 enum class ModelType {
     NEURAL_NETWORK,
@@ -34,14 +49,78 @@ public:
     // Core model operations
     virtual bool initialize(const ModelConfig& config);
     virtual std::vector<float> inference(const std::vector<float>& input);
+
+    // Allocation-free inference into a caller-owned buffer of `outputSize`
+    // floats, which must hold at least getOutputSize(inputSize) values
+    virtual bool inference(const float* input, size_t inputSize, float* output, size_t outputSize);
+
+    // Batched inference over `rows` (<= constants::MAX_BATCH_SIZE) inputs of
+    // `inputSize` floats stored contiguously row-major in `input`. Writes
+    // rows x getOutputSize(inputSize) floats to the caller-provided `output`.
+    virtual bool inferenceBatch(const float* input, size_t rows, size_t inputSize, float* output);
+
+    // Sparse counterparts of the two calls above (see sparse_input.h), with
+    // `input.dimension` as the input size. Only the weights of non-zero
+    // features are read. Neural networks need the "sparse_input" parameter
+    // set to "true". Sparse results are not cached.
+    virtual bool inference(const SparseVector& input, float* output, size_t outputSize);
+    virtual bool inferenceBatch(const SparseBatch& input, float* output);
+
+    // Stateful inference on samples arriving one at a time (see
+    // stream_state.h). createStream() makes the state of one stream of
+    // `channels`-wide samples from the "stream_window", "stream_ema_alpha",
+    // "stream_features" (comma list of value, mean, std, ema) and
+    // "stream_hidden" parameters, or returns null if they are invalid.
+    // inferenceStream() adds `sample` to `stream`, runs the model on the
+    // stream's input row (so the model's input size is stream.rowSize())
+    // and feeds the first stream_hidden outputs back into the stream.
+    std::unique_ptr<StreamState> createStream(size_t channels) const;
+    bool inferenceStream(StreamState& stream, const float* sample, size_t sampleSize,
+                         float* output, size_t outputSize);
     virtual bool train(const std::vector<std::vector<float>>& data);
     virtual bool save(const std::string& path);
     virtual bool load(const std::string& path);
+    // Loads engine weights from an already opened model file
+    virtual bool load(const ModelFile& file);
+
+    // Weight sharing, so that N instances of a model cost one copy of its
+    // weights. shareWeights() moves this model's engine weights into an
+    // immutable store and runs the model on views of it; later calls return
+    // the same store. attachWeights() makes another model of the same type
+    // run on views of `weights`. Attach before initialize(): the model keeps
+    // the attached weights and applies its own parameters on top, copying
+    // only the tensors they change (e.g. int8 precision). Input
+    // normalization already folded into the store is not applied again.
+    // Training or mutable engine access copies all weights first.
+    std::shared_ptr<const ModelWeights> shareWeights();
+    bool attachWeights(std::shared_ptr<const ModelWeights> weights);
+    const std::shared_ptr<const ModelWeights>& getSharedWeights() const { return sharedWeights; }
 
     // Model information
     std::string getModelId() const { return modelId; }
     ModelType getModelType() const { return type; }
     bool isInitialized() const { return initialized; }
+    size_t getOutputSize(size_t inputSize) const;
+    // Whether inference takes rows of `inputSize` floats; logs why not
+    bool acceptsInputSize(size_t inputSize) const { return validateInputSize(inputSize); }
+
+    // Engine access. Mutable access may change the engine, so the inference
+    // plan is recompiled before the next inference, and shared or
+    // file-mapped weights are copied.
+    //
+    // Inference calls may run concurrently on one model from any number of
+    // threads; each evaluates into scratch of its own. Mutable engine
+    // access, initialize(), train(), load() and parameter changes must not
+    // overlap them.
+    DenseNetwork& getNetwork() { detachWeights(); plan.invalidate(); return network; }
+    const DenseNetwork& getNetwork() const { return network; }
+    DecisionTree& getTree() { detachWeights(); plan.invalidate(); return tree; }
+    const DecisionTree& getTree() const { return tree; }
+    RandomForest& getForest() { detachWeights(); plan.invalidate(); return forest; }
+    const RandomForest& getForest() const { return forest; }
+    SupportVectorMachine& getSvm() { detachWeights(); plan.invalidate(); return svm; }
+    const SupportVectorMachine& getSvm() const { return svm; }
+    const InferencePlan& getPlan() const { return plan; }
     
     // Model configuration
     virtual void setParameter(const std::string& key, const std::string& value);
@@ -49,13 +128,42 @@ public:
     
     // Performance metrics
     struct ModelMetrics {
-        double accuracy;
-        double latency;
-        size_t memoryUsage;
+        double accuracy = 0.0;
+        // Latency distribution of every successful single-row call, and of
+        // every successful batch call as a whole
+        LatencyHistogram::Snapshot latency;
+        LatencyHistogram::Snapshot batchLatency;
+        // Rows inferred by successful calls, calls that failed, and rows per
+        // second since the model was created
+        uint64_t rowsProcessed = 0;
+        uint64_t errors = 0;
+        double throughput = 0.0;
+        // Bytes allocated by the model, by category, and their sum plus the
+        // model object itself. Weights borrowed from a mapped model file
+        // are counted in weightBytes only.
+        size_t memoryUsage = 0;
+        size_t weightMemory = 0;
+        size_t scratchMemory = 0;
+        size_t cacheMemory = 0;
         std::string lastError;
+        // Bytes of engine weights, and for a reduced precision (int8, float16,
+        // bfloat16) the largest output difference to the float model on a
+        // calibration batch
+        size_t weightBytes = 0;
+        double quantizationError = 0.0;
+        // Part of weightBytes read from a store shared by another model
+        size_t sharedWeightBytes = 0;
+        // Mean per-sample loss of the last training epoch
+        double trainingLoss = 0.0;
+        // Single-row inference cache ("cache_bytes" parameter); all zero
+        // while it is disabled
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t cacheEvictions = 0;
+        size_t cacheBytes = 0;
     };
     
-    ModelMetrics getMetrics() const { return metrics; }
+    ModelMetrics getMetrics() const;
 
 protected:
     std::string modelId;
@@ -63,11 +171,72 @@ protected:
     bool initialized;
     ModelConfig config;
     ModelMetrics metrics;
+    // Set once weights come from a model file, so initialize() keeps them
+    bool weightsLoaded;
     std::unordered_map<std::string, std::string> parameters;
+    // Charged with every buffer the engines, plan, trainer and cache
+    // allocate during calls on this model
+    std::shared_ptr<MemoryAccount> memory;
+
+    // Store the engines below borrow their weights from, and whether another
+    // model created it; null when the weights are this model's own
+    std::shared_ptr<const ModelWeights> sharedWeights;
+    bool weightsFromPeer;
+
+    // Inference engines
+    DenseNetwork network;
+    DecisionTree tree;
+    RandomForest forest;
+    SupportVectorMachine svm;
+    // Created on first train() and kept so optimizer state carries over
+    std::unique_ptr<NetworkTrainer> trainer;
+    // Single-row inference path, compiled by initialize() and again by the
+    // first call after the engine changed, under planMutex
+    InferencePlan plan;
+    std::mutex planMutex;
+    // Intermediate buffers of calls in flight
+    ScratchPool scratchPool;
+    // Recorded on every call; safe to read while inference runs
+    LatencyHistogram latencyHistogram;
+    LatencyHistogram batchLatencyHistogram;
+    std::atomic<uint64_t> batchRows;
+    std::atomic<uint64_t> errorCount;
+    // cycle_clock time of construction, for throughput
+    uint64_t createdTicks;
+    // Results of single-row inference, cleared whenever the plan is
+    // recompiled; null unless enabled through parameters
+    std::unique_ptr<InferenceCache> cache;
 
     // Utility methods
     virtual void updateMetrics();
     virtual bool validateInput(const std::vector<float>& input);
+    bool validateInputSize(size_t inputSize) const;
+    bool runInference(const float* input, size_t inputSize, float* output);
+    // Checks a sparse input and logs why it is rejected
+    bool validateSparseInput(const SparseVector& input) const;
+    // Runs one validated sparse row
+    void runSparse(const SparseVector& input, float* output, InferenceScratch& scratch);
+    // Logs `message` and counts the call as failed
+    void rejectInference(const std::string& message);
+    // Compiles the engine of this model type into `plan`
+    void compilePlan();
+    // Recompiles a plan invalidated by engine changes; safe to call from
+    // concurrent inference
+    void ensurePlan();
+    // Replaces the engines with views of `weights`
+    void viewWeights(std::shared_ptr<const ModelWeights> weights);
+    // Gives the model its own copy of any shared or file-mapped weights
+    void detachWeights();
+    void configureCache();
+    bool initializeNetwork();
+    // Applies input normalization, operator fusion, precision and sparse
+    // input preparation
+    bool prepareNetwork();
+    // Applies the "precision" parameter (float32, float16, bfloat16 or int8)
+    // to the network
+    bool applyPrecision();
+    bool trainNetwork(const std::vector<std::vector<float>>& data);
+    bool trainTrees(const std::vector<std::vector<float>>& data);
 };
 
 } // namespace xyz
\ No newline at end of file
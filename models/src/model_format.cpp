@@ -0,0 +1,369 @@
+#include "model_format.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace xyz {
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// a * b into `result`; false if the product does not fit in 64 bits
+bool multiplyChecked(uint64_t a, uint64_t b, uint64_t& result) {
+    return !__builtin_mul_overflow(a, b, &result);
+}
+
+// Appends little-endian fields to a byte string
+class ByteWriter {
+public:
+    template<typename T>
+    void put(T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void putString(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        buffer.append(value);
+    }
+
+    const std::string& bytes() const { return buffer; }
+
+private:
+    std::string buffer;
+};
+
+// Bounds-checked reader over the metadata section of a mapping
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : cursor(data), end(data + size) {}
+
+    template<typename T>
+    T get() {
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        auto size = get<uint32_t>();
+        require(size);
+        std::string value(reinterpret_cast<const char*>(cursor), size);
+        cursor += size;
+        return value;
+    }
+
+private:
+    void require(size_t bytes) const {
+        if (static_cast<size_t>(end - cursor) < bytes) {
+            throw std::runtime_error("Corrupt model file: metadata truncated");
+        }
+    }
+
+    const uint8_t* cursor;
+    const uint8_t* end;
+};
+
+} // namespace
+
+size_t model_format::tensorTypeSize(TensorType type) {
+    switch (type) {
+        case TensorType::FLOAT32: return sizeof(float);
+        case TensorType::INT32:   return sizeof(int32_t);
+        case TensorType::INT8:    return sizeof(int8_t);
+        case TensorType::FLOAT16:
+        case TensorType::BFLOAT16: return sizeof(uint16_t);
+        default:
+            throw std::runtime_error("Unknown tensor type: " + std::to_string(static_cast<uint32_t>(type)));
+    }
+}
+
+uint64_t TensorInfo::elementCount() const {
+    uint64_t count = 1;
+    for (auto dim : shape) {
+        count *= dim;
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// MappedFile
+// ---------------------------------------------------------------------------
+
+MappedFile::MappedFile(const std::string& path)
+    : base(nullptr)
+    , length(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(err));
+    }
+
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+        ::close(fd);
+        throw std::runtime_error("Model file is empty: " + path);
+    }
+
+    void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path + ": " + std::strerror(err));
+    }
+    base = static_cast<uint8_t*>(addr);
+}
+
+MappedFile::~MappedFile() {
+    if (base) {
+        ::munmap(base, length);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ModelFile
+// ---------------------------------------------------------------------------
+
+std::shared_ptr<ModelFile> ModelFile::open(const std::string& path) {
+    std::shared_ptr<ModelFile> file(new ModelFile());
+    file->path = path;
+    file->mapping = std::make_shared<MappedFile>(path);
+    file->parse();
+    return file;
+}
+
+void ModelFile::parse() {
+    const uint8_t* data = mapping->data();
+    const size_t size = mapping->size();
+
+    if (size < sizeof(model_format::FileHeader)) {
+        throw std::runtime_error("Not a model file: " + path);
+    }
+
+    model_format::FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, model_format::MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a model file: " + path);
+    }
+    if (header.version != model_format::VERSION) {
+        throw std::runtime_error("Unsupported model file version " + std::to_string(header.version) +
+                                 " in " + path);
+    }
+    // Bounds are compared by subtraction so crafted sizes cannot wrap
+    if (header.fileSize != size || header.dataOffset > size || header.dataOffset < sizeof(header) ||
+        header.metadataSize > header.dataOffset - sizeof(header)) {
+        throw std::runtime_error("Corrupt model file: inconsistent header in " + path);
+    }
+
+    ByteReader reader(data + sizeof(header), header.metadataSize);
+
+    config.name = reader.getString();
+    config.version = reader.getString();
+    config.type = static_cast<ModelType>(reader.get<uint32_t>());
+    auto paramCount = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < paramCount; ++i) {
+        auto key = reader.getString();
+        config.parameters[key] = reader.getString();
+    }
+    auto attrCount = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < attrCount; ++i) {
+        auto key = reader.getString();
+        attributes[key] = reader.getString();
+    }
+
+    tensors.reserve(header.tensorCount);
+    for (uint32_t i = 0; i < header.tensorCount; ++i) {
+        TensorInfo info;
+        info.name = reader.getString();
+        info.dtype = static_cast<model_format::TensorType>(reader.get<uint32_t>());
+        auto rank = reader.get<uint32_t>();
+        for (uint32_t d = 0; d < rank; ++d) {
+            info.shape.push_back(reader.get<uint64_t>());
+        }
+        info.rowStride = reader.get<uint64_t>();
+        info.offset = reader.get<uint64_t>();
+        info.byteSize = reader.get<uint64_t>();
+
+        if (info.offset % model_format::BLOB_ALIGNMENT != 0 || info.offset < header.dataOffset ||
+            info.offset > size || info.byteSize > size - info.offset) {
+            throw std::runtime_error("Corrupt model file: tensor " + info.name + " out of bounds");
+        }
+        uint64_t elements = 1;
+        bool fits = true;
+        for (auto dim : info.shape) {
+            fits = fits && multiplyChecked(elements, dim, elements);
+        }
+        const uint64_t rowLength = info.shape.empty() ? 1 : info.shape.back();
+        const uint64_t rows = rowLength == 0 ? 0 : elements / rowLength;
+        const uint64_t stride = info.rowStride ? info.rowStride : rowLength;
+        uint64_t bytes = 0;
+        if (!fits || stride < rowLength || !multiplyChecked(rows, stride, bytes) ||
+            !multiplyChecked(bytes, model_format::tensorTypeSize(info.dtype), bytes) || bytes > info.byteSize) {
+            throw std::runtime_error("Corrupt model file: tensor " + info.name + " size mismatch");
+        }
+
+        tensorIndex[info.name] = tensors.size();
+        tensors.push_back(std::move(info));
+    }
+}
+
+std::string ModelFile::getAttribute(const std::string& key, const std::string& fallback) const {
+    auto it = attributes.find(key);
+    return it != attributes.end() ? it->second : fallback;
+}
+
+const TensorInfo* ModelFile::findTensor(const std::string& name) const {
+    auto it = tensorIndex.find(name);
+    return it != tensorIndex.end() ? &tensors[it->second] : nullptr;
+}
+
+const float* ModelFile::tensorData(const TensorInfo& info) const {
+    if (info.dtype != model_format::TensorType::FLOAT32) {
+        throw std::runtime_error("Tensor " + info.name + " is not float32");
+    }
+    return reinterpret_cast<const float*>(mapping->data() + info.offset);
+}
+
+const int32_t* ModelFile::tensorDataInt(const TensorInfo& info) const {
+    if (info.dtype != model_format::TensorType::INT32) {
+        throw std::runtime_error("Tensor " + info.name + " is not int32");
+    }
+    return reinterpret_cast<const int32_t*>(mapping->data() + info.offset);
+}
+
+const int8_t* ModelFile::tensorDataInt8(const TensorInfo& info) const {
+    if (info.dtype != model_format::TensorType::INT8) {
+        throw std::runtime_error("Tensor " + info.name + " is not int8");
+    }
+    return reinterpret_cast<const int8_t*>(mapping->data() + info.offset);
+}
+
+const uint16_t* ModelFile::tensorDataHalf(const TensorInfo& info) const {
+    if (info.dtype != model_format::TensorType::FLOAT16 && info.dtype != model_format::TensorType::BFLOAT16) {
+        throw std::runtime_error("Tensor " + info.name + " is not float16 or bfloat16");
+    }
+    return reinterpret_cast<const uint16_t*>(mapping->data() + info.offset);
+}
+
+// ---------------------------------------------------------------------------
+// ModelFileWriter
+// ---------------------------------------------------------------------------
+
+void ModelFileWriter::addTensor(const std::string& name, model_format::TensorType dtype,
+                                const std::vector<uint64_t>& shape, const void* data,
+                                uint64_t rowStride) {
+    PendingTensor tensor;
+    tensor.info.name = name;
+    tensor.info.dtype = dtype;
+    tensor.info.shape = shape;
+    tensor.info.rowStride = rowStride;
+
+    const uint64_t rowLength = shape.empty() ? 1 : shape.back();
+    const uint64_t rows = rowLength == 0 ? 0 : tensor.info.elementCount() / rowLength;
+    const uint64_t stride = rowStride ? rowStride : rowLength;
+    tensor.info.byteSize = rows * stride * model_format::tensorTypeSize(dtype);
+    tensor.data = data;
+    pending.push_back(std::move(tensor));
+}
+
+void ModelFileWriter::write(const std::string& path) const {
+    ByteWriter meta;
+    meta.putString(config.name);
+    meta.putString(config.version);
+    meta.put<uint32_t>(static_cast<uint32_t>(config.type));
+    meta.put<uint32_t>(static_cast<uint32_t>(config.parameters.size()));
+    for (const auto& [key, value] : config.parameters) {
+        meta.putString(key);
+        meta.putString(value);
+    }
+    meta.put<uint32_t>(static_cast<uint32_t>(attributes.size()));
+    for (const auto& [key, value] : attributes) {
+        meta.putString(key);
+        meta.putString(value);
+    }
+
+    // The directory size does not depend on offsets, so measure it first
+    size_t directorySize = 0;
+    for (const auto& tensor : pending) {
+        directorySize += sizeof(uint32_t) + tensor.info.name.size() + 2 * sizeof(uint32_t) +
+                         tensor.info.shape.size() * sizeof(uint64_t) + 3 * sizeof(uint64_t);
+    }
+
+    model_format::FileHeader header;
+    std::memcpy(header.magic, model_format::MAGIC, sizeof(header.magic));
+    header.version = model_format::VERSION;
+    header.tensorCount = static_cast<uint32_t>(pending.size());
+    header.metadataSize = meta.bytes().size() + directorySize;
+    header.dataOffset = alignUp(sizeof(header) + header.metadataSize, model_format::BLOB_ALIGNMENT);
+
+    std::vector<uint64_t> offsets;
+    uint64_t cursor = header.dataOffset;
+    for (const auto& tensor : pending) {
+        offsets.push_back(cursor);
+        cursor = alignUp(cursor + tensor.info.byteSize, model_format::BLOB_ALIGNMENT);
+    }
+    header.fileSize = pending.empty() ? header.dataOffset
+                                      : offsets.back() + pending.back().info.byteSize;
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const auto& info = pending[i].info;
+        meta.putString(info.name);
+        meta.put<uint32_t>(static_cast<uint32_t>(info.dtype));
+        meta.put<uint32_t>(static_cast<uint32_t>(info.shape.size()));
+        for (auto dim : info.shape) {
+            meta.put<uint64_t>(dim);
+        }
+        meta.put<uint64_t>(info.rowStride);
+        meta.put<uint64_t>(offsets[i]);
+        meta.put<uint64_t>(info.byteSize);
+    }
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot create " + tmpPath);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(meta.bytes().data(), static_cast<std::streamsize>(meta.bytes().size()));
+
+        uint64_t position = sizeof(header) + meta.bytes().size();
+        const std::string padding(model_format::BLOB_ALIGNMENT, '\0');
+        for (size_t i = 0; i < pending.size(); ++i) {
+            out.write(padding.data(), static_cast<std::streamsize>(offsets[i] - position));
+            out.write(static_cast<const char*>(pending[i].data),
+                      static_cast<std::streamsize>(pending[i].info.byteSize));
+            position = offsets[i] + pending[i].info.byteSize;
+        }
+        if (position < header.dataOffset) {
+            out.write(padding.data(), static_cast<std::streamsize>(header.dataOffset - position));
+        }
+        if (!out) {
+            throw std::runtime_error("Failed writing " + tmpPath);
+        }
+    }
+
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("Cannot rename " + tmpPath + " to " + path);
+    }
+}
+
+} // namespace xyz
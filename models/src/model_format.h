@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "model.h"
+
+namespace xyz {
+
+// Binary model container (".xyzm"), little-endian:
+//
+//   FileHeader                     fixed 40 bytes
+//   metadata                       ModelConfig + engine attributes
+//   tensor directory               one TensorInfo record per tensor
+//   <padding to 4 KiB>
+//   tensor blobs                   each starting on a 4 KiB boundary
+//
+// Readers mmap the whole file, so weight pages are faulted in lazily and
+// shared between processes through the page cache.
+namespace model_format {
+
+constexpr char MAGIC[8] = {'X', 'Y', 'Z', 'M', 'O', 'D', 'E', 'L'};
+constexpr uint32_t VERSION = 1;
+constexpr uint64_t BLOB_ALIGNMENT = 4096;
+
+enum class TensorType : uint32_t {
+    FLOAT32 = 0,
+    INT32 = 1,
+    INT8 = 2,
+    // IEEE half precision and bfloat16, see kernels::HalfType
+    FLOAT16 = 3,
+    BFLOAT16 = 4
+};
+
+size_t tensorTypeSize(TensorType type);
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tensorCount;
+    uint64_t metadataSize;   // bytes of metadata + directory after the header
+    uint64_t dataOffset;     // first blob, BLOB_ALIGNMENT aligned
+    uint64_t fileSize;
+};
+
+} // namespace model_format
+
+struct TensorInfo {
+    std::string name;
+    model_format::TensorType dtype = model_format::TensorType::FLOAT32;
+    std::vector<uint64_t> shape;
+    // Elements between consecutive rows in the blob (0 = densely packed)
+    uint64_t rowStride = 0;
+    uint64_t offset = 0;
+    uint64_t byteSize = 0;
+
+    uint64_t elementCount() const;
+};
+
+// Read-only mapping of a whole file. Pages stay shared with the page cache
+// and are not charged to commit; writing to them faults, so code that
+// mutates borrowed weights detaches them first (AlignedBuffer::detach()).
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    uint8_t* base;
+    size_t length;
+};
+
+// Parsed model file. Opening only reads the header, metadata and tensor
+// directory; tensor contents stay on disk until first touched.
+class ModelFile {
+public:
+    static std::shared_ptr<ModelFile> open(const std::string& path);
+
+    const std::string& getPath() const { return path; }
+    const ModelConfig& getConfig() const { return config; }
+    const std::unordered_map<std::string, std::string>& getAttributes() const { return attributes; }
+    std::string getAttribute(const std::string& key, const std::string& fallback = "") const;
+
+    const std::vector<TensorInfo>& getTensors() const { return tensors; }
+    const TensorInfo* findTensor(const std::string& name) const;
+
+    // Pointer to a tensor blob inside the read-only mapping
+    const float* tensorData(const TensorInfo& info) const;
+    const int32_t* tensorDataInt(const TensorInfo& info) const;
+    const int8_t* tensorDataInt8(const TensorInfo& info) const;
+    // Raw 16-bit values of a float16 or bfloat16 tensor
+    const uint16_t* tensorDataHalf(const TensorInfo& info) const;
+
+    // Keeps the mapping alive for as long as any borrowed tensor is in use
+    std::shared_ptr<const void> keepAlive() const { return mapping; }
+
+private:
+    ModelFile() = default;
+    void parse();
+
+    std::string path;
+    std::shared_ptr<MappedFile> mapping;
+    ModelConfig config;
+    std::unordered_map<std::string, std::string> attributes;
+    std::vector<TensorInfo> tensors;
+    std::unordered_map<std::string, size_t> tensorIndex;
+};
+
+class ModelFileWriter {
+public:
+    void setConfig(const ModelConfig& cfg) { config = cfg; }
+    void setAttribute(const std::string& key, const std::string& value) { attributes[key] = value; }
+
+    // Records a tensor; `data` must stay valid until write() returns.
+    // `rowStride` is the distance in elements between rows (0 = dense).
+    void addTensor(const std::string& name, model_format::TensorType dtype,
+                   const std::vector<uint64_t>& shape, const void* data,
+                   uint64_t rowStride = 0);
+
+    // Writes to a temporary file and renames it over `path`
+    void write(const std::string& path) const;
+
+private:
+    struct PendingTensor {
+        TensorInfo info;
+        const void* data;
+    };
+
+    ModelConfig config;
+    std::unordered_map<std::string, std::string> attributes;
+    std::vector<PendingTensor> pending;
+};
+
+} // namespace xyz
@@ -1,50 +1,185 @@
 #include "model_loader.h"
+#include <algorithm>
 #include <fstream>
+#include <future>
+#include <stdexcept>
+#include <sys/stat.h>
+#include "model_format.h"
+#include "../../utils/constants.h"
 #include "../../utils/logging.h"
+#include "../../utils/thread_pool.h"
 
 namespace xyz {
 
+namespace {
+
+// Memory charged against the budget for a resident model: what it
+// allocated, plus weights it reads straight from its mapped file. Weights
+// shared from another model are charged to that model. Measured whenever
+// the budget is checked, since caches, scratch and training keep
+// allocating after a model is registered.
+size_t residentBytes(const AIModel& model) {
+    const auto metrics = model.getMetrics();
+    const size_t own = metrics.weightMemory + metrics.sharedWeightBytes;
+    const size_t mapped = metrics.weightBytes > own ? metrics.weightBytes - own : 0;
+    return metrics.memoryUsage + mapped;
+}
+
+} // namespace
+
+ModelLoader::ModelLoader()
+    : registry(new Registry())
+    , memoryBudget(static_cast<size_t>(constants::MAX_TOTAL_MEMORY))
+    , useEpoch(0)
+{
+}
+
+ModelLoader::~ModelLoader() {
+    delete registry.load();
+}
+
 std::shared_ptr<AIModel> ModelLoader::loadModel(const std::string& path) {
+    auto model = buildModel(path);
+    if (!model) {
+        return nullptr;
+    }
+
+    // Register model
+    if (!insertModel(model->getModelId(), model, path)) {
+        LOG_ERROR("Failed to register model: " + model->getModelId());
+        return nullptr;
+    }
+
+    LOG_INFO("Successfully loaded model: " + model->getModelId());
+    enforceBudget(model->getModelId());
+    return model;
+}
+
+std::shared_ptr<AIModel> ModelLoader::reloadModel(const std::string& path) {
+    auto model = buildModel(path);
+    if (!model) {
+        return nullptr;
+    }
+
+    publishModel(model->getModelId(), model, path);
+    LOG_INFO("Successfully reloaded model: " + model->getModelId() + " (version " +
+             std::to_string(getModelVersion(model->getModelId())) + ")");
+    enforceBudget(model->getModelId());
+    return model;
+}
+
+std::shared_ptr<AIModel> ModelLoader::buildModel(const std::string& path) {
+    std::string error;
+    return buildModel(path, error);
+}
+
+std::shared_ptr<AIModel> ModelLoader::buildModel(const std::string& path, std::string& error) {
     try {
         if (!validateModelPath(path)) {
-            LOG_ERROR("Invalid model path: " + path);
+            error = "Invalid model path: " + path;
+            LOG_ERROR(error);
             return nullptr;
         }
 
-        // Parse model configuration
-        auto config = parseModelConfig(path);
+        // Map the file and parse its header; weights are paged in on first use
+        auto file = ModelFile::open(path);
+        auto config = parseModelConfig(*file);
         
         // Create new model instance
         auto model = createModel(config.name, config.type);
         if (!model) {
-            LOG_ERROR("Failed to create model instance");
+            error = "Failed to create model instance";
+            LOG_ERROR(error);
             return nullptr;
         }
 
-        // Initialize and load model data
-        if (!model->initialize(config)) {
-            LOG_ERROR("Failed to initialize model: " + config.name);
+        // Attach weights before initializing so initialize() keeps them
+        if (!model->load(*file)) {
+            error = "Failed to load model data: " + config.name;
+            LOG_ERROR(error);
             return nullptr;
         }
 
-        if (!model->load(path)) {
-            LOG_ERROR("Failed to load model data: " + config.name);
+        if (!model->initialize(config)) {
+            error = "Failed to initialize model: " + config.name;
+            LOG_ERROR(error);
             return nullptr;
         }
+        // Shared before the model is published, so instances can be created
+        // without modifying a model other threads may be running
+        model->shareWeights();
+        return model;
+    }
+    catch (const std::exception& e) {
+        error = "Error loading model: " + std::string(e.what());
+        LOG_ERROR(error);
+        return nullptr;
+    }
+}
 
-        // Register model
-        if (!registerModel(config.name, model)) {
-            LOG_ERROR("Failed to register model: " + config.name);
-            return nullptr;
+std::vector<ModelLoader::LoadResult> ModelLoader::loadModels(const std::vector<std::string>& paths) {
+    std::vector<LoadResult> results(paths.size());
+    // Files are independent, so each worker maps, parses and initializes
+    // its own models; nothing is shared until registration
+    utils::ThreadPool::getInstance().parallelFor(paths.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i].path = paths[i];
+            results[i].model = buildModel(paths[i], results[i].error);
         }
+    });
 
-        LOG_INFO("Successfully loaded model: " + config.name);
-        return model;
+    // One registry update for the whole batch; duplicate names keep the
+    // first file
+    std::vector<std::string> registered;
+    updateRegistry([&](Registry& models) {
+        for (auto& result : results) {
+            if (!result.model) {
+                continue;
+            }
+            const std::string& modelId = result.model->getModelId();
+            if (!models.insert({modelId, makeEntry(result.model, 1, result.path)}).second) {
+                result.error = "Model already registered: " + modelId;
+                LOG_ERROR(result.error);
+                result.model.reset();
+                continue;
+            }
+            registered.push_back(modelId);
+        }
+        return !registered.empty();
+    });
+
+    for (const auto& result : results) {
+        if (result.model) {
+            LOG_INFO("Successfully loaded model: " + result.model->getModelId());
+        }
     }
-    catch (const std::exception& e) {
-        LOG_ERROR("Error loading model: " + std::string(e.what()));
+    LOG_INFO("Loaded " + std::to_string(registered.size()) + " of " + std::to_string(paths.size()) + " models");
+    enforceBudget("");
+    return results;
+}
+
+std::shared_ptr<AIModel> ModelLoader::createInstance(const std::string& sourceId, const ModelConfig& config) {
+    auto source = getModel(sourceId);
+    if (!source) {
+        LOG_ERROR("Model not found: " + sourceId);
+        return nullptr;
+    }
+    auto weights = source->getSharedWeights();
+    if (!weights) {
+        LOG_ERROR("Model does not share its weights: " + sourceId);
+        return nullptr;
+    }
+
+    auto model = createModel(config.name, source->getModelType());
+    if (!model || !model->attachWeights(std::move(weights)) || !model->initialize(config)) {
+        LOG_ERROR("Failed to create instance " + config.name + " of model " + sourceId);
+        return nullptr;
+    }
+    if (!insertModel(config.name, model, "")) {
         return nullptr;
     }
+    enforceBudget(config.name);
+    return model;
 }
 
 std::shared_ptr<AIModel> ModelLoader::createModel(const std::string& modelId, ModelType type) {
@@ -64,63 +199,317 @@ bool ModelLoader::registerModel(const std::string& modelId, std::shared_ptr<AIMo
         LOG_ERROR("Cannot register null model");
         return false;
     }
+    if (!insertModel(modelId, model, "")) {
+        return false;
+    }
+    enforceBudget(modelId);
+    return true;
+}
+
+bool ModelLoader::registerModelFile(const std::string& path) {
+    try {
+        if (!validateModelPath(path)) {
+            LOG_ERROR("Invalid model path: " + path);
+            return false;
+        }
+        // Mapping the file only reads the header; weights stay on disk
+        const std::string modelId = parseModelConfig(*ModelFile::open(path)).name;
+        return insertModel(modelId, nullptr, path);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Error registering model file: " + std::string(e.what()));
+        return false;
+    }
+}
 
-    auto [it, success] = models.insert({modelId, model});
+bool ModelLoader::insertModel(const std::string& modelId, std::shared_ptr<AIModel> model, const std::string& path) {
+    const bool resident = model != nullptr;
+    const bool success = updateRegistry([&](Registry& models) {
+        return models.insert({modelId, makeEntry(std::move(model), 1, path)}).second;
+    });
     if (!success) {
         LOG_ERROR("Model already registered: " + modelId);
         return false;
     }
 
-    LOG_INFO("Registered model: " + modelId);
+    LOG_INFO((resident ? "Registered model: " : "Registered model descriptor: ") + modelId);
     return true;
 }
 
 bool ModelLoader::unregisterModel(const std::string& modelId) {
-    auto it = models.find(modelId);
-    if (it == models.end()) {
+    const bool success = updateRegistry([&](Registry& models) {
+        return models.erase(modelId) > 0;
+    });
+    if (!success) {
         LOG_ERROR("Model not found: " + modelId);
         return false;
     }
 
-    models.erase(it);
     LOG_INFO("Unregistered model: " + modelId);
     return true;
 }
 
+std::shared_ptr<AIModel> ModelLoader::swapModel(const std::string& modelId, std::shared_ptr<AIModel> model) {
+    if (!model) {
+        LOG_ERROR("Cannot register null model");
+        return nullptr;
+    }
+    // A swapped-in model no longer matches any file, so it stays resident
+    auto previous = publishModel(modelId, std::move(model), "");
+    enforceBudget(modelId);
+    return previous;
+}
+
+std::shared_ptr<AIModel> ModelLoader::publishModel(const std::string& modelId, std::shared_ptr<AIModel> model,
+                                                   const std::string& path) {
+    std::shared_ptr<AIModel> previous;
+    uint64_t version = 1;
+    updateRegistry([&](Registry& models) {
+        auto it = models.find(modelId);
+        if (it != models.end()) {
+            previous = std::move(it->second.model);
+            version = it->second.version + 1;
+        }
+        models[modelId] = makeEntry(model, version, path);
+        return true;
+    });
+
+    LOG_INFO("Published model: " + modelId + " (version " + std::to_string(version) + ")");
+    return previous;
+}
+
+uint64_t ModelLoader::nextUseStamp() {
+    // The new model gets an epoch of its own: above everything used before
+    // it, below everything used after it
+    return useEpoch.fetch_add(2) + 1;
+}
+
+ModelLoader::ModelEntry ModelLoader::makeEntry(std::shared_ptr<AIModel> model, uint64_t version,
+                                               const std::string& path) {
+    ModelEntry entry;
+    entry.model = std::move(model);
+    entry.version = version;
+    entry.path = path;
+    entry.lastUsed = std::make_shared<std::atomic<uint64_t>>(entry.model ? nextUseStamp() : useEpoch.load());
+    return entry;
+}
+
 std::shared_ptr<AIModel> ModelLoader::getModel(const std::string& modelId) {
-    auto it = models.find(modelId);
-    if (it == models.end()) {
-        LOG_ERROR("Model not found: " + modelId);
+    {
+        utils::rcu::ReadGuard guard;
+        const Registry* models = registry.load();
+        auto it = models->find(modelId);
+        if (it == models->end()) {
+            return nullptr;
+        }
+        const ModelEntry& entry = it->second;
+        if (entry.model) {
+            // Written only when the epoch moved, so hot lookups stay reads
+            const uint64_t now = useEpoch.load(std::memory_order_relaxed);
+            if (entry.lastUsed->load(std::memory_order_relaxed) != now) {
+                entry.lastUsed->store(now, std::memory_order_relaxed);
+            }
+            return entry.model;
+        }
+    }
+    return materialize(modelId);
+}
+
+std::shared_ptr<AIModel> ModelLoader::materialize(const std::string& modelId) {
+    std::promise<void> done;
+    {
+        std::unique_lock<std::mutex> lock(materializeMutex);
+        auto it = loading.find(modelId);
+        if (it != loading.end()) {
+            // Another caller is loading this id; look it up again once it's done
+            std::shared_future<void> pending = it->second;
+            lock.unlock();
+            pending.wait();
+            return getModel(modelId);
+        }
+        loading.emplace(modelId, done.get_future().share());
+    }
+
+    auto finish = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(materializeMutex);
+            loading.erase(modelId);
+        }
+        done.set_value();
+    };
+
+    bool replaced = false;
+    std::shared_ptr<AIModel> model;
+    try {
+        model = loadDescriptor(modelId, replaced);
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+    // The load is no longer in flight, so this finds or loads the new entry
+    return replaced ? getModel(modelId) : model;
+}
+
+std::shared_ptr<AIModel> ModelLoader::loadDescriptor(const std::string& modelId, bool& replaced) {
+    std::string path;
+    uint64_t version = 0;
+    {
+        utils::rcu::ReadGuard guard;
+        const Registry* models = registry.load();
+        auto it = models->find(modelId);
+        if (it == models->end()) {
+            return nullptr;
+        }
+        if (it->second.model) {
+            return it->second.model;
+        }
+        path = it->second.path;
+        version = it->second.version;
+    }
+
+    auto model = buildModel(path);
+    if (!model) {
+        LOG_ERROR("Failed to load model " + modelId + " from " + path);
+        return nullptr;
+    }
+
+    // Publish unless the entry was replaced or removed while loading
+    const bool published = updateRegistry([&](Registry& models) {
+        auto it = models.find(modelId);
+        if (it == models.end() || it->second.version != version || it->second.model) {
+            return false;
+        }
+        it->second.model = model;
+        it->second.lastUsed->store(nextUseStamp());
+        return true;
+    });
+    if (!published) {
+        replaced = true;
         return nullptr;
     }
-    return it->second;
+
+    LOG_INFO("Loaded model on demand: " + modelId);
+    enforceBudget(modelId);
+    return model;
+}
+
+void ModelLoader::enforceBudget(const std::string& keepId) {
+    if (getResidentBytes() <= memoryBudget.load()) {
+        return;
+    }
+
+    std::vector<std::string> evicted;
+    updateRegistry([&](Registry& models) {
+        size_t total = 0;
+        for (const auto& [id, entry] : models) {
+            total += entry.model ? residentBytes(*entry.model) : 0;
+        }
+
+        const size_t budget = memoryBudget.load();
+        while (total > budget) {
+            ModelEntry* victim = nullptr;
+            const std::string* victimId = nullptr;
+            for (auto& [id, entry] : models) {
+                if (entry.model && !entry.path.empty() && id != keepId &&
+                    (!victim || entry.lastUsed->load() < victim->lastUsed->load())) {
+                    victim = &entry;
+                    victimId = &id;
+                }
+            }
+            if (!victim) {
+                break;
+            }
+            // Callers still holding the model keep it alive until they finish
+            total -= residentBytes(*victim->model);
+            victim->model.reset();
+            evicted.push_back(*victimId);
+        }
+        return !evicted.empty();
+    });
+
+    for (const auto& id : evicted) {
+        LOG_INFO("Evicted model to stay within memory budget: " + id);
+    }
 }
 
 std::vector<std::string> ModelLoader::listModels() const {
+    utils::rcu::ReadGuard guard;
+    const Registry* models = registry.load();
     std::vector<std::string> modelIds;
-    modelIds.reserve(models.size());
-    for (const auto& [id, _] : models) {
+    modelIds.reserve(models->size());
+    for (const auto& [id, _] : *models) {
         modelIds.push_back(id);
     }
     return modelIds;
 }
 
+uint64_t ModelLoader::getModelVersion(const std::string& modelId) const {
+    utils::rcu::ReadGuard guard;
+    const Registry* models = registry.load();
+    auto it = models->find(modelId);
+    return it == models->end() ? 0 : it->second.version;
+}
+
+bool ModelLoader::isModelResident(const std::string& modelId) const {
+    utils::rcu::ReadGuard guard;
+    const Registry* models = registry.load();
+    auto it = models->find(modelId);
+    return it != models->end() && it->second.model != nullptr;
+}
+
+size_t ModelLoader::getResidentBytes() const {
+    utils::rcu::ReadGuard guard;
+    size_t total = 0;
+    for (const auto& [id, entry] : *registry.load()) {
+        total += entry.model ? residentBytes(*entry.model) : 0;
+    }
+    return total;
+}
+
+void ModelLoader::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    enforceBudget("");
+}
+
 void ModelLoader::clearModels() {
-    models.clear();
+    updateRegistry([](Registry& models) {
+        models.clear();
+        return true;
+    });
     LOG_INFO("Cleared all models");
 }
 
+bool ModelLoader::updateRegistry(const std::function<bool(Registry&)>& edit) {
+    std::unique_ptr<const Registry> retired;
+    {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        auto next = std::make_unique<Registry>(*registry.load());
+        if (!edit(*next)) {
+            return false;
+        }
+        retired.reset(registry.exchange(next.release()));
+        // Readers that loaded the old snapshot may still be copying a model
+        // out of it
+        utils::rcu::synchronize();
+    }
+    // Models only referenced by the old snapshot are destroyed here
+    return true;
+}
+
 bool ModelLoader::validateModelPath(const std::string& path) {
-    // Simulate path validation
-    return !path.empty();
+    struct stat st;
+    return !path.empty() && ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
 }
 
-ModelConfig ModelLoader::parseModelConfig(const std::string& path) {
-    // Simulate config parsing
-    ModelConfig config;
-    config.name = "model_" + std::to_string(models.size() + 1);
-    config.type = ModelType::NEURAL_NETWORK;
-    config.version = "1.0.0";
+ModelConfig ModelLoader::parseModelConfig(const ModelFile& file) {
+    ModelConfig config = file.getConfig();
+    if (config.name.empty()) {
+        throw std::runtime_error("Model file has no model name: " + file.getPath());
+    }
+    if (static_cast<uint32_t>(config.type) > static_cast<uint32_t>(ModelType::CUSTOM)) {
+        throw std::runtime_error("Model file has unknown model type: " + file.getPath());
+    }
     return config;
 }
 
@@ -1,13 +1,43 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
 #include <memory>
 #include "model.h"
+#include "../../utils/rcu.h"
 
 namespace xyz {
 
+// Registry of loaded models, safe to use from any thread.
+//
+// The id -> model map is an immutable snapshot published through RCU:
+// lookups never block and normally write no shared memory but the returned
+// model's reference count, and every change copies the map, publishes the copy
+// and frees the old snapshot once no reader can still see it. A model
+// replaced by swapModel() stays alive for as long as callers hold the
+// shared_ptr they got from getModel(), so in-flight inferences finish on the
+// version they started with.
+//
+// Models that come from a file can be registered as descriptors and are
+// only loaded on the first getModel(). Once the resident models exceed the
+// memory budget, the least recently used file-backed ones are evicted back
+// to descriptors and reloaded on their next use. Models registered from
+// memory stay resident.
 class ModelLoader {
 public:
+    // Outcome of loading one file with loadModels()
+    struct LoadResult {
+        std::string path;
+        // Null if the file could not be loaded or its name was taken
+        std::shared_ptr<AIModel> model;
+        std::string error;
+
+        bool ok() const { return model != nullptr; }
+    };
+
     static ModelLoader& getInstance() {
         static ModelLoader instance;
         return instance;
@@ -15,30 +45,106 @@ public:
 
     // Model loading functions
     std::shared_ptr<AIModel> loadModel(const std::string& path);
+    // Loads `path` and publishes it under its stored name, replacing any
+    // registered version (see swapModel)
+    std::shared_ptr<AIModel> reloadModel(const std::string& path);
+    // Loads and initializes `paths` in parallel on the shared thread pool,
+    // then registers the successful ones in one registry update. Results
+    // are in the order of `paths`.
+    std::vector<LoadResult> loadModels(const std::vector<std::string>& paths);
     std::shared_ptr<AIModel> createModel(const std::string& modelId, ModelType type);
+    // Registers a model named config.name that runs on the weights of
+    // `sourceId` with its own parameters, scratch buffers and cache. The
+    // source must share its weights, which every model loaded from a file
+    // does (see AIModel::shareWeights). Instances stay resident.
+    std::shared_ptr<AIModel> createInstance(const std::string& sourceId, const ModelConfig& config);
     
     // Model registration
     bool registerModel(const std::string& modelId, std::shared_ptr<AIModel> model);
+    // Registers the model stored at `path` under its stored name without
+    // loading it; only the file header is read
+    bool registerModelFile(const std::string& path);
     bool unregisterModel(const std::string& modelId);
+    // Publishes `model` under `modelId`, registering it if the id is new.
+    // Returns the replaced version, or null if there was none.
+    std::shared_ptr<AIModel> swapModel(const std::string& modelId, std::shared_ptr<AIModel> model);
     
-    // Model management
+    // Model management. getModel() loads descriptors on demand. Unknown ids
+    // return null without logging, so callers probing for optional models
+    // don't contend on the logger.
     std::shared_ptr<AIModel> getModel(const std::string& modelId);
     std::vector<std::string> listModels() const;
+    // Times `modelId` has been published (1 after registerModel, +1 per
+    // swap); 0 for unknown ids
+    uint64_t getModelVersion(const std::string& modelId) const;
+    bool isModelResident(const std::string& modelId) const;
     void clearModels();
 
+    // Budget for the summed memory of resident models, in bytes
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const { return memoryBudget.load(); }
+    size_t getResidentBytes() const;
+
 private:
-    ModelLoader() = default;
-    ~ModelLoader() = default;
+    struct ModelEntry {
+        // Null while only the descriptor is registered
+        std::shared_ptr<AIModel> model;
+        uint64_t version = 0;
+        // Model file the entry can be reloaded from; empty for models
+        // registered from memory, which are never evicted
+        std::string path;
+        // Use epoch of the last getModel(), shared by every snapshot of the
+        // entry so readers can update it in place
+        std::shared_ptr<std::atomic<uint64_t>> lastUsed;
+    };
+    using Registry = std::unordered_map<std::string, ModelEntry>;
+
+    ModelLoader();
+    ~ModelLoader();
     
     ModelLoader(const ModelLoader&) = delete;
     ModelLoader& operator=(const ModelLoader&) = delete;
 
     // Helper functions
     bool validateModelPath(const std::string& path);
-    ModelConfig parseModelConfig(const std::string& path);
-    
-    // Storage for loaded models
-    std::unordered_map<std::string, std::shared_ptr<AIModel>> models;
+    ModelConfig parseModelConfig(const ModelFile& file);
+    // Maps, loads and initializes the model at `path` without registering it
+    std::shared_ptr<AIModel> buildModel(const std::string& path);
+    // Also reports the reason of a failure in `error`
+    std::shared_ptr<AIModel> buildModel(const std::string& path, std::string& error);
+    // Registers a new entry; `model` may be null for a descriptor
+    bool insertModel(const std::string& modelId, std::shared_ptr<AIModel> model, const std::string& path);
+    std::shared_ptr<AIModel> publishModel(const std::string& modelId, std::shared_ptr<AIModel> model,
+                                          const std::string& path);
+    // Loads the descriptor `modelId` unless another thread already has;
+    // callers of an id being loaded wait for that load only
+    std::shared_ptr<AIModel> materialize(const std::string& modelId);
+    // Builds and publishes the descriptor `modelId`. Sets `replaced` when
+    // the entry changed while loading, in which case nothing is published.
+    std::shared_ptr<AIModel> loadDescriptor(const std::string& modelId, bool& replaced);
+    // Evicts least recently used file-backed models other than `keepId`
+    // until the resident ones fit the budget
+    void enforceBudget(const std::string& keepId);
+    // Use stamp of a model that just became resident
+    uint64_t nextUseStamp();
+    ModelEntry makeEntry(std::shared_ptr<AIModel> model, uint64_t version, const std::string& path);
+    // Applies `edit` to a copy of the registry and publishes the copy unless
+    // `edit` returns false
+    bool updateRegistry(const std::function<bool(Registry&)>& edit);
+
+    // Current snapshot; read only inside an RCU read section
+    std::atomic<const Registry*> registry;
+    // Serializes registry updates
+    std::mutex updateMutex;
+    // Guards `loading`
+    std::mutex materializeMutex;
+    // Ids whose descriptor is being loaded, each signalled when its load ends
+    std::unordered_map<std::string, std::shared_future<void>> loading;
+    std::atomic<size_t> memoryBudget;
+    // Advances whenever a model becomes resident; entries used since then
+    // carry the current value, so eviction order is LRU at the granularity
+    // of loads
+    std::atomic<uint64_t> useEpoch;
 };
 
-} // namespace xyz
\ No newline at end of file
+} // namespace xyz
@@ -0,0 +1,228 @@
+#include "model_pipeline.h"
+#include <algorithm>
+#include <cstring>
+#include "model_loader.h"
+#include "../../utils/constants.h"
+#include "../../utils/logging.h"
+
+namespace xyz {
+
+ModelPipeline::ModelPipeline(ModelLoader& modelLoader)
+    : loader(modelLoader)
+    , prepared(false)
+    , inputWidth(0)
+    , resultSize(0)
+    , widest(0)
+{
+}
+
+void ModelPipeline::addStage(const std::string& modelId) {
+    Stage stage;
+    stage.modelId = modelId;
+    stages.push_back(std::move(stage));
+    prepared = false;
+}
+
+void ModelPipeline::addGate(const std::string& modelId, size_t gateOutput, float threshold) {
+    Stage stage;
+    stage.modelId = modelId;
+    stage.gate = true;
+    stage.gateOutput = gateOutput;
+    stage.threshold = threshold;
+    stages.push_back(std::move(stage));
+    prepared = false;
+}
+
+bool ModelPipeline::prepare(size_t inputSize) {
+    prepared = false;
+    if (stages.empty() || inputSize == 0) {
+        LOG_ERROR("Model pipeline needs at least one stage and a positive input size");
+        return false;
+    }
+    if (stages.back().gate) {
+        LOG_ERROR("Last stage of a model pipeline cannot be a gate: " + stages.back().modelId);
+        return false;
+    }
+
+    size_t width = inputSize;
+    resultSize = 0;
+    widest = 0;
+    for (auto& stage : stages) {
+        stage.model = loader.getModel(stage.modelId);
+        if (!stage.model || !stage.model->isInitialized()) {
+            LOG_ERROR("Model pipeline stage is not a loaded, initialized model: " + stage.modelId);
+            return false;
+        }
+        if (!stage.model->acceptsInputSize(width)) {
+            LOG_ERROR("Model pipeline stage " + stage.modelId + " does not take rows of " +
+                      std::to_string(width) + " values");
+            return false;
+        }
+        stage.inputSize = width;
+        stage.outputSize = stage.model->getOutputSize(width);
+        if (stage.gate && stage.gateOutput >= stage.outputSize) {
+            LOG_ERROR("Gate output " + std::to_string(stage.gateOutput) + " out of range for model pipeline stage " +
+                      stage.modelId);
+            return false;
+        }
+        if (stage.gate || &stage == &stages.back()) {
+            resultSize = std::max(resultSize, stage.outputSize);
+        }
+        widest = std::max(widest, stage.outputSize);
+        // Gates pass their input on
+        if (!stage.gate) {
+            width = stage.outputSize;
+        }
+    }
+    // Batches may pack input rows let through by a first gate
+    widest = std::max(widest, inputSize);
+
+    inputWidth = inputSize;
+    rowA.resize(widest);
+    rowB.resize(widest);
+    batchA = AlignedBuffer<float>();
+    batchB = AlignedBuffer<float>();
+    batchRows.assign(static_cast<size_t>(constants::MAX_BATCH_SIZE), 0);
+    prepared = true;
+    LOG_INFO("Model pipeline of " + std::to_string(stages.size()) + " stages prepared for " +
+             std::to_string(inputSize) + " inputs, " + std::to_string(resultSize) + " outputs");
+    return true;
+}
+
+void ModelPipeline::reserveBatch(size_t rows) {
+    // Grows only, so steady-state batches of the same size never allocate
+    if (batchA.size() < rows * widest) {
+        batchA.resize(rows * widest);
+        batchB.resize(rows * widest);
+    }
+}
+
+bool ModelPipeline::run(const float* input, float* output, size_t* stagesRun) {
+    if (!prepared || !input || !output) {
+        LOG_ERROR("Model pipeline run needs prepare() and input and output buffers");
+        return false;
+    }
+
+    const float* current = input;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Stage& stage = stages[i];
+        ++stage.rows;
+        const bool last = i + 1 == stages.size();
+        float* next = last ? output : other(current, rowA, rowB);
+        if (!stage.model->inference(current, stage.inputSize, next, stage.outputSize)) {
+            return false;
+        }
+        if (!stage.gate) {
+            current = next;
+        } else if (!passes(stage, next)) {
+            ++stage.exits;
+            std::copy(next, next + stage.outputSize, output);
+            if (stagesRun) {
+                *stagesRun = i + 1;
+            }
+            return true;
+        }
+    }
+    if (stagesRun) {
+        *stagesRun = stages.size();
+    }
+    return true;
+}
+
+bool ModelPipeline::runBatch(const float* input, size_t rows, float* output, size_t* stagesRun) {
+    if (!prepared || !input || !output || rows == 0) {
+        LOG_ERROR("Model pipeline batch needs prepare(), rows and input and output buffers");
+        return false;
+    }
+    if (rows > static_cast<size_t>(constants::MAX_BATCH_SIZE)) {
+        LOG_ERROR("Batch of " + std::to_string(rows) + " rows exceeds maximum batch size for model pipeline");
+        return false;
+    }
+
+    reserveBatch(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        batchRows[r] = r;
+    }
+    size_t active = rows;
+    // While no gate has stopped a row, the rows still going are all rows in
+    // order
+    bool everyRow = true;
+    const float* current = input;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Stage& stage = stages[i];
+        stage.rows += active;
+        const bool last = i + 1 == stages.size();
+        const size_t width = stage.outputSize;
+        // The last stage writes straight into `output` if its rows line up
+        const bool direct = last && everyRow && width == resultSize;
+        float* next = direct ? output : other(current, batchA, batchB);
+        if (!stage.model->inferenceBatch(current, active, stage.inputSize, next)) {
+            return false;
+        }
+
+        if (last) {
+            for (size_t j = 0; j < active; ++j) {
+                if (!direct) {
+                    std::copy(next + j * width, next + (j + 1) * width, output + batchRows[j] * resultSize);
+                }
+                if (stagesRun) {
+                    stagesRun[batchRows[j]] = stages.size();
+                }
+            }
+            break;
+        }
+        if (!stage.gate) {
+            current = next;
+            continue;
+        }
+
+        // Stopped rows take the gate's output as their result. The rows let
+        // through stay where they are until the first stopped row; from then
+        // on they close up, in place unless they are the caller's input.
+        const size_t rowWidth = stage.inputSize;
+        float* kept = nullptr;
+        size_t keptRows = 0;
+        for (size_t j = 0; j < active; ++j) {
+            const float* score = next + j * width;
+            const float* row = current + j * rowWidth;
+            if (passes(stage, score)) {
+                if (kept && kept + keptRows * rowWidth != row) {
+                    std::memmove(kept + keptRows * rowWidth, row, rowWidth * sizeof(float));
+                }
+                batchRows[keptRows++] = batchRows[j];
+                continue;
+            }
+            if (!kept) {
+                if (current == input) {
+                    kept = other(next, batchA, batchB);
+                    std::memcpy(kept, current, keptRows * rowWidth * sizeof(float));
+                } else {
+                    kept = const_cast<float*>(current);
+                }
+            }
+            ++stage.exits;
+            std::copy(score, score + width, output + batchRows[j] * resultSize);
+            if (stagesRun) {
+                stagesRun[batchRows[j]] = i + 1;
+            }
+        }
+        if (keptRows == 0) {
+            break;
+        }
+        if (kept) {
+            everyRow = false;
+            current = kept;
+        }
+        active = keptRows;
+    }
+    return true;
+}
+
+void ModelPipeline::resetCounters() {
+    for (auto& stage : stages) {
+        stage.rows = 0;
+        stage.exits = 0;
+    }
+}
+
+} // namespace xyz
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+#include "model.h"
+
+namespace xyz {
+
+class ModelLoader;
+
+// Chain of registered models, each fed the output of the one before, e.g. a
+// normalizer, then a tree filter, then a network.
+//
+// Intermediate rows live in two buffers the stages write alternately, so a
+// row flows through the chain without being copied; only the last stage
+// writes into the caller's buffer. Single-row buffers are sized by
+// prepare() and batch buffers grow to the largest batch seen, so steady
+// state calls allocate nothing.
+//
+// A gate stage turns the chain into a cascade. It scores the row without
+// changing it: the next stage gets the gate's input, and only if the gate's
+// output `gateOutput` is at least the gate's threshold. A row stopped by a
+// gate never reaches the later, more expensive stages; its result is the
+// gate's output.
+//
+// A pipeline holds per-call scratch, so each thread needs its own.
+class ModelPipeline {
+public:
+    struct Stage {
+        std::string modelId;
+        bool gate = false;
+        size_t gateOutput = 0;
+        float threshold = 0.0f;
+        // Resolved by prepare()
+        std::shared_ptr<AIModel> model;
+        size_t inputSize = 0;
+        size_t outputSize = 0;
+        // Rows that reached this stage, and rows a gate stopped here
+        uint64_t rows = 0;
+        uint64_t exits = 0;
+    };
+
+    explicit ModelPipeline(ModelLoader& loader);
+
+    void addStage(const std::string& modelId);
+    void addGate(const std::string& modelId, size_t gateOutput, float threshold);
+
+    // Looks up every stage in the loader (loading descriptors on demand),
+    // checks that each accepts the previous stage's output width and sizes
+    // the buffers for rows of `inputSize` floats. Run prepare() again to
+    // pick up models swapped in the loader since.
+    bool prepare(size_t inputSize);
+    bool isPrepared() const { return prepared; }
+    size_t getInputSize() const { return inputWidth; }
+
+    // Widest result a row can have: the last stage's output or that of a
+    // gate that stops it
+    size_t getOutputSize() const { return resultSize; }
+
+    // Runs one row of inputSize floats. `output` must hold getOutputSize()
+    // values; the result fills the first getResultSize(stagesRun) of them.
+    // `stagesRun`, if given, receives how many stages ran.
+    bool run(const float* input, float* output, size_t* stagesRun = nullptr);
+
+    // Runs `rows` (<= constants::MAX_BATCH_SIZE) contiguous rows with one
+    // batch call per stage on the rows still going. Rows a gate lets through
+    // close up in place, or are packed into a buffer if the gate read the
+    // caller's input. Row r's result starts at output + r * getOutputSize();
+    // `stagesRun`, if given, holds `rows` entries.
+    bool runBatch(const float* input, size_t rows, float* output, size_t* stagesRun = nullptr);
+
+    // Width of the result of a row that ran `stagesRun` stages
+    size_t getResultSize(size_t stagesRun) const {
+        return stagesRun == 0 ? 0 : stages[stagesRun - 1].outputSize;
+    }
+
+    const std::vector<Stage>& getStages() const { return stages; }
+    void resetCounters();
+
+private:
+    // True if `row` passes stage `stage`
+    bool passes(const Stage& stage, const float* row) const {
+        return !stage.gate || row[stage.gateOutput] >= stage.threshold;
+    }
+    void reserveBatch(size_t rows);
+    // The ping-pong buffer that `current` (a buffer or the caller's input) is
+    // not
+    static float* other(const float* current, AlignedBuffer<float>& a, AlignedBuffer<float>& b) {
+        return current == a.data() ? b.data() : a.data();
+    }
+
+    ModelLoader& loader;
+    std::vector<Stage> stages;
+    bool prepared;
+    size_t inputWidth;
+    size_t resultSize;
+    // Widest stage output or input row, for the batch buffers
+    size_t widest;
+    // Ping-pong buffers of one row, and of batches rows widest apart
+    AlignedBuffer<float> rowA;
+    AlignedBuffer<float> rowB;
+    AlignedBuffer<float> batchA;
+    AlignedBuffer<float> batchB;
+    // Input row of each row still going in a batch
+    std::vector<size_t> batchRows;
+};
+
+} // namespace xyz
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include "model.h"
+
+namespace xyz {
+
+// Engine parameters shared read-only by any number of AIModel instances.
+//
+// Models never run on the store directly. Each attached model holds views:
+// engines whose weight tensors borrow the store's memory and keep it alive,
+// with kernel bindings and scratch buffers of their own. The store is never
+// modified after it is built; a model that changes its weights copies them
+// first (see AIModel::attachWeights). The network's isInputNormalized() tells
+// attached models that its first layer already includes the input
+// normalization.
+struct ModelWeights {
+    ModelType type = ModelType::CUSTOM;
+    DenseNetwork network;
+    DecisionTree tree;
+    RandomForest forest;
+    SupportVectorMachine svm;
+
+    size_t weightBytes() const {
+        return network.weightBytes() + tree.weightBytes() + forest.weightBytes() + svm.weightBytes();
+    }
+};
+
+} // namespace xyz
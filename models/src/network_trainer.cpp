@@ -0,0 +1,272 @@
+#include "network_trainer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "../../utils/thread_pool.h"
+
+namespace xyz {
+
+namespace {
+
+// Fewest samples worth a worker of their own within a mini-batch
+constexpr size_t MIN_SHARD_ROWS = 8;
+
+// Parameters per chunk of the parallel reduce-and-update pass
+constexpr size_t STEP_GRAIN = 16384;
+
+// d activation / d pre-activation, written in terms of the activation output
+inline float activationGradient(kernels::Activation activation, float output) {
+    switch (activation) {
+        case kernels::Activation::RELU:    return output > 0.0f ? 1.0f : 0.0f;
+        case kernels::Activation::TANH:    return 1.0f - output * output;
+        case kernels::Activation::SIGMOID: return output * (1.0f - output);
+        default:                           return 1.0f;
+    }
+}
+
+} // namespace
+
+Optimizer parseOptimizer(const std::string& name) {
+    if (name.empty() || name == "adam") return Optimizer::ADAM;
+    if (name == "sgd") return Optimizer::SGD;
+    throw std::invalid_argument("Unknown optimizer: " + name);
+}
+
+NetworkTrainer::NetworkTrainer(DenseNetwork& net)
+    : network(net)
+    , kernelTable(&kernels::activeKernels())
+    , parameterTotal(0)
+    , stepCount(0)
+{
+}
+
+void NetworkTrainer::prepare(size_t workerCount) {
+    // Layer buffers may have been replaced since the last call, so the
+    // segment pointers are refreshed every time
+    segments.clear();
+    size_t total = 0;
+    size_t widest = 0;
+    for (auto& layer : network.getLayers()) {
+        segments.push_back({layer.weights.data(), total, layer.outputSize * layer.stride});
+        total += layer.outputSize * layer.stride;
+        segments.push_back({layer.bias.data(), total, layer.outputSize});
+        total += layer.outputSize;
+        widest = std::max({widest, layer.inputSize, layer.outputSize});
+    }
+
+    if (total != parameterTotal) {
+        parameterTotal = total;
+        firstMoment.resize(total);
+        secondMoment.resize(total);
+        workers.clear();
+        stepCount = 0;
+    }
+    if (workers.size() < workerCount) {
+        workers.resize(workerCount);
+    }
+    for (auto& worker : workers) {
+        if (worker.gradients.size() != total) {
+            worker.gradients.resize(total);
+            worker.activations.clear();
+            for (const auto& layer : network.getLayers()) {
+                worker.activations.emplace_back(layer.outputSize);
+            }
+            worker.delta.resize(widest);
+            worker.previousDelta.resize(widest);
+        }
+    }
+}
+
+void NetworkTrainer::backpropagate(Worker& worker, const float* sample) {
+    const auto& layers = network.getLayers();
+    const size_t count = layers.size();
+
+    const float* current = sample;
+    for (size_t l = 0; l < count; ++l) {
+        const DenseLayer& layer = layers[l];
+        float* out = worker.activations[l].data();
+        kernelTable->gemv(layer.weights.data(), layer.stride, layer.bias.data(),
+                          current, out, layer.outputSize, layer.inputSize);
+        kernels::applyActivation(*kernelTable, layer.activation, out, layer.outputSize);
+        current = out;
+    }
+
+    // Output error; softmax with cross-entropy reduces to prediction - target
+    const DenseLayer& last = layers.back();
+    const float* prediction = worker.activations.back().data();
+    const float* target = sample + layers.front().inputSize;
+    float* delta = worker.delta.data();
+    for (size_t r = 0; r < last.outputSize; ++r) {
+        const float error = prediction[r] - target[r];
+        if (last.activation == kernels::Activation::SOFTMAX) {
+            worker.loss -= target[r] * std::log(std::max(prediction[r], 1e-12f));
+            delta[r] = error;
+        } else {
+            worker.loss += 0.5f * error * error;
+            delta[r] = error * activationGradient(last.activation, prediction[r]);
+        }
+    }
+
+    for (size_t l = count; l-- > 0;) {
+        const DenseLayer& layer = layers[l];
+        const float* input = l == 0 ? sample : worker.activations[l - 1].data();
+        float* weightGrad = worker.gradients.data() + segments[2 * l].offset;
+        float* biasGrad = worker.gradients.data() + segments[2 * l + 1].offset;
+
+        for (size_t r = 0; r < layer.outputSize; ++r) {
+            const float d = delta[r];
+            biasGrad[r] += d;
+            if (d == 0.0f) {
+                continue;
+            }
+            float* row = weightGrad + r * layer.stride;
+            for (size_t c = 0; c < layer.inputSize; ++c) {
+                row[c] += d * input[c];
+            }
+        }
+
+        if (l == 0) {
+            break;
+        }
+        // Error of the previous layer: W^T * delta through its activation
+        float* previous = worker.previousDelta.data();
+        std::fill(previous, previous + layer.inputSize, 0.0f);
+        for (size_t r = 0; r < layer.outputSize; ++r) {
+            const float d = delta[r];
+            const float* row = layer.weights.data() + r * layer.stride;
+            for (size_t c = 0; c < layer.inputSize; ++c) {
+                previous[c] += d * row[c];
+            }
+        }
+        const kernels::Activation activation = layers[l - 1].activation;
+        for (size_t c = 0; c < layer.inputSize; ++c) {
+            previous[c] *= activationGradient(activation, input[c]);
+        }
+        worker.delta.swap(worker.previousDelta);
+        delta = worker.delta.data();
+    }
+}
+
+void NetworkTrainer::applyStep(size_t begin, size_t end, size_t batch, const TrainingOptions& options) {
+    const float gradScale = 1.0f / static_cast<float>(batch);
+    // Adam's bias correction folded into the step size
+    const double t = static_cast<double>(stepCount);
+    const float stepSize = options.optimizer == Optimizer::ADAM
+        ? static_cast<float>(options.learningRate * std::sqrt(1.0 - std::pow(options.beta2, t)) /
+                             (1.0 - std::pow(options.beta1, t)))
+        : options.learningRate;
+
+    float* total = workers.front().gradients.data();
+    for (size_t w = 1; w < workers.size(); ++w) {
+        float* shard = workers[w].gradients.data();
+        for (size_t i = begin; i < end; ++i) {
+            total[i] += shard[i];
+            shard[i] = 0.0f;
+        }
+    }
+
+    for (const auto& segment : segments) {
+        const size_t from = std::max(begin, segment.offset);
+        const size_t to = std::min(end, segment.offset + segment.size);
+        if (from >= to) {
+            continue;
+        }
+        const size_t n = to - from;
+        float* values = segment.values + (from - segment.offset);
+        float* g = total + from;
+        if (options.optimizer == Optimizer::ADAM) {
+            float* m = firstMoment.data() + from;
+            float* v = secondMoment.data() + from;
+            for (size_t i = 0; i < n; ++i) {
+                const float grad = g[i] * gradScale;
+                m[i] = options.beta1 * m[i] + (1.0f - options.beta1) * grad;
+                v[i] = options.beta2 * v[i] + (1.0f - options.beta2) * grad * grad;
+                values[i] -= stepSize * m[i] / (std::sqrt(v[i]) + options.epsilon);
+                g[i] = 0.0f;
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                values[i] -= stepSize * g[i] * gradScale;
+                g[i] = 0.0f;
+            }
+        }
+    }
+}
+
+float NetworkTrainer::train(const std::vector<std::vector<float>>& rows, const TrainingOptions& options) {
+    const auto& layers = network.getLayers();
+    if (layers.empty()) {
+        throw std::invalid_argument("Cannot train a network without layers");
+    }
+    if (network.isQuantized()) {
+        throw std::invalid_argument("Cannot train an int8 quantized network");
+    }
+    if (network.isHalfPrecision()) {
+        throw std::invalid_argument("Cannot train a network with half-precision weights");
+    }
+    for (size_t l = 0; l + 1 < layers.size(); ++l) {
+        if (layers[l].activation == kernels::Activation::SOFTMAX) {
+            throw std::invalid_argument("Softmax is only supported on the output layer when training");
+        }
+    }
+    if (options.batchSize == 0 || options.epochs == 0 || !(options.learningRate > 0.0f)) {
+        throw std::invalid_argument("Batch size, epochs and learning rate must be positive");
+    }
+    const size_t width = network.inputSize() + layers.back().outputSize;
+    for (const auto& row : rows) {
+        if (row.size() != width) {
+            throw std::invalid_argument("Training rows need " + std::to_string(width) +
+                                        " values (inputs then targets), got " + std::to_string(row.size()));
+        }
+    }
+    if (rows.empty()) {
+        return 0.0f;
+    }
+
+    auto& pool = utils::ThreadPool::getInstance();
+    const size_t batch = std::min(options.batchSize, rows.size());
+    const size_t workerCount = std::max<size_t>(1, std::min(pool.concurrency(), batch / MIN_SHARD_ROWS));
+    kernelTable = &kernels::getKernels(network.getSimdLevel());
+    prepare(workerCount);
+    if (stepCount == 0) {
+        rng.seed(options.seed);
+    }
+
+    order.resize(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    float epochLoss = 0.0f;
+    for (size_t epoch = 0; epoch < options.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), rng);
+        double lossSum = 0.0;
+
+        for (size_t start = 0; start < rows.size(); start += batch) {
+            const size_t count = std::min(batch, rows.size() - start);
+            const size_t shards = std::min(workerCount, count);
+            pool.parallelFor(shards, 1, [&](size_t first, size_t last) {
+                for (size_t s = first; s < last; ++s) {
+                    Worker& worker = workers[s];
+                    worker.loss = 0.0f;
+                    const size_t begin = start + s * count / shards;
+                    const size_t end = start + (s + 1) * count / shards;
+                    for (size_t i = begin; i < end; ++i) {
+                        backpropagate(worker, rows[order[i]].data());
+                    }
+                }
+            });
+            for (size_t s = 0; s < shards; ++s) {
+                lossSum += workers[s].loss;
+            }
+
+            ++stepCount;
+            pool.parallelFor(parameterTotal, STEP_GRAIN, [&](size_t first, size_t last) {
+                applyStep(first, last, count, options);
+            });
+        }
+        epochLoss = static_cast<float>(lossSum / static_cast<double>(rows.size()));
+    }
+    return epochLoss;
+}
+
+} // namespace xyz
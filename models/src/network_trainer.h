@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+#include "dense_network.h"
+
+namespace xyz {
+
+enum class Optimizer {
+    SGD,
+    ADAM
+};
+
+Optimizer parseOptimizer(const std::string& name);
+
+struct TrainingOptions {
+    Optimizer optimizer = Optimizer::ADAM;
+    float learningRate = 0.001f;
+    size_t batchSize = 32;
+    size_t epochs = 1;
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    uint32_t seed = 42;
+};
+
+// Data-parallel mini-batch training of a float DenseNetwork.
+//
+// Each mini-batch is split into one shard per worker of the shared thread
+// pool. Workers back-propagate their shard sample by sample into their own
+// flat gradient buffer; the buffers are then summed and the optimizer step
+// applied over disjoint parameter ranges. All buffers, including the Adam
+// moments, are allocated once and reused across steps and calls.
+//
+// Loss is half the squared error, or cross-entropy when the output layer is
+// softmax.
+class NetworkTrainer {
+public:
+    explicit NetworkTrainer(DenseNetwork& network);
+
+    // Trains on `rows`, each holding the network inputs followed by the
+    // target outputs. Returns the mean per-sample loss of the last epoch.
+    float train(const std::vector<std::vector<float>>& rows, const TrainingOptions& options);
+
+    // Optimizer steps taken so far (drives Adam's bias correction)
+    uint64_t getStepCount() const { return stepCount; }
+
+private:
+    // One contiguous run of parameters inside the flat gradient layout
+    struct Segment {
+        float* values;
+        size_t offset;
+        size_t size;
+    };
+
+    struct Worker {
+        AlignedBuffer<float> gradients;
+        // Layer outputs of the current sample, one buffer per layer
+        std::vector<AlignedBuffer<float>> activations;
+        AlignedBuffer<float> delta;
+        AlignedBuffer<float> previousDelta;
+        float loss = 0.0f;
+    };
+
+    void prepare(size_t workerCount);
+    void backpropagate(Worker& worker, const float* sample);
+    void applyStep(size_t begin, size_t end, size_t batch, const TrainingOptions& options);
+
+    DenseNetwork& network;
+    const kernels::KernelTable* kernelTable;
+    std::vector<Segment> segments;
+    size_t parameterTotal;
+    std::vector<Worker> workers;
+    AlignedBuffer<float> firstMoment;
+    AlignedBuffer<float> secondMoment;
+    std::vector<size_t> order;
+    std::mt19937 rng;
+    uint64_t stepCount;
+};
+
+} // namespace xyz
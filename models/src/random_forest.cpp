@@ -0,0 +1,335 @@
+#include "random_forest.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "kernels.h"
+#include "model_format.h"
+#include "simd_target.h"
+#include "../../utils/thread_pool.h"
+
+namespace xyz {
+
+namespace {
+
+// Trees walked side by side for a single row
+constexpr size_t TREE_GROUP = 8;
+
+// Rows per block in predictBatch. The block's leaf indices stay on the stack
+// and its rows stay in L1 while every tree is applied to it.
+constexpr size_t ROW_BLOCK = 64;
+
+// Tree evaluations (rows x trees) below which a batch runs on the calling
+// thread; smaller batches finish before the pool could pick them up
+constexpr size_t PARALLEL_MIN_WORK = 1 << 14;
+
+void walkTreesScalar(const TreeArrays& arena, const int32_t* roots, const uint32_t* groupDepths,
+                     size_t trees, const float* x, int32_t* leaves) {
+    for (size_t base = 0; base < trees; base += TREE_GROUP) {
+        const size_t count = std::min(TREE_GROUP, trees - base);
+        int32_t node[TREE_GROUP];
+        std::memcpy(node, roots + base, count * sizeof(int32_t));
+        for (uint32_t d = 0; d < groupDepths[base / TREE_GROUP]; ++d) {
+            for (size_t j = 0; j < count; ++j) {
+                const int32_t n = node[j];
+                node[j] = arena.child[n] + (x[arena.feature[n]] > arena.threshold[n]);
+            }
+        }
+        std::memcpy(leaves + base, node, count * sizeof(int32_t));
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+// One row through eight trees per vector; same step as the batch kernel, but
+// the lanes hold different trees rather than different rows
+XYZ_TARGET_AVX2 void walkTreesAvx2(const TreeArrays& arena, const int32_t* roots,
+                                   const uint32_t* groupDepths, size_t trees,
+                                   const float* x, int32_t* leaves) {
+    size_t base = 0;
+    for (; base + TREE_GROUP <= trees; base += TREE_GROUP) {
+        __m256i node = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(roots + base));
+        for (uint32_t d = 0; d < groupDepths[base / TREE_GROUP]; ++d) {
+            __m256i f = _mm256_i32gather_epi32(arena.feature, node, 4);
+            __m256 t = _mm256_i32gather_ps(arena.threshold, node, 4);
+            __m256i c = _mm256_i32gather_epi32(arena.child, node, 4);
+            __m256 v = _mm256_i32gather_ps(x, f, 4);
+            __m256i goRight = _mm256_castps_si256(_mm256_cmp_ps(v, t, _CMP_GT_OQ));
+            node = _mm256_sub_epi32(c, goRight);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves + base), node);
+    }
+    if (base < trees) {
+        walkTreesScalar(arena, roots + base, groupDepths + base / TREE_GROUP,
+                        trees - base, x, leaves + base);
+    }
+}
+#endif
+
+// Leaf reached in each of `trees` trees by the single row `x`
+void walkTrees(const TreeArrays& arena, const int32_t* roots, const uint32_t* groupDepths,
+               size_t trees, const float* x, int32_t* leaves) {
+#ifdef XYZ_X86_KERNELS
+    static const bool useAvx2 = kernels::detectSimdLevel() != kernels::SimdLevel::SCALAR;
+    if (useAvx2) {
+        walkTreesAvx2(arena, roots, groupDepths, trees, x, leaves);
+        return;
+    }
+#endif
+    walkTreesScalar(arena, roots, groupDepths, trees, x, leaves);
+}
+
+} // namespace
+
+RandomForest::RandomForest()
+    : treeCount(0)
+    , nodeCount(0)
+    , outputs(0)
+    , features(0)
+{
+}
+
+void RandomForest::build(const std::vector<DecisionTree>& trees) {
+    if (trees.empty()) {
+        throw std::invalid_argument("Random forest needs at least one tree");
+    }
+
+    size_t totalNodes = 0;
+    const size_t outputCount = trees.front().outputSize();
+    for (const auto& tree : trees) {
+        if (tree.empty() || tree.outputSize() != outputCount) {
+            throw std::invalid_argument("Random forest trees must be non-empty with matching outputs");
+        }
+        totalNodes += tree.getNodeCount();
+    }
+    if (totalNodes > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        throw std::invalid_argument("Random forest has too many nodes");
+    }
+
+    treeCount = trees.size();
+    nodeCount = totalNodes;
+    outputs = outputCount;
+    feature.resize(nodeCount);
+    threshold.resize(nodeCount);
+    child.resize(nodeCount);
+    value.resize(nodeCount * outputs);
+    roots.resize(treeCount);
+    depths.resize(treeCount);
+
+    const float scale = 1.0f / static_cast<float>(treeCount);
+    size_t offset = 0;
+    for (size_t t = 0; t < treeCount; ++t) {
+        const DecisionTree& tree = trees[t];
+        const TreeArrays src = tree.arrays();
+        const size_t count = tree.getNodeCount();
+        const int32_t base = static_cast<int32_t>(offset);
+        for (size_t i = 0; i < count; ++i) {
+            feature[offset + i] = src.feature[i];
+            threshold[offset + i] = src.threshold[i];
+            child[offset + i] = src.child[i] + base;
+        }
+        const float* leaves = tree.leafValue(0);
+        for (size_t i = 0; i < count * outputs; ++i) {
+            value[offset * outputs + i] = leaves[i] * scale;
+        }
+        roots[t] = base;
+        depths[t] = static_cast<int32_t>(tree.getDepth());
+        offset += count;
+    }
+    updateShape();
+}
+
+void RandomForest::updateShape() {
+    features = 0;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        if (child[i] != static_cast<int32_t>(i)) {
+            features = std::max(features, static_cast<size_t>(feature[i]) + 1);
+        }
+    }
+
+    groupDepths.assign((treeCount + TREE_GROUP - 1) / TREE_GROUP, 0);
+    for (size_t t = 0; t < treeCount; ++t) {
+        auto& group = groupDepths[t / TREE_GROUP];
+        group = std::max(group, static_cast<uint32_t>(depths[t]));
+    }
+}
+
+RandomForest RandomForest::view(const std::shared_ptr<const void>& keepAlive) const {
+    RandomForest result;
+    result.treeCount = treeCount;
+    result.nodeCount = nodeCount;
+    result.outputs = outputs;
+    result.features = features;
+    result.feature = feature.view(keepAlive);
+    result.threshold = threshold.view(keepAlive);
+    result.child = child.view(keepAlive);
+    result.value = value.view(keepAlive);
+    result.roots = roots.view(keepAlive);
+    result.depths = depths.view(keepAlive);
+    result.groupDepths = groupDepths;
+    return result;
+}
+
+void RandomForest::detachWeights() {
+    feature.detach();
+    threshold.detach();
+    child.detach();
+    value.detach();
+    roots.detach();
+    depths.detach();
+}
+
+void RandomForest::predict(const float* x, float* output) const {
+    std::fill(output, output + outputs, 0.0f);
+    int32_t leaves[ROW_BLOCK];
+    for (size_t base = 0; base < treeCount; base += ROW_BLOCK) {
+        const size_t count = std::min(ROW_BLOCK, treeCount - base);
+        walkTrees(arrays(), roots.data() + base, groupDepths.data() + base / TREE_GROUP,
+                  count, x, leaves);
+        for (size_t j = 0; j < count; ++j) {
+            const float* leaf = leafValue(leaves[j]);
+            for (size_t k = 0; k < outputs; ++k) {
+                output[k] += leaf[k];
+            }
+        }
+    }
+}
+
+void RandomForest::accumulate(const float* x, size_t rows, size_t stride,
+                              size_t firstTree, size_t lastTree, float* output) const {
+    int32_t leaves[ROW_BLOCK];
+    for (size_t base = 0; base < rows; base += ROW_BLOCK) {
+        const size_t count = std::min(ROW_BLOCK, rows - base);
+        float* block = output + base * outputs;
+        for (size_t t = firstTree; t < lastTree; ++t) {
+            tree_kernels::traverseBatch(arrays(), roots[t], static_cast<uint32_t>(depths[t]),
+                                        x + base * stride, count, stride, leaves);
+            for (size_t j = 0; j < count; ++j) {
+                const float* leaf = leafValue(leaves[j]);
+                float* out = block + j * outputs;
+                for (size_t k = 0; k < outputs; ++k) {
+                    out[k] += leaf[k];
+                }
+            }
+        }
+    }
+}
+
+void RandomForest::predictBatch(const float* x, size_t rows, size_t stride, float* output) const {
+    std::fill(output, output + rows * outputs, 0.0f);
+
+    auto& pool = utils::ThreadPool::getInstance();
+    if (rows * treeCount < PARALLEL_MIN_WORK || pool.concurrency() == 1) {
+        accumulate(x, rows, stride, 0, treeCount, output);
+        return;
+    }
+
+    // Enough rows: every worker owns whole row blocks and writes its own
+    // slice of the output
+    const size_t blocks = (rows + ROW_BLOCK - 1) / ROW_BLOCK;
+    if (blocks >= pool.concurrency()) {
+        pool.parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+            const size_t first = begin * ROW_BLOCK;
+            const size_t last = std::min(rows, end * ROW_BLOCK);
+            accumulate(x + first * stride, last - first, stride, 0, treeCount, output + first * outputs);
+        });
+        return;
+    }
+
+    // Few rows, many trees: split the trees into one range per thread and sum
+    // each range into its own partial. The partials are added in range order
+    // so the result does not depend on which worker finishes first; the first
+    // range sums straight into the output.
+    const size_t groups = (treeCount + TREE_GROUP - 1) / TREE_GROUP;
+    const size_t parts = std::min(groups, pool.concurrency());
+    const size_t perPart = (groups + parts - 1) / parts * TREE_GROUP;
+    const size_t width = rows * outputs;
+    std::vector<float> partials((parts - 1) * width, 0.0f);
+    pool.parallelFor(parts, 1, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            const size_t first = std::min(treeCount, p * perPart);
+            const size_t last = std::min(treeCount, first + perPart);
+            accumulate(x, rows, stride, first, last, p == 0 ? output : partials.data() + (p - 1) * width);
+        }
+    });
+    for (size_t p = 1; p < parts; ++p) {
+        const float* partial = partials.data() + (p - 1) * width;
+        for (size_t i = 0; i < width; ++i) {
+            output[i] += partial[i];
+        }
+    }
+}
+
+void RandomForest::save(ModelFileWriter& writer, const std::string& prefix) const {
+    writer.setAttribute(prefix + ".trees", std::to_string(treeCount));
+    writer.setAttribute(prefix + ".outputs", std::to_string(outputs));
+    writer.addTensor(prefix + ".feature", model_format::TensorType::INT32, {nodeCount}, feature.data());
+    writer.addTensor(prefix + ".threshold", model_format::TensorType::FLOAT32, {nodeCount}, threshold.data());
+    writer.addTensor(prefix + ".child", model_format::TensorType::INT32, {nodeCount}, child.data());
+    writer.addTensor(prefix + ".value", model_format::TensorType::FLOAT32, {nodeCount, outputs}, value.data());
+    writer.addTensor(prefix + ".roots", model_format::TensorType::INT32, {treeCount}, roots.data());
+    writer.addTensor(prefix + ".depths", model_format::TensorType::INT32, {treeCount}, depths.data());
+}
+
+void RandomForest::load(const ModelFile& file, const std::string& prefix) {
+    const TensorInfo* f = file.findTensor(prefix + ".feature");
+    const TensorInfo* t = file.findTensor(prefix + ".threshold");
+    const TensorInfo* c = file.findTensor(prefix + ".child");
+    const TensorInfo* v = file.findTensor(prefix + ".value");
+    const TensorInfo* r = file.findTensor(prefix + ".roots");
+    const TensorInfo* d = file.findTensor(prefix + ".depths");
+    if (!f || !t || !c || !v || !r || !d) {
+        throw std::runtime_error("Missing tensors for random forest " + prefix);
+    }
+
+    const size_t count = f->elementCount();
+    const size_t trees = r->elementCount();
+    const size_t outputCount = std::stoul(file.getAttribute(prefix + ".outputs", "0"));
+    if (count == 0 || trees == 0 || outputCount == 0 ||
+        count > static_cast<size_t>(std::numeric_limits<int32_t>::max()) ||
+        t->elementCount() != count || c->elementCount() != count ||
+        v->elementCount() != count * outputCount || d->elementCount() != trees) {
+        throw std::runtime_error("Malformed random forest " + prefix);
+    }
+
+    // Roots and children must stay inside the arena or traversal would run
+    // off it, and leaves must be stored as build() copies them (feature 0,
+    // +inf threshold) since the walks keep reading them. Each tree takes
+    // exactly its stored depth of steps, so that must match its nodes.
+    const int32_t* childData = file.tensorDataInt(*c);
+    const int32_t* featureData = file.tensorDataInt(*f);
+    const float* thresholdData = file.tensorData(*t);
+    const int32_t* rootData = file.tensorDataInt(*r);
+    const int32_t* depthData = file.tensorDataInt(*d);
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t next = childData[i];
+        const bool leaf = next == static_cast<int32_t>(i);
+        if (featureData[i] < 0 || next < 0 || (!leaf && static_cast<size_t>(next) + 1 >= count) ||
+            (leaf && (featureData[i] != 0 || thresholdData[i] != std::numeric_limits<float>::infinity()))) {
+            throw std::runtime_error("Corrupt node " + std::to_string(i) + " in random forest " + prefix);
+        }
+    }
+    const TreeArrays nodes = {featureData, thresholdData, childData};
+    std::vector<bool> visited(count, false);
+    for (size_t i = 0; i < trees; ++i) {
+        uint32_t measured = 0;
+        if (rootData[i] < 0 || static_cast<size_t>(rootData[i]) >= count ||
+            !tree_kernels::measureDepth(nodes, rootData[i], visited, measured) ||
+            depthData[i] < 0 || static_cast<uint32_t>(depthData[i]) != measured) {
+            throw std::runtime_error("Corrupt tree " + std::to_string(i) + " in random forest " + prefix);
+        }
+    }
+
+    auto owner = file.keepAlive();
+    feature = AlignedBuffer<int32_t>::borrow(featureData, count, owner);
+    child = AlignedBuffer<int32_t>::borrow(childData, count, owner);
+    threshold = AlignedBuffer<float>::borrow(thresholdData, count, owner);
+    value = AlignedBuffer<float>::borrow(file.tensorData(*v), count * outputCount, owner);
+    roots = AlignedBuffer<int32_t>::borrow(rootData, trees, owner);
+    depths = AlignedBuffer<int32_t>::borrow(depthData, trees, owner);
+    treeCount = trees;
+    nodeCount = count;
+    outputs = outputCount;
+    updateShape();
+}
+
+} // namespace xyz
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+#include "decision_tree.h"
+
+namespace xyz {
+
+class ModelFile;
+class ModelFileWriter;
+
+// Ensemble of decision trees packed into a single node arena.
+//
+// Every tree keeps the DecisionTree layout, but its nodes are appended to
+// shared feature/threshold/child/value arrays with child offsets made
+// absolute, so traversal runs the same kernels starting from roots[t].
+// Leaf values are stored pre-divided by the tree count: the prediction is
+// the mean over trees and evaluation only has to sum.
+class RandomForest {
+public:
+    RandomForest();
+
+    // Packs `trees`, which must all have the same output size
+    void build(const std::vector<DecisionTree>& trees);
+
+    // Forest whose arena borrows this forest's memory and keeps `keepAlive`
+    // alive
+    RandomForest view(const std::shared_ptr<const void>& keepAlive) const;
+    // Copies the borrowed arena into memory of its own
+    void detachWeights();
+
+    void predict(const float* x, float* output) const;
+    // Large batches are split across the shared thread pool, by rows when
+    // there are enough of them and by trees otherwise
+    void predictBatch(const float* x, size_t rows, size_t stride, float* output) const;
+
+    bool empty() const { return treeCount == 0; }
+    size_t getTreeCount() const { return treeCount; }
+    size_t getNodeCount() const { return nodeCount; }
+    size_t outputSize() const { return outputs; }
+    // Minimum input width: one past the highest feature index used
+    size_t featureCount() const { return features; }
+    size_t weightBytes() const {
+        return feature.bytes() + threshold.bytes() + child.bytes() + value.bytes() +
+               roots.bytes() + depths.bytes();
+    }
+
+    // Model file tensors "<prefix>.feature|threshold|child|value|roots|depths"
+    void save(ModelFileWriter& writer, const std::string& prefix) const;
+    void load(const ModelFile& file, const std::string& prefix);
+
+private:
+    TreeArrays arrays() const { return {feature.data(), threshold.data(), child.data()}; }
+    const float* leafValue(int32_t node) const { return value.data() + static_cast<size_t>(node) * outputs; }
+
+    // Adds the contributions of trees [firstTree, lastTree) for `rows` rows
+    // to `output`
+    void accumulate(const float* x, size_t rows, size_t stride,
+                    size_t firstTree, size_t lastTree, float* output) const;
+    void updateShape();
+
+    size_t treeCount;
+    size_t nodeCount;
+    size_t outputs;
+    size_t features;
+    AlignedBuffer<int32_t> feature;
+    AlignedBuffer<float> threshold;
+    AlignedBuffer<int32_t> child;
+    AlignedBuffer<float> value;
+    AlignedBuffer<int32_t> roots;
+    AlignedBuffer<int32_t> depths;
+    // Deepest tree in each group of eight trees walked together by
+    // predict(); shallower trees idle on their leaves for the extra steps
+    std::vector<uint32_t> groupDepths;
+};
+
+} // namespace xyz
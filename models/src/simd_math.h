@@ -0,0 +1,121 @@
+#pragma once
+
+// Vectorized math shared by the kernel sources. Include only from
+// translation units that dispatch on kernels::detectSimdLevel().
+
+#include <algorithm>
+#include <cmath>
+#include "kernels.h"
+#include "simd_target.h"
+
+namespace xyz {
+namespace kernels {
+
+// Clamp range shared by the exp-based activations; exp overflows past this
+constexpr float EXP_HI = 88.3762626647949f;
+constexpr float EXP_LO = -88.3762626647949f;
+
+// Activation applied to one value, for scalar kernel epilogues
+template<Activation Act>
+inline float activateScalar(float v) {
+    if constexpr (Act == Activation::RELU) {
+        return v > 0.0f ? v : 0.0f;
+    } else if constexpr (Act == Activation::TANH) {
+        return std::tanh(v);
+    } else {
+        return v;
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+
+// Cephes-style exp, accurate to ~1 ulp over the clamped range
+XYZ_TARGET_AVX2 inline __m256 exp256(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 fx = _mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f));
+    fx = _mm256_floor_ps(fx);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    __m256i n = _mm256_cvttps_epi32(fx);
+    n = _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+}
+
+// tanh(x) = 1 - 2 / (exp(2x) + 1)
+XYZ_TARGET_AVX2 inline __m256 tanh256(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = exp256(_mm256_add_ps(x, x));
+    return _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+}
+
+XYZ_TARGET_AVX2 inline __m256 sigmoid256(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = exp256(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+template<Activation Act>
+XYZ_TARGET_AVX2 inline __m256 activate256(__m256 v) {
+    if constexpr (Act == Activation::RELU) {
+        return _mm256_max_ps(v, _mm256_setzero_ps());
+    } else if constexpr (Act == Activation::TANH) {
+        return tanh256(v);
+    } else {
+        return v;
+    }
+}
+
+XYZ_TARGET_AVX512 inline __m512 exp512(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+    __m512 fx = _mm512_fmadd_ps(x, _mm512_set1_ps(1.44269504088896341f), _mm512_set1_ps(0.5f));
+    fx = _mm512_roundscale_ps(fx, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(0.693359375f), x);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(-2.12194440e-4f), x);
+
+    __m512 y = _mm512_set1_ps(1.9875691500e-4f);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.3981999507e-3f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(8.3334519073e-3f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(4.1665795894e-2f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.6666665459e-1f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(5.0000001201e-1f));
+    y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+    return _mm512_scalef_ps(y, fx);
+}
+
+XYZ_TARGET_AVX512 inline __m512 tanh512(__m512 x) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 e = exp512(_mm512_add_ps(x, x));
+    return _mm512_sub_ps(one, _mm512_div_ps(_mm512_set1_ps(2.0f), _mm512_add_ps(e, one)));
+}
+
+XYZ_TARGET_AVX512 inline __m512 sigmoid512(__m512 x) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 e = exp512(_mm512_sub_ps(_mm512_setzero_ps(), x));
+    return _mm512_div_ps(one, _mm512_add_ps(one, e));
+}
+
+template<Activation Act>
+XYZ_TARGET_AVX512 inline __m512 activate512(__m512 v) {
+    if constexpr (Act == Activation::RELU) {
+        return _mm512_max_ps(v, _mm512_setzero_ps());
+    } else if constexpr (Act == Activation::TANH) {
+        return tanh512(v);
+    } else {
+        return v;
+    }
+}
+
+#endif // XYZ_X86_KERNELS
+
+} // namespace kernels
+} // namespace xyz
@@ -0,0 +1,23 @@
+#pragma once
+
+// Per-function instruction set targeting for runtime-dispatched kernels.
+// Functions tagged with these attributes may only be called after checking
+// kernels::detectSimdLevel().
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define XYZ_X86_KERNELS 1
+// GCC 12 reports -W[maybe-]uninitialized inside the AVX-512 intrinsic headers
+// (their _mm512_undefined_* placeholders) once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#define XYZ_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define XYZ_TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#define XYZ_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define XYZ_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni,avx2,fma")))
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace xyz {
+
+// Non-owning sparse feature vector: `nnz` (index, value) pairs out of
+// `dimension` features, all others zero. Indices must be strictly
+// increasing and below `dimension`.
+struct SparseVector {
+    const uint32_t* indices = nullptr;
+    const float* values = nullptr;
+    size_t nnz = 0;
+    size_t dimension = 0;
+
+    // O(nnz) check of the ordering and bounds above
+    bool valid() const {
+        if (nnz > 0 && (!indices || !values)) {
+            return false;
+        }
+        for (size_t k = 0; k < nnz; ++k) {
+            if (indices[k] >= dimension || (k > 0 && indices[k] <= indices[k - 1])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Number of leading entries with an index below `width`
+    size_t countBelow(size_t width) const {
+        return static_cast<size_t>(std::lower_bound(indices, indices + nnz, width) - indices);
+    }
+};
+
+// Non-owning batch in CSR form: row i holds entries
+// [rowOffsets[i], rowOffsets[i + 1]) of `indices` and `values`, so
+// `rowOffsets` has rows + 1 entries
+struct SparseBatch {
+    const size_t* rowOffsets = nullptr;
+    const uint32_t* indices = nullptr;
+    const float* values = nullptr;
+    size_t rows = 0;
+    size_t dimension = 0;
+
+    SparseVector row(size_t i) const {
+        const size_t begin = rowOffsets[i];
+        return {indices + begin, values + begin, rowOffsets[i + 1] - begin, dimension};
+    }
+
+    bool valid() const {
+        if (!rowOffsets) {
+            return false;
+        }
+        for (size_t i = 0; i < rows; ++i) {
+            if (rowOffsets[i + 1] < rowOffsets[i] || !row(i).valid()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Writes the entries of `x` with an index below `width` into `dense`, which
+// must be all zero there; clearSparse() zeroes them again. Together they
+// let engines that read features by index (trees) take a sparse row in
+// O(nnz) however wide the row is.
+inline void scatterSparse(const SparseVector& x, size_t width, float* dense) {
+    const size_t count = x.countBelow(width);
+    for (size_t k = 0; k < count; ++k) {
+        dense[x.indices[k]] = x.values[k];
+    }
+}
+
+inline void clearSparse(const SparseVector& x, size_t width, float* dense) {
+    const size_t count = x.countBelow(width);
+    for (size_t k = 0; k < count; ++k) {
+        dense[x.indices[k]] = 0.0f;
+    }
+}
+
+} // namespace xyz
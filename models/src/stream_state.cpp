@@ -0,0 +1,126 @@
+#include "stream_state.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace xyz {
+
+StreamFeature parseStreamFeature(const std::string& name) {
+    if (name == "value") return StreamFeature::VALUE;
+    if (name == "mean") return StreamFeature::MEAN;
+    if (name == "std" || name == "stddev") return StreamFeature::STDDEV;
+    if (name == "ema") return StreamFeature::EMA;
+    throw std::invalid_argument("Unknown stream feature: " + name);
+}
+
+std::string streamFeatureName(StreamFeature feature) {
+    switch (feature) {
+        case StreamFeature::VALUE:  return "value";
+        case StreamFeature::MEAN:   return "mean";
+        case StreamFeature::STDDEV: return "std";
+        case StreamFeature::EMA:    return "ema";
+        default:                    return "unknown";
+    }
+}
+
+StreamState::StreamState(const StreamConfig& streamConfig, size_t channels)
+    : config(streamConfig)
+    , channelCount(channels)
+    , ring(streamConfig.window * channels)
+    , head(0)
+    , filled(0)
+    , seen(0)
+    , untilRefresh(streamConfig.window)
+    , sum(channels)
+    , sumSquares(channels)
+    , ema(channels)
+    , row(streamConfig.features.size() * channels + streamConfig.hidden)
+{
+    if (channels == 0 || config.window == 0 || config.emaAlpha <= 0.0f || config.emaAlpha > 1.0f) {
+        throw std::invalid_argument("Stream needs channels, a window and an EMA alpha in (0, 1]");
+    }
+    if (row.empty()) {
+        throw std::invalid_argument("Stream needs features or hidden values");
+    }
+}
+
+const float* StreamState::update(const float* sample) {
+    // Replace the oldest sample once the window is full
+    float* slot = ring.data() + head * channelCount;
+    for (size_t c = 0; c < channelCount; ++c) {
+        const double x = sample[c];
+        if (filled == config.window) {
+            const double old = slot[c];
+            sum[c] -= old;
+            sumSquares[c] -= old * old;
+        }
+        sum[c] += x;
+        sumSquares[c] += x * x;
+        slot[c] = sample[c];
+        ema[c] = seen == 0 ? sample[c] : ema[c] + config.emaAlpha * (sample[c] - ema[c]);
+    }
+    head = head + 1 == config.window ? 0 : head + 1;
+    filled = std::min(filled + 1, config.window);
+    ++seen;
+    if (--untilRefresh == 0) {
+        refreshSums();
+        untilRefresh = config.window;
+    }
+
+    const double count = static_cast<double>(filled);
+    float* out = row.data();
+    for (StreamFeature feature : config.features) {
+        for (size_t c = 0; c < channelCount; ++c) {
+            const double mean = sum[c] / count;
+            switch (feature) {
+                case StreamFeature::VALUE:
+                    out[c] = sample[c];
+                    break;
+                case StreamFeature::MEAN:
+                    out[c] = static_cast<float>(mean);
+                    break;
+                case StreamFeature::STDDEV:
+                    // Clamped at 0 against cancellation
+                    out[c] = static_cast<float>(std::sqrt(std::max(sumSquares[c] / count - mean * mean, 0.0)));
+                    break;
+                case StreamFeature::EMA:
+                    out[c] = ema[c];
+                    break;
+            }
+        }
+        out += channelCount;
+    }
+    return row.data();
+}
+
+void StreamState::feedBack(const float* outputs) {
+    std::copy(outputs, outputs + config.hidden, row.data() + row.size() - config.hidden);
+}
+
+void StreamState::reset() {
+    head = 0;
+    filled = 0;
+    seen = 0;
+    untilRefresh = config.window;
+    std::fill(sum.data(), sum.data() + channelCount, 0.0);
+    std::fill(sumSquares.data(), sumSquares.data() + channelCount, 0.0);
+    std::fill(ema.data(), ema.data() + channelCount, 0.0f);
+    std::fill(row.data(), row.data() + row.size(), 0.0f);
+}
+
+void StreamState::refreshSums() {
+    // Called once per `window` samples, so O(channels) per sample amortized
+    for (size_t c = 0; c < channelCount; ++c) {
+        double total = 0.0;
+        double squares = 0.0;
+        for (size_t i = 0; i < filled; ++i) {
+            const double x = ring[i * channelCount + c];
+            total += x;
+            squares += x * x;
+        }
+        sum[c] = total;
+        sumSquares[c] = squares;
+    }
+}
+
+} // namespace xyz
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+
+namespace xyz {
+
+// Per-channel features a stream derives from its samples
+enum class StreamFeature {
+    // The sample itself
+    VALUE,
+    // Mean and standard deviation over the last `window` samples
+    MEAN,
+    STDDEV,
+    // Exponential moving average, ema += alpha * (x - ema)
+    EMA
+};
+
+StreamFeature parseStreamFeature(const std::string& name);
+std::string streamFeatureName(StreamFeature feature);
+
+struct StreamConfig {
+    size_t window = 32;
+    float emaAlpha = 0.1f;
+    std::vector<StreamFeature> features = {StreamFeature::VALUE, StreamFeature::MEAN, StreamFeature::STDDEV,
+                                           StreamFeature::EMA};
+    // Model outputs fed back as inputs of the next step, e.g. the hidden
+    // state of a recurrent network
+    size_t hidden = 0;
+};
+
+// State of one stream of samples of `channels` values, updated in O(channels)
+// per sample however long the window.
+//
+// The window is a ring buffer of the last `window` samples with running
+// sums of the values and their squares, refreshed from the ring once per
+// window length so rounding cannot accumulate. Each update writes the model
+// input row: every configured feature for all channels in configuration
+// order, then the `hidden` values fed back from the previous step (zero
+// at first).
+//
+// A stream is used by one thread at a time.
+class StreamState {
+public:
+    StreamState(const StreamConfig& config, size_t channels);
+
+    // Adds `sample` (channels() values) and returns the updated input row of
+    // rowSize() values, valid until the next call
+    const float* update(const float* sample);
+    // Feeds back the first hidden() of `outputs` as the tail of the next row
+    void feedBack(const float* outputs);
+    // Back to no samples and zero hidden state
+    void reset();
+
+    size_t channels() const { return channelCount; }
+    size_t rowSize() const { return row.size(); }
+    size_t hidden() const { return config.hidden; }
+    // Samples seen since construction or reset(), and how many of them the
+    // window currently holds
+    size_t samples() const { return seen; }
+    size_t windowFill() const { return filled; }
+
+private:
+    // Recomputes the running sums from the ring
+    void refreshSums();
+
+    StreamConfig config;
+    size_t channelCount;
+    // `window` samples of channelCount values; `head` is the next slot
+    AlignedBuffer<float> ring;
+    size_t head;
+    size_t filled;
+    size_t seen;
+    // Samples until the next refreshSums()
+    size_t untilRefresh;
+    AlignedBuffer<double> sum;
+    AlignedBuffer<double> sumSquares;
+    AlignedBuffer<float> ema;
+    AlignedBuffer<float> row;
+};
+
+} // namespace xyz
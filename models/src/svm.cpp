@@ -0,0 +1,326 @@
+#include "svm.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include "model_format.h"
+
+namespace xyz {
+
+namespace {
+
+// Input rows per kernel block; the block's kernel matrix stays in cache
+// between the two GEMMs
+constexpr size_t SVM_BLOCK = 64;
+
+// Copies a dense rows x cols matrix into a buffer with padded rows
+AlignedBuffer<float> packMatrix(const float* data, size_t rows, size_t cols, size_t srcStride) {
+    const size_t stride = kernels::paddedStride(cols);
+    AlignedBuffer<float> packed(rows * stride);
+    for (size_t r = 0; r < rows; ++r) {
+        std::memcpy(packed.data() + r * stride, data + r * srcStride, cols * sizeof(float));
+    }
+    return packed;
+}
+
+// Borrows a matrix already stored with padded rows, repacks anything else
+AlignedBuffer<float> loadMatrix(const ModelFile& file, const TensorInfo& info, size_t rows, size_t cols) {
+    const float* data = file.tensorData(info);
+    if (info.rowStride == kernels::paddedStride(cols)) {
+        return AlignedBuffer<float>::borrow(data, rows * info.rowStride, file.keepAlive());
+    }
+    return packMatrix(data, rows, cols, info.rowStride ? info.rowStride : cols);
+}
+
+std::string formatFloat(float value) {
+    std::ostringstream ss;
+    ss << std::setprecision(9) << value;
+    return ss.str();
+}
+
+} // namespace
+
+SvmKernel parseSvmKernel(const std::string& name) {
+    if (name == "linear") return SvmKernel::LINEAR;
+    if (name == "poly" || name == "polynomial") return SvmKernel::POLYNOMIAL;
+    if (name == "rbf") return SvmKernel::RBF;
+    throw std::invalid_argument("Unknown SVM kernel: " + name);
+}
+
+std::string svmKernelName(SvmKernel kernel) {
+    switch (kernel) {
+        case SvmKernel::LINEAR:     return "linear";
+        case SvmKernel::POLYNOMIAL: return "poly";
+        case SvmKernel::RBF:        return "rbf";
+        default:                    return "unknown";
+    }
+}
+
+SupportVectorMachine::SupportVectorMachine()
+    : count(0)
+    , dim(0)
+    , outputs(0)
+    , kernelTable(&kernels::activeKernels())
+{
+}
+
+void SupportVectorMachine::build(const SvmParams& svmParams, const std::vector<float>& supportVectors,
+                                 size_t vectorCount, size_t features,
+                                 const std::vector<float>& coefficients, const std::vector<float>& biases) {
+    if (vectorCount == 0 || features == 0 || biases.empty()) {
+        throw std::invalid_argument("SVM needs support vectors, features and outputs");
+    }
+    if (supportVectors.size() != vectorCount * features ||
+        coefficients.size() != biases.size() * vectorCount) {
+        throw std::invalid_argument("SVM support vector or coefficient size mismatch");
+    }
+    if (svmParams.kernel == SvmKernel::POLYNOMIAL && svmParams.degree == 0) {
+        throw std::invalid_argument("Polynomial SVM kernel needs degree >= 1");
+    }
+
+    params = svmParams;
+    count = vectorCount;
+    dim = features;
+    outputs = biases.size();
+    vectors = packMatrix(supportVectors.data(), count, dim, dim);
+    coef = packMatrix(coefficients.data(), outputs, count, count);
+    bias.resize(outputs);
+    std::copy(biases.begin(), biases.end(), bias.data());
+    prepare();
+}
+
+SupportVectorMachine SupportVectorMachine::view(const std::shared_ptr<const void>& keepAlive) const {
+    SupportVectorMachine result;
+    result.params = params;
+    result.count = count;
+    result.dim = dim;
+    result.outputs = outputs;
+    result.vectors = vectors.view(keepAlive);
+    result.coef = coef.view(keepAlive);
+    result.bias = bias.view(keepAlive);
+    result.halfNorms = halfNorms.view(keepAlive);
+    result.kernelTable = kernelTable;
+    return result;
+}
+
+void SupportVectorMachine::detachWeights() {
+    vectors.detach();
+    coef.detach();
+    bias.detach();
+    halfNorms.detach();
+}
+
+void SupportVectorMachine::setSimdLevel(kernels::SimdLevel level) {
+    kernelTable = &kernels::getKernels(level);
+}
+
+void SupportVectorMachine::collapseLinear() {
+    // w[o] = sum_j coef[o, j] * sv_j
+    const size_t stride = kernels::paddedStride(dim);
+    const size_t coefStride = kernels::paddedStride(count);
+    AlignedBuffer<float> weights(outputs * stride);
+    for (size_t o = 0; o < outputs; ++o) {
+        float* w = weights.data() + o * stride;
+        for (size_t j = 0; j < count; ++j) {
+            const float c = coef[o * coefStride + j];
+            const float* sv = vectors.data() + j * stride;
+            for (size_t k = 0; k < dim; ++k) {
+                w[k] += c * sv[k];
+            }
+        }
+    }
+    vectors = std::move(weights);
+    coef = AlignedBuffer<float>();
+    count = 0;
+}
+
+void SupportVectorMachine::prepare() {
+    if (params.kernel == SvmKernel::LINEAR && count > 0) {
+        collapseLinear();
+    }
+
+    halfNorms = AlignedBuffer<float>();
+    if (params.kernel == SvmKernel::RBF) {
+        const size_t stride = kernels::paddedStride(dim);
+        halfNorms.resize(count);
+        for (size_t j = 0; j < count; ++j) {
+            const float* sv = vectors.data() + j * stride;
+            float norm = 0.0f;
+            for (size_t k = 0; k < dim; ++k) {
+                norm += sv[k] * sv[k];
+            }
+            halfNorms[j] = -0.5f * norm;
+        }
+    }
+}
+
+void SupportVectorMachine::applyKernel(const float* x, size_t rows, size_t stride, float* k) const {
+    const size_t ld = kernels::paddedStride(count);
+
+    // RBF rows come out as x.sv - |sv|^2 / 2, plain dot products otherwise
+    kernelTable->gemm(vectors.data(), kernels::paddedStride(dim),
+                      params.kernel == SvmKernel::RBF ? halfNorms.data() : nullptr,
+                      x, stride, k, ld, rows, count, dim);
+
+    if (params.kernel == SvmKernel::POLYNOMIAL) {
+        for (size_t i = 0; i < rows; ++i) {
+            transformKernelRow(k + i * ld, 0.0f);
+        }
+    } else if (params.kernel == SvmKernel::RBF) {
+        for (size_t i = 0; i < rows; ++i) {
+            const float* xi = x + i * stride;
+            float norm = 0.0f;
+            for (size_t c = 0; c < dim; ++c) {
+                norm += xi[c] * xi[c];
+            }
+            transformKernelRow(k + i * ld, norm);
+        }
+        kernelTable->exp(k, rows * ld);
+    }
+}
+
+void SupportVectorMachine::transformKernelRow(float* row, float squaredNorm) const {
+    if (params.kernel == SvmKernel::POLYNOMIAL) {
+        for (size_t j = 0; j < count; ++j) {
+            const float base = params.gamma * row[j] + params.coef0;
+            float value = base;
+            for (uint32_t d = 1; d < params.degree; ++d) {
+                value *= base;
+            }
+            row[j] = value;
+        }
+    } else if (params.kernel == SvmKernel::RBF) {
+        // -gamma * |x - sv|^2 = 2 * gamma * (x.sv - |sv|^2 / 2) - gamma * |x|^2,
+        // clamped at 0 against rounding
+        const float scale = 2.0f * params.gamma;
+        const float offset = -params.gamma * squaredNorm;
+        for (size_t j = 0; j < count; ++j) {
+            row[j] = std::min(scale * row[j] + offset, 0.0f);
+        }
+    }
+}
+
+void SupportVectorMachine::predict(const float* x, float* output, InferenceScratch& scratch) const {
+    predictBatch(x, 1, dim, output, scratch);
+}
+
+void SupportVectorMachine::predict(const float* x, float* output) const {
+    InferenceScratch scratch;
+    predict(x, output, scratch);
+}
+
+void SupportVectorMachine::predictBatch(const float* x, size_t rows, size_t stride, float* output,
+                                        InferenceScratch& scratch) const {
+    // Collapsed linear SVM: a single dense layer
+    if (count == 0) {
+        kernelTable->gemm(vectors.data(), kernels::paddedStride(dim), bias.data(),
+                          x, stride, output, outputs, rows, outputs, dim);
+        return;
+    }
+
+    const size_t ld = kernels::paddedStride(count);
+    float* k = scratch.floats(InferenceScratch::KERNEL, std::min(SVM_BLOCK, rows) * ld);
+    for (size_t base = 0; base < rows; base += SVM_BLOCK) {
+        const size_t n = std::min(SVM_BLOCK, rows - base);
+        applyKernel(x + base * stride, n, stride, k);
+        kernelTable->gemm(coef.data(), ld, bias.data(), k, ld, output + base * outputs, outputs, n, outputs, count);
+    }
+}
+
+void SupportVectorMachine::predictBatch(const float* x, size_t rows, size_t stride, float* output) const {
+    InferenceScratch scratch;
+    predictBatch(x, rows, stride, output, scratch);
+}
+
+void SupportVectorMachine::predictSparse(const SparseVector& x, float* output, InferenceScratch& scratch) const {
+    const size_t stride = kernels::paddedStride(dim);
+    if (count == 0) {
+        kernelTable->sparseGather(vectors.data(), stride, bias.data(), x.indices, x.values, x.nnz,
+                                  output, outputs);
+        return;
+    }
+
+    float* k = scratch.floats(InferenceScratch::KERNEL, kernels::paddedStride(count));
+    kernelTable->sparseGather(vectors.data(), stride,
+                              params.kernel == SvmKernel::RBF ? halfNorms.data() : nullptr,
+                              x.indices, x.values, x.nnz, k, count);
+    float norm = 0.0f;
+    for (size_t i = 0; i < x.nnz; ++i) {
+        norm += x.values[i] * x.values[i];
+    }
+    transformKernelRow(k, norm);
+    if (params.kernel == SvmKernel::RBF) {
+        kernelTable->exp(k, count);
+    }
+    kernelTable->gemv(coef.data(), kernels::paddedStride(count), bias.data(), k, output, outputs, count);
+}
+
+void SupportVectorMachine::predictSparse(const SparseVector& x, float* output) const {
+    InferenceScratch scratch;
+    predictSparse(x, output, scratch);
+}
+
+void SupportVectorMachine::save(ModelFileWriter& writer, const std::string& prefix) const {
+    writer.setAttribute(prefix + ".kernel", svmKernelName(params.kernel));
+    writer.setAttribute(prefix + ".gamma", formatFloat(params.gamma));
+    writer.setAttribute(prefix + ".coef0", formatFloat(params.coef0));
+    writer.setAttribute(prefix + ".degree", std::to_string(params.degree));
+
+    const uint64_t stride = kernels::paddedStride(dim);
+    if (count == 0) {
+        writer.addTensor(prefix + ".weight", model_format::TensorType::FLOAT32, {outputs, dim},
+                         vectors.data(), stride);
+    } else {
+        writer.addTensor(prefix + ".vectors", model_format::TensorType::FLOAT32, {count, dim},
+                         vectors.data(), stride);
+        writer.addTensor(prefix + ".coef", model_format::TensorType::FLOAT32, {outputs, count},
+                         coef.data(), kernels::paddedStride(count));
+    }
+    writer.addTensor(prefix + ".bias", model_format::TensorType::FLOAT32, {outputs}, bias.data());
+}
+
+void SupportVectorMachine::load(const ModelFile& file, const std::string& prefix) {
+    SvmParams loadedParams;
+    loadedParams.kernel = parseSvmKernel(file.getAttribute(prefix + ".kernel", "rbf"));
+    loadedParams.gamma = std::stof(file.getAttribute(prefix + ".gamma", "1"));
+    loadedParams.coef0 = std::stof(file.getAttribute(prefix + ".coef0", "0"));
+    loadedParams.degree = static_cast<uint32_t>(std::stoul(file.getAttribute(prefix + ".degree", "3")));
+
+    const TensorInfo* b = file.findTensor(prefix + ".bias");
+    const TensorInfo* w = file.findTensor(prefix + ".weight");
+    const TensorInfo* v = file.findTensor(prefix + ".vectors");
+    const TensorInfo* c = file.findTensor(prefix + ".coef");
+    if (!b || b->elementCount() == 0 || (!w && (!v || !c))) {
+        throw std::runtime_error("Missing tensors for SVM " + prefix);
+    }
+    const size_t outputCount = b->elementCount();
+
+    if (w) {
+        if (loadedParams.kernel != SvmKernel::LINEAR || w->shape.size() != 2 ||
+            w->shape[0] != outputCount || w->shape[1] == 0) {
+            throw std::runtime_error("Malformed linear SVM " + prefix);
+        }
+        dim = w->shape[1];
+        count = 0;
+        vectors = loadMatrix(file, *w, outputCount, dim);
+        coef = AlignedBuffer<float>();
+    } else {
+        if (v->shape.size() != 2 || c->shape.size() != 2 || v->shape[0] == 0 || v->shape[1] == 0 ||
+            c->shape[0] != outputCount || c->shape[1] != v->shape[0] ||
+            (loadedParams.kernel == SvmKernel::POLYNOMIAL && loadedParams.degree == 0)) {
+            throw std::runtime_error("Malformed SVM " + prefix);
+        }
+        count = v->shape[0];
+        dim = v->shape[1];
+        vectors = loadMatrix(file, *v, count, dim);
+        coef = loadMatrix(file, *c, outputCount, count);
+    }
+
+    params = loadedParams;
+    outputs = outputCount;
+    bias = AlignedBuffer<float>::borrow(file.tensorData(*b), outputs, file.keepAlive());
+    prepare();
+}
+
+} // namespace xyz
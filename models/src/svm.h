@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "aligned_buffer.h"
+#include "inference_scratch.h"
+#include "kernels.h"
+#include "sparse_input.h"
+
+namespace xyz {
+
+class ModelFile;
+class ModelFileWriter;
+
+enum class SvmKernel {
+    LINEAR,
+    POLYNOMIAL,
+    RBF
+};
+
+SvmKernel parseSvmKernel(const std::string& name);
+std::string svmKernelName(SvmKernel kernel);
+
+struct SvmParams {
+    SvmKernel kernel = SvmKernel::RBF;
+    float gamma = 1.0f;
+    float coef0 = 0.0f;
+    uint32_t degree = 3;
+};
+
+// Kernel SVM with one decision function per output:
+//     f_o(x) = sum_j coef[o, j] * K(sv_j, x) + bias[o]
+//
+// Support vectors and coefficients are padded row-major matrices, so a batch
+// is two GEMMs with an element-wise kernel transform in between. Linear SVMs
+// are collapsed to w = coef * SV when built or loaded and evaluate as a
+// single dense layer. Kernel values go to the caller's InferenceScratch, so
+// one SVM may be evaluated by several threads at once; the overloads without
+// a scratch allocate one per call.
+class SupportVectorMachine {
+public:
+    SupportVectorMachine();
+
+    // `vectors` holds `count` support vectors of `dim` features, `coefficients`
+    // is outputs x count and `bias` has one entry per output
+    void build(const SvmParams& params, const std::vector<float>& vectors, size_t count, size_t dim,
+               const std::vector<float>& coefficients, const std::vector<float>& bias);
+
+    // SVM whose support vectors and coefficients borrow this one's memory
+    // and keep `keepAlive` alive
+    SupportVectorMachine view(const std::shared_ptr<const void>& keepAlive) const;
+    // Copies borrowed tensors into memory of its own
+    void detachWeights();
+
+    // Pins the kernel level, mainly for testing against the scalar reference
+    void setSimdLevel(kernels::SimdLevel level);
+
+    void predict(const float* x, float* output, InferenceScratch& scratch) const;
+    void predict(const float* x, float* output) const;
+    void predictBatch(const float* x, size_t rows, size_t stride, float* output, InferenceScratch& scratch) const;
+    void predictBatch(const float* x, size_t rows, size_t stride, float* output) const;
+    // Row of inputSize() features given by its non-zeros: the dot products
+    // with the weights or support vectors gather only those features
+    void predictSparse(const SparseVector& x, float* output, InferenceScratch& scratch) const;
+    void predictSparse(const SparseVector& x, float* output) const;
+
+    bool empty() const { return outputs == 0; }
+    size_t inputSize() const { return dim; }
+    size_t outputSize() const { return outputs; }
+    // 0 once a linear SVM has been collapsed
+    size_t supportVectorCount() const { return count; }
+    const SvmParams& getParams() const { return params; }
+    size_t weightBytes() const { return vectors.bytes() + coef.bytes() + bias.bytes() + halfNorms.bytes(); }
+
+    // Model file tensors "<prefix>.weight|bias" for linear SVMs and
+    // "<prefix>.vectors|coef|bias" otherwise. A linear SVM stored with
+    // support vectors is collapsed on load.
+    void save(ModelFileWriter& writer, const std::string& prefix) const;
+    void load(const ModelFile& file, const std::string& prefix);
+
+private:
+    void collapseLinear();
+    void prepare();
+    // Writes the kernel values of `rows` rows to `k`, paddedStride(count)
+    // apart
+    void applyKernel(const float* x, size_t rows, size_t stride, float* k) const;
+    // Turns one row of dot products x.sv_j (x.sv_j - |sv_j|^2 / 2 for RBF)
+    // into kernel values, leaving the RBF exponential to the caller
+    void transformKernelRow(float* row, float squaredNorm) const;
+
+    SvmParams params;
+    size_t count;
+    size_t dim;
+    size_t outputs;
+    // count x paddedStride(dim); after collapsing, outputs x paddedStride(dim)
+    AlignedBuffer<float> vectors;
+    // outputs x paddedStride(count)
+    AlignedBuffer<float> coef;
+    AlignedBuffer<float> bias;
+    // -|sv_j|^2 / 2, the GEMM bias that turns x.sv into the RBF exponent
+    AlignedBuffer<float> halfNorms;
+    const kernels::KernelTable* kernelTable;
+};
+
+} // namespace xyz
@@ -0,0 +1,335 @@
+#include "tree_trainer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include "../../utils/thread_pool.h"
+
+namespace xyz {
+
+namespace {
+
+// Bins are stored in one byte
+constexpr size_t MAX_BINS = 256;
+
+// Values sorted per feature to place the quantile cuts
+constexpr size_t BIN_SAMPLE_ROWS = 200000;
+
+// Histogram entries (rows x candidate features) below which a node's split
+// search stays on one thread
+constexpr size_t PARALLEL_MIN_WORK = 1 << 16;
+
+// Smallest gain treated as an improvement, against rounding noise
+constexpr double MIN_GAIN = 1e-9;
+
+} // namespace
+
+TreeTrainer::TreeTrainer(const std::vector<std::vector<float>>& rows, size_t featureCount,
+                         size_t outputCount, size_t maxBins)
+    : rowCount(rows.size())
+    , features(featureCount)
+    , outputs(outputCount)
+{
+    if (rows.empty() || features == 0 || outputs == 0) {
+        throw std::invalid_argument("Tree training needs rows, features and outputs");
+    }
+    if (rows.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("Too many rows for tree training");
+    }
+    if (maxBins < 2 || maxBins > MAX_BINS) {
+        throw std::invalid_argument("Tree training max_bins must be between 2 and 256");
+    }
+    for (const auto& row : rows) {
+        if (row.size() != features + outputs) {
+            throw std::invalid_argument("Training rows need " + std::to_string(features + outputs) +
+                                        " values (features then targets), got " + std::to_string(row.size()));
+        }
+    }
+
+    targets.resize(rowCount * outputs);
+    for (size_t r = 0; r < rowCount; ++r) {
+        std::copy(rows[r].begin() + features, rows[r].end(), targets.begin() + r * outputs);
+    }
+
+    edges.resize(features);
+    bins.resize(features * rowCount);
+    utils::ThreadPool::getInstance().parallelFor(features, 1, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            binFeature(f, rows);
+            // Cap at maxBins by keeping evenly spaced edges
+            auto& cuts = edges[f];
+            if (cuts.size() + 1 > maxBins) {
+                std::vector<float> kept;
+                for (size_t k = 1; k < maxBins; ++k) {
+                    kept.push_back(cuts[k * cuts.size() / maxBins]);
+                }
+                kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+                cuts = std::move(kept);
+            }
+            uint8_t* column = bins.data() + f * rowCount;
+            for (size_t r = 0; r < rowCount; ++r) {
+                const float x = rows[r][f];
+                // NaN lands in bin 0, which always goes left like at inference
+                column[r] = std::isnan(x) ? 0
+                          : static_cast<uint8_t>(std::lower_bound(cuts.begin(), cuts.end(), x) - cuts.begin());
+            }
+        }
+    });
+
+    binOffsets.resize(features + 1, 0);
+    for (size_t f = 0; f < features; ++f) {
+        binOffsets[f + 1] = binOffsets[f] + getBinCount(f);
+    }
+}
+
+void TreeTrainer::binFeature(size_t feature, const std::vector<std::vector<float>>& rows) {
+    // Candidate cuts are the distinct values of an evenly strided sample;
+    // the constructor thins them down to the bin budget
+    const size_t step = std::max<size_t>(1, rowCount / BIN_SAMPLE_ROWS);
+    std::vector<float> values;
+    values.reserve(rowCount / step + 1);
+    for (size_t r = 0; r < rowCount; r += step) {
+        const float x = rows[r][feature];
+        if (!std::isnan(x)) {
+            values.push_back(x);
+        }
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    // The largest value needs no cut above it
+    if (!values.empty()) {
+        values.pop_back();
+    }
+    edges[feature] = std::move(values);
+}
+
+void TreeTrainer::reserveSlots(TreeArena& arena, size_t slots) const {
+    const size_t width = outputs + 1;
+    if (arena.built.size() < slots * features) {
+        arena.histograms.resize(slots * binOffsets[features] * width);
+        arena.built.resize(slots * features);
+    }
+}
+
+const double* TreeTrainer::nodeHistogram(TreeArena& arena, uint32_t feature, const NodeSpan& node,
+                                         const NodeSpan* parent, const NodeSpan* sibling) const {
+    const size_t width = outputs + 1;
+    const size_t binCount = getBinCount(feature);
+    auto slotHistogram = [&](size_t slot) {
+        return arena.histograms.data() + (slot * binOffsets[features] + binOffsets[feature]) * width;
+    };
+    double* hist = slotHistogram(node.slot);
+    uint8_t& built = arena.built[node.slot * features + feature];
+    if (built) {
+        return hist;
+    }
+
+    // The larger sibling is its parent minus the smaller one, which is
+    // summed from its rows here if it has not been already
+    if (parent && arena.built[parent->slot * features + feature] &&
+        sibling->end - sibling->begin <= node.end - node.begin) {
+        const double* whole = slotHistogram(parent->slot);
+        const double* smaller = nodeHistogram(arena, feature, *sibling, nullptr, nullptr);
+        for (size_t k = 0; k < binCount * width; ++k) {
+            hist[k] = whole[k] - smaller[k];
+        }
+        built = 1;
+        return hist;
+    }
+
+    // Per bin: row count, then the target sums
+    std::fill(hist, hist + binCount * width, 0.0);
+    const uint8_t* column = bins.data() + feature * rowCount;
+    for (size_t i = node.begin; i < node.end; ++i) {
+        const uint32_t r = arena.rows[i];
+        double* h = hist + column[r] * width;
+        h[0] += 1.0;
+        const float* t = targets.data() + static_cast<size_t>(r) * outputs;
+        for (size_t o = 0; o < outputs; ++o) {
+            h[1 + o] += t[o];
+        }
+    }
+    built = 1;
+    return hist;
+}
+
+TreeTrainer::Split TreeTrainer::searchFeature(TreeArena& arena, uint32_t feature, const NodeSpan& node,
+                                              const NodeSpan* parent, const NodeSpan* sibling,
+                                              const TreeTrainingOptions& options) const {
+    const size_t width = outputs + 1;
+    const size_t binCount = getBinCount(feature);
+    const double* hist = nodeHistogram(arena, feature, node, parent, sibling);
+
+    // Totals for the node, then a left-to-right scan. The reduction in
+    // squared error is sum(L)^2/nL + sum(R)^2/nR - sum^2/n per output.
+    double* total = arena.sums.data() + feature * 2 * width;
+    double* left = total + width;
+    std::fill(total, total + 2 * width, 0.0);
+    for (size_t b = 0; b < binCount; ++b) {
+        for (size_t k = 0; k < width; ++k) {
+            total[k] += hist[b * width + k];
+        }
+    }
+    double unsplit = 0.0;
+    for (size_t o = 0; o < outputs; ++o) {
+        unsplit += total[1 + o] * total[1 + o] / total[0];
+    }
+
+    Split best;
+    const double minLeaf = static_cast<double>(options.minSamplesLeaf);
+    for (size_t b = 0; b + 1 < binCount; ++b) {
+        for (size_t k = 0; k < width; ++k) {
+            left[k] += hist[b * width + k];
+        }
+        const double nl = left[0];
+        const double nr = total[0] - nl;
+        if (nl < minLeaf || nr < minLeaf) {
+            continue;
+        }
+        double score = 0.0;
+        for (size_t o = 0; o < outputs; ++o) {
+            const double sr = total[1 + o] - left[1 + o];
+            score += left[1 + o] * left[1 + o] / nl + sr * sr / nr;
+        }
+        const double gain = score - unsplit;
+        if (gain > best.gain) {
+            best.gain = gain;
+            best.feature = static_cast<int32_t>(feature);
+            best.bin = static_cast<uint32_t>(b);
+        }
+    }
+    return best;
+}
+
+int32_t TreeTrainer::grow(TreeArena& arena, const NodeSpan& node, const NodeSpan* parent, const NodeSpan* sibling,
+                          size_t depth, const TreeTrainingOptions& options, bool parallelFeatures) {
+    const int32_t index = static_cast<int32_t>(arena.nodes.size());
+    arena.nodes.emplace_back();
+    const size_t begin = node.begin;
+    const size_t end = node.end;
+    const size_t count = end - begin;
+
+    Split best;
+    if (depth < options.maxDepth && count >= 2 * options.minSamplesLeaf) {
+        // Random feature subset per split when maxFeatures is set
+        auto& candidates = arena.candidates;
+        candidates.resize(features);
+        std::iota(candidates.begin(), candidates.end(), 0);
+        size_t tried = features;
+        if (options.maxFeatures > 0 && options.maxFeatures < features) {
+            for (size_t i = 0; i < options.maxFeatures; ++i) {
+                std::uniform_int_distribution<size_t> pick(i, features - 1);
+                std::swap(candidates[i], candidates[pick(arena.rng)]);
+            }
+            tried = options.maxFeatures;
+        }
+
+        arena.featureBest.assign(tried, Split());
+        auto search = [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                arena.featureBest[i] = searchFeature(arena, candidates[i], node, parent, sibling, options);
+            }
+        };
+        if (parallelFeatures && count * tried >= PARALLEL_MIN_WORK) {
+            utils::ThreadPool::getInstance().parallelFor(tried, 1, search);
+        } else {
+            search(0, tried);
+        }
+        // Reduced in candidate order so results do not depend on scheduling
+        for (const auto& split : arena.featureBest) {
+            if (split.feature >= 0 && split.gain > best.gain) {
+                best = split;
+            }
+        }
+    }
+
+    if (best.feature < 0 || best.gain <= MIN_GAIN) {
+        std::vector<float> value(outputs, 0.0f);
+        for (size_t o = 0; o < outputs; ++o) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                sum += targets[static_cast<size_t>(arena.rows[i]) * outputs + o];
+            }
+            value[o] = static_cast<float>(sum / static_cast<double>(count));
+        }
+        arena.nodes[index].value = std::move(value);
+        return index;
+    }
+
+    const uint8_t* column = bins.data() + static_cast<size_t>(best.feature) * rowCount;
+    const uint32_t splitBin = best.bin;
+    auto middle = std::partition(arena.rows.begin() + begin, arena.rows.begin() + end,
+                                 [&](uint32_t r) { return column[r] <= splitBin; });
+    const size_t mid = static_cast<size_t>(middle - arena.rows.begin());
+
+    // The children take the two slots of the next depth, empty until their
+    // split search fills them
+    const NodeSpan leftSpan = {begin, mid, 2 * depth + 1};
+    const NodeSpan rightSpan = {mid, end, 2 * depth + 2};
+    reserveSlots(arena, 2 * depth + 3);
+    std::fill(arena.built.begin() + leftSpan.slot * features,
+              arena.built.begin() + (rightSpan.slot + 1) * features, 0);
+
+    const int32_t left = grow(arena, leftSpan, &node, &rightSpan, depth + 1, options, parallelFeatures);
+    const int32_t right = grow(arena, rightSpan, &node, &leftSpan, depth + 1, options, parallelFeatures);
+    TreeNode& split = arena.nodes[index];
+    split.feature = best.feature;
+    split.threshold = edges[best.feature][best.bin];
+    split.left = left;
+    split.right = right;
+    return index;
+}
+
+DecisionTree TreeTrainer::buildTree(TreeArena& arena, const TreeTrainingOptions& options, bool parallelFeatures) {
+    reserveSlots(arena, 1);
+    std::fill(arena.built.begin(), arena.built.begin() + features, 0);
+    arena.sums.resize(features * 2 * (outputs + 1));
+    arena.nodes.clear();
+    grow(arena, {0, arena.rows.size(), 0}, nullptr, nullptr, 0, options, parallelFeatures);
+
+    DecisionTree tree;
+    tree.build(arena.nodes, outputs);
+    return tree;
+}
+
+DecisionTree TreeTrainer::trainTree(const TreeTrainingOptions& options) {
+    TreeArena arena;
+    arena.rng.seed(options.seed);
+    arena.rows.resize(rowCount);
+    std::iota(arena.rows.begin(), arena.rows.end(), 0);
+    return buildTree(arena, options, true);
+}
+
+std::vector<DecisionTree> TreeTrainer::trainForest(const TreeTrainingOptions& options) {
+    if (options.trees == 0) {
+        throw std::invalid_argument("Random forest needs at least one tree");
+    }
+
+    // Trees are dealt round-robin to one arena per worker. Each tree's
+    // bootstrap sample and feature draws are seeded from its own index, so
+    // the forest does not depend on the number of threads.
+    auto& pool = utils::ThreadPool::getInstance();
+    const size_t workers = std::min(pool.concurrency(), options.trees);
+    const bool parallelFeatures = workers == 1;
+    std::vector<DecisionTree> trees(options.trees);
+    std::vector<TreeArena> arenas(workers);
+
+    pool.parallelFor(workers, 1, [&](size_t first, size_t last) {
+        for (size_t w = first; w < last; ++w) {
+            TreeArena& arena = arenas[w];
+            arena.rows.resize(rowCount);
+            for (size_t t = w; t < options.trees; t += workers) {
+                arena.rng.seed(options.seed + static_cast<uint32_t>(t));
+                std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(rowCount - 1));
+                for (auto& r : arena.rows) {
+                    r = pick(arena.rng);
+                }
+                trees[t] = buildTree(arena, options, parallelFeatures);
+            }
+        }
+    });
+    return trees;
+}
+
+} // namespace xyz
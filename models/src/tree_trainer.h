@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "decision_tree.h"
+
+namespace xyz {
+
+struct TreeTrainingOptions {
+    size_t maxDepth = 8;
+    size_t minSamplesLeaf = 1;
+    // Features tried at each split; 0 = all of them
+    size_t maxFeatures = 0;
+    // Trees built by trainForest(), each from a bootstrap sample
+    size_t trees = 1;
+    uint32_t seed = 42;
+};
+
+// Histogram-based trainer for regression trees and forests.
+//
+// Every feature is cut once into at most `maxBins` quantile bins and stored
+// as a feature-major byte matrix. Split search then only builds per-node
+// histograms of target sums over bins and scans them for the largest
+// reduction in squared error, in parallel across features for large nodes.
+// Of two siblings only the smaller histogram is summed from its rows; the
+// larger is its parent's minus the smaller, so each level of a tree reads
+// at most half of the rows.
+// Forests build their trees concurrently from bootstrap samples, each pool
+// worker reusing its own TreeArena for row indices, histograms and nodes.
+//
+// Multiple targets are fitted jointly, so one-hot targets train a
+// classifier whose leaves hold class frequencies.
+class TreeTrainer {
+public:
+    // Each row holds `features` inputs followed by `outputs` targets
+    TreeTrainer(const std::vector<std::vector<float>>& rows, size_t features, size_t outputs,
+                size_t maxBins = 255);
+
+    DecisionTree trainTree(const TreeTrainingOptions& options);
+    std::vector<DecisionTree> trainForest(const TreeTrainingOptions& options);
+
+    size_t getBinCount(size_t feature) const { return edges[feature].size() + 1; }
+
+private:
+    struct Split {
+        double gain = 0.0;
+        int32_t feature = -1;
+        uint32_t bin = 0;
+    };
+
+    // Rows of a node being grown and the histogram slot it owns
+    struct NodeSpan {
+        size_t begin;
+        size_t end;
+        size_t slot;
+    };
+
+    // Scratch storage owned by one worker and reused for every tree it builds
+    struct TreeArena {
+        std::vector<uint32_t> rows;
+        // Histograms of the nodes on the path being grown: slot 0 holds the
+        // root, then each depth has one slot per child of the node above
+        std::vector<double> histograms;
+        // Per slot and feature: whether that histogram is filled in
+        std::vector<uint8_t> built;
+        // Node totals and running left sums of each feature's scan
+        std::vector<double> sums;
+        std::vector<Split> featureBest;
+        std::vector<uint32_t> candidates;
+        std::vector<TreeNode> nodes;
+        std::mt19937 rng;
+    };
+
+    void binFeature(size_t feature, const std::vector<std::vector<float>>& rows);
+    DecisionTree buildTree(TreeArena& arena, const TreeTrainingOptions& options, bool parallelFeatures);
+    int32_t grow(TreeArena& arena, const NodeSpan& node, const NodeSpan* parent, const NodeSpan* sibling,
+                 size_t depth, const TreeTrainingOptions& options, bool parallelFeatures);
+    const double* nodeHistogram(TreeArena& arena, uint32_t feature, const NodeSpan& node,
+                                const NodeSpan* parent, const NodeSpan* sibling) const;
+    Split searchFeature(TreeArena& arena, uint32_t feature, const NodeSpan& node, const NodeSpan* parent,
+                        const NodeSpan* sibling, const TreeTrainingOptions& options) const;
+    void reserveSlots(TreeArena& arena, size_t slots) const;
+
+    size_t rowCount;
+    size_t features;
+    size_t outputs;
+    // Upper edge of every bin but the last, per feature
+    std::vector<std::vector<float>> edges;
+    // Feature-major bin indices: bins[feature * rowCount + row]
+    std::vector<uint8_t> bins;
+    // First bin of each feature within a histogram slot; the last entry is
+    // the slot's bin count
+    std::vector<size_t> binOffsets;
+    std::vector<float> targets;
+};
+
+} // namespace xyz
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <cmath>
 #include "../agents/src/base_agent.h"
 #include "../agents/src/agent_manager.h"
 #include "../agents/src/ai_processor.h"
@@ -113,5 +114,95 @@ TEST_F(AgentTest, AIProcessor) {
     processor.shutdown();
 }
 
+TEST_F(AgentTest, OutputBufferReused) {
+    auto model = std::make_shared<AIModel>("agent_model", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "agent_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,8,2";
+    ASSERT_TRUE(model->initialize(config));
+
+    BaseAgent agent("buffer_agent", "test_agent");
+    ASSERT_TRUE(agent.loadModel(model));
+    ASSERT_TRUE(agent.start());
+
+    ASSERT_TRUE(agent.processData({1.0f, 2.0f, 3.0f}));
+    const float* buffer = agent.getLastOutput().data();
+    EXPECT_EQ(agent.getLastOutput().size(), 2);
+
+    // Subsequent calls write into the same buffer
+    ASSERT_TRUE(agent.processData({0.5f, 0.0f, -1.0f}));
+    EXPECT_EQ(agent.getLastOutput().data(), buffer);
+}
+
+TEST_F(AgentTest, SparseDataProcessing) {
+    auto model = std::make_shared<AIModel>("sparse_agent_model", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "sparse_agent_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "1000,8,2";
+    config.parameters["sparse_input"] = "true";
+    ASSERT_TRUE(model->initialize(config));
+
+    BaseAgent agent("sparse_agent", "test_agent");
+    ASSERT_TRUE(agent.loadModel(model));
+    ASSERT_TRUE(agent.start());
+
+    std::vector<float> dense(1000, 0.0f);
+    dense[3] = 1.0f;
+    dense[700] = -2.0f;
+    ASSERT_TRUE(agent.processData(dense));
+    const std::vector<float> expected = agent.getOutput();
+
+    const uint32_t indices[] = {3, 700};
+    const float values[] = {1.0f, -2.0f};
+    ASSERT_TRUE(agent.processData(SparseVector{indices, values, 2, 1000}));
+    ASSERT_EQ(agent.getLastOutput().size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(agent.getLastOutput()[i], expected[i], 1e-5f);
+    }
+
+    // Wrong dimension
+    EXPECT_FALSE(agent.processData(SparseVector{indices, values, 2, 800}));
+}
+
+TEST_F(AgentTest, StreamingSamples) {
+    auto model = std::make_shared<AIModel>("stream_agent_model", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "stream_agent_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "8,4,2";
+    config.parameters["stream_window"] = "10";
+    ASSERT_TRUE(model->initialize(config));
+
+    BaseAgent agent("stream_agent", "test_agent");
+    ASSERT_TRUE(agent.loadModel(model));
+    ASSERT_TRUE(agent.start());
+
+    // The agent's stream evolves like a stream driven by hand
+    auto reference = model->createStream(2);
+    ASSERT_NE(reference, nullptr);
+    for (int n = 0; n < 25; ++n) {
+        const std::vector<float> sample = {std::sin(n * 0.3f), std::cos(n * 0.2f)};
+        ASSERT_TRUE(agent.processSample(sample));
+        float expected[2];
+        ASSERT_TRUE(model->inferenceStream(*reference, sample.data(), 2, expected, 2));
+        ASSERT_EQ(agent.getLastOutput().size(), 2u);
+        EXPECT_EQ(agent.getLastOutput()[0], expected[0]);
+        EXPECT_EQ(agent.getLastOutput()[1], expected[1]);
+    }
+
+    // Samples keep the first sample's width
+    EXPECT_FALSE(agent.processSample({1.0f, 2.0f, 3.0f}));
+
+    agent.resetStream();
+    reference->reset();
+    ASSERT_TRUE(agent.processSample({0.5f, -0.5f}));
+    float expected[2];
+    const float sample[2] = {0.5f, -0.5f};
+    ASSERT_TRUE(model->inferenceStream(*reference, sample, 2, expected, 2));
+    EXPECT_EQ(agent.getLastOutput()[0], expected[0]);
+}
+
 } // namespace tests
 } // namespace xyz
\ No newline at end of file
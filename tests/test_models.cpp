@@ -1,10 +1,55 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
 #include "../models/src/model.h"
+#include "../models/src/model_format.h"
 #include "../models/src/model_loader.h"
+#include "../models/src/model_pipeline.h"
+#include "../models/src/model_weights.h"
+#include "../utils/thread_pool.h"
 
 namespace xyz {
 namespace tests {
 
+// Overwrites int32 element `index` of tensor `name` in the model file at
+// `path`, as a corrupt file would have it
+void patchTensorInt(const std::string& path, const std::string& name, size_t index, int32_t value) {
+    uint64_t offset = 0;
+    {
+        auto file = ModelFile::open(path);
+        const TensorInfo* info = file->findTensor(name);
+        ASSERT_NE(info, nullptr);
+        offset = info->offset + index * sizeof(int32_t);
+    }
+    std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+    out.seekp(static_cast<std::streamoff>(offset));
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Overwrites the value of attribute `key` in the model file at `path` with
+// one of the same length
+void patchAttribute(const std::string& path, const std::string& key, const std::string& value) {
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    // Strings are stored as a uint32 length and the bytes
+    const size_t at = bytes.find(key);
+    ASSERT_NE(at, std::string::npos);
+    uint32_t size = 0;
+    std::memcpy(&size, bytes.data() + at + key.size(), sizeof(size));
+    ASSERT_EQ(size, value.size());
+    std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+    out.seekp(static_cast<std::streamoff>(at + key.size() + sizeof(size)));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
 class ModelTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -56,12 +101,23 @@ TEST_F(ModelTest, ModelInference) {
 }
 
 TEST_F(ModelTest, ModelLoader) {
+    // Write a model file to load
+    auto source = std::make_shared<AIModel>("test_model", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "test_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,6,2";
+    ASSERT_TRUE(source->initialize(config));
+    const std::string path = ::testing::TempDir() + "test_model.xyzm";
+    ASSERT_TRUE(source->save(path));
+
     // Test model loading
-    auto model = loader->loadModel("test_model.json");
+    auto model = loader->loadModel(path);
     ASSERT_NE(model, nullptr);
+    EXPECT_EQ(loader->loadModel(::testing::TempDir() + "missing.xyzm"), nullptr);
     
-    // Test model registration
-    EXPECT_TRUE(loader->registerModel("test_model", model));
+    // Loaded models are registered under their stored name
+    EXPECT_FALSE(loader->registerModel("test_model", model));
     
     // Test model retrieval
     auto retrievedModel = loader->getModel("test_model");
@@ -72,27 +128,2216 @@ TEST_F(ModelTest, ModelLoader) {
     auto models = loader->listModels();
     EXPECT_EQ(models.size(), 1);
     EXPECT_EQ(models[0], "test_model");
+
+    // Mapped weights reproduce the saved model
+    std::vector<float> input = {0.3f, -0.7f, 1.1f};
+    auto expected = source->inference(input);
+    auto actual = model->inference(input);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        EXPECT_FLOAT_EQ(actual[i], expected[i]);
+    }
+    const AIModel& loaded = *model;
+    EXPECT_TRUE(loaded.getNetwork().getLayers()[0].weights.isBorrowed());
+
+    // The mapping is read-only: mutable access copies the weights first
+    auto direct = std::make_shared<AIModel>("test_model_direct", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(direct->load(path));
+    ASSERT_TRUE(direct->initialize(config));
+    const AIModel& directView = *direct;
+    EXPECT_TRUE(directView.getNetwork().getLayers()[0].weights.isBorrowed());
+    direct->getNetwork().getLayers()[0].weights[0] += 1.0f;
+    EXPECT_FALSE(directView.getNetwork().getLayers()[0].weights.isBorrowed());
+    EXPECT_EQ(model->inference(input), actual);
+
+    // Directory sizes that wrap around 64 bits are rejected. The record of a
+    // tensor follows its name: dtype, rank, dims, row stride, offset, bytes.
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    const std::string name = "dense.0.weight";
+    const size_t record = bytes.find(name) + name.size();
+    uint32_t rank = 0;
+    uint64_t offset = 0;
+    std::memcpy(&rank, &bytes[record + 4], sizeof(rank));
+    const size_t dims = record + 8;
+    std::memcpy(&offset, &bytes[dims + rank * 8 + 8], sizeof(offset));
+    auto corrupt = [&](size_t at, uint64_t value) {
+        std::string patched = bytes;
+        std::memcpy(&patched[at], &value, sizeof(value));
+        const std::string corruptPath = ::testing::TempDir() + "corrupt_model.xyzm";
+        std::ofstream(corruptPath, std::ios::binary) << patched;
+        return corruptPath;
+    };
+    EXPECT_THROW(ModelFile::open(corrupt(dims + rank * 8 + 16, 0 - offset + 16)), std::runtime_error);
+    EXPECT_THROW(ModelFile::open(corrupt(dims, uint64_t(1) << 62)), std::runtime_error);
+    EXPECT_NO_THROW(ModelFile::open(corrupt(dims, 6)));
+}
+
+TEST_F(ModelTest, ModelHotSwap) {
+    ModelConfig config;
+    config.name = "swap_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,4,2";
+    std::vector<std::shared_ptr<AIModel>> versions;
+    for (int i = 0; i < 20; ++i) {
+        config.parameters["seed"] = std::to_string(i + 1);
+        versions.push_back(std::make_shared<AIModel>("swap_model", ModelType::NEURAL_NETWORK));
+        ASSERT_TRUE(versions.back()->initialize(config));
+    }
+    EXPECT_EQ(loader->swapModel("swap_model", versions[0]), nullptr);
+    EXPECT_EQ(loader->getModelVersion("swap_model"), 1u);
+
+    // Readers keep looking the model up while versions are published; every
+    // lookup returns one complete version
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                auto model = loader->getModel("swap_model");
+                if (!model || std::find(versions.begin(), versions.end(), model) == versions.end() ||
+                    !model->isInitialized()) {
+                    ++bad;
+                }
+            }
+        });
+    }
+    for (size_t i = 1; i < versions.size(); ++i) {
+        EXPECT_EQ(loader->swapModel("swap_model", versions[i]), versions[i - 1]);
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    EXPECT_EQ(loader->getModelVersion("swap_model"), versions.size());
+    EXPECT_EQ(loader->getModel("swap_model"), versions.back());
+
+    // A caller holding the old version finishes on it after a swap, and the
+    // old version is freed once the last holder lets go
+    const std::vector<float> input = {0.2f, -0.4f, 0.9f};
+    auto inFlight = loader->getModel("swap_model");
+    const auto expected = inFlight->inference(input);
+    std::weak_ptr<AIModel> retired = inFlight;
+    versions.clear();
+    auto replacement = std::make_shared<AIModel>("swap_model", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(replacement->initialize(config));
+    EXPECT_EQ(loader->swapModel("swap_model", replacement), inFlight);
+    EXPECT_EQ(inFlight->inference(input), expected);
+    EXPECT_FALSE(retired.expired());
+    inFlight.reset();
+    EXPECT_TRUE(retired.expired());
+    EXPECT_EQ(loader->swapModel("swap_model", nullptr), nullptr);
+    EXPECT_EQ(loader->getModel("swap_model"), replacement);
+
+    // Reloading a file publishes a new version under the stored name
+    auto source = std::make_shared<AIModel>("reload_model", ModelType::NEURAL_NETWORK);
+    config.name = "reload_model";
+    ASSERT_TRUE(source->initialize(config));
+    const std::string path = ::testing::TempDir() + "reload_model.xyzm";
+    ASSERT_TRUE(source->save(path));
+    auto first = loader->loadModel(path);
+    ASSERT_NE(first, nullptr);
+    auto second = loader->reloadModel(path);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(loader->getModel("reload_model"), second);
+    EXPECT_EQ(loader->getModelVersion("reload_model"), 2u);
+    EXPECT_EQ(loader->getModelVersion("missing_model"), 0u);
+}
+
+TEST_F(ModelTest, ConcurrentModelRegistry) {
+    ModelConfig config;
+    config.name = "stable_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,4,2";
+    auto stable = std::make_shared<AIModel>("stable_model", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(stable->initialize(config));
+    ASSERT_TRUE(loader->registerModel("stable_model", stable));
+
+    // Readers hit, miss and race with models coming and going
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                if (loader->getModel("stable_model") != stable || loader->getModel("missing_model")) {
+                    ++bad;
+                }
+                auto churn = loader->getModel("churn_model");
+                if (churn && !churn->isInitialized()) {
+                    ++bad;
+                }
+            }
+        });
+    }
+    config.name = "churn_model";
+    for (int i = 0; i < 50; ++i) {
+        auto churn = std::make_shared<AIModel>("churn_model", ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(churn->initialize(config));
+        ASSERT_TRUE(loader->registerModel("churn_model", churn));
+        ASSERT_TRUE(loader->unregisterModel("churn_model"));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+
+    // A grace period waits for the outermost of nested read sections
+    std::atomic<bool> synchronized{false};
+    std::thread writer;
+    {
+        utils::rcu::ReadGuard outer;
+        {
+            utils::rcu::ReadGuard inner;
+            writer = std::thread([&]() {
+                utils::rcu::synchronize();
+                synchronized = true;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_FALSE(synchronized.load());
+    }
+    writer.join();
+    EXPECT_TRUE(synchronized.load());
+}
+
+TEST_F(ModelTest, BulkModelLoading) {
+    ModelConfig config;
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,6,2";
+    std::vector<std::string> paths;
+    for (int i = 0; i < 6; ++i) {
+        config.name = "bulk_" + std::to_string(i);
+        auto source = std::make_shared<AIModel>(config.name, ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(source->initialize(config));
+        paths.push_back(::testing::TempDir() + config.name + ".xyzm");
+        ASSERT_TRUE(source->save(paths.back()));
+    }
+    // A missing file and a second copy of an already listed model fail
+    // without affecting the others
+    paths.push_back(::testing::TempDir() + "bulk_missing.xyzm");
+    paths.push_back(paths[2]);
+
+    auto results = loader->loadModels(paths);
+    ASSERT_EQ(results.size(), paths.size());
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_TRUE(results[i].ok()) << results[i].error;
+        EXPECT_EQ(results[i].path, paths[i]);
+        EXPECT_EQ(results[i].model->getModelId(), "bulk_" + std::to_string(i));
+        EXPECT_TRUE(results[i].model->isInitialized());
+        EXPECT_EQ(loader->getModel("bulk_" + std::to_string(i)), results[i].model);
+    }
+    EXPECT_FALSE(results[6].ok());
+    EXPECT_NE(results[6].error.find("Invalid model path"), std::string::npos);
+    EXPECT_FALSE(results[7].ok());
+    EXPECT_NE(results[7].error.find("already registered"), std::string::npos);
+    EXPECT_EQ(loader->listModels().size(), 6u);
+    EXPECT_TRUE(loader->loadModels({}).empty());
+}
+
+TEST_F(ModelTest, ModelLazyLoading) {
+    ModelConfig config;
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,6,2";
+    std::vector<std::vector<float>> expected;
+    const std::vector<float> input = {0.3f, -0.7f, 1.1f};
+    for (const std::string name : {"lazy_a", "lazy_b", "lazy_c"}) {
+        config.name = name;
+        config.parameters["seed"] = std::to_string(expected.size() + 1);
+        auto source = std::make_shared<AIModel>(name, ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(source->initialize(config));
+        ASSERT_TRUE(source->save(::testing::TempDir() + name + ".xyzm"));
+        expected.push_back(source->inference(input));
+        ASSERT_TRUE(loader->registerModelFile(::testing::TempDir() + name + ".xyzm"));
+    }
+    EXPECT_FALSE(loader->registerModelFile(::testing::TempDir() + "lazy_a.xyzm"));
+    EXPECT_FALSE(loader->registerModelFile(::testing::TempDir() + "missing.xyzm"));
+
+    // Descriptors are listed but take no memory until first use
+    EXPECT_EQ(loader->listModels().size(), 3u);
+    EXPECT_EQ(loader->getResidentBytes(), 0u);
+    auto a = loader->getModel("lazy_a");
+    ASSERT_NE(a, nullptr);
+    EXPECT_TRUE(loader->isModelResident("lazy_a"));
+    EXPECT_FALSE(loader->isModelResident("lazy_b"));
+    EXPECT_EQ(a->inference(input), expected[0]);
+    EXPECT_EQ(loader->getModel("lazy_a"), a);
+
+    // With room for two models, loading a third evicts the least recently
+    // used one
+    const size_t modelBytes = loader->getResidentBytes();
+    ASSERT_GT(modelBytes, 0u);
+    loader->setMemoryBudget(modelBytes * 5 / 2);
+    ASSERT_NE(loader->getModel("lazy_b"), nullptr);
+    ASSERT_NE(loader->getModel("lazy_a"), nullptr);
+    auto c = loader->getModel("lazy_c");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->inference(input), expected[2]);
+    EXPECT_TRUE(loader->isModelResident("lazy_a"));
+    EXPECT_FALSE(loader->isModelResident("lazy_b"));
+    EXPECT_TRUE(loader->isModelResident("lazy_c"));
+    EXPECT_LE(loader->getResidentBytes(), loader->getMemoryBudget());
+
+    // Evicted models reload on demand; holders of an evicted model keep
+    // using it
+    auto b = loader->getModel("lazy_b");
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(b->inference(input), expected[1]);
+    EXPECT_FALSE(loader->isModelResident("lazy_a"));
+    EXPECT_EQ(a->inference(input), expected[0]);
+
+    // Models registered from memory are never evicted
+    auto pinned = std::make_shared<AIModel>("pinned", ModelType::NEURAL_NETWORK);
+    config.name = "pinned";
+    ASSERT_TRUE(pinned->initialize(config));
+    ASSERT_TRUE(loader->registerModel("pinned", pinned));
+    loader->setMemoryBudget(0);
+    EXPECT_TRUE(loader->isModelResident("pinned"));
+    EXPECT_FALSE(loader->isModelResident("lazy_b"));
+    EXPECT_FALSE(loader->isModelResident("lazy_c"));
+    EXPECT_EQ(loader->getResidentBytes(), modelBytes);
+    loader->setMemoryBudget(static_cast<size_t>(constants::MAX_TOTAL_MEMORY));
+    EXPECT_EQ(loader->getModel("lazy_c")->inference(input), expected[2]);
+
+    // Concurrent first uses of different ids load in parallel, while callers
+    // of the same id share one load
+    ASSERT_FALSE(loader->isModelResident("lazy_a"));
+    ASSERT_FALSE(loader->isModelResident("lazy_b"));
+    std::vector<std::shared_ptr<AIModel>> loaded(8);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        readers.emplace_back([&, i]() {
+            loaded[i] = loader->getModel(i % 2 == 0 ? "lazy_a" : "lazy_b");
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        ASSERT_NE(loaded[i], nullptr);
+        EXPECT_EQ(loaded[i], loaded[i % 2]);
+    }
+    EXPECT_EQ(loaded[0]->inference(input), expected[0]);
+    EXPECT_EQ(loaded[1]->inference(input), expected[1]);
+
+    // Memory a model allocates after it was loaded counts against the
+    // budget: a budget that fitted before the batch no longer does
+    const size_t resident = loader->getResidentBytes();
+    std::vector<float> rows(256 * 3, 0.5f), outputs(256 * 2);
+    ASSERT_TRUE(loaded[0]->inferenceBatch(rows.data(), 256, 3, outputs.data()));
+    EXPECT_GT(loader->getResidentBytes(), resident);
+    loader->setMemoryBudget(resident);
+    EXPECT_FALSE(loader->isModelResident("lazy_c"));
+    EXPECT_LE(loader->getResidentBytes(), resident);
+    loader->setMemoryBudget(static_cast<size_t>(constants::MAX_TOTAL_MEMORY));
 }
 
 TEST_F(ModelTest, ModelPerformance) {
     auto model = std::make_shared<AIModel>("perf_test", ModelType::NEURAL_NETWORK);
-    model->initialize(ModelConfig{});
+    ModelConfig config;
+    config.name = "perf_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,16,2";
+    ASSERT_TRUE(model->initialize(config));
     
     // Test inference performance
     const int numIterations = 1000;
     std::vector<float> input = {1.0f, 2.0f, 3.0f};
     
-    auto start = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < numIterations; ++i) {
         model->inference(input);
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
     auto metrics = model->getMetrics();
     
     EXPECT_GT(metrics.accuracy, 0.0);
-    EXPECT_GT(metrics.latency, 0.0);
+    EXPECT_EQ(metrics.latency.count, static_cast<uint64_t>(numIterations));
+    EXPECT_GT(metrics.latency.p50, 0.0);
+    EXPECT_LE(metrics.latency.p50, metrics.latency.p90);
+    EXPECT_LE(metrics.latency.p90, metrics.latency.p99);
+    EXPECT_LE(metrics.latency.p99, metrics.latency.p999);
+    EXPECT_LE(metrics.latency.p999, metrics.latency.max);
+    EXPECT_EQ(metrics.rowsProcessed, static_cast<uint64_t>(numIterations));
+    EXPECT_EQ(metrics.errors, 0u);
+    EXPECT_GT(metrics.throughput, 0.0);
+
+    // Batches are timed per call; rejected calls only count as errors
+    std::vector<float> batch(8 * 3, 0.5f);
+    std::vector<float> output(8 * 2);
+    ASSERT_TRUE(model->inferenceBatch(batch.data(), 8, 3, output.data()));
+    EXPECT_TRUE(model->inference({1.0f}).empty());
+    metrics = model->getMetrics();
+    EXPECT_EQ(metrics.batchLatency.count, 1u);
+    EXPECT_EQ(metrics.latency.count, static_cast<uint64_t>(numIterations));
+    EXPECT_EQ(metrics.rowsProcessed, static_cast<uint64_t>(numIterations + 8));
+    EXPECT_EQ(metrics.errors, 1u);
+}
+
+TEST_F(ModelTest, LatencyHistogram) {
+    // Every value falls in the bucket that claims it, within 1/32 relative
+    // width, and buckets are ordered by value
+    size_t previous = 0;
+    for (uint64_t value = 0; value < (uint64_t(1) << 20); value += 1 + value / 7) {
+        const size_t index = LatencyHistogram::bucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::BUCKETS);
+        EXPECT_GE(index, previous);
+        EXPECT_LE(LatencyHistogram::bucketLow(index), value);
+        EXPECT_LT(value, LatencyHistogram::bucketLow(index) + LatencyHistogram::bucketWidth(index));
+        EXPECT_LE(LatencyHistogram::bucketWidth(index) * 32, std::max<uint64_t>(value, 32));
+        previous = index;
+    }
+    EXPECT_EQ(LatencyHistogram::bucketIndex(~uint64_t(0)), LatencyHistogram::BUCKETS - 1);
+
+    // Percentiles of 1..100000 ticks, recorded from several threads
+    LatencyHistogram histogram;
+    std::vector<std::thread> recorders;
+    for (int t = 0; t < 4; ++t) {
+        recorders.emplace_back([&histogram, t]() {
+            for (uint64_t value = t + 1; value <= 100000; value += 4) {
+                histogram.record(value);
+            }
+        });
+    }
+    for (auto& recorder : recorders) {
+        recorder.join();
+    }
+    const auto snapshot = histogram.snapshot();
+    const double msPerTick = cycle_clock::nanosPerTick() * 1e-6;
+    EXPECT_EQ(snapshot.count, 100000u);
+    EXPECT_NEAR(snapshot.p50, 50000 * msPerTick, 50000 * msPerTick * 0.04);
+    EXPECT_NEAR(snapshot.p90, 90000 * msPerTick, 90000 * msPerTick * 0.04);
+    EXPECT_NEAR(snapshot.p99, 99000 * msPerTick, 99000 * msPerTick * 0.04);
+    EXPECT_NEAR(snapshot.p999, 99900 * msPerTick, 99900 * msPerTick * 0.04);
+    EXPECT_NEAR(snapshot.max, 100000 * msPerTick, 100000 * msPerTick * 0.01);
+    EXPECT_NEAR(snapshot.mean, 50000.5 * msPerTick, 50000 * msPerTick * 0.01);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.snapshot().count, 0u);
+}
+
+TEST_F(ModelTest, ModelMemoryAccounting) {
+    auto model = std::make_shared<AIModel>("memory_test", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "memory_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "3,64,64,2";
+    config.parameters["cache_bytes"] = "65536";
+    config.parameters["cache_shards"] = "4";
+    ASSERT_TRUE(model->initialize(config));
+
+    // Every byte the model allocated is in exactly one category
+    auto metrics = model->getMetrics();
+    EXPECT_GE(metrics.weightMemory, metrics.weightBytes);
+    EXPECT_GT(metrics.scratchMemory, 0u);
+    EXPECT_GT(metrics.cacheMemory, 0u);
+    EXPECT_EQ(metrics.memoryUsage,
+              sizeof(AIModel) + metrics.weightMemory + metrics.scratchMemory + metrics.cacheMemory);
+
+    // Cached results, batch buffers and optimizer state are charged as they
+    // are allocated
+    const auto before = metrics;
+    for (int i = 0; i < 10; ++i) {
+        model->inference({static_cast<float>(i), 0.5f, -0.5f});
+    }
+    metrics = model->getMetrics();
+    EXPECT_GT(metrics.cacheBytes, before.cacheBytes);
+    EXPECT_EQ(metrics.cacheMemory - before.cacheMemory, metrics.cacheBytes - before.cacheBytes);
+    std::vector<float> batch(256 * 3, 0.25f);
+    std::vector<float> output(256 * 2);
+    ASSERT_TRUE(model->inferenceBatch(batch.data(), 256, 3, output.data()));
+    // The batch grows the single-row activations it reuses
+    EXPECT_GT(model->getMetrics().scratchMemory, metrics.scratchMemory);
+    EXPECT_GE(model->getMetrics().scratchMemory, 2 * 256 * 64 * sizeof(float));
+    metrics = model->getMetrics();
+    ASSERT_TRUE(model->train({{0.1f, 0.2f, 0.3f, 1.0f, 0.0f}, {0.3f, 0.2f, 0.1f, 0.0f, 1.0f}}));
+    EXPECT_GT(model->getMetrics().scratchMemory, metrics.scratchMemory);
+    EXPECT_EQ(model->getMetrics().weightMemory, metrics.weightMemory);
+
+    // Freed buffers are credited back, even when freed outside the model
+    model->getNetwork().clear();
+    EXPECT_EQ(model->getMetrics().weightMemory, 0u);
+
+    // Weights of a loaded model stay in the mapped file
+    auto source = std::make_shared<AIModel>("memory_source", ModelType::NEURAL_NETWORK);
+    config.parameters.erase("cache_bytes");
+    ASSERT_TRUE(source->initialize(config));
+    const std::string path = ::testing::TempDir() + "memory_model.xyzm";
+    ASSERT_TRUE(source->save(path));
+    auto loaded = loader->loadModel(path);
+    ASSERT_NE(loaded, nullptr);
+    metrics = loaded->getMetrics();
+    EXPECT_GT(metrics.weightBytes, 0u);
+    EXPECT_LT(metrics.weightMemory, metrics.weightBytes);
+    EXPECT_EQ(metrics.cacheMemory, 0u);
+}
+
+TEST_F(ModelTest, SharedModelWeights) {
+    ModelConfig config;
+    config.name = "shared_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "16,128,128,4";
+    auto source = std::make_shared<AIModel>("shared_model", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(source->initialize(config));
+    const std::vector<float> input(16, 0.25f);
+    const auto expected = source->inference(input);
+
+    auto weights = source->shareWeights();
+    ASSERT_NE(weights, nullptr);
+    EXPECT_EQ(source->shareWeights(), weights);
+    EXPECT_EQ(source->inference(input), expected);
+
+    // Instances run on the same tensors with buffers of their own
+    std::vector<std::shared_ptr<AIModel>> instances;
+    for (int i = 0; i < 3; ++i) {
+        config.name = "shared_instance_" + std::to_string(i);
+        auto instance = std::make_shared<AIModel>(config.name, ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(instance->attachWeights(weights));
+        ASSERT_TRUE(instance->initialize(config));
+        EXPECT_EQ(instance->inference(input), expected);
+        const AIModel& view = *instance;
+        EXPECT_EQ(view.getNetwork().getLayers()[1].weights.data(), weights->network.getLayers()[1].weights.data());
+        const auto metrics = instance->getMetrics();
+        EXPECT_EQ(metrics.sharedWeightBytes, weights->weightBytes());
+        EXPECT_EQ(metrics.weightMemory, 0u);
+        instances.push_back(instance);
+    }
+    EXPECT_EQ(source->getMetrics().sharedWeightBytes, 0u);
+    EXPECT_GE(source->getMetrics().weightMemory, weights->weightBytes());
+    auto wrongType = std::make_shared<AIModel>("shared_tree", ModelType::DECISION_TREE);
+    EXPECT_FALSE(wrongType->attachWeights(weights));
+
+    // Parameters that change weights copy only what they change
+    config.name = "shared_int8";
+    config.parameters["precision"] = "int8";
+    auto quantized = std::make_shared<AIModel>(config.name, ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(quantized->attachWeights(weights));
+    ASSERT_TRUE(quantized->initialize(config));
+    EXPECT_GT(quantized->getMetrics().weightMemory, 0u);
+    EXPECT_EQ(instances[0]->inference(input), expected);
+
+    // Training copies the weights first and leaves the other instances alone
+    config.parameters.erase("precision");
+    std::vector<std::vector<float>> data(8, std::vector<float>(20, 0.5f));
+    ASSERT_TRUE(instances[0]->train(data));
+    EXPECT_EQ(instances[0]->getSharedWeights(), nullptr);
+    EXPECT_NE(instances[0]->inference(input), expected);
+    EXPECT_EQ(instances[1]->inference(input), expected);
+    EXPECT_EQ(source->inference(input), expected);
+
+    // The store outlives the model that created it
+    std::weak_ptr<const ModelWeights> store = weights;
+    weights.reset();
+    source.reset();
+    EXPECT_EQ(instances[2]->inference(input), expected);
+    instances.clear();
+    quantized.reset();
+    EXPECT_TRUE(store.expired());
+
+    // Loaded models share their weights, so the loader can create instances
+    // that add no weight memory
+    auto file = std::make_shared<AIModel>("shared_file", ModelType::NEURAL_NETWORK);
+    config.name = "shared_file";
+    ASSERT_TRUE(file->initialize(config));
+    const std::string path = ::testing::TempDir() + "shared_file.xyzm";
+    ASSERT_TRUE(file->save(path));
+    auto loaded = loader->loadModel(path);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_NE(loaded->getSharedWeights(), nullptr);
+    const size_t before = loader->getResidentBytes();
+    config.name = "shared_file_a";
+    auto a = loader->createInstance("shared_file", config);
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(loader->getModel("shared_file_a"), a);
+    EXPECT_EQ(a->inference(input), loaded->inference(input));
+    EXPECT_LT(loader->getResidentBytes() - before, loaded->getMetrics().weightBytes);
+    EXPECT_EQ(loader->createInstance("missing_model", config), nullptr);
+    EXPECT_EQ(loader->createInstance("shared_file", config), nullptr);
+
+    // Input normalization folded into the store is not applied again by
+    // instances initialized with the source's parameters
+    ModelConfig normConfig;
+    normConfig.name = "shared_normalized";
+    normConfig.type = ModelType::NEURAL_NETWORK;
+    normConfig.parameters["layers"] = "3,4,2";
+    normConfig.parameters["input_mean"] = "1,2,3";
+    normConfig.parameters["input_scale"] = "0.5,0.25,2";
+    auto normalized = std::make_shared<AIModel>("shared_normalized", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(normalized->initialize(normConfig));
+    const std::vector<float> row = {0.5f, -1.0f, 2.0f};
+    const auto normExpected = normalized->inference(row);
+    auto normWeights = normalized->shareWeights();
+    ASSERT_TRUE(normWeights->network.isInputNormalized());
+    auto peer = std::make_shared<AIModel>("shared_normalized_peer", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(peer->attachWeights(normWeights));
+    ASSERT_TRUE(peer->initialize(normConfig));
+    EXPECT_EQ(peer->inference(row), normExpected);
+
+    const std::string normPath = ::testing::TempDir() + "shared_normalized.xyzm";
+    ASSERT_TRUE(normalized->save(normPath));
+    ASSERT_NE(loader->loadModel(normPath), nullptr);
+    normConfig.name = "shared_normalized_a";
+    auto normInstance = loader->createInstance("shared_normalized", normConfig);
+    ASSERT_NE(normInstance, nullptr);
+    EXPECT_EQ(normInstance->inference(row), normExpected);
+}
+
+TEST_F(ModelTest, ModelPipeline) {
+    // Normalizer -> tree gate on the normalized x0 -> network
+    auto makeNetwork = [](const std::string& id, const std::string& layers, const std::string& activation) {
+        auto model = std::make_shared<AIModel>(id, ModelType::NEURAL_NETWORK);
+        ModelConfig config;
+        config.name = id;
+        config.type = ModelType::NEURAL_NETWORK;
+        config.parameters["layers"] = layers;
+        config.parameters["output_activation"] = activation;
+        EXPECT_TRUE(model->initialize(config));
+        return model;
+    };
+    auto normalizer = makeNetwork("pipeline_norm", "4,4", "none");
+    auto scorer = makeNetwork("pipeline_net", "4,16,2", "tanh");
+    auto gate = std::make_shared<AIModel>("pipeline_gate", ModelType::DECISION_TREE);
+    gate->getTree() = DecisionTree::stump(0, 0.0f, 0.0f, 1.0f);
+    ModelConfig gateConfig;
+    gateConfig.name = "pipeline_gate";
+    gateConfig.type = ModelType::DECISION_TREE;
+    ASSERT_TRUE(gate->initialize(gateConfig));
+    ASSERT_TRUE(loader->registerModel("pipeline_norm", normalizer));
+    ASSERT_TRUE(loader->registerModel("pipeline_gate", gate));
+    ASSERT_TRUE(loader->registerModel("pipeline_net", scorer));
+
+    ModelPipeline pipeline(*loader);
+    pipeline.addStage("pipeline_norm");
+    pipeline.addGate("pipeline_gate", 0, 0.5f);
+    pipeline.addStage("pipeline_net");
+    ASSERT_TRUE(pipeline.prepare(4));
+    EXPECT_EQ(pipeline.getOutputSize(), 2u);
+    EXPECT_EQ(pipeline.getResultSize(2), 1u);
+    EXPECT_EQ(pipeline.getResultSize(3), 2u);
+
+    const size_t rows = 37;
+    std::vector<float> input(rows * 4);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.83f);
+    }
+
+    // Rows the gate stops skip the network and return the gate's score
+    std::vector<float> expected(rows * 2, 0.0f);
+    std::vector<size_t> expectedStages(rows);
+    size_t stopped = 0;
+    for (size_t r = 0; r < rows; ++r) {
+        float normalized[4], score[1];
+        ASSERT_TRUE(normalizer->inference(&input[r * 4], 4, normalized, 4));
+        ASSERT_TRUE(gate->inference(normalized, 4, score, 1));
+        if (score[0] < 0.5f) {
+            expected[r * 2] = score[0];
+            expectedStages[r] = 2;
+            ++stopped;
+        } else {
+            ASSERT_TRUE(scorer->inference(normalized, 4, &expected[r * 2], 2));
+            expectedStages[r] = 3;
+        }
+    }
+    ASSERT_GT(stopped, 0u);
+    ASSERT_LT(stopped, rows);
+
+    for (size_t r = 0; r < rows; ++r) {
+        float output[2] = {0.0f, 0.0f};
+        size_t stages = 0;
+        ASSERT_TRUE(pipeline.run(&input[r * 4], output, &stages));
+        EXPECT_EQ(stages, expectedStages[r]) << "row " << r;
+        for (size_t o = 0; o < pipeline.getResultSize(stages); ++o) {
+            EXPECT_NEAR(output[o], expected[r * 2 + o], 1e-5f) << "row " << r;
+        }
+    }
+    const auto& counters = pipeline.getStages();
+    EXPECT_EQ(counters[0].rows, rows);
+    EXPECT_EQ(counters[1].rows, rows);
+    EXPECT_EQ(counters[1].exits, stopped);
+    EXPECT_EQ(counters[2].rows, rows - stopped);
+
+    // Batches run each stage once on the rows still going, twice to reuse
+    // the grown buffers
+    pipeline.resetCounters();
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<float> output(rows * 2, 0.0f);
+        std::vector<size_t> stages(rows);
+        ASSERT_TRUE(pipeline.runBatch(input.data(), rows, output.data(), stages.data()));
+        EXPECT_EQ(stages, expectedStages);
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t o = 0; o < pipeline.getResultSize(stages[r]); ++o) {
+                EXPECT_NEAR(output[r * 2 + o], expected[r * 2 + o], 1e-5f) << "row " << r;
+            }
+        }
+    }
+    EXPECT_EQ(counters[2].rows, 2 * (rows - stopped));
+
+    // A gate reading the caller's input, and one that stops every row
+    ModelPipeline cascade(*loader);
+    cascade.addGate("pipeline_gate", 0, 0.5f);
+    cascade.addStage("pipeline_net");
+    ASSERT_TRUE(cascade.prepare(4));
+    std::vector<float> output(rows * 2);
+    std::vector<size_t> stages(rows);
+    ASSERT_TRUE(cascade.runBatch(input.data(), rows, output.data(), stages.data()));
+    for (size_t r = 0; r < rows; ++r) {
+        float single[2];
+        size_t singleStages = 0;
+        ASSERT_TRUE(cascade.run(&input[r * 4], single, &singleStages));
+        EXPECT_EQ(stages[r], singleStages);
+        for (size_t o = 0; o < cascade.getResultSize(singleStages); ++o) {
+            EXPECT_NEAR(output[r * 2 + o], single[o], 1e-5f) << "row " << r;
+        }
+    }
+    ModelPipeline closed(*loader);
+    closed.addGate("pipeline_gate", 0, 2.0f);
+    closed.addStage("pipeline_net");
+    ASSERT_TRUE(closed.prepare(4));
+    ASSERT_TRUE(closed.runBatch(input.data(), rows, output.data(), stages.data()));
+    EXPECT_EQ(closed.getStages()[1].rows, 0u);
+    EXPECT_TRUE(std::all_of(stages.begin(), stages.end(), [](size_t s) { return s == 1; }));
+
+    // Unknown models, width mismatches and a trailing gate are rejected
+    ModelPipeline invalid(*loader);
+    invalid.addStage("pipeline_missing");
+    EXPECT_FALSE(invalid.prepare(4));
+    ModelPipeline mismatched(*loader);
+    mismatched.addStage("pipeline_net");
+    mismatched.addStage("pipeline_norm");
+    EXPECT_FALSE(mismatched.prepare(4));
+    ModelPipeline trailing(*loader);
+    trailing.addStage("pipeline_norm");
+    trailing.addGate("pipeline_gate", 0, 0.5f);
+    EXPECT_FALSE(trailing.prepare(4));
+    EXPECT_FALSE(trailing.run(input.data(), output.data()));
+}
+
+TEST_F(ModelTest, NeuralNetworkForward) {
+    auto model = std::make_shared<AIModel>("nn_test", ModelType::NEURAL_NETWORK);
+
+    ModelConfig config;
+    config.name = "nn_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "5,16,3";
+    config.parameters["output_activation"] = "softmax";
+    ASSERT_TRUE(model->initialize(config));
+
+    auto output = model->inference({0.1f, -0.2f, 0.3f, 0.4f, -0.5f});
+    ASSERT_EQ(output.size(), 3);
+    float sum = 0.0f;
+    for (float v : output) {
+        EXPECT_GE(v, 0.0f);
+        sum += v;
+    }
+    EXPECT_NEAR(sum, 1.0f, 1e-5f);
+
+    // Wrong input width is rejected
+    EXPECT_TRUE(model->inference({1.0f, 2.0f}).empty());
+}
+
+TEST_F(ModelTest, SimdKernelsMatchScalar) {
+    // Odd widths exercise the masked tail paths
+    DenseNetwork simd;
+    simd.configure({37, 19, 7}, kernels::Activation::TANH, kernels::Activation::SIGMOID, 7);
+    DenseNetwork scalar = simd;
+    scalar.setSimdLevel(kernels::SimdLevel::SCALAR);
+
+    std::vector<float> input(37);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i));
+    }
+    std::vector<float> a(7), b(7);
+    simd.forward(input.data(), input.size(), a.data());
+    scalar.forward(input.data(), input.size(), b.data());
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_NEAR(a[i], b[i], 1e-5f);
+    }
+
+    const auto& table = kernels::activeKernels();
+    std::vector<float> values = {-20.0f, -3.0f, -0.5f, 0.0f, 1e-4f, 0.7f, 2.5f, 9.0f, 30.0f};
+    auto tanhValues = values;
+    auto reluValues = values;
+    table.tanh(tanhValues.data(), tanhValues.size());
+    table.relu(reluValues.data(), reluValues.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_NEAR(tanhValues[i], std::tanh(values[i]), 1e-6f);
+        EXPECT_EQ(reluValues[i], std::max(values[i], 0.0f));
+    }
+}
+
+TEST_F(ModelTest, FixedShapeKernels) {
+    // Every specialized shape at every level the host runs, against the
+    // generic scalar GEMM
+    const auto& reference = kernels::getKernels(kernels::SimdLevel::SCALAR);
+    const size_t batch = 7;
+    for (auto level : {kernels::SimdLevel::SCALAR, kernels::SimdLevel::AVX2, kernels::SimdLevel::AVX512}) {
+        const auto& table = kernels::getKernels(level);
+        for (size_t rows : kernels::FIXED_WIDTHS) {
+            for (size_t cols : kernels::FIXED_WIDTHS) {
+              for (auto act : {kernels::Activation::NONE, kernels::Activation::RELU, kernels::Activation::TANH}) {
+                auto fixed = kernels::findFixedKernels(table.level, rows, cols, act);
+                ASSERT_TRUE(fixed);
+                EXPECT_EQ(fixed.activation, act);
+                AlignedBuffer<float> weights(rows * cols);
+                std::vector<float> bias(rows), x(batch * cols);
+                for (size_t i = 0; i < weights.size(); ++i) {
+                    weights[i] = std::sin(static_cast<float>(i) * 0.7f);
+                }
+                for (size_t i = 0; i < rows; ++i) {
+                    bias[i] = static_cast<float>(i) * 0.01f;
+                }
+                for (size_t i = 0; i < x.size(); ++i) {
+                    x[i] = std::cos(static_cast<float>(i) * 0.3f);
+                }
+                std::vector<float> expected(batch * rows), batched(batch * rows), single(rows);
+                reference.gemm(weights.data(), cols, bias.data(), x.data(), cols, expected.data(), rows,
+                               batch, rows, cols);
+                kernels::applyActivation(reference, act, expected.data(), expected.size());
+                fixed.gemm(weights.data(), cols, bias.data(), x.data(), cols, batched.data(), rows,
+                           batch, rows, cols);
+                fixed.gemv(weights.data(), cols, bias.data(), x.data() + cols, single.data(), rows, cols);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_NEAR(batched[i], expected[i], 1e-4f) << rows << "x" << cols;
+                }
+                for (size_t r = 0; r < rows; ++r) {
+                    ASSERT_NEAR(single[r], expected[rows + r], 1e-4f) << rows << "x" << cols;
+                }
+              }
+            }
+        }
+    }
+    // Activations without an in-register epilogue are left to the caller
+    EXPECT_EQ(kernels::findFixedKernels(kernels::SimdLevel::SCALAR, 16, 16, kernels::Activation::SIGMOID).activation,
+              kernels::Activation::NONE);
+    EXPECT_FALSE(kernels::findFixedKernels(kernels::SimdLevel::SCALAR, 16, 5));
+    EXPECT_FALSE(kernels::findFixedKernels(kernels::SimdLevel::SCALAR, 48, 64));
+
+    // Only layers with both widths in the list are specialized, and the
+    // result matches the generic kernels
+    auto model = std::make_shared<AIModel>("fixed_test", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "fixed_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "16,64,32,3";
+    ASSERT_TRUE(model->initialize(config));
+    EXPECT_EQ(model->getNetwork().specializedLayerCount(), 2u);
+
+    DenseNetwork generic;
+    generic.configure({16, 64, 32, 3}, kernels::Activation::RELU, kernels::Activation::TANH, 42);
+    EXPECT_EQ(generic.specializedLayerCount(), 0u);
+    std::vector<float> rows(5 * 16);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = std::sin(static_cast<float>(i) * 0.11f);
+    }
+    std::vector<float> expected(5 * 3), actual(5 * 3);
+    generic.forwardBatch(rows.data(), 5, 16, expected.data());
+    model->getNetwork().forwardBatch(rows.data(), 5, 16, actual.data());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-5f);
+    }
+    auto output = model->inference(std::vector<float>(rows.begin() + 16, rows.begin() + 32));
+    ASSERT_EQ(output.size(), 3u);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_NEAR(output[i], expected[3 + i], 1e-5f);
+    }
+
+    // Switching level keeps the layers specialized, now at the new level
+    model->getNetwork().setSimdLevel(kernels::SimdLevel::SCALAR);
+    EXPECT_EQ(model->getNetwork().specializedLayerCount(), 2u);
+    model->getNetwork().forwardBatch(rows.data(), 5, 16, actual.data());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-5f);
+    }
+}
+
+TEST_F(ModelTest, OperatorFusion) {
+    // Tile-fused kernels on odd shapes, against GEMM plus a separate
+    // activation pass
+    const auto& reference = kernels::getKernels(kernels::SimdLevel::SCALAR);
+    const size_t batch = 6, rows = 13, cols = 21;
+    const size_t ld = kernels::paddedStride(cols);
+    AlignedBuffer<float> weights(rows * ld);
+    std::vector<float> bias(rows), x(batch * cols);
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = std::sin(static_cast<float>(i) * 0.37f);
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        bias[i] = static_cast<float>(i) * 0.05f - 0.3f;
+    }
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = std::cos(static_cast<float>(i) * 0.19f);
+    }
+    for (auto level : {kernels::SimdLevel::SCALAR, kernels::SimdLevel::AVX2, kernels::SimdLevel::AVX512}) {
+        const auto& table = kernels::getKernels(level);
+        EXPECT_FALSE(kernels::fusedLayerKernels(table, kernels::Activation::NONE));
+        EXPECT_FALSE(kernels::fusedLayerKernels(table, kernels::Activation::SOFTMAX));
+        for (auto act : {kernels::Activation::RELU, kernels::Activation::TANH}) {
+            auto fused = kernels::fusedLayerKernels(table, act);
+            ASSERT_TRUE(fused);
+            EXPECT_EQ(fused.activation, act);
+            // Single rows activate in the GEMV epilogue, not in a second pass
+            EXPECT_NE(fused.gemv, table.gemv);
+            std::vector<float> expected(batch * rows), batched(batch * rows), single(rows);
+            reference.gemm(weights.data(), ld, bias.data(), x.data(), cols, expected.data(), rows,
+                           batch, rows, cols);
+            kernels::applyActivation(reference, act, expected.data(), expected.size());
+            fused.gemm(weights.data(), ld, bias.data(), x.data(), cols, batched.data(), rows, batch, rows, cols);
+            fused.gemv(weights.data(), ld, bias.data(), x.data() + 5 * cols, single.data(), rows, cols);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_NEAR(batched[i], expected[i], 1e-5f);
+            }
+            for (size_t r = 0; r < rows; ++r) {
+                ASSERT_NEAR(single[r], expected[5 * rows + r], 1e-5f);
+            }
+        }
+    }
+
+    // A model with input normalization folds it into the first layer and
+    // fuses both activations; results match normalizing by hand and running
+    // an unfused network with the same weights
+    auto model = std::make_shared<AIModel>("fusion_test", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "fusion_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "4,10,3";
+    config.parameters["input_mean"] = "1,-2,0.5,0";
+    config.parameters["input_scale"] = "0.5,2,1,4";
+    ASSERT_TRUE(model->initialize(config));
+    const DenseNetwork& fusedNetwork = model->getNetwork();
+    EXPECT_FALSE(fusedNetwork.hasInputNormalization());
+    EXPECT_EQ(fusedNetwork.fusedLayerCount(), 2u);
+
+    DenseNetwork plain;
+    plain.configure({4, 10, 3}, kernels::Activation::RELU, kernels::Activation::TANH, 42);
+    EXPECT_EQ(plain.fusedLayerCount(), 0u);
+    const std::vector<float> mean = {1.0f, -2.0f, 0.5f, 0.0f};
+    const std::vector<float> scale = {0.5f, 2.0f, 1.0f, 4.0f};
+    const size_t count = 5;
+    std::vector<float> input(count * 4), normalized(count * 4);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.9f) * 3.0f;
+        normalized[i] = (input[i] - mean[i % 4]) * scale[i % 4];
+    }
+    std::vector<float> expected(count * 3), actual(count * 3);
+    plain.forwardBatch(normalized.data(), count, 4, expected.data());
+    model->getNetwork().forwardBatch(input.data(), count, 4, actual.data());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-5f);
+    }
+    for (size_t r = 0; r < count; ++r) {
+        auto output = model->inference(std::vector<float>(input.begin() + r * 4, input.begin() + r * 4 + 4));
+        ASSERT_EQ(output.size(), 3u);
+        for (size_t i = 0; i < 3; ++i) {
+            EXPECT_NEAR(output[i], expected[r * 3 + i], 1e-5f);
+        }
+    }
+
+    // The folded normalization is saved with the weights and not applied
+    // again on load
+    EXPECT_TRUE(fusedNetwork.isInputNormalized());
+    const std::string foldedPath = ::testing::TempDir() + "fusion_folded.xyzm";
+    ASSERT_TRUE(model->save(foldedPath));
+    auto reloaded = loader->loadModel(foldedPath);
+    ASSERT_NE(reloaded, nullptr);
+    const AIModel& reloadedView = *reloaded;
+    EXPECT_TRUE(reloadedView.getNetwork().isInputNormalized());
+    EXPECT_FALSE(reloadedView.getNetwork().hasInputNormalization());
+    for (size_t r = 0; r < count; ++r) {
+        auto output = reloaded->inference(std::vector<float>(input.begin() + r * 4, input.begin() + r * 4 + 4));
+        ASSERT_EQ(output.size(), 3u);
+        for (size_t i = 0; i < 3; ++i) {
+            EXPECT_NEAR(output[i], expected[r * 3 + i], 1e-5f);
+        }
+    }
+
+    // An int8 first layer keeps the normalization as a separate pass, in
+    // both the network and the compiled plan
+    config.parameters.erase("input_mean");
+    config.parameters.erase("input_scale");
+    config.parameters["precision"] = "int8";
+    auto quantized = std::make_shared<AIModel>("fusion_int8", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(quantized->initialize(config));
+    ASSERT_TRUE(quantized->getNetwork().isQuantized());
+    std::vector<float> expectedInt8(count * 3);
+    quantized->getNetwork().forwardBatch(normalized.data(), count, 4, expectedInt8.data());
+    quantized->getNetwork().setInputNormalization(mean, scale);
+    EXPECT_EQ(quantized->getNetwork().fuse(), 0u);
+    EXPECT_TRUE(quantized->getNetwork().hasInputNormalization());
+    quantized->getNetwork().forwardBatch(input.data(), count, 4, actual.data());
+    for (size_t i = 0; i < expectedInt8.size(); ++i) {
+        EXPECT_NEAR(actual[i], expectedInt8[i], 1e-6f);
+    }
+    auto output = quantized->inference(std::vector<float>(input.begin(), input.begin() + 4));
+    ASSERT_EQ(output.size(), 3u);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_NEAR(output[i], expectedInt8[i], 1e-6f);
+    }
+
+    // The unfused normalization is saved with the network
+    const std::string path = ::testing::TempDir() + "fusion_model.xyzm";
+    ASSERT_TRUE(quantized->save(path));
+    auto loaded = std::make_shared<AIModel>("fusion_loaded", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(loaded->load(path));
+    ASSERT_TRUE(loaded->initialize(config));
+    EXPECT_TRUE(loaded->getNetwork().hasInputNormalization());
+    EXPECT_EQ(loaded->inference(std::vector<float>(input.begin(), input.begin() + 4)), output);
+
+    config.parameters["precision"] = "float32";
+    config.parameters["input_mean"] = "1,-2,0.5,0";
+    config.parameters["input_scale"] = "1,2";
+    auto mismatched = std::make_shared<AIModel>("fusion_bad", ModelType::NEURAL_NETWORK);
+    EXPECT_FALSE(mismatched->initialize(config));
+}
+
+TEST_F(ModelTest, InferencePlan) {
+    auto model = std::make_shared<AIModel>("plan_test", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "plan_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "6,16,16,4";
+    config.parameters["output_activation"] = "softmax";
+    ASSERT_TRUE(model->initialize(config));
+    EXPECT_TRUE(model->getPlan().valid());
+    EXPECT_EQ(model->getPlan().stepCount(), 3u);
+    EXPECT_TRUE(model->getPlan().acceptsInput(6));
+    EXPECT_FALSE(model->getPlan().acceptsInput(5));
+
+    // The compiled plan agrees with the engine's own forward pass
+    std::vector<float> input = {0.3f, -0.1f, 0.8f, 0.0f, -0.6f, 0.2f};
+    std::vector<float> expected(4);
+    model->getNetwork().forward(input.data(), input.size(), expected.data());
+    auto output = model->inference(input);
+    ASSERT_EQ(output.size(), 4u);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_NEAR(output[i], expected[i], 1e-6f);
+    }
+    EXPECT_TRUE(model->inference(std::vector<float>()).empty());
+    EXPECT_TRUE(model->inference(std::vector<float>(7, 0.0f)).empty());
+
+    // Changing the engine through the accessor recompiles before next use
+    model->getNetwork().configure({6, 3}, kernels::Activation::RELU, kernels::Activation::NONE, 3);
+    EXPECT_FALSE(model->getPlan().valid());
+    std::vector<float> reconfigured(3);
+    model->getNetwork().forward(input.data(), input.size(), reconfigured.data());
+    output = model->inference(input);
+    ASSERT_EQ(output.size(), 3u);
+    EXPECT_EQ(model->getPlan().stepCount(), 1u);
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_NEAR(output[i], reconfigured[i], 1e-6f);
+    }
+
+    // Custom models pass any width through
+    auto custom = std::make_shared<AIModel>("plan_custom", ModelType::CUSTOM);
+    config.type = ModelType::CUSTOM;
+    ASSERT_TRUE(custom->initialize(config));
+    EXPECT_EQ(custom->inference({1.0f, 2.0f, 3.0f}), std::vector<float>({1.0f, 2.0f, 3.0f}));
+}
+
+TEST_F(ModelTest, ConcurrentInference) {
+    ModelConfig config;
+    config.name = "concurrent_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "8,64,64,4";
+    config.parameters["sparse_input"] = "true";
+    auto plain = std::make_shared<AIModel>("concurrent_float", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(plain->initialize(config));
+    // An int8 first layer keeps the normalization as a step of its own
+    config.parameters["input_mean"] = "0.1,0,0,0,0,0,0,-0.1";
+    config.parameters["input_scale"] = "2,1,1,1,1,1,1,0.5";
+    config.parameters["precision"] = "int8";
+    auto quantized = std::make_shared<AIModel>("concurrent_int8", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(quantized->initialize(config));
+
+    const size_t rows = 64;
+    std::vector<float> input(rows * 8);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.61f);
+    }
+
+    for (const auto& model : {plain, quantized}) {
+        std::vector<float> expected(rows * 4);
+        for (size_t r = 0; r < rows; ++r) {
+            ASSERT_TRUE(model->inference(&input[r * 8], 8, &expected[r * 4], 4));
+        }
+        // Each thread runs batches of its own size, so their buffers need
+        // different sizes
+        std::vector<std::vector<float>> expectedBatch(4);
+        for (size_t t = 0; t < 4; ++t) {
+            expectedBatch[t].resize((t + 1) * 16 * 4);
+            ASSERT_TRUE(model->inferenceBatch(input.data(), (t + 1) * 16, 8, expectedBatch[t].data()));
+        }
+
+        // Threads share the model, and the first calls race to recompile
+        // the plan the accessor invalidated
+        model->getNetwork();
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < 4; ++t) {
+            workers.emplace_back([&, t]() {
+                float output[4];
+                std::vector<float> batch(expectedBatch[t].size());
+                for (int pass = 0; pass < 50; ++pass) {
+                    for (size_t i = 0; i < rows; ++i) {
+                        const size_t r = (i + t * 17) % rows;
+                        if (!model->inference(&input[r * 8], 8, output, 4) ||
+                            std::memcmp(output, &expected[r * 4], sizeof(output)) != 0) {
+                            ++mismatches;
+                        }
+                    }
+                    if (!model->inferenceBatch(input.data(), (t + 1) * 16, 8, batch.data()) ||
+                        batch != expectedBatch[t]) {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        EXPECT_EQ(mismatches.load(), 0) << model->getModelId();
+        EXPECT_TRUE(model->getPlan().valid());
+    }
+
+    // Sparse rows: networks run the sparse copy of their first layer, trees
+    // read a dense feature row the input is scattered into. SVMs evaluate
+    // kernel rows for dense and sparse inputs alike.
+    std::vector<TreeNode> nodes(5);
+    nodes[0] = {120, 0.0f, 1, 2, {}};
+    nodes[1].value = {-1.0f};
+    nodes[2] = {277, -0.5f, 3, 4, {}};
+    nodes[3].value = {1.0f};
+    nodes[4].value = {2.0f};
+    auto tree = std::make_shared<AIModel>("concurrent_tree", ModelType::DECISION_TREE);
+    tree->getTree().build(nodes, 1);
+    ModelConfig treeConfig;
+    treeConfig.name = "concurrent_tree";
+    treeConfig.type = ModelType::DECISION_TREE;
+    ASSERT_TRUE(tree->initialize(treeConfig));
+    std::vector<float> vectors(20 * 8), coef(2 * 20);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        vectors[i] = std::sin(static_cast<float>(i) * 0.29f);
+    }
+    for (size_t i = 0; i < coef.size(); ++i) {
+        coef[i] = std::cos(static_cast<float>(i) * 1.1f);
+    }
+    SvmParams params;
+    params.gamma = 0.2f;
+    auto svm = std::make_shared<AIModel>("concurrent_svm", ModelType::SVM);
+    svm->getSvm().build(params, vectors, 20, 8, coef, {0.5f, -0.25f});
+    ModelConfig svmConfig;
+    svmConfig.name = "concurrent_svm";
+    svmConfig.type = ModelType::SVM;
+    ASSERT_TRUE(svm->initialize(svmConfig));
+
+    const uint32_t netIndices[] = {1, 3, 6};
+    std::vector<uint32_t> treeIndices(rows * 3);
+    std::vector<float> values(rows * 3);
+    for (size_t r = 0; r < rows; ++r) {
+        treeIndices[r * 3] = static_cast<uint32_t>(r);
+        treeIndices[r * 3 + 1] = 120;
+        treeIndices[r * 3 + 2] = 277;
+        for (size_t k = 0; k < 3; ++k) {
+            values[r * 3 + k] = input[r * 8 + netIndices[k]];
+        }
+    }
+    auto netRow = [&](size_t r) { return SparseVector{netIndices, &values[r * 3], 3, 8}; };
+    auto treeRow = [&](size_t r) { return SparseVector{&treeIndices[r * 3], &values[r * 3], 3, 300}; };
+    std::vector<float> expectedNet(rows * 4), expectedTree(rows), expectedSvm(rows * 2), expectedSparseSvm(rows * 2);
+    for (size_t r = 0; r < rows; ++r) {
+        ASSERT_TRUE(plain->inference(netRow(r), &expectedNet[r * 4], 4));
+        ASSERT_TRUE(tree->inference(treeRow(r), &expectedTree[r], 1));
+        ASSERT_TRUE(svm->inference(&input[r * 8], 8, &expectedSvm[r * 2], 2));
+        ASSERT_TRUE(svm->inference(netRow(r), &expectedSparseSvm[r * 2], 2));
+    }
+    EXPECT_NE(std::count(expectedTree.begin(), expectedTree.end(), 1.0f), 0);
+    EXPECT_NE(std::count(expectedTree.begin(), expectedTree.end(), 2.0f), 0);
+
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < 4; ++t) {
+        workers.emplace_back([&, t]() {
+            float output[4];
+            for (int pass = 0; pass < 50; ++pass) {
+                for (size_t i = 0; i < rows; ++i) {
+                    const size_t r = (i + t * 17) % rows;
+                    if (!plain->inference(netRow(r), output, 4) ||
+                        std::memcmp(output, &expectedNet[r * 4], sizeof(output)) != 0) {
+                        ++mismatches;
+                    }
+                    if (!tree->inference(treeRow(r), output, 1) || output[0] != expectedTree[r]) {
+                        ++mismatches;
+                    }
+                    if (!svm->inference(&input[r * 8], 8, output, 2) ||
+                        std::memcmp(output, &expectedSvm[r * 2], 2 * sizeof(float)) != 0) {
+                        ++mismatches;
+                    }
+                    if (!svm->inference(netRow(r), output, 2) ||
+                        std::memcmp(output, &expectedSparseSvm[r * 2], 2 * sizeof(float)) != 0) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0);
+}
+
+TEST_F(ModelTest, BatchInference) {
+    auto model = std::make_shared<AIModel>("batch_test", ModelType::NEURAL_NETWORK);
+
+    ModelConfig config;
+    config.name = "batch_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "21,33,5";
+    ASSERT_TRUE(model->initialize(config));
+
+    const size_t rows = 7;
+    const size_t width = 21;
+    std::vector<float> input(rows * width);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::cos(static_cast<float>(i) * 0.37f);
+    }
+
+    ASSERT_EQ(model->getOutputSize(width), 5);
+    std::vector<float> output(rows * 5);
+    ASSERT_TRUE(model->inferenceBatch(input.data(), rows, width, output.data()));
+
+    // Each batched row matches single-row inference
+    for (size_t r = 0; r < rows; ++r) {
+        std::vector<float> row(input.begin() + r * width, input.begin() + (r + 1) * width);
+        auto expected = model->inference(row);
+        ASSERT_EQ(expected.size(), 5);
+        for (size_t i = 0; i < 5; ++i) {
+            EXPECT_NEAR(output[r * 5 + i], expected[i], 1e-5f);
+        }
+    }
+
+    // Batches larger than MAX_BATCH_SIZE are rejected
+    std::vector<float> big((constants::MAX_BATCH_SIZE + 1) * width);
+    std::vector<float> bigOut((constants::MAX_BATCH_SIZE + 1) * 5);
+    EXPECT_FALSE(model->inferenceBatch(big.data(), constants::MAX_BATCH_SIZE + 1, width, bigOut.data()));
+}
+
+TEST_F(ModelTest, InferenceIntoCallerBuffer) {
+    auto model = std::make_shared<AIModel>("buffer_test", ModelType::NEURAL_NETWORK);
+
+    ModelConfig config;
+    config.name = "buffer_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "4,8,2";
+    ASSERT_TRUE(model->initialize(config));
+
+    std::vector<float> input = {0.5f, -1.0f, 0.25f, 2.0f};
+    auto expected = model->inference(input);
+
+    float output[2] = {0.0f, 0.0f};
+    ASSERT_TRUE(model->inference(input.data(), input.size(), output, 2));
+    EXPECT_FLOAT_EQ(output[0], expected[0]);
+    EXPECT_FLOAT_EQ(output[1], expected[1]);
+
+    // Undersized output buffers are rejected
+    EXPECT_FALSE(model->inference(input.data(), input.size(), output, 1));
+}
+
+TEST_F(ModelTest, InferenceCache) {
+    auto model = std::make_shared<AIModel>("cache_test", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "cache_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "4,8,2";
+    config.parameters["cache_bytes"] = "4096";
+    config.parameters["cache_shards"] = "2";
+    ASSERT_TRUE(model->initialize(config));
+
+    auto uncached = std::make_shared<AIModel>("cache_reference", ModelType::NEURAL_NETWORK);
+    config.parameters.erase("cache_bytes");
+    ASSERT_TRUE(uncached->initialize(config));
+    EXPECT_EQ(uncached->getMetrics().cacheMisses, 0u);
+
+    // A repeated input is served from the cache with the same result
+    const std::vector<float> input = {0.5f, -1.0f, 0.25f, 2.0f};
+    const auto expected = uncached->inference(input);
+    EXPECT_EQ(model->inference(input), expected);
+    EXPECT_EQ(model->inference(input), expected);
+    float output[2] = {0.0f, 0.0f};
+    ASSERT_TRUE(model->inference(input.data(), input.size(), output, 2));
+    EXPECT_EQ(std::vector<float>(output, output + 2), expected);
+    auto metrics = model->getMetrics();
+    EXPECT_EQ(metrics.cacheMisses, 1u);
+    EXPECT_EQ(metrics.cacheHits, 2u);
+    EXPECT_EQ(metrics.cacheEvictions, 0u);
+    EXPECT_GT(metrics.cacheBytes, 0u);
+
+    // Distinct inputs beyond the budget evict, and the cache stays in budget
+    // and correct
+    for (int i = 0; i < 200; ++i) {
+        const std::vector<float> x = {static_cast<float>(i), 0.5f, -0.25f, 1.0f};
+        EXPECT_EQ(model->inference(x), uncached->inference(x));
+    }
+    metrics = model->getMetrics();
+    EXPECT_GT(metrics.cacheEvictions, 0u);
+    EXPECT_LE(metrics.cacheBytes, 4096u);
+
+    // Changing the engine drops the cached results
+    model->getNetwork().getLayers()[0].bias[0] += 1.0f;
+    uncached->getNetwork().getLayers()[0].bias[0] += 1.0f;
+    const auto misses = model->getMetrics().cacheMisses;
+    EXPECT_EQ(model->inference(input), uncached->inference(input));
+    EXPECT_EQ(model->getMetrics().cacheMisses, misses + 1);
+
+    // Hashing covers every input byte, including a short tail
+    const float a[3] = {1.0f, 2.0f, 3.0f};
+    const float b[3] = {1.0f, 2.0f, 3.5f};
+    EXPECT_NE(InferenceCache::hashInput(a, 3), InferenceCache::hashInput(b, 3));
+    EXPECT_NE(InferenceCache::hashInput(a, 2), InferenceCache::hashInput(a, 3));
+}
+
+TEST_F(ModelTest, DecisionTreeEvaluation) {
+    // x0 > 0 ? (x2 > 1 ? 3 : 2) : (x1 > -1 ? 1 : 0)
+    std::vector<TreeNode> nodes(7);
+    nodes[0] = {0, 0.0f, 1, 2, {}};
+    nodes[1] = {1, -1.0f, 3, 4, {}};
+    nodes[2] = {2, 1.0f, 5, 6, {}};
+    nodes[3].value = {0.0f};
+    nodes[4].value = {1.0f};
+    nodes[5].value = {2.0f};
+    nodes[6].value = {3.0f};
+
+    auto model = std::make_shared<AIModel>("tree_test", ModelType::DECISION_TREE);
+    model->getTree().build(nodes, 1);
+    ModelConfig config;
+    config.name = "tree_model";
+    config.type = ModelType::DECISION_TREE;
+    ASSERT_TRUE(model->initialize(config));
+    EXPECT_EQ(model->getTree().getDepth(), 2u);
+
+    auto expected = [](const float* x) {
+        return x[0] > 0.0f ? (x[2] > 1.0f ? 3.0f : 2.0f) : (x[1] > -1.0f ? 1.0f : 0.0f);
+    };
+
+    // Odd row count covers the vector body and the scalar tail
+    const size_t rows = 37;
+    std::vector<float> input(rows * 3);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 1.7f) * 2.0f;
+    }
+    std::vector<float> output(rows);
+    ASSERT_TRUE(model->inferenceBatch(input.data(), rows, 3, output.data()));
+    for (size_t r = 0; r < rows; ++r) {
+        EXPECT_EQ(output[r], expected(&input[r * 3]));
+        auto single = model->inference({input[r * 3], input[r * 3 + 1], input[r * 3 + 2]});
+        EXPECT_EQ(single[0], output[r]);
+    }
+
+    // Missing values go left; inputs narrower than the tree are rejected
+    EXPECT_EQ(model->inference({std::nanf(""), 0.0f, 0.0f})[0], 1.0f);
+    EXPECT_TRUE(model->inference({1.0f, 1.0f}).empty());
+
+    // Round trip through the model file format
+    const std::string path = ::testing::TempDir() + "tree_model.xyzm";
+    ASSERT_TRUE(model->save(path));
+    auto loaded = std::make_shared<AIModel>("tree_loaded", ModelType::DECISION_TREE);
+    ASSERT_TRUE(loaded->load(path));
+    ASSERT_TRUE(loaded->initialize(config));
+    std::vector<float> reloaded(rows);
+    ASSERT_TRUE(loaded->inferenceBatch(input.data(), rows, 3, reloaded.data()));
+    EXPECT_EQ(reloaded, output);
+
+    // Rows take exactly `depth` steps, so a depth that would spin or stop on
+    // internal nodes is rejected, as are links that revisit a node
+    patchAttribute(path, "tree.depth", "9");
+    auto corrupt = std::make_shared<AIModel>("tree_corrupt", ModelType::DECISION_TREE);
+    EXPECT_FALSE(corrupt->load(path));
+    patchAttribute(path, "tree.depth", "1");
+    EXPECT_FALSE(corrupt->load(path));
+    patchAttribute(path, "tree.depth", "2");
+    patchTensorInt(path, "tree.child", 1, 0);
+    EXPECT_FALSE(corrupt->load(path));
+
+    // Leaves are evaluated on every remaining step, so a leaf reading any
+    // feature but 0 is rejected; the last node is a leaf
+    ASSERT_TRUE(model->save(path));
+    patchTensorInt(path, "tree.feature", model->getTree().getNodeCount() - 1, 1 << 30);
+    EXPECT_FALSE(corrupt->load(path));
+}
+
+TEST_F(ModelTest, RandomForestEvaluation) {
+    // Trees of depth 1 and 2 with two outputs each, so groups of trees walk
+    // different depths together
+    std::vector<DecisionTree> trees;
+    for (int t = 0; t < 21; ++t) {
+        std::vector<TreeNode> nodes(t % 3 == 0 ? 5 : 3);
+        const float threshold = static_cast<float>(t % 5) * 0.3f - 0.6f;
+        nodes[0] = {t % 4, threshold, 1, 2, {}};
+        nodes[1].value = {static_cast<float>(t), 0.5f};
+        nodes[2].value = {-static_cast<float>(t), 1.5f};
+        if (nodes.size() == 5) {
+            nodes[2] = {(t + 1) % 4, -threshold, 3, 4, {}};
+            nodes[3].value = {1.0f, static_cast<float>(t)};
+            nodes[4].value = {2.0f, -1.0f};
+        }
+        DecisionTree tree;
+        tree.build(nodes, 2);
+        trees.push_back(std::move(tree));
+    }
+
+    auto model = std::make_shared<AIModel>("forest_test", ModelType::RANDOM_FOREST);
+    model->getForest().build(trees);
+    ModelConfig config;
+    config.name = "forest_model";
+    config.type = ModelType::RANDOM_FOREST;
+    ASSERT_TRUE(model->initialize(config));
+    EXPECT_EQ(model->getOutputSize(4), 2u);
+
+    const size_t rows = 250;
+    std::vector<float> input(rows * 4);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.37f);
+    }
+    std::vector<float> output(rows * 2);
+    ASSERT_TRUE(model->inferenceBatch(input.data(), rows, 4, output.data()));
+
+    for (size_t r = 0; r < rows; ++r) {
+        float expected[2] = {0.0f, 0.0f};
+        for (const auto& tree : trees) {
+            float leaf[2];
+            tree.predict(&input[r * 4], leaf);
+            expected[0] += leaf[0] / trees.size();
+            expected[1] += leaf[1] / trees.size();
+        }
+        EXPECT_NEAR(output[r * 2], expected[0], 1e-4f);
+        EXPECT_NEAR(output[r * 2 + 1], expected[1], 1e-4f);
+
+        float single[2];
+        ASSERT_TRUE(model->inference(&input[r * 4], 4, single, 2));
+        EXPECT_NEAR(single[0], output[r * 2], 1e-5f);
+        EXPECT_NEAR(single[1], output[r * 2 + 1], 1e-5f);
+    }
+
+    // Round trip through the model file format
+    const std::string path = ::testing::TempDir() + "forest_model.xyzm";
+    ASSERT_TRUE(model->save(path));
+    auto loaded = std::make_shared<AIModel>("forest_loaded", ModelType::RANDOM_FOREST);
+    ASSERT_TRUE(loaded->load(path));
+    ASSERT_TRUE(loaded->initialize(config));
+    EXPECT_EQ(loaded->getForest().getTreeCount(), trees.size());
+    std::vector<float> reloaded(rows * 2);
+    ASSERT_TRUE(loaded->inferenceBatch(input.data(), rows, 4, reloaded.data()));
+    EXPECT_EQ(reloaded, output);
+
+    // Each tree takes exactly its stored depth of steps, so depths that
+    // would spin or stop on internal nodes are rejected; the first tree has
+    // depth 2. So are trees sharing nodes: the first tree's root is linked
+    // to the second tree's.
+    auto corrupt = std::make_shared<AIModel>("forest_corrupt", ModelType::RANDOM_FOREST);
+    patchTensorInt(path, "forest.depths", 0, 1 << 30);
+    EXPECT_FALSE(corrupt->load(path));
+    patchTensorInt(path, "forest.depths", 0, 1);
+    EXPECT_FALSE(corrupt->load(path));
+    patchTensorInt(path, "forest.depths", 0, 2);
+    patchTensorInt(path, "forest.child", 0, 5);
+    EXPECT_FALSE(corrupt->load(path));
+
+    // The walks read leaf features too, so a leaf reading any feature but 0
+    // is rejected; the last node of the arena is a leaf
+    ASSERT_TRUE(model->save(path));
+    patchTensorInt(path, "forest.feature", model->getForest().getNodeCount() - 1, 1 << 30);
+    EXPECT_FALSE(corrupt->load(path));
+}
+
+TEST_F(ModelTest, RandomForestTreeSplit) {
+    // Few rows through many trees: with more than one thread the trees are
+    // split across workers, and the partial sums must come back the same on
+    // every call whichever worker finishes first
+    std::vector<DecisionTree> trees;
+    for (int t = 0; t < 600; ++t) {
+        std::vector<TreeNode> nodes(3);
+        nodes[0] = {t % 4, static_cast<float>(t % 7) * 0.2f - 0.6f, 1, 2, {}};
+        nodes[1].value = {std::sin(static_cast<float>(t)) * 0.1f};
+        nodes[2].value = {std::cos(static_cast<float>(t)) * 0.3f};
+        DecisionTree tree;
+        tree.build(nodes, 1);
+        trees.push_back(std::move(tree));
+    }
+    RandomForest forest;
+    forest.build(trees);
+
+    const size_t rows = 40;
+    std::vector<float> input(rows * 4);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.9f);
+    }
+    std::vector<float> first(rows);
+    forest.predictBatch(input.data(), rows, 4, first.data());
+    for (int pass = 0; pass < 20; ++pass) {
+        std::vector<float> again(rows);
+        forest.predictBatch(input.data(), rows, 4, again.data());
+        ASSERT_EQ(std::memcmp(again.data(), first.data(), rows * sizeof(float)), 0);
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        float single = 0.0f;
+        forest.predict(&input[r * 4], &single);
+        EXPECT_NEAR(single, first[r], 1e-3f);
+    }
+}
+
+TEST_F(ModelTest, ThreadPoolParallelFor) {
+    utils::ThreadPool pool(4);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+    });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 1000);
+
+    EXPECT_THROW(pool.parallelFor(100, 1, [](size_t begin, size_t) {
+        if (begin == 0) {
+            throw std::runtime_error("chunk failed");
+        }
+    }), std::runtime_error);
+}
+
+TEST_F(ModelTest, SvmKernels) {
+    const size_t count = 37, dim = 5, outputs = 2, rows = 70;
+    std::vector<float> vectors(count * dim), coef(outputs * count), input(rows * dim);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        vectors[i] = std::sin(static_cast<float>(i) * 0.91f);
+    }
+    for (size_t i = 0; i < coef.size(); ++i) {
+        coef[i] = std::cos(static_cast<float>(i) * 1.3f);
+    }
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.53f + 0.2f);
+    }
+    const std::vector<float> bias = {0.25f, -0.5f};
+
+    for (auto kernel : {SvmKernel::LINEAR, SvmKernel::POLYNOMIAL, SvmKernel::RBF}) {
+        SvmParams params;
+        params.kernel = kernel;
+        params.gamma = 0.4f;
+        params.coef0 = 1.0f;
+        params.degree = 3;
+
+        auto model = std::make_shared<AIModel>("svm_test", ModelType::SVM);
+        model->getSvm().build(params, vectors, count, dim, coef, bias);
+        ModelConfig config;
+        config.name = "svm_model";
+        config.type = ModelType::SVM;
+        ASSERT_TRUE(model->initialize(config));
+        // Linear SVMs keep only the collapsed weight vector
+        EXPECT_EQ(model->getSvm().supportVectorCount(), kernel == SvmKernel::LINEAR ? 0u : count);
+
+        std::vector<float> output(rows * outputs);
+        ASSERT_TRUE(model->inferenceBatch(input.data(), rows, dim, output.data()));
+
+        for (size_t r = 0; r < rows; ++r) {
+            const float* x = &input[r * dim];
+            for (size_t o = 0; o < outputs; ++o) {
+                double expected = bias[o];
+                for (size_t j = 0; j < count; ++j) {
+                    double dot = 0.0, dist = 0.0;
+                    for (size_t k = 0; k < dim; ++k) {
+                        dot += x[k] * vectors[j * dim + k];
+                        dist += (x[k] - vectors[j * dim + k]) * (x[k] - vectors[j * dim + k]);
+                    }
+                    double value = dot;
+                    if (kernel == SvmKernel::POLYNOMIAL) {
+                        value = std::pow(params.gamma * dot + params.coef0, params.degree);
+                    } else if (kernel == SvmKernel::RBF) {
+                        value = std::exp(-params.gamma * dist);
+                    }
+                    expected += coef[o * count + j] * value;
+                }
+                EXPECT_NEAR(output[r * outputs + o], expected, 1e-3) << svmKernelName(kernel);
+            }
+
+            float single[2];
+            ASSERT_TRUE(model->inference(x, dim, single, outputs));
+            EXPECT_NEAR(single[0], output[r * outputs], 1e-4f);
+            EXPECT_NEAR(single[1], output[r * outputs + 1], 1e-4f);
+        }
+
+        // Round trip through the model file format
+        const std::string path = ::testing::TempDir() + "svm_model.xyzm";
+        ASSERT_TRUE(model->save(path));
+        auto loaded = std::make_shared<AIModel>("svm_loaded", ModelType::SVM);
+        ASSERT_TRUE(loaded->load(path));
+        ASSERT_TRUE(loaded->initialize(config));
+        std::vector<float> reloaded(rows * outputs);
+        ASSERT_TRUE(loaded->inferenceBatch(input.data(), rows, dim, reloaded.data()));
+        EXPECT_EQ(reloaded, output);
+        EXPECT_TRUE(model->inference(std::vector<float>(dim + 1, 0.0f)).empty());
+    }
+}
+
+TEST_F(ModelTest, Int8Quantization) {
+    ModelConfig config;
+    config.name = "quant_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "64,128,16";
+
+    auto reference = std::make_shared<AIModel>("float_net", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(reference->initialize(config));
+    config.parameters["precision"] = "int8";
+    auto model = std::make_shared<AIModel>("int8_net", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(model->initialize(config));
+    ASSERT_TRUE(model->getNetwork().isQuantized());
+
+    // Weights shrink close to 4x; the measured error stays small
+    auto metrics = model->getMetrics();
+    EXPECT_LT(metrics.weightBytes * 3, reference->getMetrics().weightBytes);
+    EXPECT_GT(metrics.quantizationError, 0.0);
+    EXPECT_LT(metrics.quantizationError, 0.05);
+
+    const size_t rows = 9;
+    std::vector<float> input(rows * 64);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.71f);
+    }
+    std::vector<float> expected(rows * 16), output(rows * 16);
+    ASSERT_TRUE(reference->inferenceBatch(input.data(), rows, 64, expected.data()));
+    ASSERT_TRUE(model->inferenceBatch(input.data(), rows, 64, output.data()));
+    for (size_t i = 0; i < output.size(); ++i) {
+        EXPECT_NEAR(output[i], expected[i], 0.05f);
+    }
+    std::vector<float> single(16);
+    ASSERT_TRUE(model->inference(input.data(), 64, single.data(), single.size()));
+    EXPECT_TRUE(std::equal(single.begin(), single.end(), output.begin()));
+
+    // Integer kernels agree exactly with the scalar reference
+    const size_t cols = 100, outs = 7;
+    DenseLayer layer(cols, outs, kernels::Activation::NONE);
+    for (size_t r = 0; r < outs; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            layer.weight(r, c) = std::cos(static_cast<float>(r * cols + c));
+        }
+    }
+    layer.quantize();
+    std::vector<int8_t> x(kernels::paddedStrideInt8(cols), 5);
+    const float xScale = kernels::quantizeSymmetric(input.data(), cols, x.data());
+    std::vector<float> scalar(outs);
+    kernels::getKernels(kernels::SimdLevel::SCALAR).gemvInt8(layer.quantWeights.data(), layer.quantStride,
+                                                             layer.scales.data(), layer.bias.data(), x.data(),
+                                                             xScale, scalar.data(), outs, cols);
+    for (auto level : {kernels::SimdLevel::AVX2, kernels::SimdLevel::AVX512}) {
+        std::vector<float> simd(outs);
+        kernels::getKernels(level).gemvInt8(layer.quantWeights.data(), layer.quantStride, layer.scales.data(),
+                                            layer.bias.data(), x.data(), xScale, simd.data(), outs, cols);
+        EXPECT_EQ(simd, scalar) << kernels::simdLevelName(level);
+    }
+
+    // Quantized weights and the measured error survive a round trip
+    const std::string path = ::testing::TempDir() + "int8_model.xyzm";
+    ASSERT_TRUE(model->save(path));
+    auto loaded = std::make_shared<AIModel>("int8_loaded", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(loaded->load(path));
+    ASSERT_TRUE(loaded->initialize(config));
+    const AIModel& loadedView = *loaded;
+    EXPECT_TRUE(loadedView.getNetwork().getLayers()[0].quantWeights.isBorrowed());
+    EXPECT_NEAR(loaded->getMetrics().quantizationError, metrics.quantizationError, 1e-6);
+    std::vector<float> reloaded(rows * 16);
+    ASSERT_TRUE(loaded->inferenceBatch(input.data(), rows, 64, reloaded.data()));
+    EXPECT_EQ(reloaded, output);
+
+    config.parameters["precision"] = "int4";
+    auto unsupported = std::make_shared<AIModel>("int4_net", ModelType::NEURAL_NETWORK);
+    EXPECT_FALSE(unsupported->initialize(config));
+}
+
+TEST_F(ModelTest, HalfPrecisionWeights) {
+    using kernels::HalfType;
+    // Round to nearest even, range limits and subnormals
+    EXPECT_EQ(kernels::floatToHalf(1.0f, HalfType::FP16), 0x3C00);
+    EXPECT_EQ(kernels::floatToHalf(-2.0f, HalfType::FP16), 0xC000);
+    EXPECT_EQ(kernels::floatToHalf(65504.0f, HalfType::FP16), 0x7BFF);
+    EXPECT_EQ(kernels::floatToHalf(65520.0f, HalfType::FP16), 0x7C00);
+    EXPECT_EQ(kernels::floatToHalf(1.0f + 1.0f / 2048.0f, HalfType::FP16), 0x3C00);
+    EXPECT_EQ(kernels::floatToHalf(1.0f + 3.0f / 2048.0f, HalfType::FP16), 0x3C02);
+    EXPECT_EQ(kernels::floatToHalf(std::ldexp(1.0f, -24), HalfType::FP16), 0x0001);
+    EXPECT_EQ(kernels::halfToFloat(0x0001, HalfType::FP16), std::ldexp(1.0f, -24));
+    EXPECT_EQ(kernels::halfToFloat(0xC000, HalfType::FP16), -2.0f);
+    EXPECT_TRUE(std::isnan(kernels::halfToFloat(kernels::floatToHalf(NAN, HalfType::FP16), HalfType::FP16)));
+    EXPECT_EQ(kernels::floatToHalf(1.0f, HalfType::BF16), 0x3F80);
+    EXPECT_EQ(kernels::floatToHalf(1.0f + 1.0f / 256.0f, HalfType::BF16), 0x3F80);
+    EXPECT_EQ(kernels::floatToHalf(1.0f + 3.0f / 256.0f, HalfType::BF16), 0x3F82);
+    EXPECT_EQ(kernels::halfToFloat(0x7F7F, HalfType::BF16), 0x1.FEp127f);
+    EXPECT_TRUE(std::isnan(kernels::halfToFloat(kernels::floatToHalf(NAN, HalfType::BF16), HalfType::BF16)));
+    for (float value : {0.1f, -3.7f, 1234.5f, 6e-5f}) {
+        for (auto type : {HalfType::FP16, HalfType::BF16}) {
+            const float tolerance = std::fabs(value) * (type == HalfType::FP16 ? 1.0f / 1024 : 1.0f / 128);
+            EXPECT_NEAR(kernels::halfToFloat(kernels::floatToHalf(value, type), type), value, tolerance);
+        }
+    }
+
+    // Widening kernels at every level agree with the scalar reference on
+    // odd shapes
+    const size_t cols = 37, outs = 11, batch = 6;
+    for (auto type : {HalfType::FP16, HalfType::BF16}) {
+        DenseLayer layer(cols, outs, kernels::Activation::NONE);
+        for (size_t r = 0; r < outs; ++r) {
+            layer.bias[r] = 0.1f * static_cast<float>(r);
+            for (size_t c = 0; c < cols; ++c) {
+                layer.weight(r, c) = std::cos(static_cast<float>(r * cols + c));
+            }
+        }
+        layer.toHalf(type);
+        ASSERT_TRUE(layer.halfPrecision());
+        EXPECT_TRUE(layer.weights.empty());
+        std::vector<float> x(batch * cols);
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = std::sin(static_cast<float>(i) * 0.3f);
+        }
+        const auto& scalar = kernels::getKernels(kernels::SimdLevel::SCALAR);
+        const auto index = static_cast<size_t>(type);
+        std::vector<float> expected(batch * outs);
+        scalar.gemmHalf[index](layer.halfWeights.data(), layer.stride, layer.bias.data(), x.data(), cols,
+                               expected.data(), outs, batch, outs, cols);
+        for (auto level : {kernels::SimdLevel::SCALAR, kernels::SimdLevel::AVX2, kernels::SimdLevel::AVX512}) {
+            const auto& table = kernels::getKernels(level);
+            std::vector<float> batched(batch * outs), single(outs);
+            table.gemmHalf[index](layer.halfWeights.data(), layer.stride, layer.bias.data(), x.data(), cols,
+                                  batched.data(), outs, batch, outs, cols);
+            table.gemvHalf[index](layer.halfWeights.data(), layer.stride, layer.bias.data(), x.data() + cols,
+                                  single.data(), outs, cols);
+            for (size_t i = 0; i < batched.size(); ++i) {
+                EXPECT_NEAR(batched[i], expected[i], 1e-4f) << kernels::simdLevelName(level);
+            }
+            for (size_t r = 0; r < outs; ++r) {
+                EXPECT_NEAR(single[r], expected[outs + r], 1e-4f) << kernels::simdLevelName(level);
+            }
+        }
+    }
+
+    // Models store half the weight bytes and stay close to the float model
+    ModelConfig config;
+    config.name = "half_model";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "64,128,16";
+    auto reference = std::make_shared<AIModel>("float_net", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(reference->initialize(config));
+    const size_t rows = 9;
+    std::vector<float> input(rows * 64);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = std::sin(static_cast<float>(i) * 0.71f);
+    }
+    std::vector<float> expected(rows * 16);
+    ASSERT_TRUE(reference->inferenceBatch(input.data(), rows, 64, expected.data()));
+    const size_t floatBytes = reference->getMetrics().weightBytes;
+
+    for (const std::string precision : {"float16", "bfloat16"}) {
+        config.parameters["precision"] = precision;
+        auto model = std::make_shared<AIModel>("half_net", ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(model->initialize(config));
+        const AIModel& view = *model;
+        ASSERT_TRUE(view.getNetwork().isHalfPrecision()) << precision;
+        auto metrics = model->getMetrics();
+        EXPECT_LT(metrics.weightBytes * 10, floatBytes * 6) << precision;
+        EXPECT_GT(metrics.quantizationError, 0.0) << precision;
+        const float tolerance = precision == "float16" ? 0.005f : 0.03f;
+        EXPECT_LT(metrics.quantizationError, tolerance) << precision;
+
+        std::vector<float> output(rows * 16), single(16);
+        ASSERT_TRUE(model->inferenceBatch(input.data(), rows, 64, output.data()));
+        for (size_t i = 0; i < output.size(); ++i) {
+            EXPECT_NEAR(output[i], expected[i], tolerance) << precision;
+        }
+        ASSERT_TRUE(model->inference(input.data(), 64, single.data(), single.size()));
+        for (size_t i = 0; i < single.size(); ++i) {
+            EXPECT_NEAR(single[i], output[i], 1e-5f) << precision;
+        }
+
+        // 16-bit tensors load in place and keep their type
+        const std::string path = ::testing::TempDir() + precision + "_model.xyzm";
+        ASSERT_TRUE(model->save(path));
+        auto loaded = std::make_shared<AIModel>("half_loaded", ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(loaded->load(path));
+        ASSERT_TRUE(loaded->initialize(config));
+        const AIModel& loadedView = *loaded;
+        EXPECT_TRUE(loadedView.getNetwork().getLayers()[0].halfWeights.isBorrowed()) << precision;
+        EXPECT_EQ(loadedView.getNetwork().getLayers()[0].halfType, view.getNetwork().getLayers()[0].halfType);
+        EXPECT_NEAR(loaded->getMetrics().quantizationError, metrics.quantizationError, 1e-6);
+        std::vector<float> reloaded(rows * 16);
+        ASSERT_TRUE(loaded->inferenceBatch(input.data(), rows, 64, reloaded.data()));
+        EXPECT_EQ(reloaded, output) << precision;
+
+        std::vector<std::vector<float>> data(4, std::vector<float>(80, 0.5f));
+        EXPECT_FALSE(model->train(data)) << precision;
+    }
+}
+
+TEST_F(ModelTest, SparseInput) {
+    // Rows of 300 features with a handful of non-zeros at varying offsets;
+    // `dense` gets the same rows densified
+    const size_t dim = 300, rows = 7;
+    std::vector<size_t> offsets = {0};
+    std::vector<uint32_t> indices;
+    std::vector<float> values;
+    std::vector<float> dense(rows * dim, 0.0f);
+    for (size_t r = 0; r < rows; ++r) {
+        // Row 3 is empty; the others cover the vector bodies and tails
+        const size_t nnz = r == 3 ? 0 : 3 + r * 7;
+        for (size_t k = 0; k < nnz; ++k) {
+            const uint32_t index = static_cast<uint32_t>((r * 13 + k * (dim / nnz)) % dim);
+            if (!indices.empty() && offsets.back() < indices.size() && indices.back() >= index) {
+                continue;
+            }
+            const float value = std::sin(static_cast<float>(index + r) * 0.77f) * 2.0f;
+            indices.push_back(index);
+            values.push_back(value);
+            dense[r * dim + index] = value;
+        }
+        offsets.push_back(indices.size());
+    }
+    SparseBatch batch{offsets.data(), indices.data(), values.data(), rows, dim};
+    ASSERT_TRUE(batch.valid());
+
+    // Gather and axpy kernels at every level match the dense dot products
+    const size_t outs = 70;
+    const size_t ld = kernels::paddedStride(dim), columnStride = kernels::paddedStride(outs);
+    AlignedBuffer<float> weights(outs * ld), columns(dim * columnStride), bias(outs);
+    for (size_t o = 0; o < outs; ++o) {
+        bias[o] = 0.01f * static_cast<float>(o);
+        for (size_t c = 0; c < dim; ++c) {
+            weights[o * ld + c] = std::cos(static_cast<float>(o * dim + c) * 0.13f);
+            columns[c * columnStride + o] = weights[o * ld + c];
+        }
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        const SparseVector x = batch.row(r);
+        std::vector<float> expected(outs);
+        for (size_t o = 0; o < outs; ++o) {
+            double sum = bias[o];
+            for (size_t c = 0; c < dim; ++c) {
+                sum += static_cast<double>(weights[o * ld + c]) * dense[r * dim + c];
+            }
+            expected[o] = static_cast<float>(sum);
+        }
+        for (auto level : {kernels::SimdLevel::SCALAR, kernels::SimdLevel::AVX2, kernels::SimdLevel::AVX512}) {
+            const auto& table = kernels::getKernels(level);
+            std::vector<float> gathered(outs), accumulated(outs);
+            table.sparseGather(weights.data(), ld, bias.data(), x.indices, x.values, x.nnz, gathered.data(), outs);
+            table.sparseAxpy(columns.data(), columnStride, bias.data(), x.indices, x.values, x.nnz,
+                             accumulated.data(), outs);
+            for (size_t o = 0; o < outs; ++o) {
+                EXPECT_NEAR(gathered[o], expected[o], 1e-4f) << kernels::simdLevelName(level);
+                EXPECT_NEAR(accumulated[o], expected[o], 1e-4f) << kernels::simdLevelName(level);
+            }
+        }
+    }
+
+    // Networks: a sparse row matches its densified input, also as a batch
+    ModelConfig config;
+    config.name = "sparse_net";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "300,70,5";
+    std::string mean, scale;
+    for (size_t c = 0; c < dim; ++c) {
+        mean += std::to_string(0.01f * static_cast<float>(c % 7)) + ",";
+        scale += std::to_string(1.0f + 0.1f * static_cast<float>(c % 3)) + ",";
+    }
+    config.parameters["input_mean"] = mean;
+    config.parameters["input_scale"] = scale;
+    auto plain = std::make_shared<AIModel>("dense_only_net", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(plain->initialize(config));
+    float out[5];
+    EXPECT_FALSE(plain->inference(batch.row(0), out, 5));
+
+    config.parameters["sparse_input"] = "true";
+    for (const std::string precision : {"float32", "int8"}) {
+        config.parameters["precision"] = precision;
+        auto model = std::make_shared<AIModel>("sparse_net", ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(model->initialize(config));
+        const AIModel& view = *model;
+        ASSERT_TRUE(view.getNetwork().hasSparseInput());
+        // The int8 network quantizes dense inputs, sparse ones are not
+        const float tolerance = precision == "int8" ? 0.05f : 1e-4f;
+
+        std::vector<float> expected(rows * 5), sparseBatch(rows * 5);
+        ASSERT_TRUE(model->inferenceBatch(dense.data(), rows, dim, expected.data()));
+        ASSERT_TRUE(model->inferenceBatch(batch, sparseBatch.data()));
+        for (size_t r = 0; r < rows; ++r) {
+            ASSERT_TRUE(model->inference(batch.row(r), out, 5));
+            for (size_t o = 0; o < 5; ++o) {
+                EXPECT_NEAR(out[o], expected[r * 5 + o], tolerance) << precision << " row " << r;
+                EXPECT_NEAR(sparseBatch[r * 5 + o], out[o], 1e-5f) << precision << " row " << r;
+            }
+        }
+    }
+
+    // A normalization the first layer cannot absorb is folded into the
+    // sparse copy instead
+    DenseNetwork network;
+    network.configure({dim, 24, 3}, kernels::Activation::RELU, kernels::Activation::NONE, 7);
+    network.quantize(7);
+    std::vector<float> meanValues(dim), scaleValues(dim);
+    for (size_t c = 0; c < dim; ++c) {
+        meanValues[c] = 0.05f * static_cast<float>(c % 5);
+        scaleValues[c] = 0.5f + 0.01f * static_cast<float>(c % 11);
+    }
+    ASSERT_TRUE(network.prepareSparseInput());
+    network.setInputNormalization(meanValues, scaleValues);
+    EXPECT_TRUE(network.hasInputNormalization());
+    for (size_t r = 0; r < rows; ++r) {
+        float expectedRow[3], sparseRow[3];
+        network.forward(&dense[r * dim], dim, expectedRow);
+        network.forwardSparse(batch.row(r), sparseRow);
+        for (size_t o = 0; o < 3; ++o) {
+            EXPECT_NEAR(sparseRow[o], expectedRow[o], 0.05f) << "row " << r;
+        }
+    }
+
+    // SVMs, trees and forests need no preparation
+    std::vector<float> vectors(20 * dim), coef(2 * 20);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        vectors[i] = std::sin(static_cast<float>(i) * 0.29f) * 0.3f;
+    }
+    for (size_t i = 0; i < coef.size(); ++i) {
+        coef[i] = std::cos(static_cast<float>(i) * 1.1f);
+    }
+    auto expectSparseMatchesDense = [&](AIModel& model, size_t width) {
+        std::vector<float> expected(rows * width), sparseBatch(rows * width), single(width);
+        ASSERT_TRUE(model.inferenceBatch(dense.data(), rows, dim, expected.data()));
+        ASSERT_TRUE(model.inferenceBatch(batch, sparseBatch.data()));
+        for (size_t r = 0; r < rows; ++r) {
+            ASSERT_TRUE(model.inference(batch.row(r), single.data(), width));
+            for (size_t o = 0; o < width; ++o) {
+                EXPECT_NEAR(single[o], expected[r * width + o], 1e-4f) << model.getModelId() << " row " << r;
+                EXPECT_NEAR(sparseBatch[r * width + o], single[o], 1e-6f) << model.getModelId();
+            }
+        }
+    };
+    for (auto kernel : {SvmKernel::LINEAR, SvmKernel::RBF}) {
+        SvmParams params;
+        params.kernel = kernel;
+        params.gamma = 0.05f;
+        auto svm = std::make_shared<AIModel>("sparse_" + svmKernelName(kernel), ModelType::SVM);
+        svm->getSvm().build(params, vectors, 20, dim, coef, {0.5f, -0.25f});
+        ModelConfig svmConfig;
+        svmConfig.name = "sparse_svm";
+        svmConfig.type = ModelType::SVM;
+        ASSERT_TRUE(svm->initialize(svmConfig));
+        expectSparseMatchesDense(*svm, 2);
+    }
+
+    std::vector<TreeNode> nodes(5);
+    nodes[0] = {120, 0.0f, 1, 2, {}};
+    nodes[1].value = {-1.0f};
+    nodes[2] = {277, -0.5f, 3, 4, {}};
+    nodes[3].value = {1.0f};
+    nodes[4].value = {2.0f};
+    auto tree = std::make_shared<AIModel>("sparse_tree", ModelType::DECISION_TREE);
+    tree->getTree().build(nodes, 1);
+    ModelConfig treeConfig;
+    treeConfig.name = "sparse_tree";
+    treeConfig.type = ModelType::DECISION_TREE;
+    ASSERT_TRUE(tree->initialize(treeConfig));
+    expectSparseMatchesDense(*tree, 1);
+
+    std::vector<DecisionTree> trees;
+    for (int t = 0; t < 9; ++t) {
+        trees.push_back(DecisionTree::stump(t * 31, 0.1f * static_cast<float>(t % 3), static_cast<float>(t), -1.0f));
+    }
+    auto forest = std::make_shared<AIModel>("sparse_forest", ModelType::RANDOM_FOREST);
+    forest->getForest().build(trees);
+    ModelConfig forestConfig;
+    forestConfig.name = "sparse_forest";
+    forestConfig.type = ModelType::RANDOM_FOREST;
+    ASSERT_TRUE(forest->initialize(forestConfig));
+    expectSparseMatchesDense(*forest, 1);
+
+    // Models without an engine pass the densified row through
+    auto passthrough = std::make_shared<AIModel>("sparse_passthrough", ModelType::SVM);
+    ModelConfig passthroughConfig;
+    passthroughConfig.name = "sparse_passthrough";
+    passthroughConfig.type = ModelType::SVM;
+    ASSERT_TRUE(passthrough->initialize(passthroughConfig));
+    expectSparseMatchesDense(*passthrough, dim);
+
+    // Malformed inputs are rejected and counted
+    const uint64_t errors = tree->getMetrics().errors;
+    const uint32_t unordered[] = {5, 2};
+    const uint32_t outOfRange[] = {2, dim};
+    const float twoValues[] = {1.0f, 1.0f};
+    EXPECT_FALSE(tree->inference(SparseVector{unordered, twoValues, 2, dim}, out, 1));
+    EXPECT_FALSE(tree->inference(SparseVector{outOfRange, twoValues, 2, dim}, out, 1));
+    EXPECT_FALSE(tree->inference(SparseVector{nullptr, nullptr, 0, 100}, out, 1));
+    EXPECT_FALSE(tree->inference(batch.row(0), out, 0));
+    EXPECT_EQ(tree->getMetrics().errors, errors + 4);
+}
+
+TEST_F(ModelTest, StreamingInference) {
+    // Window statistics and EMA match a recomputation over the samples
+    StreamConfig config;
+    config.window = 5;
+    config.emaAlpha = 0.25f;
+    StreamState stream(config, 2);
+    ASSERT_EQ(stream.rowSize(), 8u);
+    std::vector<std::vector<float>> history;
+    double ema[2] = {0.0, 0.0};
+    for (size_t n = 0; n < 23; ++n) {
+        const std::vector<float> sample = {std::sin(static_cast<float>(n) * 0.7f),
+                                           static_cast<float>(n % 4) - 1.5f};
+        history.push_back(sample);
+        const float* row = stream.update(sample.data());
+        const size_t fill = std::min<size_t>(history.size(), config.window);
+        EXPECT_EQ(stream.windowFill(), fill);
+        for (size_t c = 0; c < 2; ++c) {
+            ema[c] = n == 0 ? sample[c] : ema[c] + config.emaAlpha * (sample[c] - ema[c]);
+            double mean = 0.0, variance = 0.0;
+            for (size_t i = history.size() - fill; i < history.size(); ++i) {
+                mean += history[i][c] / static_cast<double>(fill);
+            }
+            for (size_t i = history.size() - fill; i < history.size(); ++i) {
+                variance += (history[i][c] - mean) * (history[i][c] - mean) / static_cast<double>(fill);
+            }
+            EXPECT_EQ(row[c], sample[c]);
+            EXPECT_NEAR(row[2 + c], mean, 1e-5) << "sample " << n;
+            EXPECT_NEAR(row[4 + c], std::sqrt(variance), 1e-4) << "sample " << n;
+            EXPECT_NEAR(row[6 + c], ema[c], 1e-5) << "sample " << n;
+        }
+    }
+    EXPECT_EQ(stream.samples(), 23u);
+
+    // Running sums on a large offset stay accurate over a long stream
+    StreamConfig driftConfig;
+    driftConfig.window = 16;
+    driftConfig.features = {StreamFeature::STDDEV};
+    StreamState drift(driftConfig, 1);
+    std::vector<float> tail;
+    const float* row = nullptr;
+    for (size_t n = 0; n < 20000; ++n) {
+        const float x = 1e4f + std::sin(static_cast<float>(n) * 0.37f);
+        row = drift.update(&x);
+        tail.push_back(x);
+    }
+    double mean = 0.0, variance = 0.0;
+    for (size_t i = tail.size() - 16; i < tail.size(); ++i) {
+        mean += tail[i] / 16.0;
+    }
+    for (size_t i = tail.size() - 16; i < tail.size(); ++i) {
+        variance += (tail[i] - mean) * (tail[i] - mean) / 16.0;
+    }
+    EXPECT_NEAR(row[0], std::sqrt(variance), 1e-3);
+
+    // A model with fed-back hidden state: each step sees the stream's
+    // features followed by its own first three outputs from the step before
+    auto model = std::make_shared<AIModel>("stream_net", ModelType::NEURAL_NETWORK);
+    ModelConfig modelConfig;
+    modelConfig.name = "stream_net";
+    modelConfig.type = ModelType::NEURAL_NETWORK;
+    modelConfig.parameters["layers"] = "6,8,4";
+    modelConfig.parameters["stream_window"] = "4";
+    modelConfig.parameters["stream_features"] = "value,mean,ema";
+    modelConfig.parameters["stream_hidden"] = "3";
+    ASSERT_TRUE(model->initialize(modelConfig));
+    auto state = model->createStream(1);
+    ASSERT_NE(state, nullptr);
+    ASSERT_EQ(state->rowSize(), 6u);
+
+    StreamConfig referenceConfig;
+    referenceConfig.window = 4;
+    referenceConfig.features = {StreamFeature::VALUE, StreamFeature::MEAN, StreamFeature::EMA};
+    StreamState reference(referenceConfig, 1);
+    float hidden[3] = {0.0f, 0.0f, 0.0f};
+    std::vector<std::vector<float>> outputs;
+    for (size_t n = 0; n < 12; ++n) {
+        const float x = std::cos(static_cast<float>(n) * 0.45f);
+        const float* features = reference.update(&x);
+        float input[6] = {features[0], features[1], features[2], hidden[0], hidden[1], hidden[2]};
+        float expected[4], output[4];
+        ASSERT_TRUE(model->inference(input, 6, expected, 4));
+        ASSERT_TRUE(model->inferenceStream(*state, &x, 1, output, 4));
+        for (size_t o = 0; o < 4; ++o) {
+            EXPECT_NEAR(output[o], expected[o], 1e-6f) << "sample " << n;
+        }
+        std::copy(expected, expected + 3, hidden);
+        outputs.emplace_back(output, output + 4);
+    }
+
+    // reset() starts over from an empty window and zero hidden state
+    state->reset();
+    float output[4];
+    const float first = 1.0f;
+    ASSERT_TRUE(model->inferenceStream(*state, &first, 1, output, 4));
+    EXPECT_EQ(std::vector<float>(output, output + 4), outputs[0]);
+
+    // Rejected samples leave the stream untouched
+    const uint64_t errors = model->getMetrics().errors;
+    const float pair[2] = {0.5f, 0.5f};
+    EXPECT_FALSE(model->inferenceStream(*state, pair, 2, output, 4));
+    EXPECT_FALSE(model->inferenceStream(*state, &first, 1, output, 3));
+    EXPECT_EQ(model->getMetrics().errors, errors + 2);
+    EXPECT_EQ(state->samples(), 1u);
+
+    // Invalid configurations make no stream
+    model->setParameter("stream_features", "value,median");
+    EXPECT_EQ(model->createStream(1), nullptr);
+    model->setParameter("stream_features", "value");
+    EXPECT_EQ(model->createStream(0), nullptr);
+    model->setParameter("stream_ema_alpha", "0");
+    EXPECT_EQ(model->createStream(1), nullptr);
+}
+
+TEST_F(ModelTest, NetworkTraining) {
+    // y = sin(2 * x0) * x1, inputs in [-1, 1]
+    std::vector<std::vector<float>> data;
+    for (int i = 0; i < 256; ++i) {
+        const float x0 = std::sin(static_cast<float>(i) * 0.37f);
+        const float x1 = std::cos(static_cast<float>(i) * 0.71f);
+        data.push_back({x0, x1, std::sin(2.0f * x0) * x1});
+    }
+    auto meanSquaredError = [&](AIModel& model) {
+        double sum = 0.0;
+        for (const auto& row : data) {
+            const float error = model.inference({row[0], row[1]})[0] - row[2];
+            sum += error * error;
+        }
+        return sum / data.size();
+    };
+
+    for (const std::string optimizer : {"adam", "sgd"}) {
+        ModelConfig config;
+        config.name = "train_model";
+        config.type = ModelType::NEURAL_NETWORK;
+        config.parameters["layers"] = "2,24,1";
+        config.parameters["activation"] = "tanh";
+        config.parameters["output_activation"] = "none";
+        config.parameters["optimizer"] = optimizer;
+        config.parameters["learning_rate"] = optimizer == "adam" ? "0.01" : "0.1";
+        config.parameters["batch_size"] = "32";
+        config.parameters["epochs"] = "100";
+
+        auto model = std::make_shared<AIModel>("train_" + optimizer, ModelType::NEURAL_NETWORK);
+        ASSERT_TRUE(model->initialize(config));
+        const double before = meanSquaredError(*model);
+        ASSERT_TRUE(model->train(data));
+        const double after = meanSquaredError(*model);
+        EXPECT_LT(after, before * 0.1) << optimizer;
+        // The reported loss is half the mean squared error of the last epoch
+        EXPECT_GT(model->getMetrics().trainingLoss, 0.0);
+        EXPECT_LT(model->getMetrics().trainingLoss, before);
+
+        // Training continues from the current weights and optimizer state
+        ASSERT_TRUE(model->train(data));
+        EXPECT_LE(meanSquaredError(*model), after * 1.5) << optimizer;
+    }
+
+    // Loaded weights borrow the read-only file mapping; training copies them
+    // and leaves the file as it was
+    ModelConfig fileConfig;
+    fileConfig.name = "train_file";
+    fileConfig.type = ModelType::NEURAL_NETWORK;
+    fileConfig.parameters["layers"] = "2,24,1";
+    fileConfig.parameters["activation"] = "tanh";
+    fileConfig.parameters["output_activation"] = "none";
+    fileConfig.parameters["learning_rate"] = "0.01";
+    auto source = std::make_shared<AIModel>("train_file", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(source->initialize(fileConfig));
+    const std::string path = ::testing::TempDir() + "train_file.xyzm";
+    ASSERT_TRUE(source->save(path));
+    auto loaded = std::make_shared<AIModel>("train_loaded", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(loaded->load(path));
+    ASSERT_TRUE(loaded->initialize(fileConfig));
+    const double untrained = meanSquaredError(*loaded);
+    ASSERT_TRUE(loaded->train(data));
+    EXPECT_LT(meanSquaredError(*loaded), untrained);
+    auto reloaded = std::make_shared<AIModel>("train_reloaded", ModelType::NEURAL_NETWORK);
+    ASSERT_TRUE(reloaded->load(path));
+    ASSERT_TRUE(reloaded->initialize(fileConfig));
+    EXPECT_EQ(meanSquaredError(*reloaded), untrained);
+
+    auto model = std::make_shared<AIModel>("train_bad", ModelType::NEURAL_NETWORK);
+    ModelConfig config;
+    config.name = "train_bad";
+    config.type = ModelType::NEURAL_NETWORK;
+    config.parameters["layers"] = "2,4,1";
+    ASSERT_TRUE(model->initialize(config));
+    EXPECT_FALSE(model->train({{1.0f, 2.0f}}));
+    model->setParameter("optimizer", "rmsprop");
+    EXPECT_FALSE(model->train(data));
+}
+
+TEST_F(ModelTest, TreeTraining) {
+    // Piecewise target a single tree can represent, plus a smooth one
+    std::vector<std::vector<float>> steps, smooth;
+    for (int i = 0; i < 2000; ++i) {
+        const float x0 = std::sin(static_cast<float>(i) * 0.37f);
+        const float x1 = std::cos(static_cast<float>(i) * 0.53f);
+        const float x2 = std::sin(static_cast<float>(i) * 1.13f + 0.4f);
+        const float step = x0 > 0.2f ? (x1 > -0.3f ? 2.0f : 1.0f) : 0.0f;
+        steps.push_back({x0, x1, x2, step});
+        smooth.push_back({x0, x1, x2, std::sin(2.0f * x0) + x1 * x2});
+    }
+
+    auto makeModel = [](const std::string& name, ModelType type,
+                        const std::unordered_map<std::string, std::string>& parameters) {
+        auto model = std::make_shared<AIModel>(name, type);
+        ModelConfig config;
+        config.name = name;
+        config.type = type;
+        config.parameters = parameters;
+        EXPECT_TRUE(model->initialize(config));
+        return model;
+    };
+
+    auto tree = makeModel("tree_train", ModelType::DECISION_TREE, {});
+    ASSERT_TRUE(tree->train(steps));
+    double treeError = 0.0;
+    for (const auto& row : steps) {
+        treeError += std::fabs(tree->inference({row[0], row[1], row[2]})[0] - row[3]);
+    }
+    EXPECT_LT(treeError / steps.size(), 0.02);
+    EXPECT_LE(tree->getTree().getDepth(), 8u);
+
+    auto meanSquaredError = [&](AIModel& model) {
+        double sum = 0.0;
+        for (const auto& row : smooth) {
+            const float error = model.inference({row[0], row[1], row[2]})[0] - row[3];
+            sum += error * error;
+        }
+        return sum / smooth.size();
+    };
+    double variance = 0.0, mean = 0.0;
+    for (const auto& row : smooth) {
+        mean += row[3] / smooth.size();
+    }
+    for (const auto& row : smooth) {
+        variance += (row[3] - mean) * (row[3] - mean) / smooth.size();
+    }
+
+    auto forest = makeModel("forest_train", ModelType::RANDOM_FOREST, {{"trees", "20"}, {"max_features", "3"}});
+    ASSERT_TRUE(forest->train(smooth));
+    EXPECT_EQ(forest->getForest().getTreeCount(), 20u);
+    EXPECT_LT(meanSquaredError(*forest), variance * 0.1);
+
+    // Bootstrap samples are seeded per tree, so retraining is reproducible
+    auto again = makeModel("forest_again", ModelType::RANDOM_FOREST, {{"trees", "20"}, {"max_features", "3"}});
+    ASSERT_TRUE(again->train(smooth));
+    EXPECT_EQ(meanSquaredError(*again), meanSquaredError(*forest));
+
+    // One-hot targets give leaves holding class frequencies
+    std::vector<std::vector<float>> classes;
+    for (const auto& row : steps) {
+        classes.push_back({row[0], row[1], row[2], row[3] > 0.5f ? 1.0f : 0.0f, row[3] > 0.5f ? 0.0f : 1.0f});
+    }
+    auto classifier = makeModel("tree_classes", ModelType::DECISION_TREE, {{"outputs", "2"}, {"max_depth", "2"}});
+    ASSERT_TRUE(classifier->train(classes));
+    auto probabilities = classifier->inference({0.9f, 0.9f, 0.0f});
+    ASSERT_EQ(probabilities.size(), 2u);
+    EXPECT_NEAR(probabilities[0] + probabilities[1], 1.0f, 1e-5f);
+    EXPECT_GT(probabilities[0], 0.9f);
+
+    EXPECT_FALSE(tree->train({{1.0f}}));
 }
 
 } // namespace tests
@@ -27,7 +27,7 @@ constexpr auto HEARTBEAT_INTERVAL = 1000;
 
 // Memory limits (in bytes)
 constexpr auto MAX_MEMORY_PER_AGENT = 1024 * 1024 * 100;  // 100 MB
-constexpr auto MAX_TOTAL_MEMORY = 1024 * 1024 * 1024 * 2; // 2 GB
+constexpr auto MAX_TOTAL_MEMORY = 1024ULL * 1024 * 1024 * 2; // 2 GB
 
 // File paths and extensions
 struct Paths {
@@ -77,8 +77,12 @@ std::string Logger::getTimestamp() const {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()) % 1000;
 
+    // localtime() shares one static buffer between threads
+    std::tm local{};
+    localtime_r(&time, &local);
+
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S")
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S")
        << '.' << std::setfill('0') << std::setw(3) << ms.count();
     
     return ss.str();
@@ -0,0 +1,117 @@
+#include "rcu.h"
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace xyz {
+namespace utils {
+namespace rcu {
+
+namespace {
+
+// Slots are allocated in blocks and never freed; a slot released by an
+// exiting thread is reused by the next new one
+constexpr size_t SLOTS_PER_BLOCK = 64;
+
+std::atomic<detail::ReaderSlot*> slotList{nullptr};
+
+// Whether membarrier(2) can stand in for reader-side fences. Registration
+// is required before the expedited command may be used.
+bool useMembarrier() {
+    static const bool available = [] {
+#if defined(__linux__) && defined(__NR_membarrier)
+        const long commands = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+        if (commands < 0 || !(commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+            return false;
+        }
+        return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+        return false;
+#endif
+    }();
+    return available;
+}
+
+// Full barrier on the calling thread and on every thread of the process
+// that skips its reader fence
+void heavyBarrier() {
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (useMembarrier() && syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) == 0) {
+        return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+detail::ReaderSlot* claimSlot() {
+    for (detail::ReaderSlot* slot = slotList.load(std::memory_order_acquire); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->claimed.load(std::memory_order_relaxed) &&
+            slot->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+
+    // All taken: add a block with the first slot already ours
+    auto* block = new detail::ReaderSlot[SLOTS_PER_BLOCK];
+    block[0].claimed.store(true, std::memory_order_relaxed);
+    for (size_t i = 0; i + 1 < SLOTS_PER_BLOCK; ++i) {
+        block[i].next = &block[i + 1];
+    }
+    detail::ReaderSlot* head = slotList.load(std::memory_order_relaxed);
+    do {
+        block[SLOTS_PER_BLOCK - 1].next = head;
+    } while (!slotList.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+    return block;
+}
+
+} // namespace
+
+namespace detail {
+
+void registerReader(ReaderState& state) {
+    // Queried before the slot is visible to writers, so a writer that waits
+    // on the slot also issues the barrier it relies on
+    state.fenceless = useMembarrier();
+    state.slot = claimSlot();
+}
+
+ReaderState::~ReaderState() {
+    if (slot) {
+        slot->active.store(0, std::memory_order_release);
+        slot->claimed.store(false, std::memory_order_release);
+    }
+}
+
+} // namespace detail
+
+void synchronize() {
+    static std::mutex writerMutex;
+    std::lock_guard<std::mutex> lock(writerMutex);
+
+    // Readers entering from now on carry `target` or later and already see
+    // everything published before this call
+    const uint64_t target = detail::epoch.fetch_add(1) + 1;
+    // Orders the epoch update and earlier publications against the slot
+    // stores of readers that entered before it
+    heavyBarrier();
+
+    for (detail::ReaderSlot* slot = slotList.load(std::memory_order_acquire); slot; slot = slot->next) {
+        for (;;) {
+            const uint64_t active = slot->active.load(std::memory_order_acquire);
+            if (active == 0 || active >= target) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace rcu
+} // namespace utils
+} // namespace xyz
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace xyz {
+namespace utils {
+
+// Process-wide read-copy-update with wait-free readers.
+//
+// Readers bracket every access to RCU-published data with a ReadGuard. Each
+// thread owns a reader slot on a cache line of its own, so entering a read
+// section is a load of the global epoch and a store to that slot; no other
+// thread writes the line and readers never contend. A writer publishes a new
+// version with an atomic exchange and then calls synchronize(), which
+// returns once no reader can still hold the old version, so it can be freed.
+//
+// Where the kernel supports membarrier(2), synchronize() forces a memory
+// barrier on every running thread instead of readers issuing one, and the
+// read side needs no fence at all. Elsewhere readers fall back to a full
+// fence on entry.
+//
+// Grace periods are shared by all data published this way: synchronize()
+// waits for every reader in the process, not only those of one structure.
+namespace rcu {
+
+namespace detail {
+
+struct alignas(64) ReaderSlot {
+    // Epoch the thread entered its read section in; 0 outside of one
+    std::atomic<uint64_t> active{0};
+    std::atomic<bool> claimed{false};
+    ReaderSlot* next = nullptr;
+};
+
+struct ReaderState {
+    ReaderSlot* slot = nullptr;
+    unsigned nesting = 0;
+    // Writers issue the barrier for this reader
+    bool fenceless = false;
+
+    ~ReaderState();
+};
+
+// Starts at 1 so that 0 can mean "not reading"
+inline std::atomic<uint64_t> epoch{1};
+inline thread_local ReaderState reader;
+
+// Claims a slot for the calling thread
+void registerReader(ReaderState& state);
+
+} // namespace detail
+
+class ReadGuard {
+public:
+    ReadGuard() {
+        detail::ReaderState& state = detail::reader;
+        if (state.nesting++ != 0) {
+            return;
+        }
+        if (!state.slot) {
+            detail::registerReader(state);
+        }
+        // Acquire so a reader that sees a writer's epoch also sees what it
+        // published before
+        state.slot->active.store(detail::epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // The slot store must be visible before any load of published data
+        if (state.fenceless) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    ~ReadGuard() {
+        detail::ReaderState& state = detail::reader;
+        if (--state.nesting == 0) {
+            state.slot->active.store(0, std::memory_order_release);
+        }
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+// Blocks until every read section that started before the call has ended.
+// Must not be called from inside a read section.
+void synchronize();
+
+} // namespace rcu
+
+} // namespace utils
+} // namespace xyz
@@ -0,0 +1,131 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+namespace xyz {
+namespace utils {
+
+namespace {
+
+// Shared between the caller and the helper tasks of one parallelFor; helpers
+// may start after the call has returned, so they hold it by shared_ptr
+struct ParallelRange {
+    size_t count;
+    size_t chunk;
+    size_t chunks;
+    std::function<void(size_t, size_t)> fn;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    // Claims and runs chunks until none are left
+    void run() {
+        size_t index;
+        while ((index = next.fetch_add(1)) < chunks) {
+            const size_t begin = index * chunk;
+            try {
+                fn(begin, std::min(count, begin + chunk));
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            if (done.fetch_add(1) + 1 == chunks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : stopping(false)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // The caller of parallelFor works too, so one thread fewer is enough
+    for (size_t i = 1; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::getInstance() {
+    static ThreadPool instance;
+    return instance;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain,
+                             const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    const size_t maxChunks = std::min(concurrency(), (count + grain - 1) / grain);
+    if (maxChunks <= 1) {
+        fn(0, count);
+        return;
+    }
+
+    auto range = std::make_shared<ParallelRange>();
+    range->count = count;
+    range->chunk = (count + maxChunks - 1) / maxChunks;
+    range->chunks = (count + range->chunk - 1) / range->chunk;
+    range->fn = fn;
+
+    for (size_t i = 1; i < range->chunks; ++i) {
+        submit([range] { range->run(); });
+    }
+    range->run();
+
+    std::unique_lock<std::mutex> lock(range->mutex);
+    range->finished.wait(lock, [&] { return range->done.load() == range->chunks; });
+    if (range->error) {
+        std::rethrow_exception(range->error);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+} // namespace utils
+} // namespace xyz
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace xyz {
+namespace utils {
+
+// Fixed-size worker pool for data-parallel work inside the engines.
+//
+// parallelFor() splits a range into chunks that workers and the calling
+// thread claim from a shared counter, so a call made from inside a worker
+// still makes progress instead of waiting on a busy pool.
+class ThreadPool {
+public:
+    // 0 threads = one per hardware thread
+    explicit ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool shared by all models
+    static ThreadPool& getInstance();
+
+    // Workers plus the calling thread
+    size_t concurrency() const { return workers.size() + 1; }
+
+    void submit(std::function<void()> task);
+
+    // Calls fn(begin, end) over [0, count) in chunks of at least `grain`
+    // items and returns once all chunks are done. The first exception thrown
+    // by fn is rethrown here.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+};
+
+} // namespace utils
+} // namespace xyz